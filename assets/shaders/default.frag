@@ -21,7 +21,7 @@ struct MaterialData{
 	ivec4 textureIndex;
 };
 
-layout(std140,set = 0, binding = 0) readonly buffer DrawDataBuffer{
+layout(std430,set = 0, binding = 0) readonly buffer DrawDataBuffer{
 	DrawData objects[];
 } drawDataArray;
 
@@ -38,18 +38,49 @@ layout(std140,set = 1, binding = 1) uniform  DirLightBuffer{
 } lightData;
 
 
-layout(std140,set = 0, binding = 2) readonly buffer MaterialDataBuffer{
+layout(std430,set = 0, binding = 2) readonly buffer MaterialDataBuffer{
 	MaterialData objects[];
 } materialDataArray;
 
+struct TextureStreaming{
+	uint baseMip;
+	uint requestedMip;
+};
+
+// devices without fragmentStoresAndAtomics use the build with NO_TEXTURE_FEEDBACK, it never writes the buffer
+#ifdef NO_TEXTURE_FEEDBACK
+#define STREAMING_ACCESS readonly
+#else
+#define STREAMING_ACCESS
+#endif
+
+layout(std430,set = 1, binding = 2) STREAMING_ACCESS buffer TextureStreamingBuffer{
+	uint feedback;
+	TextureStreaming textures[];
+} streamingData;
+
 layout (set = 0, binding = 3) uniform sampler samp;
-layout (set = 0, binding = 4) uniform texture2D bindlessTextures[];
+// shared by every frame, material texture indices are slots in it
+layout (set = 2, binding = 0) uniform texture2D bindlessTextures[];
+
+// one pixel in every 8x8 tile reports the mip it samples, counted from the full texture rather than the resident levels
+void requestMip(int textureIndex)
+{
+#ifndef NO_TEXTURE_FEEDBACK
+	float lod = textureQueryLod(sampler2D(bindlessTextures[nonuniformEXT(textureIndex)], samp), inTexCoords).y;
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	if (streamingData.feedback != 0 && ((pixel.x | pixel.y) & 7u) == 0){
+		atomicMin(streamingData.textures[textureIndex].requestedMip, streamingData.textures[textureIndex].baseMip + uint(max(lod, 0.0)));
+	}
+#endif
+}
 
 void main(void)	{
 	DrawData draw = drawDataArray.objects[inDrawDataIndex];
 	MaterialData matData = materialDataArray.objects[draw.materialIndex];
 	int diffuseIndex = matData.textureIndex.x;
 	int normalIndex = matData.textureIndex.y;
+	int ormIndex = matData.textureIndex.z;
 
 	// pass to shader
 	vec3 sunlightDirection = lightData.direction.xyz;
@@ -59,10 +90,25 @@ void main(void)	{
 	float materialShininess = matData.shininess;
 	vec3 materialSpecular = matData.specular;
 
+	// occlusion, roughness and metalness from one sample of the packed texture
+	float occlusion = 1.0;
+	float metalness = 0.0;
+	if (ormIndex >= 0){
+		requestMip(ormIndex);
+		vec3 orm = texture(sampler2D(bindlessTextures[(nonuniformEXT(ormIndex))], samp), inTexCoords).rgb;
+		occlusion = orm.r;
+		// rough surfaces get a wide, dim highlight
+		materialShininess = mix(256.0, 2.0, orm.g);
+		metalness = orm.b;
+	}
+
 	// Diffuse
 	vec3 materialNormal;
 	if (normalIndex >= 0){
-		materialNormal = texture(sampler2D(bindlessTextures[(nonuniformEXT(normalIndex))], samp), inTexCoords).rgb;
+		requestMip(normalIndex);
+		// z is rebuilt from x and y, BC5 normal maps only store those two
+		vec2 normalXY = texture(sampler2D(bindlessTextures[(nonuniformEXT(normalIndex))], samp), inTexCoords).rg * 2.0 - 1.0;
+		materialNormal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
 	} else {
 		materialNormal = inNormal;
 
@@ -74,14 +120,17 @@ void main(void)	{
 
 	vec3 materialDiffuse;
 	if (diffuseIndex >= 0){
+		requestMip(diffuseIndex);
 		materialDiffuse = texture(sampler2D(bindlessTextures[(nonuniformEXT(diffuseIndex))], samp), inTexCoords).rgb;
 	} else {
 		materialDiffuse = (diff * materialDiffuseColour);
 	}
-	diffuse = diffuse * materialDiffuse;
+	// metals have no diffuse term, their specular takes the albedo colour
+	diffuse = diffuse * materialDiffuse * (1.0 - metalness);
+	materialSpecular = mix(materialSpecular, materialDiffuse, metalness);
 
 	//Ambient
-	vec3 ambient = sunlightAmbient * materialDiffuse;
+	vec3 ambient = sunlightAmbient * materialDiffuse * occlusion;
 
 	// Specular
 	vec3 viewDir = normalize(cameraData.cameraPos.xyz - inWorldPos);
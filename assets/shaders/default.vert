@@ -11,6 +11,9 @@ layout (location = 2) out vec3 outNormal;
 layout (location = 3) out vec3 outWorldPos;
 layout (location = 4) out flat int outDrawDataIndex;
 
+// must match depth.vert exactly for the EQUAL test after the depth pre-pass
+invariant gl_Position;
+
 layout( push_constant ) uniform constants
 {
 	int drawDataIndex;
@@ -21,44 +24,47 @@ struct DrawData{
 	int materialIndex;
 };
 
+// first three rows of the affine model matrix
 struct ObjectData{
-	mat4 modelMatrix;
-	mat4 normalMatrix;
-};
-
-struct MaterialData{
-	ivec4 diffuseIndex;
+	vec4 modelRows[3];
 };
 
-layout(std140,set = 0, binding = 0) readonly buffer DrawDataBuffer{
+layout(std430,set = 0, binding = 0) readonly buffer DrawDataBuffer{
 	DrawData objects[];
 } drawDataArray;
 
-layout(std140,set = 0, binding = 1) readonly buffer TransformBuffer{
+layout(std430,set = 0, binding = 1) readonly buffer TransformBuffer{
 	ObjectData objects[];
 } transformData;
 
-layout(std140,set = 0, binding = 2) readonly buffer MaterialDataBuffer{
-	MaterialData objects[];
-} materialDataArray;
-
 layout(std140,set = 1, binding = 0) uniform  CameraBuffer{
 	mat4 viewMatrix;
 	mat4 projMatrix;
 	vec4 cameraPos;
 } cameraData;
 
+mat4 modelFromRows(ObjectData object){
+	return transpose(mat4(object.modelRows[0], object.modelRows[1], object.modelRows[2], vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+// Model matrices are translation * rotation * scale, so inverse transpose of the upper 3x3
+// is each column divided by its squared length.
+mat3 normalFromModel(mat4 model){
+	mat3 m = mat3(model);
+	return mat3(m[0] / dot(m[0], m[0]), m[1] / dot(m[1], m[1]), m[2] / dot(m[2], m[2]));
+}
+
 void main(void)		{
 	DrawData draw = drawDataArray.objects[pushConstants.drawDataIndex];
 	mat4 proj = cameraData.projMatrix;
 	mat4 view = cameraData.viewMatrix;
-	mat4 model = transformData.objects[draw.transformIndex].modelMatrix;
+	mat4 model = modelFromRows(transformData.objects[draw.transformIndex]);
 	mat4 transformMatrix = (proj * view * model);	
 
 	outColor = vColor;
 	outTexCoords = vTexCoord;
 	outDrawDataIndex = pushConstants.drawDataIndex;
-	outNormal = mat3(transformData.objects[draw.transformIndex].normalMatrix) * vNormal;
+	outNormal = normalFromModel(model) * vNormal;
 	outWorldPos = vec3(model * vec4(vPosition, 1.0f));
 
 	gl_Position = transformMatrix * vec4(vPosition, 1.0f);
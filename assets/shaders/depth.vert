@@ -0,0 +1,49 @@
+#version 460
+
+layout (location = 0) in vec3 vPosition;
+
+// default.vert computes the same position, the shading pass tests against this depth with EQUAL
+invariant gl_Position;
+
+layout( push_constant ) uniform constants
+{
+	int drawDataIndex;
+} pushConstants;
+
+struct DrawData{
+	int transformIndex;
+	int materialIndex;
+};
+
+// first three rows of the affine model matrix
+struct ObjectData{
+	vec4 modelRows[3];
+};
+
+layout(std430,set = 0, binding = 0) readonly buffer DrawDataBuffer{
+	DrawData objects[];
+} drawDataArray;
+
+layout(std430,set = 0, binding = 1) readonly buffer TransformBuffer{
+	ObjectData objects[];
+} transformData;
+
+layout(std140,set = 1, binding = 0) uniform  CameraBuffer{
+	mat4 viewMatrix;
+	mat4 projMatrix;
+	vec4 cameraPos;
+} cameraData;
+
+mat4 modelFromRows(ObjectData object){
+	return transpose(mat4(object.modelRows[0], object.modelRows[1], object.modelRows[2], vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+void main(void)		{
+	DrawData draw = drawDataArray.objects[pushConstants.drawDataIndex];
+	mat4 proj = cameraData.projMatrix;
+	mat4 view = cameraData.viewMatrix;
+	mat4 model = modelFromRows(transformData.objects[draw.transformIndex]);
+	mat4 transformMatrix = (proj * view * model);
+
+	gl_Position = transformMatrix * vec4(vPosition, 1.0f);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string_view>
+
+/*
+*
+* Benchmark: Benchmarks run from the command line with "--benchmark <name>" instead of starting the editor.
+*			GPU benchmarks open the renderer on a fixed scene. Results go to the core logger.
+*
+*/
+namespace Benchmark
+{
+	// Returns false if no benchmark has that name
+	bool Run(std::string_view name);
+
+	void JobSystemStress();
+	void DepthPrepass();
+	void OcclusionCulling();
+	// Draw recording time of the overdraw scene at every record thread count
+	void RecordThreadSweep();
+	// CPU only, no window
+	void SoftwareOcclusion();
+	// CPU only, build, refit and queries at 10k, 100k and 1M objects
+	void BoundingVolumeHierarchy();
+	// CPU only, decoding the source textures against mapping their cached KTX2 files, each copied out as it would be to staging
+	void TextureLoading();
+}
@@ -1,24 +1,60 @@
 #pragma once
 
 #include <imgui.h>
+#include <atomic>
 #include "spdlog/sinks/ostream_sink.h"
 #include "glm.hpp"
+#include "SceneGraph.h"
 
 namespace Editor
 {
-	extern ImTextureID ViewportTexture;
-	extern ImTextureID ViewportDepthTexture;
+	// Placeholder IDs, the renderer swaps in the textures of the frame it is recording
+	extern const ImTextureID ViewportTexture;
+	extern const ImTextureID ViewportDepthTexture;
 
 	extern glm::vec4* lightDirection;
 	extern glm::vec4* lightColor;
 	extern glm::vec4* lightAmbientColor;
 
+	extern int* recordThreadCount;
+	extern const std::atomic<float>* recordTimeMs;
+
+	extern const std::atomic<float>* presentLatencyMs;
+	extern const char* latencyProfileName;
+
+	extern const std::atomic<float>* asyncComputeMs;
+	extern const std::atomic<float>* asyncOverlapMs;
+
+	extern bool* depthPrepass;
+	extern bool* occlusionCulling;
+	extern const std::atomic<float>* graphicsGpuMs;
+	extern const std::atomic<uint64_t>* fragmentInvocations;
+
+	extern bool* softwareOcclusion;
+	extern const std::atomic<float>* softwareOcclusionMs;
+	extern const std::atomic<uint32_t>* softwareCulledObjects;
+
+	extern bool* textureFeedback;
+	extern const std::atomic<uint64_t>* textureResidentBytes;
+	extern const std::atomic<uint64_t>* textureTotalBytes;
+	extern const std::atomic<uint64_t>* textureStreamedBytes;
+
+	// Clicking the viewport stores its uv and requests a pick, the engine selects the node of the object it hit
+	extern glm::vec2* pickPosition;
+	extern bool* pickRequested;
+
+	extern SceneGraph* sceneGraph;
+	extern SceneNodeHandle* selectedNode;
+
 	void DrawEditor();
 
 	void DrawViewportWindow();
 	void DrawViewport();
 	void DrawViewportDepth();
 	void DrawSceneGraph();
+	void DrawSceneNode(SceneNodeHandle handle);
+	void DrawSelectedNode();
+	void DrawRendererStats();
 	void DrawLog();
 
 
@@ -2,18 +2,63 @@
 
 #include "Graphics/Renderer.h"
 #include "RenderableTypes.h"
+#include "RenderObjectStore.h"
+#include "SceneGraph.h"
+#include "Structures/BVH.h"
 
 class Engine
 {
 public:
-	void init();
+	void init(RenderTypes::LatencyProfile latencyProfile = RenderTypes::LatencyProfile::BALANCED);
 	void run();
 	void deinit();
 
+	// Renders an overdraw heavy scene with and without the depth pre-pass and logs fragment shader invocations
+	void runDepthPrepassBenchmark();
+	// Same scene with and without two phase occlusion culling
+	void runOcclusionCullingBenchmark();
+	// Same scene recorded with every record thread count up to MAX_RECORD_THREADS, logs the CPU recording time
+	void runRecordThreadBenchmark();
+
 private:
 	void setupScene();
+	void setupOverdrawScene();
+	// Samples input and hands one frame to the renderer, returns false once the window is closed
+	bool runFrame();
+	// Runs the benchmark warm up and measured frames, returns the per frame averages or false once the window is closed
+	bool measureFrames(uint64_t& invocations, double& graphicsMs, double& recordMs);
+	void updateScene();
+	// Updates the scene graph and copies the world matrices into the render objects and occluders
+	void updateTransforms();
+	// World space bounds of every render object
+	void updateObjectBounds();
+	// Sorts the objects for drawing, brings the transforms up to date and builds the BVH from scratch
+	void finishSceneSetup();
+	RenderEntity addRenderObject(const RenderableTypes::RenderObject& object, SceneNodeHandle node);
+	// Casts a ray through the viewport position the editor clicked and selects the closest object's node
+	void pickObject();
+	FramePacket buildFramePacket();
 
 	Renderer rend;
-	std::vector<RenderableTypes::RenderObject> renderObjects;
+	RenderObjectStore renderObjects;
+	std::vector<RenderableTypes::OccluderObject> occluders;
+	RenderableTypes::OccluderHandle cubeOccluder{};
+	// What the overdraw scene's walls are built from, the generated cube works even if no file loads
+	RenderableTypes::MeshHandle cubeMesh{};
+	RenderableTypes::MaterialHandle cubeMaterial{};
+	SceneGraph sceneGraph;
+	// Scene graph node of every render entity
+	std::vector<SceneNodeHandle> entityNodes;
+	// Scene graph node of every occluder, in the same order
+	std::vector<SceneNodeHandle> occluderNodes;
+	// Over the render objects' world bounds, objects are identified by their store index
+	BVH sceneBVH;
+	// Viewport uv of the last click, y pointing down
+	glm::vec2 pickPosition{};
+	bool pickRequested = false;
+	SceneNodeHandle selectedNode = INVALID_SCENE_NODE;
+	GPUShaderData::Camera camera;
+	GPUShaderData::DirectionalLight sunlight;
+	RenderTypes::RenderSettings renderSettings;
 };
 
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+/*
+*
+* AssetCache: Content addressed lookup in front of the renderer's uploads. Assets are keyed by a hash of their
+*			source bytes and import settings, so the same content under another name resolves to the handle that
+*			is already resident. Every lookup that hits takes a reference, the asset is freed with the last one.
+*
+*/
+class AssetCache
+{
+public:
+	// Handle cached under the key with one more reference, 0 if there is none
+	[[nodiscard]] uint32_t acquire(uint64_t key);
+	// The handle starts out with a single reference
+	void insert(uint64_t key, uint32_t handle);
+	// Returns true when that was the last reference, the handle is no longer cached then. Handles that were never
+	// cached count as having one reference.
+	bool release(uint32_t handle);
+
+	// 0 for handles that aren't cached
+	[[nodiscard]] uint32_t getReferenceCount(uint32_t handle) const;
+	// Lookups that returned an existing handle
+	[[nodiscard]] uint64_t getHitCount() const { return hits; }
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		uint32_t references;
+	};
+
+	std::unordered_map<uint64_t, uint32_t> handles;
+	std::unordered_map<uint32_t, Entry> entries;
+	uint64_t hits = 0;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+#include "Structures/SlotAllocator.h"
+
+/*
+*
+* BindlessTable: One descriptor set of sampled images shared by every frame. It is sized from the device's
+*			update-after-bind limits, so slots are written while frames using the set are in flight. A slot
+*			must not be written again while pending work samples it, it is freed through the timeline.
+*
+*/
+class BindlessTable
+{
+public:
+	static constexpr uint32_t INVALID_SLOT = SlotAllocator::INVALID_SLOT;
+
+	// Holds maxCapacity images, or fewer if the device allows less
+	void init(VkDevice vkDevice, VkPhysicalDevice physicalDevice, uint32_t maxCapacity);
+	void deinit();
+
+	// Writes the view into a free slot, INVALID_SLOT once the table is full
+	[[nodiscard]] uint32_t add(VkImageView view);
+	// The slot is reused by a later add, nothing pending may still sample it
+	void remove(uint32_t slot);
+
+	[[nodiscard]] VkDescriptorSetLayout getLayout() const { return layout; }
+	[[nodiscard]] VkDescriptorSet getSet() const { return set; }
+	[[nodiscard]] uint32_t getCapacity() const { return slots.getCapacity(); }
+	[[nodiscard]] uint32_t getFreeCount() const { return slots.getFreeCount(); }
+
+private:
+	VkDevice device{ VK_NULL_HANDLE };
+	VkDescriptorPool pool{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout layout{ VK_NULL_HANDLE };
+	VkDescriptorSet set{ VK_NULL_HANDLE };
+	SlotAllocator slots;
+};
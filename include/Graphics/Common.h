@@ -17,6 +17,8 @@ namespace GFX {
 			STORAGE,
 			VERTEX,
 			INDEX,
+			// storage buffer that is also read by indirect draws
+			INDIRECT,
 		};
 	}
 }
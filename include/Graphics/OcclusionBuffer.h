@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Every tile row is one SSE register of scanlines, every scanline one 32 bit coverage mask
+constexpr uint32_t OCCLUSION_TILE_WIDTH = 32;
+constexpr uint32_t OCCLUSION_TILE_HEIGHT = 4;
+
+// Simplified mesh rasterised by the occlusion buffer, a triangle list of positions only
+struct OccluderMesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+};
+
+/*
+*
+* OcclusionBuffer: Low resolution CPU depth buffer in the style of masked software occlusion culling. Each 32x4 tile
+*			keeps a conservative farthest depth and a working layer of coverage masks with its own farthest depth,
+*			which is merged into the first once the masks cover the whole tile. Occluders are rasterised on the
+*			job threads, occludees are tested against the farthest depths four tiles at a time.
+*
+*/
+class OcclusionBuffer
+{
+public:
+	struct Occluder
+	{
+		const OccluderMesh* mesh;
+		glm::mat4 modelMatrix;
+	};
+
+	// The size is rounded up to whole tiles, pixels past width and height are never covered
+	void init(uint32_t width, uint32_t height);
+
+	// Clears the buffer and rasterises the occluders as seen through viewProj
+	void rasterize(const glm::mat4& viewProj, const Occluder* occluders, uint32_t count);
+
+	// Tests the screen space bounds of the sphere, xyz centre and w radius, against what was last rasterised.
+	// Safe to call from several threads at once.
+	[[nodiscard]] bool isOccluded(const glm::vec4& boundingSphere) const;
+
+	[[nodiscard]] uint32_t getWidth() const { return width; }
+	[[nodiscard]] uint32_t getHeight() const { return height; }
+	[[nodiscard]] uint32_t getTriangleCount() const { return static_cast<uint32_t>(triangles.size()); }
+
+private:
+	// Screen space triangle ready for rasterisation, an empty bounds rectangle marks a rejected one
+	struct Triangle
+	{
+		// per edge the span bound x = slope * y + offset, a horizontal edge instead stores the edge
+		// function as slope * y + offset >= 0
+		float edgeSlope[3];
+		float edgeOffset[3];
+		// +1 bounds the span on the left, -1 on the right, 0 horizontal
+		int edgeSide[3];
+		// depth plane z = depth + depthDx * x + depthDy * y, clamped to maxDepth
+		float depth;
+		float depthDx;
+		float depthDy;
+		float maxDepth;
+		// inclusive pixel bounds
+		int minX, minY, maxX, maxY;
+	};
+
+	void setupTriangles(const Occluder& occluder, Triangle* outTriangles, std::vector<glm::vec4>& clipPositions) const;
+	void rasterizeTileRows(uint32_t beginRow, uint32_t endRow);
+	void rasterizeTriangle(const Triangle& triangle, uint32_t tileRow);
+	void updateTile(uint32_t tileIndex, const uint32_t rowMasks[OCCLUSION_TILE_HEIGHT], float triangleDepth);
+
+	uint32_t width{};
+	uint32_t height{};
+	uint32_t tilesX{};
+	uint32_t tilesY{};
+
+	glm::mat4 viewProj{ 1.0f };
+
+	// Per tile, farthest depth of the tile and of the working layer. The farthest depths are padded by three
+	// tiles so the occludee test can always read four at a time.
+	std::vector<float> farthestDepth;
+	std::vector<float> workingDepth;
+	// Per tile, coverage of the working layer, one mask per scanline
+	std::vector<uint32_t> workingMasks;
+
+	std::vector<Triangle> triangles;
+	std::vector<uint32_t> triangleOffsets;
+};
@@ -16,7 +16,11 @@ namespace PipelineBuild {
 		VkPipelineRasterizationStateCreateInfo rasterizer = {};
 		std::vector<VkPipelineShaderStageCreateInfo> shaderStages = {};
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+		// dynamic rendering attachments, every colour attachment uses colorBlendAttachment
+		std::vector<VkFormat> colorAttachmentFormats = { VK_FORMAT_R8G8B8A8_SRGB };
+		VkFormat depthAttachmentFormat = VK_FORMAT_D32_SFLOAT;
 	};
 
 	VkPipeline BuildPipeline(VkDevice device, const BuildInfo& pipelineBuildInfo);
+	VkPipeline BuildComputePipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkShaderModule shaderModule);
 };
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ResourceManager.h"
+
+class Timeline;
+
+/*
+*
+* RenderGraph: Frame graph rebuilt every frame. Passes declare how they use images, the graph culls passes
+*			whose results are never used, places one batched Synchronization2 barrier in front of each pass
+*			and aliases the memory of transient images whose lifetimes don't overlap.
+*
+*/
+class RenderGraph
+{
+public:
+	typedef uint32_t ImageId;
+
+	enum class Access : uint8_t
+	{
+		COLOR_ATTACHMENT,
+		DEPTH_ATTACHMENT,
+		// depth test without depth writes
+		DEPTH_ATTACHMENT_READ,
+		FRAGMENT_SAMPLED,
+		COMPUTE_SAMPLED,
+		COMPUTE_STORAGE_READ,
+		COMPUTE_STORAGE_WRITE,
+		TRANSFER_SRC,
+		TRANSFER_DST,
+		PRESENT,
+	};
+
+	struct ImageUse
+	{
+		ImageId image;
+		Access access;
+	};
+
+	// Last use of an imported image before the graph runs
+	struct ImageState
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 access = VK_ACCESS_2_NONE;
+	};
+
+	struct ImageDesc
+	{
+		VkFormat format;
+		VkExtent2D extent;
+		VkImageUsageFlags usage;
+		ImageCreateInfo::Usage aspect = ImageCreateInfo::Usage::COLOR;
+	};
+
+	typedef std::function<void(VkCommandBuffer cmd, const RenderGraph& graph)> PassFunction;
+
+	void init(Timeline* timeline);
+	void deinit();
+
+	// Clears the passes and images of the previous frame, transient memory is kept for reuse
+	void reset();
+
+	// Image the graph doesn't own. An image with a final access is an output, passes producing it are never culled.
+	ImageId importImage(std::string_view name, VkImage image, VkImageView imageView, VkImageAspectFlags aspect, const ImageState& initialState, std::optional<Access> finalAccess = std::nullopt);
+	// Image that only lives within the frame, its memory may be shared with other transient images
+	ImageId createImage(std::string_view name, const ImageDesc& desc);
+
+	// A pass without any writes is treated as having side effects and is never culled
+	void addPass(std::string_view name, std::initializer_list<ImageUse> uses, PassFunction&& function);
+
+	// Culls passes, works out lifetimes and places transient images, call once all passes are added
+	void compile();
+	void execute(VkCommandBuffer cmd);
+
+	[[nodiscard]] VkImage getImage(ImageId image) const { return images[image].image; }
+	[[nodiscard]] VkImageView getImageView(ImageId image) const { return images[image].imageView; }
+
+	[[nodiscard]] uint32_t getCulledPassCount() const { return culledPassCount; }
+	[[nodiscard]] uint32_t getBarrierCount() const { return barrierCount; }
+	[[nodiscard]] VkDeviceSize getTransientMemorySize() const { return transientMemorySize; }
+
+private:
+	struct AccessInfo
+	{
+		VkPipelineStageFlags2 stage;
+		VkAccessFlags2 access;
+		VkImageLayout layout;
+		bool write;
+	};
+
+	struct GraphImage
+	{
+		std::string name;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+		bool transient = false;
+		ImageDesc desc{};
+		std::optional<Access> finalAccess;
+
+		// Tracked while the graph executes
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags2 writeStage = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+		// stages that have read since the last write, and the stages the last write is visible to
+		VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+		VkPipelineStageFlags2 visibleStages = VK_PIPELINE_STAGE_2_NONE;
+
+		// Live pass range, first > last when the image is unused
+		uint32_t firstPass = UINT32_MAX;
+		uint32_t lastPass = 0U;
+		// Transient image that used the same memory before this one, if any
+		ImageId aliasPredecessor = UINT32_MAX;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::vector<ImageUse> uses;
+		PassFunction function;
+		bool live = false;
+	};
+
+	// Physical transient image, cached between frames while the graph keeps the same shape
+	struct TransientImage
+	{
+		ImageDesc desc;
+		uint32_t firstPass;
+		uint32_t lastPass;
+		ImageHandle handle;
+		// index into transientImages of the image that used the memory before, UINT32_MAX if none
+		uint32_t predecessor;
+	};
+
+	struct MemoryBlock
+	{
+		VmaAllocation allocation = VK_NULL_HANDLE;
+		VkMemoryRequirements requirements{};
+	};
+
+	static AccessInfo GetAccessInfo(Access access);
+
+	void cullPasses();
+	void computeLifetimes();
+	void placeTransientImages();
+	void releaseTransientImages();
+	void addBarrier(GraphImage& image, const AccessInfo& info, bool discardContents);
+
+	Timeline* timeline = nullptr;
+
+	std::vector<GraphImage> images;
+	std::vector<Pass> passes;
+
+	std::vector<TransientImage> transientImages;
+	std::vector<MemoryBlock> memoryBlocks;
+
+	std::vector<VkImageMemoryBarrier2> pendingBarriers;
+
+	uint32_t culledPassCount = 0U;
+	uint32_t barrierCount = 0U;
+	VkDeviceSize transientMemorySize = 0U;
+};
@@ -4,21 +4,74 @@
 #include <vk_mem_alloc.h>
 #include <glm.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <functional>
 #include <imgui.h>
+#include <memory>
+#include <span>
+#include <thread>
 #include <unordered_map>
 
+#include "AssetCache.h"
+#include "BindlessTable.h"
 #include "PipelineBuilder.h"
 #include "ResourceManager.h"
 #include "Mesh.h"
 #include "DeletionQueue.h"
+#include "OcclusionBuffer.h"
+#include "RenderGraph.h"
+#include "StagingRing.h"
+#include "TextureStreamer.h"
+#include "Timeline.h"
 #include "RenderableTypes.h"
-
-constexpr unsigned int FRAME_OVERLAP = 2U;
-constexpr unsigned int MAX_OBJECTS = 100;
+#include "Structures/Bounds.h"
+#include "Structures/SPSCQueue.h"
+
+// Frame packets the main thread may queue ahead of the render thread
+constexpr unsigned int FRAME_PACKET_QUEUE_SIZE = 2U;
+// Starting sizes of the per-frame storage buffers, they grow geometrically when exceeded
+constexpr unsigned int INITIAL_OBJECT_CAPACITY = 128;
+constexpr unsigned int INITIAL_MATERIAL_CAPACITY = 64;
 constexpr glm::vec3 UP_DIR = { 0.0f,1.0f,0.0f };
 constexpr VkFormat DEFAULT_FORMAT = { VK_FORMAT_R8G8B8A8_SRGB };
 constexpr VkFormat NORMAL_FORMAT = { VK_FORMAT_R8G8B8A8_UNORM };
+constexpr VkFormat RENDER_IMAGE_FORMAT = { VK_FORMAT_R8G8B8A8_SRGB };
+constexpr VkFormat DEPTH_IMAGE_FORMAT = { VK_FORMAT_D32_SFLOAT };
+
+// Upper bound on parallel draw recording jobs, each owns a command pool per frame
+constexpr unsigned int MAX_RECORD_THREADS = 8;
+constexpr unsigned int MIN_DRAWS_PER_RECORD_JOB = 64;
+constexpr unsigned int TRANSFORM_JOB_GRAIN = 256;
+// Frames averaged for each logged input to present latency
+constexpr unsigned int LATENCY_LOG_FRAMES = 600;
+// Matches local_size_x in cull.comp and occlusion.comp
+constexpr unsigned int CULL_GROUP_SIZE = 64;
+// Matches MAX_HIZ_MIPS and the tile reduced by one workgroup in hiz.comp
+constexpr unsigned int MAX_HIZ_MIPS = 16;
+constexpr unsigned int HIZ_TILE_SIZE = 32;
+// Nearest and farthest depth
+constexpr VkFormat HIZ_FORMAT = { VK_FORMAT_R32G32_SFLOAT };
+// Levels of a 32k texture, the compute fallback allocates a descriptor set per level
+constexpr unsigned int MAX_TEXTURE_MIPS = 16;
+// Matches the workgroup size in mipgen.comp
+constexpr unsigned int MIPGEN_GROUP_SIZE = 8;
+// Width of the CPU occlusion buffer, its height follows the window's aspect ratio
+constexpr unsigned int SOFTWARE_OCCLUSION_WIDTH = 256;
+// Frames averaged for each logged async compute overlap
+constexpr unsigned int ASYNC_COMPUTE_LOG_FRAMES = 600;
+// Fits a 4k RGBA8 texture with its whole chain, bigger uploads get a staging buffer of their own
+constexpr VkDeviceSize STAGING_RING_SIZE = 128ULL << 20;
+// Slots of the shared bindless texture set, fewer if the device's update-after-bind limits are lower
+constexpr unsigned int MAX_BINDLESS_TEXTURES = 1U << 16;
+// Bytes of texture levels streamed in per frame, and the most streamed textures may hold at once
+constexpr size_t TEXTURE_STREAMING_FRAME_BUDGET = 16ULL << 20;
+constexpr size_t TEXTURE_STREAMING_POOL_SIZE = 512ULL << 20;
+// Share of the device memory budget streaming leaves to everything else
+constexpr float TEXTURE_STREAMING_HEADROOM = 0.1f;
+// Closest an object counts as when its mips are estimated, the camera may be inside its bounds
+constexpr float TEXTURE_STREAMING_NEAR_DISTANCE = 0.1f;
 
 struct SDL_Window;
 
@@ -28,7 +81,8 @@ namespace RenderTypes
 	{
 		SDL_Window* window = { nullptr };
 		VkExtent2D extent = { 1920 , 1080 };
-		bool resized{ false };
+		// set by the event loop on the main thread, consumed by the render thread
+		std::atomic<bool> resized{ false };
 	};
 
 	struct CommandContext
@@ -37,17 +91,15 @@ namespace RenderTypes
 		VkCommandBuffer buffer;
 	};
 
-	template<uint32_t FRAMES>
 	struct QueueContext
 	{
 		VkQueue queue;
 		uint32_t queueFamily;
-		CommandContext commands[FRAMES];
+		std::vector<CommandContext> commands;
 	};
 
 	struct UploadContext
 	{
-		VkFence uploadFence;
 		VkCommandPool commandPool;
 		VkCommandBuffer commandBuffer;
 	};
@@ -56,9 +108,99 @@ namespace RenderTypes
 	{
 		VkSwapchainKHR swapchain;
 		VkFormat imageFormat;
+		VkPresentModeKHR presentMode;
 		std::vector<VkImage> images;
 		std::vector<VkImageView> imageViews;
 		std::vector<VkFramebuffer> framebuffers;
+		// Signalled by the frame that renders into the image and waited on by its present
+		std::vector<VkSemaphore> renderSemaphores;
+	};
+
+	enum class LatencyProfile
+	{
+		LOW_LATENCY,
+		BALANCED,
+		THROUGHPUT,
+	};
+
+	struct LatencySettings
+	{
+		uint32_t framesInFlight;
+		// In order of preference, FIFO is always available as the last resort
+		std::vector<VkPresentModeKHR> presentModes;
+		// The main thread samples input only once the render thread has a free frame to record it into
+		bool lateInputSampling;
+	};
+
+	// Timestamp queries written by every frame, each queue resets and writes its own pair
+	enum FrameTimestamp : uint32_t
+	{
+		COMPUTE_BEGIN,
+		COMPUTE_END,
+		GRAPHICS_BEGIN,
+		GRAPHICS_END,
+		TIMESTAMP_COUNT,
+	};
+
+	LatencySettings GetLatencySettings(LatencyProfile profile);
+	const char* GetLatencyProfileName(LatencyProfile profile);
+
+	// Renderer settings owned by the main thread, copied into every frame packet
+	struct RenderSettings
+	{
+		// 0 picks one record job per job system thread
+		int recordThreadCount = 0;
+		// Depth only pass before shading, pays off in scenes with a lot of overdraw
+		bool depthPrepass = false;
+		// Two phase culling against a depth pyramid built between the phases
+		bool occlusionCulling = true;
+		// Occluders rasterised on the CPU, objects behind them are never recorded
+		bool softwareOcclusion = false;
+		// Fragments report the mip they sample, streaming then also sees what the per-object estimate misses
+		bool textureFeedback = false;
+	};
+
+	enum class DrawPass
+	{
+		// positions only, no fragment shader
+		DEPTH_PREPASS,
+		SHADING,
+	};
+
+	// With occlusion culling every draw pass runs in two phases
+	enum DrawPhase : uint32_t
+	{
+		// objects visible the last time the frame's buffers were used
+		EARLY,
+		// objects the early phase skipped that pass the Hi-Z test
+		LATE,
+		DRAW_PHASE_COUNT,
+	};
+
+	struct ImDrawListDeleter
+	{
+		void operator()(ImDrawList* drawList) const { IM_DELETE(drawList); }
+	};
+
+	/*
+	Owns a copy of ImGui's draw lists, so the main thread can build the next UI frame
+	while the render thread is still recording this one. Move only, drawData points into drawLists.
+	*/
+	struct ImGuiFrameSnapshot
+	{
+		ImGuiFrameSnapshot() = default;
+		ImGuiFrameSnapshot(ImGuiFrameSnapshot&&) = default;
+		ImGuiFrameSnapshot& operator=(ImGuiFrameSnapshot&&) = default;
+		ImGuiFrameSnapshot(const ImGuiFrameSnapshot&) = delete;
+		ImGuiFrameSnapshot& operator=(const ImGuiFrameSnapshot&) = delete;
+
+		void capture(const ImDrawData& source);
+		// Swaps the texture ID of every draw command using placeholder for texture
+		void replaceTexture(ImTextureID placeholder, ImTextureID texture);
+
+		ImDrawData drawData{};
+		std::vector<std::unique_ptr<ImDrawList, ImDrawListDeleter>> drawLists;
+		std::vector<ImDrawList*> drawListPointers;
 	};
 }
 
@@ -70,11 +212,12 @@ namespace GPUShaderData
 		int drawDataIndex;
 	};
 
+	// Storage buffers are std430 on the GLSL side, so these are laid out tightly.
+	// Offsets are checked against the shader declarations below.
 	struct DrawData
 	{
 		int transformIndex;
 		int materialIndex;
-		int padding[2];
 	};
 
 	struct Material
@@ -85,10 +228,79 @@ namespace GPUShaderData
 		glm::ivec4 textureIndices;
 	};
 
+	/*
+	Affine model matrix stored as the first three rows (3x4). The normal matrix is not stored,
+	the vertex shader rebuilds it from the column scales of the TRS matrix.
+	*/
 	struct Transform
 	{
-		glm::mat4 modelMatrix{};
-		glm::mat4 normalMatrix{};
+		glm::vec4 modelRows[3]{};
+	};
+
+	inline Transform PackTransform(const glm::mat4& modelMatrix)
+	{
+		const glm::mat4 rows = glm::transpose(modelMatrix);
+		return Transform{ .modelRows = { rows[0], rows[1], rows[2] } };
+	}
+
+	/*
+	Indirect draw filled on the CPU and culled on the async compute queue. The first five values are a
+	VkDrawIndexedIndirectCommand, non-indexed draws read the first four as a VkDrawIndirectCommand.
+	*/
+	struct DrawCommand
+	{
+		uint32_t count;
+		uint32_t instanceCount;
+		uint32_t first;
+		int32_t vertexOffset;
+		uint32_t firstInstance;
+		// result of the last occlusion test, kept by the CPU when it rewrites the command
+		uint32_t visible;
+		uint32_t frustumVisible;
+		uint32_t padding;
+		// world space, xyz centre and w radius
+		glm::vec4 boundingSphere;
+	};
+
+	struct CullPushConstants
+	{
+		// xyz normal pointing into the frustum, w distance
+		glm::vec4 frustumPlanes[6];
+		uint32_t drawCount;
+		uint32_t occlusionCulling;
+	};
+
+	struct HizPushConstants
+	{
+		uint32_t mipCount;
+		uint32_t workgroupCount;
+	};
+
+	struct MipPushConstants
+	{
+		// nonzero when the texels are sRGB encoded
+		uint32_t srgb;
+	};
+
+	struct OcclusionPushConstants
+	{
+		glm::mat4 viewProj;
+		glm::vec2 depthSize;
+		uint32_t drawCount;
+		uint32_t hizMipCount;
+	};
+
+	struct TextureStreaming
+	{
+		uint32_t baseMip;
+		// finest level a sampled fragment asked for, reset by the CPU once read
+		uint32_t requestedMip;
+	};
+
+	// Fragments write their requests only while feedback is nonzero. A TextureStreaming per bindless slot follows it.
+	struct TextureStreamingHeader
+	{
+		uint32_t feedback;
 	};
 
 	struct DirectionalLight
@@ -104,8 +316,60 @@ namespace GPUShaderData
 		glm::mat4 proj{};
 		glm::vec4 pos{};
 	};
+
+	// std430 layout of DrawDataBuffer, TransformBuffer and MaterialDataBuffer in default.vert/default.frag
+	static_assert(sizeof(DrawData) == 8);
+	static_assert(offsetof(DrawData, transformIndex) == 0);
+	static_assert(offsetof(DrawData, materialIndex) == 4);
+
+	static_assert(sizeof(Transform) == 48);
+	static_assert(offsetof(Transform, modelRows) == 0);
+
+	static_assert(sizeof(Material) == 48);
+	static_assert(offsetof(Material, diffuse) == 0);
+	static_assert(offsetof(Material, specular) == 16);
+	static_assert(offsetof(Material, shininess) == 28);
+	static_assert(offsetof(Material, textureIndices) == 32);
+
+	// std430 layout of DrawCommandBuffer in cull.comp and occlusion.comp, instanceCount is where both indirect command types expect it
+	static_assert(sizeof(DrawCommand) == 48);
+	static_assert(offsetof(DrawCommand, instanceCount) == offsetof(VkDrawIndexedIndirectCommand, instanceCount));
+	static_assert(offsetof(DrawCommand, instanceCount) == offsetof(VkDrawIndirectCommand, instanceCount));
+	static_assert(offsetof(DrawCommand, visible) == 20);
+	static_assert(offsetof(DrawCommand, frustumVisible) == 24);
+	static_assert(offsetof(DrawCommand, boundingSphere) == 32);
+
+	static_assert(offsetof(CullPushConstants, drawCount) == 96);
+	static_assert(offsetof(CullPushConstants, occlusionCulling) == 100);
+
+	static_assert(offsetof(OcclusionPushConstants, depthSize) == 64);
+	static_assert(offsetof(OcclusionPushConstants, drawCount) == 72);
+	static_assert(offsetof(OcclusionPushConstants, hizMipCount) == 76);
+
+	// std430 layout of TextureStreamingBuffer in default.frag, the entries start right after the header
+	static_assert(sizeof(TextureStreaming) == 8);
+	static_assert(alignof(TextureStreaming) == 4);
+	static_assert(sizeof(TextureStreamingHeader) == 4);
 }
 
+/*
+Immutable snapshot of everything the render thread needs for one frame,
+built on the main thread and handed over through the frame packet queue.
+*/
+struct FramePacket
+{
+	RenderableTypes::RenderObjectArrays renderObjects;
+	std::vector<RenderableTypes::OccluderObject> occluders;
+	GPUShaderData::Camera camera;
+	GPUShaderData::DirectionalLight sunlight;
+	RenderTypes::RenderSettings settings;
+	RenderTypes::ImGuiFrameSnapshot imguiFrame;
+	// when input was sampled for this frame
+	std::chrono::steady_clock::time_point sampleTime;
+	// the last packet, the render thread exits after it
+	bool shutdown = false;
+};
+
 struct VertexInputDescription
 {
 	std::vector<VkVertexInputBindingDescription> bindings;
@@ -115,56 +379,185 @@ struct VertexInputDescription
 
 struct RenderMesh
 {
-	RenderableTypes::MeshDesc meshDesc;
+	uint32_t vertexCount;
+	// 0 for meshes drawn without an index buffer
+	uint32_t indexCount;
 	BufferHandle vertexBuffer;
 	BufferHandle indexBuffer;
+	// Tightly packed positions for the depth pre-pass
+	BufferHandle positionBuffer;
+	// mesh space, xyz centre and w radius
+	glm::vec4 boundingSphere;
+	// mesh space
+	AABB bounds;
+	// UV distance per mesh space unit, averaged over the surface
+	float uvDensity;
 
 	static VertexInputDescription getVertexDescription();
+	static VertexInputDescription getPositionVertexDescription();
 };
 
 struct MaterialType
 {
 	VkPipeline pipeline = { VK_NULL_HANDLE };
+	// Same shaders without depth writes and an EQUAL test, used after the depth pre-pass
+	VkPipeline depthEqualPipeline = { VK_NULL_HANDLE };
 	VkPipelineLayout pipelineLayout = { VK_NULL_HANDLE };
 };
 
 struct MaterialInstance
 {
 	MaterialType* matType = nullptr;
+	// texture indices are TextureHandles, the material buffer gets the slot each texture is in when written
 	GPUShaderData::Material materialData;
 };
 
+// A TextureHandle's image and the bindless slot it is sampled through, streaming moves it to a new slot
+struct BindlessTexture
+{
+	ImageHandle image{};
+	uint32_t slot = BindlessTable::INVALID_SLOT;
+};
+
 struct RenderFrame
 {
 	ImageHandle renderImage;
+	// Built every frame, it owns the transient attachments
+	RenderGraph graph;
+	ImTextureID imguiDepthTexture{};
+	VkImageView imguiDepthView{ VK_NULL_HANDLE };
 
 	VkSemaphore presentSem;
-	VkSemaphore	renderSem;
-	VkFence renderFen;
+	// Timeline value signalled by this frame's last submission, waited on before the frame is reused
+	uint64_t submitValue{};
+	// Compute timeline value of this frame's culling, waited on by its graphics submission
+	uint64_t computeValue{};
+
+	// Written on the CPU, culled on the compute queue and read by the indirect draws
+	VkDescriptorSet cullSet;
+	BufferHandle drawCommandBuffer;
+	// The last graphics submission released the draw commands to the compute queue family
+	bool drawCommandsReleased{ false };
+
+	// Min/max depth pyramid of the early phase, padded to powers of two. Only used on the graphics queue.
+	ImageHandle hizImage;
+	VkImageView hizMipViews[MAX_HIZ_MIPS]{};
+	VkDescriptorSet hizSet;
+	// depth view the Hi-Z set was last written with, the graph may move the depth image
+	VkImageView hizDepthView{ VK_NULL_HANDLE };
+	// Finished downsample workgroups, the last one reduces the levels above the tiles
+	BufferHandle hizCounterBuffer;
+	VkDescriptorSet occlusionSet;
+	// Objects the early phase skipped that passed the Hi-Z test
+	BufferHandle lateDrawCommandBuffer;
+
+	VkQueryPool timestampPool{ VK_NULL_HANDLE };
+	// Fragment shader invocations of the depth pre-pass and scene passes
+	VkQueryPool statisticsPool{ VK_NULL_HANDLE };
+	bool queriesWritten{ false };
+
+	// Secondary command buffers for the draw recording jobs, one pool per job so they record in parallel
+	RenderTypes::CommandContext recordCommands[RenderTypes::DRAW_PHASE_COUNT][MAX_RECORD_THREADS];
+	RenderTypes::CommandContext prepassCommands[RenderTypes::DRAW_PHASE_COUNT][MAX_RECORD_THREADS];
 
 	VkDescriptorSet globalSet;
 	BufferHandle transformBuffer;
 	BufferHandle materialBuffer;
 	BufferHandle drawDataBuffer;
+	uint32_t objectCapacity;
+	uint32_t materialCapacity;
+
+	// Materials created or edited since this frame's material buffer was last written
+	std::vector<RenderableTypes::MaterialHandle> dirtyMaterials;
 
 	VkDescriptorSet sceneSet;
 	BufferHandle cameraBuffer;
 	BufferHandle dirLightBuffer;
+	// Mips fragments sampled, read back once the frame is reused
+	BufferHandle textureStreamingBuffer;
+	bool textureFeedbackWritten{ false };
+
+	// Streamed textures and the slots their feedback was written to, a texture may have moved since
+	struct FeedbackSlot
+	{
+		uint32_t slot;
+		RenderableTypes::TextureHandle handle;
+	};
+	std::vector<FeedbackSlot> feedbackSlots;
 };
 
 class Renderer 
 {
 public:
-	void init();
+	void init(RenderTypes::LatencyProfile profile = RenderTypes::LatencyProfile::BALANCED);
 	void deinit();
 
+	// Render thread, resources have to be created before it starts
+	void startRenderThread();
+	void stopRenderThread();
+	// Queues a frame for the render thread, blocks while the queue is full
+	void submitFrame(FramePacket&& packet);
+	// Blocks until the render thread can record a new frame when the profile samples input late
+	void waitForFrameSlot();
+
+	// Counts every submission to the device, use it to check whether GPU work has finished
+	[[nodiscard]] Timeline& getTimeline() { return timeline; }
+
 	// Public rendering API
-	void draw(const std::vector<RenderableTypes::RenderObject>& renderObjects);
+	// Meshes and textures are cached by content, uploading or loading the same bytes again returns the existing
+	// handle with another reference. Every handle returned is paired with a release.
 	RenderableTypes::MeshHandle uploadMesh(const RenderableTypes::MeshDesc& mesh);
+	// Parses the OBJ file straight into staging memory, returns 0 if it can't be read
+	RenderableTypes::MeshHandle loadMesh(const char* file);
+	// The last reference frees the mesh once the frames drawing it have finished. Like the uploads, only while
+	// the render thread isn't running.
+	void releaseMesh(RenderableTypes::MeshHandle handle);
+	// Mesh space bounds of an uploaded mesh
+	[[nodiscard]] AABB getMeshBounds(RenderableTypes::MeshHandle handle) { return meshes.get(handle).bounds; }
 	RenderableTypes::TextureHandle uploadTexture(const RenderableTypes::Texture& texture);
+	// Decodes the files in parallel and uploads each as soon as it is ready. Handles are reserved in request order
+	// up front, so they don't depend on which decode finishes first. Files that fail to load get handle 0.
+	// The textures are streamed, they start with their levels up to STREAMING_TAIL_SIZE resident.
+	std::vector<RenderableTypes::TextureHandle> loadTextures(std::span<const RenderableTypes::TextureLoadRequest> requests);
+	// Like releaseMesh, the handle isn't reused while frames in flight can sample it. Materials still referencing the
+	// texture lose it and draw as if they never had one.
+	void releaseTexture(RenderableTypes::TextureHandle handle);
+	// Occluders are only seen by the CPU occlusion buffer, the mesh should be a simplified version of what it hides
+	RenderableTypes::OccluderHandle createOccluder(const RenderableTypes::MeshDesc& mesh);
+	RenderableTypes::MaterialHandle createMaterial(const RenderableTypes::MaterialDesc& materialDesc);
+	// Materials are deduplicated, so an edit applies to every object sharing the handle
+	void updateMaterial(RenderableTypes::MaterialHandle handle, const RenderableTypes::MaterialDesc& materialDesc);
 
 	RenderTypes::WindowContext window;
+	// Written by the render thread, read by the editor
+	std::atomic<float> recordTimeMs{};
+	std::atomic<float> presentLatencyMs{};
+	std::atomic<float> asyncComputeMs{};
+	// Time the compute queue ran alongside graphics work, from timestamps on both queues
+	std::atomic<float> asyncOverlapMs{};
+	std::atomic<float> graphicsGpuMs{};
+	std::atomic<uint64_t> fragmentInvocations{};
+	std::atomic<float> softwareOcclusionMs{};
+	std::atomic<uint32_t> softwareCulledObjects{};
+	// Bytes of streamed texture levels on the GPU, of all of them, and streamed in or out in the last frame
+	std::atomic<uint64_t> textureResidentBytes{};
+	std::atomic<uint64_t> textureTotalBytes{};
+	std::atomic<uint64_t> textureStreamedBytes{};
+	[[nodiscard]] bool supportsPipelineStatistics() const { return pipelineStatisticsSupported; }
+	// BC1 to BC7 textures can be uploaded
+	[[nodiscard]] bool supportsBlockCompression() const { return blockCompressionSupported; }
+	// The Hi-Z pyramid can be built, occlusionCulling is ignored otherwise
+	[[nodiscard]] bool supportsGpuOcclusion() const { return gpuOcclusionSupported; }
+	// Fragments can report the mips they sample, textureFeedback is ignored otherwise
+	[[nodiscard]] bool supportsTextureFeedback() const { return textureFeedbackSupported; }
+	RenderTypes::LatencyProfile latencyProfile{ RenderTypes::LatencyProfile::BALANCED };
 private:
+	void renderThreadLoop();
+	void beginFrame();
+	void draw(FramePacket& packet);
+	void updatePresentLatency(std::chrono::steady_clock::time_point sampleTime);
+	void resolveFrameQueries();
+
 	void initVulkan();
 	void initImguiRenderpass();
 	void createSwapchain();
@@ -178,16 +571,57 @@ private:
 	void initImgui();
 	void initImguiRenderImages();
 	void initShaders();
+	// Sized from the window, recreated with the swapchain
+	void initHizImages();
+	void destroyHizImages();
+	// Sized from the window like the Hi-Z
+	void initOcclusionBuffer();
 
 	void initShaderData();
 
-	void drawObjects(VkCommandBuffer cmd, const std::vector<RenderableTypes::RenderObject>& renderObjects);
+	void applySettings(const RenderTypes::RenderSettings& settings);
+	void updateFrameData(const FramePacket& packet);
+	void dispatchCulling(const FramePacket& packet);
+	// Rasterises the packet's occluders, updateFrameData then tests every object against them
+	void rasterizeOccluders(const FramePacket& packet);
+	void buildHiz(VkCommandBuffer cmd);
+	// Tests the objects the early phase skipped against the Hi-Z and writes the late draw commands
+	void cullOccluded(VkCommandBuffer cmd, const FramePacket& packet);
+	// Requests mips from the packet and the last feedback, then swaps in new images for the planned changes.
+	// The uploads are recorded into cmd ahead of the frame's draws.
+	void streamTextures(VkCommandBuffer cmd, const FramePacket& packet);
+	// Finest mip each material's textures are seen at, from object distance, scale and UV density
+	void requestTextureMips(const FramePacket& packet);
+	// Returns the CPU time spent recording
+	float drawObjects(VkCommandBuffer cmd, const FramePacket& packet, RenderTypes::DrawPass pass, RenderTypes::DrawPhase phase);
+	void recordDrawJob(const RenderTypes::CommandContext& commands, RenderTypes::DrawPass pass, RenderTypes::DrawPhase phase, const RenderableTypes::RenderObjectArrays& objects, int begin, int end);
+	void recordDrawRange(VkCommandBuffer cmd, RenderTypes::DrawPass pass, RenderTypes::DrawPhase phase, const RenderableTypes::RenderObjectArrays& objects, int begin, int end);
+	void setViewportAndScissor(VkCommandBuffer cmd);
+	void uploadDirtyMaterials();
+
+	void ensureObjectCapacity(RenderFrame& renderFrame, uint32_t objectCount);
+	void ensureMaterialCapacity(RenderFrame& renderFrame, uint32_t materialCount);
+	void writeGlobalBufferDescriptors(const RenderFrame& renderFrame);
+	[[nodiscard]] bool sharesQueueFamily() const { return graphics.queueFamily == compute.queueFamily; }
 
 	ImageHandle uploadTextureInternal(const RenderableTypes::Texture& image);
-
+	// Creates the image and records its upload, mipViews collects the views the compute fallback creates
+	ImageHandle recordTextureUpload(VkCommandBuffer cmd, const RenderableTypes::Texture& image, std::vector<VkImageView>& mipViews);
+	// Bindless slot the material buffer refers to the texture by, -1 for none
+	[[nodiscard]] int getTextureSlot(int textureHandle);
+	// Fill every level above the first, which must be in TRANSFER_DST. Both leave the whole chain in SHADER_READ_ONLY.
+	void generateMipsBlit(VkCommandBuffer cmd, VkImage image, VkExtent3D extent, uint32_t mipCount);
+	void generateMipsCompute(VkCommandBuffer cmd, VkImage image, VkFormat format, VkExtent3D extent, uint32_t mipCount, std::vector<VkImageView>& outViews);
+	// Creates the mesh's device buffers and copies its filled staging streams into them
+	RenderableTypes::MeshHandle finishMeshUpload(RenderMesh& renderMesh, const StagingRing::Allocation& vertices,
+		const StagingRing::Allocation& positions, const StagingRing::Allocation& indices);
+	// Device local buffer filled from staging memory by a copy recorded into cmd
+	BufferHandle copyToDeviceBuffer(VkCommandBuffer cmd, const StagingRing::Allocation& staging, GFX::Buffer::Usage usage);
+
+	// Waits for the commands to finish, staging memory handed out before the call is free for reuse after it
 	void immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function);
 
-	[[nodiscard]] int getCurrentFrameNumber() { return frameNumber % FRAME_OVERLAP; }
+	[[nodiscard]] int getCurrentFrameNumber() { return frameNumber % static_cast<int>(latency.framesInFlight); }
 	[[nodiscard]] RenderFrame& getCurrentFrame() { return frame[getCurrentFrameNumber()]; }
 
 	VkInstance instance;
@@ -200,20 +634,29 @@ private:
 	VmaAllocator allocator;
 	VkDebugUtilsMessengerEXT debugMessenger;
 
-	RenderTypes::QueueContext<FRAME_OVERLAP> graphics;
-	RenderTypes::QueueContext<1> compute;
+	RenderTypes::QueueContext graphics;
+	RenderTypes::QueueContext compute;
 	RenderTypes::UploadContext uploadContext;
+	Timeline timeline;
+	// Signalled by compute submissions only. The queues finish out of order, a single
+	// timeline would have its value signalled backwards.
+	Timeline computeTimeline;
+	StagingRing stagingRing;
 
 	RenderTypes::Swapchain swapchain;
 	uint32_t currentSwapchainImage;
 
 	VkRenderPass imguiPass;
-	ImTextureID imguiRenderTexture[FRAME_OVERLAP];
-	ImTextureID imguiDepthTexture;
+	std::vector<ImTextureID> imguiRenderTexture;
+	VkSampler imguiSampler;
 
-	RenderFrame frame[FRAME_OVERLAP];
-	ImageHandle depthImage;
+	RenderTypes::LatencySettings latency;
+	std::vector<RenderFrame> frame;
 	int frameNumber{};
+	uint32_t objectHighWaterMark{};
+
+	int recordThreadCount{ 1 };
+	int defaultRecordThreadCount{ 1 };
 
 	VkDescriptorSetLayout globalSetLayout;
 	VkDescriptorPool globalPool;
@@ -221,11 +664,76 @@ private:
 	VkDescriptorSetLayout sceneSetLayout;
 	VkDescriptorPool scenePool;
 
-	GPUShaderData::Camera camera;
-	GPUShaderData::DirectionalLight sunlight;
+	VkDescriptorSetLayout cullSetLayout;
+	VkDescriptorPool cullPool;
+	VkPipelineLayout cullPipelineLayout;
+	VkPipeline cullPipeline;
+
+	bool occlusionCulling{ true };
+	VkExtent2D hizExtent{};
+	uint32_t hizMipCount{};
+	VkSampler hizSampler;
+	VkDescriptorPool occlusionPool;
+	VkDescriptorSetLayout hizSetLayout;
+	VkPipelineLayout hizPipelineLayout;
+	VkPipeline hizPipeline{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout occlusionSetLayout;
+	VkPipelineLayout occlusionPipelineLayout;
+	VkPipeline occlusionPipeline;
+
+	// reset after every upload that falls back to compute mip generation
+	VkDescriptorPool mipPool;
+	VkDescriptorSetLayout mipSetLayout;
+	VkPipelineLayout mipPipelineLayout;
+	VkPipeline mipPipeline;
+
+	bool softwareOcclusion{ false };
+	OcclusionBuffer occlusionBuffer;
+	std::vector<OccluderMesh> occluderMeshes;
+	std::vector<OcclusionBuffer::Occluder> frameOccluders;
+	// Per object, zero if the occlusion buffer hides it this frame
+	std::vector<uint8_t> softwareVisibility;
+
+	std::thread renderThread;
+	SPSCQueue<FramePacket, FRAME_PACKET_QUEUE_SIZE> framePackets;
+	std::atomic<bool> frameSlotReady{ false };
+
+	float accumulatedLatencyMs{};
+	uint32_t latencySampleCount{};
+
+	// Nanoseconds per timestamp tick, zero when either queue family can't write timestamps
+	float timestampPeriod{};
+	bool pipelineStatisticsSupported{ false };
+	bool blockCompressionSupported{ false };
+	bool gpuOcclusionSupported{ false };
+	bool textureFeedbackSupported{ false };
+
+	bool depthPrepass{ false };
+	VkPipeline depthPrepassPipeline;
+	VkPipelineLayout depthPrepassLayout;
+
+	struct AsyncComputeStats
+	{
+		// graphics interval of the last resolved frame, the next frame's culling runs alongside it
+		uint64_t lastGraphicsBegin{};
+		uint64_t lastGraphicsEnd{};
+		float accumulatedComputeMs{};
+		float accumulatedOverlapMs{};
+		uint32_t sampleCount{};
+	} asyncComputeStats;
 
 	Slotmap<RenderMesh> meshes;
-	std::unordered_map<std::string, MaterialType> materials;
+	AssetCache meshCache;
+	std::unordered_map<std::string, MaterialType> materialTypes;
+
+	// Dense material table, a MaterialHandle indexes straight into it and into the GPU material buffer
+	std::vector<MaterialInstance> materials;
+	std::unordered_map<std::size_t, RenderableTypes::MaterialHandle> materialLookup;
+
+	Slotmap<BindlessTexture> bindlessTextures;
+	BindlessTable bindlessTable;
+	AssetCache textureCache;
 
-	Slotmap<ImageHandle> bindlessImages;
+	bool textureFeedback{ false };
+	TextureStreamer textureStreamer;
 };
\ No newline at end of file
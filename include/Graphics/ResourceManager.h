@@ -34,6 +34,12 @@ struct ImageCreateInfo
 		COLOR,
 		DEPTH
 	} usage;
+
+	// Creates the image in existing memory instead of allocating, the caller owns the allocation
+	VmaAllocation aliasAllocation = VK_NULL_HANDLE;
+	// Narrows the usage of the default view, for images with usages their own format doesn't support. Zero
+	// keeps the image's usage.
+	VkImageUsageFlags viewUsage = 0;
 };
 
 struct Buffer
@@ -54,6 +60,14 @@ struct Image
 typedef uint32_t BufferHandle;
 typedef uint32_t ImageHandle;
 
+// Summed over the device local heaps. Exact with VK_EXT_memory_budget, estimated from the heap sizes without it.
+struct MemoryBudget
+{
+	VkDeviceSize usage;
+	// how much the process can use before allocations start to fail or get slow
+	VkDeviceSize budget;
+};
+
 class ResourceManager
 {
 public:
@@ -68,6 +82,13 @@ public:
 	ImageHandle CreateImage(const ImageCreateInfo& createInfo);
 	Image GetImage(const ImageHandle& image);
 	void DestroyImage(const ImageHandle& image);
+
+	// Device memory for images that alias each other
+	VkMemoryRequirements GetImageMemoryRequirements(const VkImageCreateInfo& imageInfo);
+	VmaAllocation AllocateImageMemory(const VkMemoryRequirements& requirements);
+	void FreeMemory(VmaAllocation allocation);
+
+	MemoryBudget GetDeviceMemoryBudget();
 protected:
 	const VkDevice device;
 	const VmaAllocator allocator;
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "ResourceManager.h"
+
+class Timeline;
+
+/*
+*
+* StagingRing: One persistently mapped upload buffer handed out front to back. Loaders reserve space first and
+*			decode or parse straight into it, a region is written over again once the submission that read it
+*			has finished on the timeline.
+*
+*/
+class StagingRing
+{
+public:
+	struct Allocation
+	{
+		uint8_t* ptr = nullptr;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+	};
+
+	void init(Timeline* uploadTimeline, VkDeviceSize ringCapacity);
+	void deinit();
+
+	// Waits on older uploads while the ring is full. Requests that can't fit beside the unsubmitted ones get a
+	// buffer of their own, freed like the ring space.
+	[[nodiscard]] Allocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+	// Everything allocated since the last call is read by the submission that signals value
+	void retire(uint64_t value);
+
+	[[nodiscard]] VkDeviceSize getCapacity() const { return capacity; }
+
+private:
+	struct RetiredRegion
+	{
+		// absolute position, the ring offset is end % capacity
+		uint64_t end;
+		uint64_t value;
+	};
+
+	Timeline* timeline = nullptr;
+	BufferHandle buffer{};
+	Buffer ring{};
+	VkDeviceSize capacity = 0;
+
+	// both only grow, the space in use is [freePosition, writePosition)
+	uint64_t writePosition = 0;
+	uint64_t freePosition = 0;
+	uint64_t retiredPosition = 0;
+	std::deque<RetiredRegion> retiredRegions;
+	std::vector<BufferHandle> dedicatedBuffers;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "RenderableTypes.h"
+
+// Levels at most this wide and high are always resident, every streamed texture starts with only these
+constexpr uint32_t STREAMING_TAIL_SIZE = 64;
+
+/*
+*
+* TextureStreamer: Decides which mip levels of each streamed texture belong on the GPU. The renderer requests the
+*			finest level every texture is seen at each frame, the streamer plans residency changes from that under
+*			a per-frame upload budget and a memory limit. It keeps the whole chain of each texture on the CPU,
+*			a change is uploaded from there as a new image holding the resident levels only.
+*
+*/
+class TextureStreamer
+{
+public:
+	// The texture's resident levels become baseMip down to 1x1
+	struct Change
+	{
+		RenderableTypes::TextureHandle handle;
+		uint32_t baseMip;
+		// bytes uploaded for the change, the new image is filled from the CPU copy
+		size_t uploadSize;
+	};
+
+	// Takes over the texture, which needs its whole chain. Returns the base level it starts with.
+	uint32_t add(RenderableTypes::TextureHandle handle, std::unique_ptr<RenderableTypes::Texture> source);
+	// Frees the CPU copy, the texture is no longer streamed
+	void remove(RenderableTypes::TextureHandle handle);
+	[[nodiscard]] bool isStreamed(RenderableTypes::TextureHandle handle) const;
+
+	// Every request falls back to the always resident levels, requests in the frame only ever lower it
+	void beginRequests(uint64_t frame);
+	// uvLod is log2 of the UV distance one pixel spans where the texture is sampled
+	void request(RenderableTypes::TextureHandle handle, float uvLod);
+	void requestMip(RenderableTypes::TextureHandle handle, uint32_t mip);
+
+	// Evicts while the resident levels exceed memoryLimit, unused and over resident textures first. Then loads
+	// the largest shortfalls first as far as the upload budget and memory limit allow.
+	[[nodiscard]] std::vector<Change> plan(size_t uploadBudget, size_t memoryLimit) const;
+	// The renderer has swapped in the change's image
+	void commit(const Change& change);
+
+	// View of the texture's levels from baseMip down, pointing into the CPU copy
+	void getLevels(RenderableTypes::TextureHandle handle, uint32_t baseMip, RenderableTypes::Texture& outLevels) const;
+	[[nodiscard]] uint32_t getBaseMip(RenderableTypes::TextureHandle handle) const;
+
+	// Bytes of every resident level, and of every level if all of them were resident
+	[[nodiscard]] size_t getResidentSize() const { return residentSize; }
+	[[nodiscard]] size_t getTotalSize() const { return totalSize; }
+
+private:
+	struct StreamedTexture
+	{
+		std::unique_ptr<RenderableTypes::Texture> source;
+		// log2 of the larger side of level 0
+		float sizeLog2 = 0.0f;
+		// the finest always resident level
+		uint32_t tailMip = 0;
+		uint32_t baseMip = 0;
+		uint32_t requestedMip = 0;
+		uint64_t lastRequestFrame = 0;
+		// per level, bytes of that level and every smaller one
+		std::vector<size_t> chainSizes;
+	};
+
+	// Indexed by handle, textures that aren't streamed have no source
+	std::vector<StreamedTexture> textures;
+	uint64_t currentFrame = 0;
+	size_t residentSize = 0;
+	size_t totalSize = 0;
+};
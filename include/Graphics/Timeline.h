@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+/*
+*
+* Timeline: Timeline semaphore counting the submissions to one queue. Every submission signals the next value,
+*			so "has submission N finished?" is a single counter read instead of a fence per subsystem.
+*
+*/
+class Timeline
+{
+public:
+	void init(VkDevice device);
+	void deinit();
+
+	// Reserves the value the next submission signals, submissions must use them in the order they were reserved
+	[[nodiscard]] uint64_t nextValue();
+	[[nodiscard]] uint64_t getSubmittedValue() const { return submittedValue.load(std::memory_order_acquire); }
+	[[nodiscard]] uint64_t getCompletedValue();
+
+	[[nodiscard]] bool isComplete(uint64_t value);
+	void wait(uint64_t value);
+
+	// Runs the function once everything submitted so far has finished on the GPU
+	void deferDeletion(std::function<void()>&& function);
+	// Runs the deferred deletions whose submissions have completed
+	void collect();
+	// Waits for every submission and runs all remaining deletions
+	void flush();
+
+	[[nodiscard]] VkSemaphore getSemaphore() const { return semaphore; }
+
+private:
+	struct PendingDeletion
+	{
+		uint64_t value;
+		std::function<void()> function;
+	};
+
+	VkDevice device{ VK_NULL_HANDLE };
+	VkSemaphore semaphore{ VK_NULL_HANDLE };
+
+	std::atomic<uint64_t> submittedValue{ 0U };
+	std::atomic<uint64_t> completedValue{ 0U };
+
+	std::mutex deletionMutex;
+	std::deque<PendingDeletion> pendingDeletions;
+};
@@ -31,6 +31,8 @@ namespace VkCommon
 			return VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
 		case GFX::Buffer::Usage::INDEX:
 			return VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+		case GFX::Buffer::Usage::INDIRECT:
+			return VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
 		}
 	}
 }
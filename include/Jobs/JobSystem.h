@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Jobs
+{
+	/*
+	Tracks a group of jobs, it is decremented as each job finishes.
+	Waiting on a counter runs other jobs until it reaches zero.
+	*/
+	struct Counter
+	{
+		std::atomic<uint32_t> pending{ 0U };
+
+		bool isDone() const { return pending.load(std::memory_order_acquire) == 0U; }
+	};
+
+	typedef std::function<void()> JobFunction;
+	typedef std::function<void(uint32_t begin, uint32_t end)> RangeFunction;
+
+	/*
+	*
+	* JobSystem: Work stealing scheduler. Every worker owns a deque, it pushes and pops its own work from the back
+	*			and steals from the front of the others. Threads that are not workers share queue 0.
+	*
+	*/
+	class JobSystem
+	{
+	public:
+		static JobSystem* ptr;
+
+		explicit JobSystem(uint32_t workerCount);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		void run(JobFunction&& job, Counter& counter);
+		void wait(Counter& counter);
+		// Runs jobs until the condition holds, for callers that consume results as they finish rather than all at once
+		void waitUntil(const std::function<bool()>& condition);
+
+		// Splits [0, count) into ranges of at most grainSize, runs them as jobs and waits for all of them
+		void parallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function);
+
+		// Worker threads plus the thread that waits on jobs
+		[[nodiscard]] uint32_t getThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+
+		// Index of the calling thread's queue, 0 for any thread that is not a worker
+		[[nodiscard]] static uint32_t GetThreadIndex();
+
+	private:
+		struct Job
+		{
+			JobFunction function;
+			Counter* counter = nullptr;
+		};
+
+		struct WorkQueue
+		{
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		void workerLoop(uint32_t index);
+		bool tryRunJob(uint32_t index);
+		bool popJob(uint32_t index, Job& outJob);
+		bool stealJob(uint32_t index, Job& outJob);
+
+		std::vector<std::unique_ptr<WorkQueue>> queues;
+		std::vector<std::thread> workers;
+
+		std::atomic<uint32_t> queuedJobs{ 0U };
+		std::atomic<uint32_t> sleepingWorkers{ 0U };
+		std::atomic<bool> running{ true };
+		std::mutex sleepMutex;
+		std::condition_variable wakeCondition;
+	};
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.h"
+#include "RenderableTypes.h"
+
+/*
+*
+* Ktx2: Reader and writer for KTX2 texture containers holding R8, RG8, RGBA8 or BC1, BC4, BC5 and BC7 data with their
+*			mip chain. Files are memory mapped and the texture's levels point straight into the mapping, the upload
+*			copies them from there into staging. Supercompressed files are not supported.
+*
+*/
+namespace Ktx2
+{
+	struct KeyValue
+	{
+		std::string key;
+		std::vector<uint8_t> value;
+	};
+
+	// Maps the file and points the texture's levels into the mapping, nothing is copied
+	bool Load(const char* path, const RenderableTypes::TextureDesc& textureDesc, RenderableTypes::Texture& outImage);
+	// Value stored under the key in a mapped file's key/value data, empty if there is none
+	std::span<const uint8_t> FindValue(const MappedFile& file, std::string_view key);
+	// Writes the levels, level 0 first. Channels picks R8, RG8 or RGBA8 for uncompressed levels. The keys must be
+	// sorted and unique.
+	bool Write(const char* path, RenderableTypes::BlockFormat format, uint32_t channels, bool srgb, uint32_t width, uint32_t height,
+		const std::vector<std::span<const uint8_t>>& levels, const std::vector<KeyValue>& keyValues);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+*
+* MappedFile: Read only memory mapping of a whole file. The pages are loaded by the OS as they are first touched,
+*			so reading a level out of a large file only costs the pages of that level.
+*
+*/
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns false if the file can't be opened or is empty
+	bool open(const char* path);
+	void close();
+
+	[[nodiscard]] bool isOpen() const { return mappedData != nullptr; }
+	[[nodiscard]] const uint8_t* data() const { return mappedData; }
+	[[nodiscard]] size_t size() const { return mappedSize; }
+
+private:
+	const uint8_t* mappedData = nullptr;
+	size_t mappedSize = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
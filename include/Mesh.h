@@ -2,9 +2,12 @@
 
 #include <glm.hpp>
 
+#include <functional>
 #include <vector>
 #include <optional>
 
+#include "Structures/Bounds.h"
+
 namespace RenderableTypes
 {
 	struct Vertex
@@ -15,6 +18,14 @@ namespace RenderableTypes
 		glm::vec2 uv;
 	};
 
+	// Where a loader writes the vertices it parses, usually straight into upload memory
+	struct MeshStreams
+	{
+		Vertex* vertices = nullptr;
+		// Optional tightly packed copy of the positions
+		glm::vec3* positions = nullptr;
+	};
+
 	struct MeshDesc
 	{
 		typedef uint32_t Index;
@@ -24,6 +35,14 @@ namespace RenderableTypes
 
 		bool hasIndices() const;
 		bool loadFromObj(const char* filename);
+		// Parses the file and writes every vertex once into the streams allocate returns for the vertex count.
+		// The bounds cover the positions in the file, the UV density its triangles.
+		static bool LoadObj(const char* filename, const std::function<MeshStreams(size_t vertexCount)>& allocate, AABB& outBounds, glm::vec4& outBoundingSphere, float& outUvDensity);
+		// Centre of the box and the furthest position from it, looser than a minimal sphere but cheap. Stride is in bytes.
+		static void CalculateBounds(const glm::vec3* positions, size_t count, size_t stride, AABB& outBounds, glm::vec4& outBoundingSphere);
+		// UV distance per unit of surface, the square root of UV area over surface area. Without indices every three
+		// vertices are a triangle. Meshes without any area get 1.
+		static float CalculateUvDensity(const Vertex* vertices, size_t vertexCount, const Index* indices, size_t indexCount);
 
 		static glm::vec3 CalculateSurfaceNormal(glm::vec3 pointA, glm::vec3 pointB, glm::vec3 pointC)
 		{
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "RenderableTypes.h"
+#include "Structures/Bounds.h"
+
+typedef uint32_t RenderEntity;
+
+/*
+*
+* RenderObjectStore: Render objects kept dense in one array per component. Entities are stable handles that map to
+*			the objects' current index, removal moves the last object into the hole so the arrays never have gaps.
+*			Indices change on destroy and sort, entities don't.
+*
+*/
+class RenderObjectStore
+{
+public:
+	RenderEntity create(const RenderableTypes::RenderObject& object);
+	void destroy(RenderEntity entity);
+	void clear();
+
+	// Orders the objects by material then mesh so draws sharing state are recorded together, objects with
+	// the same key keep their order
+	void sortForDrawing();
+
+	[[nodiscard]] uint32_t size() const { return objects.size(); }
+	[[nodiscard]] uint32_t getIndex(RenderEntity entity) const { return entityToIndex[entity]; }
+	[[nodiscard]] RenderEntity getEntity(uint32_t index) const { return indexToEntity[index]; }
+
+	// Components by index, written in place by whoever owns that component
+	[[nodiscard]] const RenderableTypes::RenderObjectArrays& getArrays() const { return objects; }
+	[[nodiscard]] std::vector<glm::mat4>& getTransforms() { return objects.transforms; }
+	[[nodiscard]] std::vector<uint8_t>& getFlags() { return objects.flags; }
+	// World space, kept by the engine for the scene BVH
+	[[nodiscard]] std::vector<AABB>& getBounds() { return bounds; }
+	[[nodiscard]] const std::vector<AABB>& getBounds() const { return bounds; }
+
+private:
+	RenderableTypes::RenderObjectArrays objects;
+	std::vector<AABB> bounds;
+
+	std::vector<RenderEntity> indexToEntity;
+	std::vector<uint32_t> entityToIndex;
+	std::vector<RenderEntity> freeEntities;
+};
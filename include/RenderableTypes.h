@@ -1,48 +1,156 @@
 #pragma once
 
+#include <functional>
 #include <optional>
+#include <span>
+#include <string>
+#include <vector>
 #include "glm.hpp"
 
+#include "MappedFile.h"
+
 namespace RenderableTypes
 {
 	typedef uint32_t MeshHandle;
 	typedef uint32_t TextureHandle;
+	typedef uint32_t MaterialHandle;
+	typedef uint32_t OccluderHandle;
+
+	// Handle 0 is always the renderer's default material
+	constexpr MaterialHandle DEFAULT_MATERIAL = 0U;
 
+	enum RenderObjectFlags : uint8_t
+	{
+		// cleared objects are kept in the arrays but never drawn
+		VISIBLE = 1 << 0,
+	};
+
+	// Description of a new render object, stored split into RenderObjectArrays
 	struct RenderObject
 	{
 		MeshHandle meshHandle;
-		std::optional<TextureHandle> textureHandle = {};
-		std::optional<TextureHandle> normalHandle = {};
+		MaterialHandle materialHandle = DEFAULT_MATERIAL;
+
+		// World matrix, the engine copies it from the object's scene graph node
+		glm::mat4 transform{ 1.0f };
+		uint8_t flags = VISIBLE;
+	};
+
+	// Render objects as one contiguous array per component, every pass streams only the arrays it reads
+	struct RenderObjectArrays
+	{
+		std::vector<glm::mat4> transforms;
+		std::vector<MeshHandle> meshes;
+		std::vector<MaterialHandle> materials;
+		std::vector<uint8_t> flags;
+
+		[[nodiscard]] uint32_t size() const { return static_cast<uint32_t>(meshes.size()); }
+	};
+
+	// Simplified stand in for the geometry behind it, only rasterised by the CPU occlusion buffer
+	struct OccluderObject
+	{
+		OccluderHandle occluderHandle;
 
-		glm::vec3 translation = { 0.0f, 0.0f, 0.0f };
-		glm::vec3 rotation = { 0.0f, 0.0f, 0.0f };
-		glm::vec3 scale = { 1.0f, 1.0f, 1.0f };
+		glm::mat4 transform{ 1.0f };
+	};
+
+	struct MaterialDesc
+	{
+		glm::vec4 diffuse = { 1.0f, 1.0f, 1.0f, 1.0f };
+		glm::vec3 specular = { 0.4f, 0.4f, 0.4f };
+		float shininess = { 64.0f };
+		std::optional<TextureHandle> diffuseTexture = {};
+		std::optional<TextureHandle> normalTexture = {};
+		// Occlusion, roughness and metalness in red, green and blue, sampled once for all three
+		std::optional<TextureHandle> ormTexture = {};
 	};
 
 	struct TextureDesc
 	{
+		// Decoded with only the channels the layout needs
 		enum class Format
 		{
+			// sRGB colour with alpha, RGBA8
 			DEFAULT,
+			// Tangent space xy, RG8, z is rebuilt in the shader
 			NORMAL,
+			// Linear single channel data such as height, R8
+			R8,
+			// Linear two channel data, RG8
+			RG8,
+			// Linear occlusion, roughness and metalness, RGBA8 as three channel formats are rarely sampled natively
+			ORM,
 		} format;
+		// Stored block compressed with every mip level, the compressed data is cached on disk
+		bool compress = false;
+	};
+
+	enum class BlockFormat : uint32_t
+	{
+		NONE,
+		// RGB with 1 bit alpha, 8 bytes per 4x4 block
+		BC1,
+		// One channel, 8 bytes per block
+		BC4,
+		// Two BC4 channels, 16 bytes per block
+		BC5,
+		// RGBA, 16 bytes per block
+		BC7,
 	};
 
 	struct Texture
 	{
+		Texture() = default;
 		~Texture();
+		// Moving hands over ptr, the levels stay valid as neither blocks nor the mapping move in memory
+		Texture(Texture&& other) noexcept;
+		Texture& operator=(Texture&& other) noexcept;
 
 		TextureDesc desc;
 
 		void* ptr = nullptr;
-		int texWidth;
-		int texHeight;
-		int texChannels;
+		int texWidth = 0;
+		int texHeight = 0;
+		// Channels per texel of ptr and of uncompressed levels
+		int texChannels = 0;
+
+		// Compressed and KTX2 textures leave ptr null and come with their whole chain, level 0 first. The levels
+		// point into blocks when they were just compressed, or into the mapped file they were read from.
+		BlockFormat blockFormat = BlockFormat::NONE;
+		std::vector<std::span<const uint8_t>> levels;
+		std::vector<uint8_t> blocks;
+		MappedFile file;
+	};
+
+	struct TextureLoadRequest
+	{
+		std::string path;
+		TextureDesc desc;
 	};
 
 	namespace TextureUtil
 	{
+		// KTX2 files are mapped as they are, anything else is decoded by stb
 		void LoadTextureFromFile(const char* file, RenderableTypes::TextureDesc textureDesc, Texture& outImage);
+		// Decodes every file on the job threads. onLoaded runs on the calling thread once per request, in the order
+		// the decodes finish, with the request's index. The texture is freed when it returns.
+		void LoadTextures(std::span<const TextureLoadRequest> requests, const std::function<void(uint32_t index, Texture& texture)>& onLoaded);
+		// Told apart by their name, "_normal" for normal maps, "_orm" for packed ORM and "_depth" for height maps
+		TextureDesc::Format GetFormatFromName(const char* file);
+		uint32_t GetChannelCount(TextureDesc::Format format);
+
+		// Levels in a full chain down to 1x1
+		uint32_t GetMipCount(uint32_t width, uint32_t height);
+		// Box filters an RG8 normal map down to 1x1, z is rebuilt before averaging and every texel renormalised. Levels
+		// 1 and up are appended to outMips tightly packed, level 0 is not included.
+		void GenerateNormalMips(const uint8_t* level0, uint32_t width, uint32_t height, std::vector<uint8_t>& outMips);
+		// Box filters an image of 1, 2 or 4 channels down to 1x1. sRGB colour is averaged in linear space, only
+		// RGBA8 can be sRGB. Appends like GenerateNormalMips.
+		void GenerateMips(const uint8_t* level0, uint32_t width, uint32_t height, uint32_t channels, bool srgb, std::vector<uint8_t>& outMips);
+		// Gives a decoded texture its whole chain in blocks like a compressed one and frees ptr. Textures that
+		// already have their levels are left alone.
+		void BuildMipChain(Texture& texture);
 	}
 }
 
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+typedef uint32_t SceneNodeHandle;
+
+constexpr SceneNodeHandle INVALID_SCENE_NODE = UINT32_MAX;
+
+/*
+*
+* SceneGraph: Transform hierarchy stored breadth first in parallel arrays. The children of a node are adjacent, so
+*			any subtree is one contiguous range per level and a moved node only recomputes the world matrices
+*			below it, level by level, with every level split across the job threads. Adding or removing nodes
+*			reorders the arrays on the next update, handles stay valid until their node is destroyed.
+*
+*/
+class SceneGraph
+{
+public:
+	// Pass INVALID_SCENE_NODE as the parent for a root
+	SceneNodeHandle createNode(SceneNodeHandle parent, std::string name = {});
+	// Destroys the node and everything below it
+	void destroyNode(SceneNodeHandle handle);
+
+	void setLocalTransform(SceneNodeHandle handle, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+	void setLocalTranslation(SceneNodeHandle handle, const glm::vec3& translation);
+
+	// Recomputes the world matrices of the subtrees below every node changed since the last update
+	void update();
+
+	[[nodiscard]] const glm::mat4& getWorldMatrix(SceneNodeHandle handle) const { return worldMatrices[handleToIndex[handle]]; }
+	[[nodiscard]] const glm::vec3& getLocalTranslation(SceneNodeHandle handle) const { return localTranslations[handleToIndex[handle]]; }
+	[[nodiscard]] const glm::quat& getLocalRotation(SceneNodeHandle handle) const { return localRotations[handleToIndex[handle]]; }
+	[[nodiscard]] const glm::vec3& getLocalScale(SceneNodeHandle handle) const { return localScales[handleToIndex[handle]]; }
+	[[nodiscard]] const std::string& getName(SceneNodeHandle handle) const { return names[handleToIndex[handle]]; }
+
+	// Children are only known after an update, nodes created since are not listed yet
+	[[nodiscard]] const std::vector<SceneNodeHandle>& getRoots() const { return roots; }
+	[[nodiscard]] uint32_t getChildCount(SceneNodeHandle handle) const { return childCounts[handleToIndex[handle]]; }
+	[[nodiscard]] SceneNodeHandle getChild(SceneNodeHandle handle, uint32_t child) const { return handles[firstChildren[handleToIndex[handle]] + child]; }
+	[[nodiscard]] uint32_t getNodeCount() const { return static_cast<uint32_t>(handles.size()); }
+	// World matrices recomputed by the last update
+	[[nodiscard]] uint32_t getUpdatedNodeCount() const { return updatedNodeCount; }
+
+private:
+	// Sorts the arrays breadth first and drops destroyed nodes
+	void rebuildLayout();
+	void markDirty(uint32_t index);
+	// Recomputes the subtrees below the nodes, which must be sorted and none below another
+	void updateSubtrees(const std::vector<uint32_t>& subtreeRoots);
+	[[nodiscard]] uint32_t getLevel(uint32_t index) const;
+
+	// Per node in breadth first order
+	std::vector<SceneNodeHandle> handles;
+	std::vector<uint32_t> parents;
+	// Leaves keep the index their children would start at, so the children of a range of nodes are always
+	// the range from the first node's firstChild to the last node's firstChild + childCount
+	std::vector<uint32_t> firstChildren;
+	std::vector<uint32_t> childCounts;
+	std::vector<glm::vec3> localTranslations;
+	std::vector<glm::quat> localRotations;
+	std::vector<glm::vec3> localScales;
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<uint8_t> dirty;
+	std::vector<uint8_t> destroyed;
+	std::vector<std::string> names;
+
+	// Per handle
+	std::vector<uint32_t> handleToIndex;
+	std::vector<SceneNodeHandle> freeHandles;
+
+	std::vector<SceneNodeHandle> roots;
+	// Index of the first node of every level
+	std::vector<uint32_t> levelStarts;
+	std::vector<uint32_t> dirtyNodes;
+	bool layoutDirty = false;
+	uint32_t updatedNodeCount = 0;
+};
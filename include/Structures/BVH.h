@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "Structures/Bounds.h"
+
+/*
+*
+* BVH: Bounding volume hierarchy over object boxes, built with the binned surface area heuristic. Nodes live in one
+*			depth first array where a subtree of n objects owns a block of 2n - 1 nodes, so moved objects are handled
+*			by refitting and by rebuilding the worst subtrees in place instead of rebuilding everything.
+*
+*/
+class BVH
+{
+public:
+	// 32 bytes, two nodes per cache line
+	struct Node
+	{
+		glm::vec3 boundsMin;
+		// interior nodes, the first of the two adjacent children. Leaves, the first entry in the object list.
+		uint32_t first;
+		glm::vec3 boundsMax;
+		// zero for interior nodes
+		uint32_t objectCount;
+	};
+
+	struct RayHit
+	{
+		uint32_t object;
+		// along the ray in units of its direction
+		float distance;
+	};
+
+	// Objects are identified by their index in bounds
+	void build(const std::vector<AABB>& bounds);
+	// Fits every node to the new bounds, the tree keeps its shape. The object count must not change.
+	void refit(const std::vector<AABB>& bounds);
+	// Refits, then rebuilds the subtrees whose surface area grew the most since they were built until
+	// maxRebuildObjects objects have been rebuilt. Returns the number of objects rebuilt.
+	uint32_t update(const std::vector<AABB>& bounds, uint32_t maxRebuildObjects);
+
+	// The queries append the objects whose boxes pass to outObjects
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& outObjects) const;
+	void querySphere(const glm::vec3& centre, float radius, std::vector<uint32_t>& outObjects) const;
+	void queryAABB(const AABB& box, std::vector<uint32_t>& outObjects) const;
+	// Closest object box along the ray, a ray starting inside a box hits it at distance 0
+	[[nodiscard]] std::optional<RayHit> raycast(const glm::vec3& origin, const glm::vec3& direction,
+		float maxDistance = std::numeric_limits<float>::max()) const;
+
+	[[nodiscard]] uint32_t getObjectCount() const { return static_cast<uint32_t>(objectIndices.size()); }
+	[[nodiscard]] const std::vector<Node>& getNodes() const { return nodes; }
+	// Surface area heuristic cost of the tree relative to its root, lower is faster to query
+	[[nodiscard]] float getCost() const;
+
+private:
+	// Builds the subtree of the object range at nodeIndex, its descendants go into the block starting at childBase
+	void buildNode(uint32_t nodeIndex, uint32_t childBase, uint32_t first, uint32_t count, uint32_t depth);
+	void makeLeaf(Node& node, uint32_t first, uint32_t count);
+	void refitNode(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& objects);
+	// Range of objectIndices below a node, a subtree's objects are always contiguous
+	[[nodiscard]] std::pair<uint32_t, uint32_t> getObjectRange(uint32_t nodeIndex) const;
+	void appendObjects(uint32_t nodeIndex, std::vector<uint32_t>& outObjects) const;
+
+	std::vector<Node> nodes;
+	// Per node, surface area when its subtree was last built
+	std::vector<float> builtArea;
+	// Objects in leaf order, every leaf owns a contiguous range
+	std::vector<uint32_t> objectIndices;
+	std::vector<AABB> objectBounds;
+
+	// Sorted in place while building so the passes over a node's objects read memory in order
+	struct BuildObject
+	{
+		AABB bounds;
+		glm::vec3 centre;
+		uint32_t object;
+	};
+	std::vector<BuildObject> buildObjects;
+};
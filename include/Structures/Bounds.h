@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glm.hpp>
+
+#include <limits>
+
+/*
+*
+* AABB: Axis aligned box. A default constructed box is empty, growing it by anything gives that thing's bounds.
+*
+*/
+struct AABB
+{
+	glm::vec3 min{ std::numeric_limits<float>::max() };
+	glm::vec3 max{ std::numeric_limits<float>::lowest() };
+
+	void grow(const glm::vec3& point)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void grow(const AABB& box)
+	{
+		min = glm::min(min, box.min);
+		max = glm::max(max, box.max);
+	}
+
+	[[nodiscard]] glm::vec3 centre() const { return (min + max) * 0.5f; }
+
+	[[nodiscard]] float surfaceArea() const
+	{
+		const glm::vec3 extent = glm::max(max - min, glm::vec3{ 0.0f });
+		return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	[[nodiscard]] bool overlaps(const AABB& box) const
+	{
+		return min.x <= box.max.x && max.x >= box.min.x
+			&& min.y <= box.max.y && max.y >= box.min.y
+			&& min.z <= box.max.z && max.z >= box.min.z;
+	}
+
+	[[nodiscard]] bool overlapsSphere(const glm::vec3& centre, float radius) const
+	{
+		const glm::vec3 offset = centre - glm::clamp(centre, min, max);
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	// Bounds of the transformed box, the centre is transformed and the extent projected onto the new axes
+	[[nodiscard]] static AABB Transform(const AABB& box, const glm::mat4& matrix)
+	{
+		const glm::vec3 centre = glm::vec3(matrix * glm::vec4(box.centre(), 1.0f));
+		const glm::vec3 halfExtent = (box.max - box.min) * 0.5f;
+		const glm::mat3 absolute{ glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])) };
+		const glm::vec3 transformedExtent = absolute * halfExtent;
+		return AABB{ .min = centre - transformedExtent, .max = centre + transformedExtent };
+	}
+};
+
+/*
+*
+* Frustum: Clip volume planes, xyz normal pointing into the frustum and w distance. The normals are unit length
+*			so distances compare directly with radii.
+*
+*/
+struct Frustum
+{
+	glm::vec4 planes[6];
+
+	// planes of the clip volume from the rows of view projection
+	[[nodiscard]] static Frustum FromViewProj(const glm::mat4& viewProj)
+	{
+		const glm::mat4 rows = glm::transpose(viewProj);
+		Frustum frustum{ .planes = {
+			rows[3] + rows[0], rows[3] - rows[0],
+			rows[3] + rows[1], rows[3] - rows[1],
+			rows[3] + rows[2], rows[3] - rows[2],
+		} };
+		for (glm::vec4& plane : frustum.planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+*
+* Hash: 64 bit non-cryptographic hashing of byte ranges, XXH64 compatible. Four independent lanes consume 32 bytes
+*			per step, so large inputs hash at about memory speed.
+*
+*/
+namespace Hash
+{
+	// Hashes can be chained by passing the previous one as the seed of the next range
+	uint64_t Hash64(const void* data, size_t size, uint64_t seed = 0);
+}
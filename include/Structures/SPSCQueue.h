@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+/*
+*
+* SPSCQueue: Lock free ring buffer for exactly one producer thread and one consumer thread.
+*			The wait functions block on the index atomics rather than spinning.
+*
+*/
+
+template<typename T, uint32_t CAPACITY>
+class SPSCQueue
+{
+public:
+	// Producer only, returns false when the queue is full
+	bool push(T&& value);
+	// Consumer only, returns false when the queue is empty
+	bool pop(T& outValue);
+
+	// Producer only, blocks until a push would succeed
+	void waitForSpace() const;
+	// Consumer only, blocks until a pop would succeed
+	void waitForItem() const;
+
+private:
+	std::array<T, CAPACITY> slots;
+
+	// head is only written by the consumer and tail only by the producer
+	alignas(64) std::atomic<uint32_t> head{ 0U };
+	alignas(64) std::atomic<uint32_t> tail{ 0U };
+};
+
+template<typename T, uint32_t CAPACITY>
+inline bool SPSCQueue<T, CAPACITY>::push(T&& value)
+{
+	const uint32_t currentTail = tail.load(std::memory_order_relaxed);
+	if (currentTail - head.load(std::memory_order_acquire) == CAPACITY)
+	{
+		return false;
+	}
+
+	slots[currentTail % CAPACITY] = std::move(value);
+	tail.store(currentTail + 1U, std::memory_order_release);
+	tail.notify_one();
+	return true;
+}
+
+template<typename T, uint32_t CAPACITY>
+inline bool SPSCQueue<T, CAPACITY>::pop(T& outValue)
+{
+	const uint32_t currentHead = head.load(std::memory_order_relaxed);
+	if (currentHead == tail.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+
+	outValue = std::move(slots[currentHead % CAPACITY]);
+	head.store(currentHead + 1U, std::memory_order_release);
+	head.notify_one();
+	return true;
+}
+
+template<typename T, uint32_t CAPACITY>
+inline void SPSCQueue<T, CAPACITY>::waitForSpace() const
+{
+	const uint32_t currentTail = tail.load(std::memory_order_relaxed);
+	head.wait(currentTail - CAPACITY, std::memory_order_acquire);
+}
+
+template<typename T, uint32_t CAPACITY>
+inline void SPSCQueue<T, CAPACITY>::waitForItem() const
+{
+	const uint32_t currentHead = head.load(std::memory_order_relaxed);
+	tail.wait(currentHead, std::memory_order_acquire);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/*
+*
+* SlotAllocator: Hands out indices into a fixed size table. Freed slots are reused before untouched ones, so the
+*			table stays packed at the front.
+*
+*/
+class SlotAllocator
+{
+public:
+	static constexpr uint32_t INVALID_SLOT = std::numeric_limits<uint32_t>::max();
+
+	void init(uint32_t slotCapacity);
+
+	// INVALID_SLOT once every slot is taken
+	[[nodiscard]] uint32_t allocate();
+	// Freeing INVALID_SLOT does nothing, so failed allocations can be freed like any other
+	void free(uint32_t slot);
+
+	[[nodiscard]] uint32_t getCapacity() const { return capacity; }
+	[[nodiscard]] uint32_t getFreeCount() const { return capacity - nextSlot + static_cast<uint32_t>(freeSlots.size()); }
+
+private:
+	uint32_t capacity = 0;
+
+	// slots below nextSlot were handed out at least once, the free ones among them are reused first
+	uint32_t nextSlot = 0;
+	std::vector<uint32_t> freeSlots;
+};
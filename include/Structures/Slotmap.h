@@ -1,11 +1,12 @@
 #pragma once
 
-#include <array>
+#include <cstdint>
+#include <vector>
 
 /*
 *
-* Slotmap: Persistent handle to data. Not actual implementation, but at the moment simple array works best
-*			until I need to be able to add new/delete buffers on a per frame basis.
+* Slotmap: Persistent handle to data. Not actual implementation, but at the moment a growable array with
+*			a free list works best. Handle 0 is never handed out so it can be used as a null handle.
 *
 */
 
@@ -15,14 +16,22 @@ class Slotmap
 public:
 	uint32_t add(const T& object);
 	T& get(uint32_t handle);
+	void remove(uint32_t handle);
 
 	// TODO: make private
-	std::array<T, 1024> array;
+	std::vector<T> array = std::vector<T>(1);
 private:
-	uint32_t lastHandle{ 0U };
+	std::vector<uint32_t> freeHandles;
 	[[nodiscard]] uint32_t getNewHandle()
 	{
-		return ++lastHandle;
+		if (!freeHandles.empty())
+		{
+			const uint32_t handle = freeHandles.back();
+			freeHandles.pop_back();
+			return handle;
+		}
+		array.emplace_back();
+		return static_cast<uint32_t>(array.size() - 1);
 	}
 };
 
@@ -39,3 +48,10 @@ inline T& Slotmap<T>::get(uint32_t handle)
 {
 	return array[handle];
 }
+
+template<typename T>
+inline void Slotmap<T>::remove(uint32_t handle)
+{
+	array[handle] = T{};
+	freeHandles.push_back(handle);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "RenderableTypes.h"
+
+/*
+*
+* TextureCompression: BC1, BC4, BC5 and BC7 encoders for RGBA8 images, with SSE2 endpoint fitting. Compressed
+*			textures are cached on disk as KTX2, keyed by the source path and format, and rebuilt when the source
+*			file changes. Run with "--compress-textures <directory>" to fill the cache offline.
+*
+*/
+namespace TextureCompression
+{
+	// Block format textures of that kind are compressed to
+	RenderableTypes::BlockFormat GetBlockFormat(RenderableTypes::TextureDesc::Format format);
+	// Bytes per 4x4 block
+	uint32_t GetBlockSize(RenderableTypes::BlockFormat format);
+	// Bytes of one level, partial blocks at the edges count as whole ones. Channels only matter for uncompressed levels.
+	size_t GetLevelSize(RenderableTypes::BlockFormat format, uint32_t width, uint32_t height, uint32_t channels);
+
+	// Single blocks of 16 RGBA8 texels in row order. BC4 reads one channel, BC5 the first two.
+	void CompressBlockBC1(const uint8_t* texels, uint8_t* outBlock);
+	void CompressBlockBC4(const uint8_t* texels, uint32_t channel, uint8_t* outBlock);
+	void CompressBlockBC5(const uint8_t* texels, uint8_t* outBlock);
+	// Mode 6 only, one subset with 4 bit indices
+	void CompressBlockBC7(const uint8_t* texels, uint8_t* outBlock);
+
+	// Compresses one level of 1, 2 or 4 channel texels in block row order, split across the job threads
+	void CompressLevel(RenderableTypes::BlockFormat format, const uint8_t* texels, uint32_t width, uint32_t height, uint32_t channels, uint8_t* outBlocks);
+	// Builds the mip chain of the decoded texture and compresses every level into blocks, freeing ptr
+	void CompressTexture(RenderableTypes::Texture& texture);
+
+	// Maps the cached KTX2 file, returns false if there is none or the source changed since it was written
+	bool LoadCached(const char* file, const RenderableTypes::TextureDesc& textureDesc, RenderableTypes::Texture& outImage);
+	void StoreCached(const char* file, const RenderableTypes::Texture& texture);
+	// Compresses every png and jpg below the directory into the cache, in the format their name suggests.
+	// Returns the number of textures written.
+	uint32_t CompressDirectory(const char* directory);
+}
@@ -0,0 +1,442 @@
+#include "Benchmark.h"
+
+#include <public/tracy/Tracy.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <thread>
+
+#include "Engine.h"
+#include "Graphics/OcclusionBuffer.h"
+#include "Jobs/JobSystem.h"
+#include "RenderableTypes.h"
+#include "Structures/BVH.h"
+#include "Log.h"
+
+typedef std::chrono::high_resolution_clock BenchmarkClock;
+
+static double elapsedMs(BenchmarkClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count();
+}
+
+bool Benchmark::Run(std::string_view name)
+{
+	ZoneScoped;
+	static const std::pair<std::string_view, void(*)()> benchmarks[] = {
+		{"jobs", &Benchmark::JobSystemStress},
+		{"prepass", &Benchmark::DepthPrepass},
+		{"occlusion", &Benchmark::OcclusionCulling},
+		{"recordthreads", &Benchmark::RecordThreadSweep},
+		{"softocclusion", &Benchmark::SoftwareOcclusion},
+		{"bvh", &Benchmark::BoundingVolumeHierarchy},
+		{"textures", &Benchmark::TextureLoading},
+	};
+
+	for (const auto& benchmark : benchmarks)
+	{
+		if (benchmark.first == name)
+		{
+			LOG_CORE_INFO("Running benchmark: {}", name);
+			benchmark.second();
+			return true;
+		}
+	}
+
+	LOG_CORE_ERROR("Unknown benchmark: {}", name);
+	return false;
+}
+
+void Benchmark::JobSystemStress()
+{
+	ZoneScoped;
+	constexpr uint32_t EMPTY_JOBS = 200000;
+	constexpr uint32_t WORK_ITEMS = 1 << 20;
+	constexpr uint32_t WORK_GRAIN = 1024;
+	constexpr uint32_t ITERATIONS_PER_ITEM = 256;
+
+	const uint32_t maxThreads = std::max(1U, std::thread::hardware_concurrency());
+	double singleThreadMs = 0.0;
+
+	for (uint32_t threads = 1; threads <= maxThreads; ++threads)
+	{
+		// the calling thread also runs jobs while it waits
+		Jobs::JobSystem jobSystem(threads - 1);
+
+		// scheduling overhead, the jobs are empty so this is all push, pop, steal and wait
+		Jobs::Counter counter;
+		const auto overheadStart = BenchmarkClock::now();
+		for (uint32_t i = 0; i < EMPTY_JOBS; ++i)
+		{
+			jobSystem.run([]() {}, counter);
+		}
+		jobSystem.wait(counter);
+		const double overheadNs = elapsedMs(overheadStart) * 1000000.0 / EMPTY_JOBS;
+
+		// scaling, a fixed amount of arithmetic split with parallelFor
+		std::atomic<uint32_t> sink{ 0U };
+		const auto scalingStart = BenchmarkClock::now();
+		jobSystem.parallelFor(WORK_ITEMS, WORK_GRAIN, [&sink](uint32_t begin, uint32_t end) {
+			float value = 0.0f;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				float x = static_cast<float>(i);
+				for (uint32_t j = 0; j < ITERATIONS_PER_ITEM; ++j)
+				{
+					x = std::sqrt(x * 1.0001f + 0.5f);
+				}
+				value += x;
+			}
+			sink.fetch_add(static_cast<uint32_t>(value), std::memory_order_relaxed);
+			});
+		const double scalingMs = elapsedMs(scalingStart);
+
+		if (threads == 1)
+		{
+			singleThreadMs = scalingMs;
+		}
+
+		LOG_CORE_INFO("Jobs: {} threads, {:.1f} ns per empty job, parallelFor {:.2f} ms ({:.2f}x)",
+			threads, overheadNs, scalingMs, singleThreadMs / scalingMs);
+	}
+}
+
+void Benchmark::DepthPrepass()
+{
+	ZoneScoped;
+	Engine engine;
+	engine.init();
+	engine.runDepthPrepassBenchmark();
+	engine.deinit();
+}
+
+void Benchmark::OcclusionCulling()
+{
+	ZoneScoped;
+	Engine engine;
+	engine.init();
+	engine.runOcclusionCullingBenchmark();
+	engine.deinit();
+}
+
+void Benchmark::RecordThreadSweep()
+{
+	ZoneScoped;
+	Engine engine;
+	engine.init();
+	engine.runRecordThreadBenchmark();
+	engine.deinit();
+}
+
+void Benchmark::SoftwareOcclusion()
+{
+	ZoneScoped;
+	constexpr int WALL_SIZE = 16;
+	constexpr int LAYERS = 16;
+	constexpr uint32_t ITERATIONS = 200;
+
+	// the overdraw scene without a window, the front wall is the only occluder
+	const RenderableTypes::MeshDesc cube = RenderableTypes::MeshDesc::GenerateCube();
+	OccluderMesh cubeOccluder{ .indices = cube.indices };
+	for (const RenderableTypes::Vertex& vertex : cube.vertices)
+	{
+		cubeOccluder.positions.push_back(vertex.position);
+	}
+
+	std::vector<OcclusionBuffer::Occluder> occluders;
+	std::vector<glm::vec4> occludees;
+	for (int layer = 0; layer < LAYERS; ++layer)
+	{
+		for (int y = 0; y < WALL_SIZE; ++y)
+		{
+			for (int x = 0; x < WALL_SIZE; ++x)
+			{
+				const glm::vec3 translation{ 1.0f * (x - WALL_SIZE / 2), 1.0f * (y - WALL_SIZE / 2), -2.0f * layer };
+				if (layer == 0)
+				{
+					occluders.push_back({ .mesh = &cubeOccluder, .modelMatrix = glm::translate(glm::mat4{ 1.0f }, translation) });
+				}
+				occludees.emplace_back(translation, std::sqrt(3.0f) * 0.5f);
+			}
+		}
+	}
+	const uint32_t occludeeCount = static_cast<uint32_t>(occludees.size());
+	const uint32_t hiddenCount = (LAYERS - 1) * WALL_SIZE * WALL_SIZE;
+
+	glm::mat4 proj = glm::perspective(glm::radians(90.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	proj[1][1] *= -1;
+	const glm::mat4 viewProj = proj * glm::lookAt(glm::vec3{ 0.0f, 0.0f, 6.0f }, glm::vec3{ 0.0f, -0.5f, 0.0f }, UP_DIR);
+
+	const uint32_t maxThreads = std::max(1U, std::thread::hardware_concurrency());
+	for (const uint32_t threads : { 1U, maxThreads })
+	{
+		// the occlusion buffer schedules its work on the global job system
+		Jobs::JobSystem jobSystem(threads - 1);
+		Jobs::JobSystem::ptr = &jobSystem;
+
+		OcclusionBuffer occlusionBuffer;
+		occlusionBuffer.init(SOFTWARE_OCCLUSION_WIDTH, SOFTWARE_OCCLUSION_WIDTH * 600 / 800);
+
+		double rasterizeMs = 0.0;
+		double testMs = 0.0;
+		uint32_t culled = 0U;
+		for (uint32_t iteration = 0; iteration < ITERATIONS; ++iteration)
+		{
+			const auto rasterizeStart = BenchmarkClock::now();
+			occlusionBuffer.rasterize(viewProj, occluders.data(), static_cast<uint32_t>(occluders.size()));
+			rasterizeMs += elapsedMs(rasterizeStart);
+
+			std::atomic<uint32_t> culledObjects{ 0U };
+			const auto testStart = BenchmarkClock::now();
+			jobSystem.parallelFor(occludeeCount, TRANSFORM_JOB_GRAIN, [&](uint32_t begin, uint32_t end) {
+				uint32_t hidden = 0U;
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					hidden += occlusionBuffer.isOccluded(occludees[i]) ? 1U : 0U;
+				}
+				culledObjects.fetch_add(hidden, std::memory_order_relaxed);
+				});
+			testMs += elapsedMs(testStart);
+			culled = culledObjects.load(std::memory_order_relaxed);
+		}
+		Jobs::JobSystem::ptr = nullptr;
+
+		LOG_CORE_INFO("Software occlusion: {} threads, {}x{} buffer, {} occluder triangles, rasterize {:.3f} ms, test {:.3f} ms",
+			threads, occlusionBuffer.getWidth(), occlusionBuffer.getHeight(), occlusionBuffer.getTriangleCount(),
+			rasterizeMs / ITERATIONS, testMs / ITERATIONS);
+		LOG_CORE_INFO("Software occlusion: {} of {} objects culled, {:.1f}% of the {} hidden behind the wall",
+			culled, occludeeCount, 100.0 * culled / hiddenCount, hiddenCount);
+
+		// a single core machine would only repeat the first run
+		if (maxThreads == 1U)
+		{
+			break;
+		}
+	}
+}
+
+void Benchmark::BoundingVolumeHierarchy()
+{
+	ZoneScoped;
+	constexpr uint32_t OBJECT_COUNTS[] = { 10000, 100000, 1000000 };
+	constexpr uint32_t QUERIES = 1000;
+	// a tenth of the objects move every frame
+	constexpr uint32_t MOVED_FRACTION = 10;
+
+	// the tree builds and refits its top levels on the global job system
+	Jobs::JobSystem jobSystem(std::max(1U, std::thread::hardware_concurrency()) - 1U);
+	Jobs::JobSystem::ptr = &jobSystem;
+
+	glm::mat4 proj = glm::perspective(glm::radians(90.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	proj[1][1] *= -1;
+
+	for (const uint32_t objectCount : OBJECT_COUNTS)
+	{
+		// the same density at every size, so queries of a fixed size return a similar number of objects
+		const float worldExtent = 50.0f * std::cbrt(objectCount / 10000.0f);
+		std::mt19937 random(1234U);
+		std::uniform_real_distribution<float> position(-worldExtent, worldExtent);
+		std::uniform_real_distribution<float> halfSize(0.1f, 1.0f);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		std::vector<AABB> bounds(objectCount);
+		for (AABB& box : bounds)
+		{
+			const glm::vec3 centre{ position(random), position(random), position(random) };
+			const glm::vec3 extent{ halfSize(random), halfSize(random), halfSize(random) };
+			box = AABB{ .min = centre - extent, .max = centre + extent };
+		}
+
+		BVH bvh;
+		const auto buildStart = BenchmarkClock::now();
+		bvh.build(bounds);
+		const double buildMs = elapsedMs(buildStart);
+		const float builtCost = bvh.getCost();
+
+		// small moves keep the tree shape reasonable, refitting alone is enough for them
+		for (uint32_t i = 0; i < objectCount; i += MOVED_FRACTION)
+		{
+			const glm::vec3 offset{ unit(random), unit(random), unit(random) };
+			bounds[i].min += offset;
+			bounds[i].max += offset;
+		}
+		const auto refitStart = BenchmarkClock::now();
+		bvh.refit(bounds);
+		const double refitMs = elapsedMs(refitStart);
+
+		// larger moves, a tenth of the world across, degrade it until the worst subtrees are rebuilt
+		for (uint32_t i = 0; i < objectCount; i += MOVED_FRACTION)
+		{
+			const glm::vec3 offset = glm::vec3{ unit(random), unit(random), unit(random) } * (0.1f * worldExtent);
+			bounds[i].min += offset;
+			bounds[i].max += offset;
+		}
+		bvh.refit(bounds);
+		const float degradedCost = bvh.getCost();
+		const auto updateStart = BenchmarkClock::now();
+		const uint32_t rebuiltObjects = bvh.update(bounds, objectCount / 4);
+		const double updateMs = elapsedMs(updateStart);
+		const float updatedCost = bvh.getCost();
+
+		LOG_CORE_INFO("BVH: {} objects, {} nodes, build {:.3f} ms, refit {:.3f} ms, update {:.3f} ms rebuilding {} objects",
+			objectCount, bvh.getNodes().size(), buildMs, refitMs, updateMs, rebuiltObjects);
+		LOG_CORE_INFO("BVH: cost {:.1f} built, {:.1f} after the large moves, {:.1f} after the update",
+			builtCost, degradedCost, updatedCost);
+
+		std::vector<uint32_t> results;
+		const glm::mat4 viewProj = proj * glm::lookAt(glm::vec3{ 0.0f, 0.0f, worldExtent }, glm::vec3{ 0.0f }, UP_DIR);
+		const auto frustumStart = BenchmarkClock::now();
+		bvh.queryFrustum(Frustum::FromViewProj(viewProj), results);
+		const double frustumMs = elapsedMs(frustumStart);
+		const size_t frustumCount = results.size();
+
+		uint32_t rayHits = 0U;
+		const auto rayStart = BenchmarkClock::now();
+		for (uint32_t query = 0; query < QUERIES; ++query)
+		{
+			const glm::vec3 origin{ position(random), position(random), position(random) };
+			const glm::vec3 direction{ unit(random), unit(random), unit(random) };
+			rayHits += bvh.raycast(origin, direction).has_value() ? 1U : 0U;
+		}
+		const double rayMs = elapsedMs(rayStart);
+
+		results.clear();
+		const auto sphereStart = BenchmarkClock::now();
+		for (uint32_t query = 0; query < QUERIES; ++query)
+		{
+			bvh.querySphere(glm::vec3{ position(random), position(random), position(random) }, 5.0f, results);
+		}
+		const double sphereMs = elapsedMs(sphereStart);
+		const size_t sphereCount = results.size();
+
+		results.clear();
+		const auto boxStart = BenchmarkClock::now();
+		for (uint32_t query = 0; query < QUERIES; ++query)
+		{
+			const glm::vec3 centre{ position(random), position(random), position(random) };
+			bvh.queryAABB(AABB{ .min = centre - 5.0f, .max = centre + 5.0f }, results);
+		}
+		const double boxMs = elapsedMs(boxStart);
+		const size_t boxCount = results.size();
+
+		LOG_CORE_INFO("BVH: frustum {:.3f} ms for {} objects, {} rays {:.3f} ms with {} hits",
+			frustumMs, frustumCount, QUERIES, rayMs, rayHits);
+		LOG_CORE_INFO("BVH: {} spheres {:.3f} ms for {} objects, {} boxes {:.3f} ms for {} objects",
+			QUERIES, sphereMs, sphereCount, QUERIES, boxMs, boxCount);
+	}
+
+	Jobs::JobSystem::ptr = nullptr;
+}
+
+void Benchmark::TextureLoading()
+{
+	ZoneScoped;
+	constexpr uint32_t PASSES = 3;
+
+	// compression runs on the global job system, only the first pass over an empty cache needs it
+	Jobs::JobSystem jobSystem(std::max(1U, std::thread::hardware_concurrency()) - 1U);
+	Jobs::JobSystem::ptr = &jobSystem;
+
+	std::vector<std::string> files;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator("../../assets/textures", error))
+	{
+		const std::string extension = entry.path().extension().string();
+		if (entry.is_regular_file() && (extension == ".png" || extension == ".jpg" || extension == ".jpeg"))
+		{
+			files.push_back(entry.path().string());
+		}
+	}
+	if (files.empty())
+	{
+		LOG_CORE_WARN("Textures: nothing to load");
+		Jobs::JobSystem::ptr = nullptr;
+		return;
+	}
+
+	// the cache is filled untimed, so the KTX2 passes never compress
+	for (const std::string& file : files)
+	{
+		RenderableTypes::Texture texture;
+		RenderableTypes::TextureUtil::LoadTextureFromFile(file.c_str(), RenderableTypes::TextureDesc{
+			.format = RenderableTypes::TextureUtil::GetFormatFromName(file.c_str()), .compress = true }, texture);
+	}
+
+	// stands in for the staging buffer, both paths end with their data copied into it
+	std::vector<uint8_t> staging;
+	double bestDecodeMs = 0.0;
+	double bestParallelMs = 0.0;
+	double bestMappedMs = 0.0;
+	size_t decodedBytes = 0;
+	size_t mappedBytes = 0;
+	for (uint32_t pass = 0; pass < PASSES; ++pass)
+	{
+		decodedBytes = 0;
+		const auto decodeStart = BenchmarkClock::now();
+		for (const std::string& file : files)
+		{
+			RenderableTypes::Texture texture;
+			RenderableTypes::TextureUtil::LoadTextureFromFile(file.c_str(), RenderableTypes::TextureDesc{
+				.format = RenderableTypes::TextureUtil::GetFormatFromName(file.c_str()) }, texture);
+			const size_t size = static_cast<size_t>(texture.texWidth) * texture.texHeight * texture.texChannels;
+			if (texture.ptr != nullptr)
+			{
+				staging.resize(std::max(staging.size(), size));
+				memcpy(staging.data(), texture.ptr, size);
+				decodedBytes += size;
+			}
+		}
+		const double decodeMs = elapsedMs(decodeStart);
+
+		// the same decodes as a batch across the job threads, each copied out on this thread as it finishes
+		std::vector<RenderableTypes::TextureLoadRequest> requests;
+		for (const std::string& file : files)
+		{
+			requests.push_back({ .path = file, .desc = { .format = RenderableTypes::TextureUtil::GetFormatFromName(file.c_str()) } });
+		}
+		const auto parallelStart = BenchmarkClock::now();
+		RenderableTypes::TextureUtil::LoadTextures(requests, [&staging](uint32_t, RenderableTypes::Texture& texture) {
+			const size_t size = static_cast<size_t>(texture.texWidth) * texture.texHeight * texture.texChannels;
+			if (texture.ptr != nullptr)
+			{
+				staging.resize(std::max(staging.size(), size));
+				memcpy(staging.data(), texture.ptr, size);
+			}
+			});
+		const double parallelMs = elapsedMs(parallelStart);
+
+		mappedBytes = 0;
+		const auto mappedStart = BenchmarkClock::now();
+		for (const std::string& file : files)
+		{
+			RenderableTypes::Texture texture;
+			RenderableTypes::TextureUtil::LoadTextureFromFile(file.c_str(), RenderableTypes::TextureDesc{
+				.format = RenderableTypes::TextureUtil::GetFormatFromName(file.c_str()), .compress = true }, texture);
+			size_t offset = 0;
+			for (const std::span<const uint8_t>& level : texture.levels)
+			{
+				staging.resize(std::max(staging.size(), offset + level.size()));
+				memcpy(staging.data() + offset, level.data(), level.size());
+				offset += level.size();
+			}
+			mappedBytes += offset;
+		}
+		const double mappedMs = elapsedMs(mappedStart);
+
+		bestDecodeMs = pass == 0 ? decodeMs : std::min(bestDecodeMs, decodeMs);
+		bestParallelMs = pass == 0 ? parallelMs : std::min(bestParallelMs, parallelMs);
+		bestMappedMs = pass == 0 ? mappedMs : std::min(bestMappedMs, mappedMs);
+	}
+
+	LOG_CORE_INFO("Textures: {} files, decoded {:.2f} ms for {} KB, KTX2 {:.2f} ms for {} KB with every level ({:.1f}x)",
+		files.size(), bestDecodeMs, decodedBytes / 1024, bestMappedMs, mappedBytes / 1024, bestDecodeMs / bestMappedMs);
+	LOG_CORE_INFO("Textures: decoded on {} threads {:.2f} ms ({:.2f}x)", jobSystem.getThreadCount(), bestParallelMs, bestDecodeMs / bestParallelMs);
+
+	Jobs::JobSystem::ptr = nullptr;
+}
@@ -4,6 +4,7 @@
 #include <backends/imgui_impl_vulkan.h>
 
 #include "Log.h"
+#include "Graphics/Renderer.h"
 #include <memory>
 
 static ImGuiDockNodeFlags dockspace_flags = ImGuiDockNodeFlags_PassthruCentralNode;
@@ -11,12 +12,41 @@ ImGuiWindowFlags window_flags = ImGuiWindowFlags_MenuBar | ImGuiWindowFlags_NoDo
 
 namespace Editor
 {
-	ImTextureID Editor::ViewportTexture;
-	ImTextureID Editor::ViewportDepthTexture;
+	const ImTextureID ViewportTexture = (ImTextureID)(intptr_t)1;
+	const ImTextureID ViewportDepthTexture = (ImTextureID)(intptr_t)2;
 
 	glm::vec4* lightDirection;
 	glm::vec4* lightColor;
 	glm::vec4* lightAmbientColor;
+
+	int* recordThreadCount;
+	const std::atomic<float>* recordTimeMs;
+
+	const std::atomic<float>* presentLatencyMs;
+	const char* latencyProfileName;
+
+	const std::atomic<float>* asyncComputeMs;
+	const std::atomic<float>* asyncOverlapMs;
+
+	bool* depthPrepass;
+	bool* occlusionCulling;
+	const std::atomic<float>* graphicsGpuMs;
+	const std::atomic<uint64_t>* fragmentInvocations;
+
+	bool* softwareOcclusion;
+	const std::atomic<float>* softwareOcclusionMs;
+	const std::atomic<uint32_t>* softwareCulledObjects;
+
+	bool* textureFeedback;
+	const std::atomic<uint64_t>* textureResidentBytes;
+	const std::atomic<uint64_t>* textureTotalBytes;
+	const std::atomic<uint64_t>* textureStreamedBytes;
+
+	glm::vec2* pickPosition;
+	bool* pickRequested;
+
+	SceneGraph* sceneGraph;
+	SceneNodeHandle* selectedNode;
 }
 
 void Editor::DrawEditor()
@@ -86,6 +116,14 @@ void Editor::DrawViewport()
 {
 	ImGui::Begin("Viewport", nullptr, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
 	ImGui::Image(Editor::ViewportTexture, ImGui::GetContentRegionMax());
+	if (ImGui::IsItemClicked())
+	{
+		const ImVec2 mouse = ImGui::GetMousePos();
+		const ImVec2 imageMin = ImGui::GetItemRectMin();
+		const ImVec2 imageSize = ImGui::GetItemRectSize();
+		*pickPosition = { (mouse.x - imageMin.x) / imageSize.x, (mouse.y - imageMin.y) / imageSize.y };
+		*pickRequested = true;
+	}
 	ImGui::End();
 }
 
@@ -101,9 +139,92 @@ void Editor::DrawSceneGraph()
 	ImGui::DragFloat3("Light Direction", (float*)lightDirection, 0.05f, -1.0f, 1.0f);
 	ImGui::ColorEdit4("Light Color", (float*)lightColor, ImGuiColorEditFlags_DisplayRGB);
 	ImGui::ColorEdit4("Light Ambient Color", (float*)lightAmbientColor, ImGuiColorEditFlags_DisplayRGB);
+	if (ImGui::CollapsingHeader("Hierarchy", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		for (const SceneNodeHandle root : sceneGraph->getRoots())
+		{
+			DrawSceneNode(root);
+		}
+	}
+	DrawSelectedNode();
+	DrawRendererStats();
 	ImGui::End();
 }
 
+void Editor::DrawSceneNode(SceneNodeHandle handle)
+{
+	const uint32_t childCount = sceneGraph->getChildCount(handle);
+	ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth;
+	if (childCount == 0)
+	{
+		flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+	}
+	if (handle == *selectedNode)
+	{
+		flags |= ImGuiTreeNodeFlags_Selected;
+	}
+
+	const bool open = ImGui::TreeNodeEx((void*)(intptr_t)handle, flags, "%s", sceneGraph->getName(handle).c_str());
+	if (ImGui::IsItemClicked())
+	{
+		*selectedNode = handle;
+	}
+	// collapsed children are never visited, a wall of a few hundred cubes costs nothing until it is opened
+	if (open && childCount > 0)
+	{
+		for (uint32_t child = 0; child < childCount; ++child)
+		{
+			DrawSceneNode(sceneGraph->getChild(handle, child));
+		}
+		ImGui::TreePop();
+	}
+}
+
+void Editor::DrawSelectedNode()
+{
+	if (*selectedNode == INVALID_SCENE_NODE || !ImGui::CollapsingHeader("Transform", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		return;
+	}
+
+	const SceneNodeHandle handle = *selectedNode;
+	ImGui::Text("%s", sceneGraph->getName(handle).c_str());
+	glm::vec3 translation = sceneGraph->getLocalTranslation(handle);
+	glm::vec3 rotation = glm::degrees(glm::eulerAngles(sceneGraph->getLocalRotation(handle)));
+	glm::vec3 scale = sceneGraph->getLocalScale(handle);
+	bool changed = ImGui::DragFloat3("Translation", (float*)&translation, 0.05f);
+	changed |= ImGui::DragFloat3("Rotation", (float*)&rotation, 0.5f);
+	changed |= ImGui::DragFloat3("Scale", (float*)&scale, 0.01f);
+	if (changed)
+	{
+		sceneGraph->setLocalTransform(handle, translation, glm::quat(glm::radians(rotation)), scale);
+	}
+}
+
+void Editor::DrawRendererStats()
+{
+	if (!ImGui::CollapsingHeader("Renderer"))
+	{
+		return;
+	}
+
+	ImGui::Text("Latency profile: %s", latencyProfileName);
+	ImGui::Text("Input to present: %.3f ms", presentLatencyMs->load(std::memory_order_relaxed));
+	ImGui::SliderInt("Record Threads", recordThreadCount, 0, MAX_RECORD_THREADS, *recordThreadCount == 0 ? "auto" : "%d");
+	ImGui::Text("Draw recording: %.3f ms", recordTimeMs->load(std::memory_order_relaxed));
+	ImGui::Text("Async compute: %.3f ms, %.3f ms overlapped", asyncComputeMs->load(std::memory_order_relaxed), asyncOverlapMs->load(std::memory_order_relaxed));
+	ImGui::Checkbox("Depth Prepass", depthPrepass);
+	ImGui::Checkbox("Occlusion Culling", occlusionCulling);
+	ImGui::Text("Graphics GPU: %.3f ms", graphicsGpuMs->load(std::memory_order_relaxed));
+	ImGui::Text("Fragment shader invocations: %llu", static_cast<unsigned long long>(fragmentInvocations->load(std::memory_order_relaxed)));
+	ImGui::Checkbox("Software Occlusion", softwareOcclusion);
+	ImGui::Text("Software occlusion: %.3f ms, %u objects culled", softwareOcclusionMs->load(std::memory_order_relaxed), softwareCulledObjects->load(std::memory_order_relaxed));
+	ImGui::Checkbox("Texture Feedback", textureFeedback);
+	constexpr float MB = 1024.0f * 1024.0f;
+	ImGui::Text("Streamed textures: %.1f / %.1f MB resident, %.2f MB last frame", static_cast<float>(textureResidentBytes->load(std::memory_order_relaxed)) / MB,
+		static_cast<float>(textureTotalBytes->load(std::memory_order_relaxed)) / MB, static_cast<float>(textureStreamedBytes->load(std::memory_order_relaxed)) / MB);
+}
+
 void Editor::DrawLog()
 {
 	ImGui::Begin("Log");
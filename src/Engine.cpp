@@ -2,91 +2,423 @@
 #include <SDL.h>
 #include <public/tracy/Tracy.hpp>
 #include <backends/imgui_impl_sdl.h>
+#include <backends/imgui_impl_vulkan.h>
+#include <gtc/matrix_transform.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "Editor.h"
+#include "Jobs/JobSystem.h"
 #include "Log.h"
 
-void Engine::init() {
+void Engine::init(RenderTypes::LatencyProfile latencyProfile) {
 	ZoneScoped;
 
 	Log::Init();
-	rend.init();
+	// the main thread runs jobs too while it waits on them
+	Jobs::JobSystem::ptr = new Jobs::JobSystem(std::max(1U, std::thread::hardware_concurrency()) - 1U);
+	rend.init(latencyProfile);
 	setupScene();
 }
 
 void Engine::setupScene() {
-	RenderableTypes::MeshDesc fileMesh;
-	RenderableTypes::MeshHandle fileMeshHandle {};
-	if (fileMesh.loadFromObj("../../assets/meshes/cube.obj"))
-	{
-		fileMeshHandle = rend.uploadMesh(fileMesh);
-	}
+	const RenderableTypes::MeshHandle fileMeshHandle = rend.loadMesh("../../assets/meshes/cube.obj");
 
 	RenderableTypes::MeshDesc cubeMeshDesc = RenderableTypes::MeshDesc::GenerateCube();
-	RenderableTypes::MeshHandle cubeMeshHandle = rend.uploadMesh(cubeMeshDesc);
+	cubeMesh = rend.uploadMesh(cubeMeshDesc);
+	// a cube is already as simple as an occluder gets
+	cubeOccluder = rend.createOccluder(cubeMeshDesc);
 
 	static const std::pair<std::string, RenderableTypes::TextureDesc::Format> texturePaths[] = {
 		{"../../assets/textures/default.png", RenderableTypes::TextureDesc::Format::DEFAULT},
 		{"../../assets/textures/texture.jpg", RenderableTypes::TextureDesc::Format::DEFAULT},
 		{"../../assets/textures/metal/metal_albedo.png", RenderableTypes::TextureDesc::Format::DEFAULT},
 		{"../../assets/textures/metal/metal_normal.png", RenderableTypes::TextureDesc::Format::NORMAL},
+		{"../../assets/textures/metal/metal_orm.png", RenderableTypes::TextureDesc::Format::ORM},
 		{"../../assets/textures/bricks/bricks_albedo.png", RenderableTypes::TextureDesc::Format::DEFAULT},
 		{"../../assets/textures/bricks/bricks_normal.png", RenderableTypes::TextureDesc::Format::NORMAL},
+		{"../../assets/textures/bricks/bricks_orm.png", RenderableTypes::TextureDesc::Format::ORM},
 	};
 
-	std::vector<RenderableTypes::TextureHandle> textures;
-	for (int i = 0; i < std::size(texturePaths); ++i)
+	std::vector<RenderableTypes::TextureLoadRequest> textureRequests;
+	for (const auto& [path, format] : texturePaths)
 	{
-		RenderableTypes::Texture img;
-		const RenderableTypes::TextureDesc textureDesc{ .format = texturePaths[i].second };
-		RenderableTypes::TextureUtil::LoadTextureFromFile(texturePaths[i].first.c_str(), textureDesc, img);
-		RenderableTypes::TextureHandle texHandle = rend.uploadTexture(img);
-		textures.push_back(texHandle);
+		textureRequests.push_back({ .path = path, .desc = { .format = format, .compress = rend.supportsBlockCompression() } });
 	}
+	const std::vector<RenderableTypes::TextureHandle> textures = rend.loadTextures(textureRequests);
 
+	const RenderableTypes::MaterialHandle metalMaterial = rend.createMaterial({
+		.diffuseTexture = textures[2],
+		.normalTexture = textures[3],
+		.ormTexture = textures[4],
+		});
+	const RenderableTypes::MaterialHandle brickMaterial = rend.createMaterial({
+		.diffuseTexture = textures[5],
+		.normalTexture = textures[6],
+		.ormTexture = textures[7],
+		});
+	cubeMaterial = brickMaterial;
+
+	const SceneNodeHandle gridNode = sceneGraph.createNode(INVALID_SCENE_NODE, "Material test grid");
+	sceneGraph.setLocalTranslation(gridNode, { 0.0f, -0.5f, 0.0f });
 	for (int i = 0; i < 6; ++i)
 	{
 		for (int j = 0; j < 6; ++j)
 		{
-			const RenderableTypes::RenderObject materialTestObject{
-				.meshHandle = cubeMeshHandle,
-				.textureHandle = i > 3 ? textures[2] : textures[4],
-				.normalHandle = i > 3 ? textures[3] : textures[5],
-				.translation = { 1.0f * j,-0.5f,1.0f * i},
-			};
-			renderObjects.push_back(materialTestObject);
+			const SceneNodeHandle cubeNode = sceneGraph.createNode(gridNode, "Cube " + std::to_string(i * 6 + j));
+			sceneGraph.setLocalTranslation(cubeNode, { 1.0f * j, 0.0f, 1.0f * i });
+			addRenderObject({
+				.meshHandle = cubeMesh,
+				.materialHandle = i > 3 ? metalMaterial : brickMaterial,
+				}, cubeNode);
+			occluders.push_back({ .occluderHandle = cubeOccluder });
+			occluderNodes.push_back(cubeNode);
 		}
 	}
 
+	camera.proj = glm::perspective(glm::radians(90.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	camera.proj[1][1] *= -1;
+	camera.pos = { 6.0f,3.0f,6.0f,0.0f };
+
+	Editor::lightDirection = &sunlight.direction;
+	Editor::lightColor = &sunlight.color;
+	Editor::lightAmbientColor = &sunlight.ambientColor;
+	Editor::recordThreadCount = &renderSettings.recordThreadCount;
+	Editor::depthPrepass = &renderSettings.depthPrepass;
+	Editor::occlusionCulling = &renderSettings.occlusionCulling;
+	Editor::softwareOcclusion = &renderSettings.softwareOcclusion;
+	Editor::textureFeedback = &renderSettings.textureFeedback;
+	Editor::pickPosition = &pickPosition;
+	Editor::pickRequested = &pickRequested;
+	Editor::sceneGraph = &sceneGraph;
+	Editor::selectedNode = &selectedNode;
+
+	// a few dozen cubes barely overdraw, the pre-pass would cost more vertex work than it saves
+	renderSettings.depthPrepass = false;
+
+	finishSceneSetup();
 
 	LOG_CORE_INFO("Scene setup.");
 }
 
-void Engine::run()
+void Engine::setupOverdrawScene()
 {
-	bool bQuit = { false };
-	SDL_Event e;
+	constexpr int OVERDRAW_LAYERS = 16;
+	constexpr int WALL_SIZE = 16;
+
+	// walls of cubes one behind the other, submitted back to front so without the pre-pass every layer is shaded
+	const RenderableTypes::RenderObject templateObject{
+		.meshHandle = cubeMesh,
+		.materialHandle = cubeMaterial,
+	};
+	renderObjects.clear();
+	occluders.clear();
+	entityNodes.clear();
+	occluderNodes.clear();
+	for (const SceneNodeHandle root : std::vector<SceneNodeHandle>(sceneGraph.getRoots()))
+	{
+		sceneGraph.destroyNode(root);
+	}
+	selectedNode = INVALID_SCENE_NODE;
 
-	while (!bQuit)
+	// every wall is one node, moving it only updates its own cubes
+	for (int layer = OVERDRAW_LAYERS - 1; layer >= 0; --layer)
 	{
-		while (SDL_PollEvent(&e) != 0)
+		const SceneNodeHandle wallNode = sceneGraph.createNode(INVALID_SCENE_NODE, "Wall " + std::to_string(layer));
+		sceneGraph.setLocalTranslation(wallNode, { 0.0f, 0.0f, -2.0f * layer });
+		for (int y = 0; y < WALL_SIZE; ++y)
 		{
-			ImGui_ImplSDL2_ProcessEvent(&e);
-			if (e.type == SDL_QUIT)
-			{
-				bQuit = true;
-			}
-			if (e.window.event == SDL_WINDOWEVENT_RESIZED || e.window.event == SDL_WINDOWEVENT_MINIMIZED)
+			for (int x = 0; x < WALL_SIZE; ++x)
 			{
-				rend.window.resized = true;
-				break;
+				const SceneNodeHandle cubeNode = sceneGraph.createNode(wallNode, "Cube " + std::to_string(y * WALL_SIZE + x));
+				sceneGraph.setLocalTranslation(cubeNode, { 1.0f * (x - WALL_SIZE / 2), 1.0f * (y - WALL_SIZE / 2), 0.0f });
+				addRenderObject(templateObject, cubeNode);
+				// the front wall hides every layer behind it
+				if (layer == 0)
+				{
+					occluders.push_back({ .occluderHandle = cubeOccluder });
+					occluderNodes.push_back(cubeNode);
+				}
 			}
 		}
-		rend.draw(renderObjects);
 	}
+
+	camera.pos = { 0.0f, 0.0f, 6.0f, 0.0f };
+	renderSettings.depthPrepass = true;
+
+	finishSceneSetup();
+	LOG_CORE_INFO("Overdraw scene setup, {} objects.", renderObjects.size());
+}
+
+bool Engine::runFrame()
+{
+	bool bQuit = { false };
+	SDL_Event e;
+
+	rend.waitForFrameSlot();
+	const auto sampleTime = std::chrono::steady_clock::now();
+	while (SDL_PollEvent(&e) != 0)
+	{
+		ImGui_ImplSDL2_ProcessEvent(&e);
+		if (e.type == SDL_QUIT)
+		{
+			bQuit = true;
+		}
+		if (e.window.event == SDL_WINDOWEVENT_RESIZED || e.window.event == SDL_WINDOWEVENT_MINIMIZED)
+		{
+			rend.window.resized = true;
+			break;
+		}
+	}
+
+	updateScene();
+	FramePacket packet = buildFramePacket();
+	packet.sampleTime = sampleTime;
+	rend.submitFrame(std::move(packet));
+	return !bQuit;
+}
+
+void Engine::run()
+{
+	rend.startRenderThread();
+	while (runFrame())
+	{
+	}
+}
+
+// results trail submission by the frames in flight, the warm up also flushes the other mode's frames
+constexpr uint32_t BENCHMARK_WARMUP_FRAMES = 30;
+constexpr uint32_t BENCHMARK_MEASURED_FRAMES = 300;
+
+bool Engine::measureFrames(uint64_t& invocations, double& graphicsMs, double& recordMs)
+{
+	invocations = 0U;
+	graphicsMs = 0.0;
+	recordMs = 0.0;
+	for (uint32_t frame = 0; frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_MEASURED_FRAMES; ++frame)
+	{
+		if (!runFrame())
+		{
+			return false;
+		}
+		if (frame >= BENCHMARK_WARMUP_FRAMES)
+		{
+			invocations += rend.fragmentInvocations.load(std::memory_order_relaxed);
+			graphicsMs += rend.graphicsGpuMs.load(std::memory_order_relaxed);
+			recordMs += rend.recordTimeMs.load(std::memory_order_relaxed);
+		}
+	}
+	invocations /= BENCHMARK_MEASURED_FRAMES;
+	graphicsMs /= BENCHMARK_MEASURED_FRAMES;
+	recordMs /= BENCHMARK_MEASURED_FRAMES;
+	return true;
+}
+
+void Engine::runDepthPrepassBenchmark()
+{
+	ZoneScoped;
+	setupOverdrawScene();
+	if (!rend.supportsPipelineStatistics())
+	{
+		LOG_CORE_WARN("Pipeline statistics queries are not supported, fragment shader invocations read as 0");
+	}
+
+	// every layer has to reach the rasteriser for the pre-pass to have something to save
+	renderSettings.occlusionCulling = false;
+
+	rend.startRenderThread();
+	for (const bool prepass : { false, true })
+	{
+		renderSettings.depthPrepass = prepass;
+
+		uint64_t invocations = 0U;
+		double graphicsMs = 0.0;
+		double recordMs = 0.0;
+		if (!measureFrames(invocations, graphicsMs, recordMs))
+		{
+			return;
+		}
+
+		LOG_CORE_INFO("Depth prepass {}: {} fragment shader invocations, {:.3f} ms graphics GPU per frame",
+			prepass ? "on" : "off", invocations, graphicsMs);
+	}
+}
+
+void Engine::runOcclusionCullingBenchmark()
+{
+	ZoneScoped;
+	setupOverdrawScene();
+	if (!rend.supportsPipelineStatistics())
+	{
+		LOG_CORE_WARN("Pipeline statistics queries are not supported, fragment shader invocations read as 0");
+	}
+
+	if (!rend.supportsGpuOcclusion())
+	{
+		LOG_CORE_WARN("GPU occlusion culling is not supported, both runs draw every layer");
+	}
+
+	// only the front wall is visible, everything behind it should be culled before it reaches the rasteriser
+	renderSettings.depthPrepass = false;
+
+	rend.startRenderThread();
+	for (const bool occlusion : { false, true })
+	{
+		renderSettings.occlusionCulling = occlusion;
+
+		uint64_t invocations = 0U;
+		double graphicsMs = 0.0;
+		double recordMs = 0.0;
+		if (!measureFrames(invocations, graphicsMs, recordMs))
+		{
+			return;
+		}
+
+		LOG_CORE_INFO("Occlusion culling {}: {} fragment shader invocations, {:.3f} ms graphics GPU per frame",
+			occlusion ? "on" : "off", invocations, graphicsMs);
+	}
+}
+
+void Engine::runRecordThreadBenchmark()
+{
+	ZoneScoped;
+	setupOverdrawScene();
+
+	// only the shading passes are recorded, so every thread count records the same draws
+	renderSettings.depthPrepass = false;
+
+	rend.startRenderThread();
+	double singleThreadMs = 0.0;
+	for (int threads = 1; threads <= static_cast<int>(MAX_RECORD_THREADS); ++threads)
+	{
+		renderSettings.recordThreadCount = threads;
+
+		uint64_t invocations = 0U;
+		double graphicsMs = 0.0;
+		double recordMs = 0.0;
+		if (!measureFrames(invocations, graphicsMs, recordMs))
+		{
+			return;
+		}
+		if (threads == 1)
+		{
+			singleThreadMs = recordMs;
+		}
+
+		LOG_CORE_INFO("Record threads {}: {:.3f} ms draw recording per frame ({:.2f}x)",
+			threads, recordMs, singleThreadMs / recordMs);
+	}
+}
+
+// enough to repair the overdraw scene's tree within a frame or two if everything moved
+constexpr uint32_t BVH_REBUILD_OBJECTS_PER_FRAME = 2048;
+
+void Engine::updateScene()
+{
+	ZoneScoped;
+	camera.view =
+		glm::lookAt({ camera.pos.x,camera.pos.y,camera.pos.z },
+			glm::vec3(0.0f, -0.5f, 0.0f),
+			UP_DIR);
+
+	ImGui_ImplVulkan_NewFrame();
+	ImGui_ImplSDL2_NewFrame(rend.window.window);
+	ImGui::NewFrame();
+	Editor::DrawEditor();
+	ImGui::Render();
+
+	// the editor may have moved nodes
+	updateTransforms();
+
+	// objects that moved are refitted, the subtrees they stretched the most are rebuilt a few at a time
+	updateObjectBounds();
+	sceneBVH.update(renderObjects.getBounds(), BVH_REBUILD_OBJECTS_PER_FRAME);
+
+	if (pickRequested)
+	{
+		pickObject();
+		pickRequested = false;
+	}
+}
+
+void Engine::updateTransforms()
+{
+	ZoneScoped;
+	sceneGraph.update();
+	std::vector<glm::mat4>& transforms = renderObjects.getTransforms();
+	for (uint32_t i = 0; i < renderObjects.size(); ++i)
+	{
+		transforms[i] = sceneGraph.getWorldMatrix(entityNodes[renderObjects.getEntity(i)]);
+	}
+	for (size_t i = 0; i < occluders.size(); ++i)
+	{
+		occluders[i].transform = sceneGraph.getWorldMatrix(occluderNodes[i]);
+	}
+}
+
+void Engine::updateObjectBounds()
+{
+	ZoneScoped;
+	const RenderableTypes::RenderObjectArrays& objects = renderObjects.getArrays();
+	std::vector<AABB>& bounds = renderObjects.getBounds();
+	for (uint32_t i = 0; i < renderObjects.size(); ++i)
+	{
+		bounds[i] = AABB::Transform(rend.getMeshBounds(objects.meshes[i]), objects.transforms[i]);
+	}
+}
+
+void Engine::finishSceneSetup()
+{
+	renderObjects.sortForDrawing();
+	updateTransforms();
+	updateObjectBounds();
+	sceneBVH.build(renderObjects.getBounds());
+}
+
+RenderEntity Engine::addRenderObject(const RenderableTypes::RenderObject& object, SceneNodeHandle node)
+{
+	const RenderEntity entity = renderObjects.create(object);
+	if (entity >= entityNodes.size())
+	{
+		entityNodes.resize(entity + 1, INVALID_SCENE_NODE);
+	}
+	entityNodes[entity] = node;
+	return entity;
+}
+
+void Engine::pickObject()
+{
+	ZoneScoped;
+	// any point on the pixel's line of sight will do, the far plane avoids depth range conventions
+	const glm::vec2 ndc = pickPosition * 2.0f - 1.0f;
+	const glm::vec4 farPoint = glm::inverse(camera.proj * camera.view) * glm::vec4(ndc, 1.0f, 1.0f);
+	const glm::vec3 origin{ camera.pos };
+	const glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+
+	const std::optional<BVH::RayHit> hit = sceneBVH.raycast(origin, direction);
+	selectedNode = hit ? entityNodes[renderObjects.getEntity(hit->object)] : INVALID_SCENE_NODE;
+}
+
+FramePacket Engine::buildFramePacket()
+{
+	ZoneScoped;
+	FramePacket packet{
+		.renderObjects = renderObjects.getArrays(),
+		.occluders = occluders,
+		.camera = camera,
+		.sunlight = sunlight,
+		.settings = renderSettings,
+	};
+	packet.imguiFrame.capture(*ImGui::GetDrawData());
+	return packet;
 }
 
 void Engine::deinit()
 {
 	ZoneScoped;
 	rend.deinit();
+	delete Jobs::JobSystem::ptr;
 }
\ No newline at end of file
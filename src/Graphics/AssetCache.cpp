@@ -0,0 +1,41 @@
+#include "Graphics/AssetCache.h"
+
+uint32_t AssetCache::acquire(uint64_t key)
+{
+	const auto found = handles.find(key);
+	if (found == handles.end())
+	{
+		return 0;
+	}
+	++entries[found->second].references;
+	++hits;
+	return found->second;
+}
+
+void AssetCache::insert(uint64_t key, uint32_t handle)
+{
+	handles[key] = handle;
+	entries[handle] = Entry{ .key = key, .references = 1 };
+}
+
+bool AssetCache::release(uint32_t handle)
+{
+	const auto found = entries.find(handle);
+	if (found == entries.end())
+	{
+		return true;
+	}
+	if (--found->second.references > 0)
+	{
+		return false;
+	}
+	handles.erase(found->second.key);
+	entries.erase(found);
+	return true;
+}
+
+uint32_t AssetCache::getReferenceCount(uint32_t handle) const
+{
+	const auto found = entries.find(handle);
+	return found == entries.end() ? 0U : found->second.references;
+}
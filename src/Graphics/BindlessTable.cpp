@@ -0,0 +1,115 @@
+#include "Graphics/BindlessTable.h"
+
+#include <public/tracy/Tracy.hpp>
+
+#include <algorithm>
+
+#include "Graphics/VulkanInit.h"
+#include "Log.h"
+
+void BindlessTable::init(VkDevice vkDevice, VkPhysicalDevice physicalDevice, uint32_t maxCapacity)
+{
+	ZoneScoped;
+	device = vkDevice;
+
+	VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES,
+	};
+	VkPhysicalDeviceProperties2 properties{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &indexingProperties,
+	};
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+	// the fragment stage sees the whole array, so the per stage limit applies as well
+	const uint32_t capacity = std::min({ maxCapacity,
+		indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+		indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		indexingProperties.maxUpdateAfterBindDescriptorsInAllPools });
+
+	const VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, capacity };
+	const VkDescriptorPoolCreateInfo poolCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &poolSize,
+	};
+	vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &pool);
+
+	// slots are written while the set is bound, and any that pending work doesn't sample may change meanwhile
+	const VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+		| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	const VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlags{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+		.bindingCount = 1,
+		.pBindingFlags = &flags,
+	};
+	const VkDescriptorSetLayoutBinding binding = VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 0, capacity);
+	const VkDescriptorSetLayoutCreateInfo layoutInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = &bindingFlags,
+		.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+		.bindingCount = 1,
+		.pBindings = &binding,
+	};
+	vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout);
+
+	const VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
+		.descriptorSetCount = 1,
+		.pDescriptorCounts = &capacity,
+	};
+	const VkDescriptorSetAllocateInfo allocInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = &countInfo,
+		.descriptorPool = pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &layout,
+	};
+	vkAllocateDescriptorSets(device, &allocInfo, &set);
+	slots.init(capacity);
+
+	LOG_CORE_INFO("Bindless table holds {} textures", capacity);
+}
+
+void BindlessTable::deinit()
+{
+	vkDestroyDescriptorPool(device, pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, layout, nullptr);
+	pool = VK_NULL_HANDLE;
+	layout = VK_NULL_HANDLE;
+	set = VK_NULL_HANDLE;
+	slots.init(0);
+}
+
+uint32_t BindlessTable::add(VkImageView view)
+{
+	const uint32_t slot = slots.allocate();
+	if (slot == INVALID_SLOT)
+	{
+		LOG_CORE_ERROR("Bindless table is full, {} textures", slots.getCapacity());
+		return INVALID_SLOT;
+	}
+
+	const VkDescriptorImageInfo imageInfo{
+		.imageView = view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+	const VkWriteDescriptorSet write{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = set,
+		.dstBinding = 0,
+		.dstArrayElement = slot,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+		.pImageInfo = &imageInfo,
+	};
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	return slot;
+}
+
+void BindlessTable::remove(uint32_t slot)
+{
+	// the descriptor keeps pointing at the old view until the slot is written again, the binding is partially bound
+	slots.free(slot);
+}
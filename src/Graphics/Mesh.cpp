@@ -1,7 +1,9 @@
 #include "Mesh.h"
 
 #include <iostream>
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <tiny_obj_loader.h>
 
 #include "Log.h"
@@ -314,6 +316,32 @@ bool RenderableTypes::MeshDesc::hasIndices() const {
 }
 
 bool RenderableTypes::MeshDesc::loadFromObj(const char* filename)
+{
+	AABB bounds;
+	glm::vec4 boundingSphere;
+	float uvDensity;
+	return LoadObj(filename, [this](size_t vertexCount) {
+		vertices.resize(vertexCount);
+		return MeshStreams{ .vertices = vertices.data() };
+		}, bounds, boundingSphere, uvDensity);
+}
+
+static void accumulateTriangleArea(const RenderableTypes::Vertex& a, const RenderableTypes::Vertex& b, const RenderableTypes::Vertex& c,
+	float& surfaceArea, float& uvArea)
+{
+	surfaceArea += glm::length(glm::cross(b.position - a.position, c.position - a.position));
+	const glm::vec2 uvAB = b.uv - a.uv;
+	const glm::vec2 uvAC = c.uv - a.uv;
+	uvArea += std::abs(uvAB.x * uvAC.y - uvAB.y * uvAC.x);
+}
+
+static float uvDensityFromAreas(float surfaceArea, float uvArea)
+{
+	// both are doubled areas, the factor cancels
+	return surfaceArea > 0.0f && uvArea > 0.0f ? std::sqrt(uvArea / surfaceArea) : 1.0f;
+}
+
+bool RenderableTypes::MeshDesc::LoadObj(const char* filename, const std::function<MeshStreams(size_t vertexCount)>& allocate, AABB& outBounds, glm::vec4& outBoundingSphere, float& outUvDensity)
 {
 	//attrib will contain the vertex arrays of the file
 	tinyobj::attrib_t attrib;
@@ -341,6 +369,22 @@ bool RenderableTypes::MeshDesc::loadFromObj(const char* filename)
 		return false;
 	}
 
+	//hardcode loading to triangles
+	constexpr size_t fv = 3;
+
+	size_t vertexCount = 0;
+	for (const tinyobj::shape_t& shape : shapes)
+	{
+		vertexCount += shape.mesh.num_face_vertices.size() * fv;
+	}
+	CalculateBounds(reinterpret_cast<const glm::vec3*>(attrib.vertices.data()), attrib.vertices.size() / 3, sizeof(glm::vec3), outBounds, outBoundingSphere);
+
+	// every vertex is written once and never read back, the streams may be write combined upload memory
+	const MeshStreams streams = allocate(vertexCount);
+	size_t vertex = 0;
+	float surfaceArea = 0.0f;
+	float uvArea = 0.0f;
+
 	// Loop over shapes
 	for (size_t s = 0; s < shapes.size(); s++)
 	{
@@ -348,10 +392,7 @@ bool RenderableTypes::MeshDesc::loadFromObj(const char* filename)
 		size_t index_offset = 0;
 		for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
 		{
-
-			//hardcode loading to triangles
-			int fv = 3;
-
+			Vertex face[fv];
 			// Loop over vertices in the face.
 			for (size_t v = 0; v < fv; v++)
 			{
@@ -386,12 +427,66 @@ bool RenderableTypes::MeshDesc::loadFromObj(const char* filename)
 				new_vert.uv.x = ux;
 				new_vert.uv.y = 1 - uy;
 
-
-				vertices.push_back(new_vert);
+				face[v] = new_vert;
+				streams.vertices[vertex] = new_vert;
+				if (streams.positions != nullptr)
+				{
+					streams.positions[vertex] = new_vert.position;
+				}
+				++vertex;
 			}
+			accumulateTriangleArea(face[0], face[1], face[2], surfaceArea, uvArea);
 			index_offset += fv;
 		}
 	}
+	outUvDensity = uvDensityFromAreas(surfaceArea, uvArea);
 
 	return true;
-}
\ No newline at end of file
+}
+
+void RenderableTypes::MeshDesc::CalculateBounds(const glm::vec3* positions, size_t count, size_t stride, AABB& outBounds, glm::vec4& outBoundingSphere)
+{
+	const auto position = [positions, stride](size_t i) -> const glm::vec3& {
+		return *reinterpret_cast<const glm::vec3*>(reinterpret_cast<const uint8_t*>(positions) + i * stride);
+	};
+
+	outBounds = AABB{};
+	for (size_t i = 0; i < count; ++i)
+	{
+		outBounds.grow(position(i));
+	}
+	if (count == 0)
+	{
+		outBounds = AABB{ .min = glm::vec3{ 0.0f }, .max = glm::vec3{ 0.0f } };
+	}
+	const glm::vec3 centre = outBounds.centre();
+
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const glm::vec3 offset = position(i) - centre;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	outBoundingSphere = glm::vec4(centre, std::sqrt(radiusSquared));
+}
+
+float RenderableTypes::MeshDesc::CalculateUvDensity(const Vertex* vertices, size_t vertexCount, const Index* indices, size_t indexCount)
+{
+	float surfaceArea = 0.0f;
+	float uvArea = 0.0f;
+	if (indexCount > 0)
+	{
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			accumulateTriangleArea(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]], surfaceArea, uvArea);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i + 2 < vertexCount; i += 3)
+		{
+			accumulateTriangleArea(vertices[i], vertices[i + 1], vertices[i + 2], surfaceArea, uvArea);
+		}
+	}
+	return uvDensityFromAreas(surfaceArea, uvArea);
+}
@@ -0,0 +1,354 @@
+#include "Graphics/OcclusionBuffer.h"
+
+#include <public/tracy/Tracy.hpp>
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "Jobs/JobSystem.h"
+
+// Occluders transformed per job and tile rows rasterised per job
+constexpr uint32_t OCCLUDER_JOB_GRAIN = 16;
+constexpr uint32_t TILE_ROW_JOB_GRAIN = 2;
+// Vertices closer to the camera plane than this reject their triangle or make an occludee visible
+constexpr float MIN_CLIP_W = 1e-5f;
+
+constexpr float FAR_DEPTH = std::numeric_limits<float>::max();
+
+void OcclusionBuffer::init(uint32_t width, uint32_t height)
+{
+	this->width = std::max(width, 1U);
+	this->height = std::max(height, 1U);
+	tilesX = (this->width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+	tilesY = (this->height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+
+	const size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+	farthestDepth.assign(tileCount + 3, FAR_DEPTH);
+	workingDepth.assign(tileCount, 0.0f);
+	workingMasks.assign(tileCount * OCCLUSION_TILE_HEIGHT, 0U);
+}
+
+void OcclusionBuffer::rasterize(const glm::mat4& viewProj, const Occluder* occluders, uint32_t count)
+{
+	ZoneScoped;
+	this->viewProj = viewProj;
+	std::fill(farthestDepth.begin(), farthestDepth.end(), FAR_DEPTH);
+	std::fill(workingDepth.begin(), workingDepth.end(), 0.0f);
+	std::fill(workingMasks.begin(), workingMasks.end(), 0U);
+
+	triangleOffsets.resize(count + 1);
+	triangleOffsets[0] = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		triangleOffsets[i + 1] = triangleOffsets[i] + static_cast<uint32_t>(occluders[i].mesh->indices.size() / 3);
+	}
+	triangles.resize(triangleOffsets[count]);
+
+	Jobs::JobSystem::ptr->parallelFor(count, OCCLUDER_JOB_GRAIN, [this, occluders](uint32_t begin, uint32_t end) {
+		ZoneScopedN("Setup Occluders");
+		std::vector<glm::vec4> clipPositions;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			setupTriangles(occluders[i], triangles.data() + triangleOffsets[i], clipPositions);
+		}
+		});
+
+	// every job owns whole tile rows, so no two jobs touch the same tile
+	Jobs::JobSystem::ptr->parallelFor(tilesY, TILE_ROW_JOB_GRAIN, [this](uint32_t begin, uint32_t end) {
+		ZoneScopedN("Rasterize Occluders");
+		rasterizeTileRows(begin, end);
+		});
+}
+
+void OcclusionBuffer::setupTriangles(const Occluder& occluder, Triangle* outTriangles, std::vector<glm::vec4>& clipPositions) const
+{
+	const OccluderMesh& mesh = *occluder.mesh;
+	const glm::mat4 modelViewProj = viewProj * occluder.modelMatrix;
+	clipPositions.resize(mesh.positions.size());
+	for (size_t i = 0; i < mesh.positions.size(); ++i)
+	{
+		clipPositions[i] = modelViewProj * glm::vec4(mesh.positions[i], 1.0f);
+	}
+
+	const float maxX = static_cast<float>(width - 1);
+	const float maxY = static_cast<float>(height - 1);
+	const size_t triangleCount = mesh.indices.size() / 3;
+	for (size_t t = 0; t < triangleCount; ++t)
+	{
+		Triangle& triangle = outTriangles[t];
+		// rejected until it passes every test
+		triangle.minY = 1;
+		triangle.maxY = 0;
+
+		// x and y in pixels, z the depth the GPU would write
+		glm::vec3 screen[3];
+		bool rejected = false;
+		for (int k = 0; k < 3; ++k)
+		{
+			const glm::vec4 clip = clipPositions[mesh.indices[t * 3 + k]];
+			// no clipping, a triangle crossing the near plane is simply not an occluder
+			if (clip.w <= MIN_CLIP_W || clip.z < 0.0f)
+			{
+				rejected = true;
+				break;
+			}
+			const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			screen[k] = { (ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z };
+		}
+		if (rejected)
+		{
+			continue;
+		}
+
+		// occluders are two sided, wind every triangle the same way
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+		if (area == 0.0f)
+		{
+			continue;
+		}
+		if (area < 0.0f)
+		{
+			std::swap(screen[1], screen[2]);
+			area = -area;
+		}
+
+		const float boundsMinX = std::floor(std::min({ screen[0].x, screen[1].x, screen[2].x }));
+		const float boundsMaxX = std::ceil(std::max({ screen[0].x, screen[1].x, screen[2].x }));
+		const float boundsMinY = std::floor(std::min({ screen[0].y, screen[1].y, screen[2].y }));
+		const float boundsMaxY = std::ceil(std::max({ screen[0].y, screen[1].y, screen[2].y }));
+		if (boundsMaxX < 0.0f || boundsMaxY < 0.0f || boundsMinX > maxX || boundsMinY > maxY)
+		{
+			continue;
+		}
+
+		// edge function a * x + b * y + c >= 0 inside, solved for the x where a scanline crosses the edge
+		for (int e = 0; e < 3; ++e)
+		{
+			const glm::vec3& from = screen[e];
+			const glm::vec3& to = screen[(e + 1) % 3];
+			const float a = from.y - to.y;
+			const float b = to.x - from.x;
+			const float c = from.x * to.y - from.y * to.x;
+			if (a != 0.0f)
+			{
+				triangle.edgeSlope[e] = -b / a;
+				triangle.edgeOffset[e] = -c / a;
+				triangle.edgeSide[e] = a > 0.0f ? 1 : -1;
+			}
+			else
+			{
+				triangle.edgeSlope[e] = b;
+				triangle.edgeOffset[e] = c;
+				triangle.edgeSide[e] = 0;
+			}
+		}
+
+		const glm::vec3 edge1 = screen[1] - screen[0];
+		const glm::vec3 edge2 = screen[2] - screen[0];
+		triangle.depthDx = (edge1.z * edge2.y - edge1.y * edge2.z) / area;
+		triangle.depthDy = (edge1.x * edge2.z - edge1.z * edge2.x) / area;
+		triangle.depth = screen[0].z - triangle.depthDx * screen[0].x - triangle.depthDy * screen[0].y;
+		triangle.maxDepth = std::max({ screen[0].z, screen[1].z, screen[2].z });
+
+		triangle.minX = static_cast<int>(std::max(boundsMinX, 0.0f));
+		triangle.maxX = static_cast<int>(std::min(boundsMaxX, maxX));
+		triangle.minY = static_cast<int>(std::max(boundsMinY, 0.0f));
+		triangle.maxY = static_cast<int>(std::min(boundsMaxY, maxY));
+	}
+}
+
+void OcclusionBuffer::rasterizeTileRows(uint32_t beginRow, uint32_t endRow)
+{
+	// triangles stay in submission order within a tile, the working layer heuristic depends on it
+	for (const Triangle& triangle : triangles)
+	{
+		if (triangle.minY > triangle.maxY)
+		{
+			continue;
+		}
+		const uint32_t firstRow = std::max(beginRow, static_cast<uint32_t>(triangle.minY) / OCCLUSION_TILE_HEIGHT);
+		const uint32_t lastRow = std::min(endRow - 1, static_cast<uint32_t>(triangle.maxY) / OCCLUSION_TILE_HEIGHT);
+		for (uint32_t tileRow = firstRow; tileRow <= lastRow; ++tileRow)
+		{
+			rasterizeTriangle(triangle, tileRow);
+		}
+	}
+}
+
+void OcclusionBuffer::rasterizeTriangle(const Triangle& triangle, uint32_t tileRow)
+{
+	// the four scanlines of the tile row, sampled at pixel centres
+	const int rowY = static_cast<int>(tileRow * OCCLUSION_TILE_HEIGHT);
+	const __m128 scanlineY = _mm_add_ps(_mm_set1_ps(static_cast<float>(rowY)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+	const __m128 lowest = _mm_set1_ps(std::numeric_limits<float>::lowest());
+
+	__m128 left = lowest;
+	__m128 right = _mm_set1_ps(std::numeric_limits<float>::max());
+	for (int e = 0; e < 3; ++e)
+	{
+		const __m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeSlope[e]), scanlineY), _mm_set1_ps(triangle.edgeOffset[e]));
+		if (triangle.edgeSide[e] > 0)
+		{
+			left = _mm_max_ps(left, value);
+		}
+		else if (triangle.edgeSide[e] < 0)
+		{
+			right = _mm_min_ps(right, value);
+		}
+		else
+		{
+			// a horizontal edge either keeps the whole scanline or none of it
+			const __m128 outside = _mm_cmplt_ps(value, _mm_setzero_ps());
+			right = _mm_or_ps(_mm_and_ps(outside, lowest), _mm_andnot_ps(outside, right));
+		}
+	}
+
+	// first and last pixel whose centre is inside the span, clamped to the bounds so they fit an int
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 firstX = _mm_min_ps(_mm_max_ps(_mm_sub_ps(left, half), _mm_set1_ps(static_cast<float>(triangle.minX))), _mm_set1_ps(static_cast<float>(triangle.maxX + 1)));
+	const __m128 lastX = _mm_max_ps(_mm_min_ps(_mm_sub_ps(right, half), _mm_set1_ps(static_cast<float>(triangle.maxX))), _mm_set1_ps(static_cast<float>(triangle.minX - 1)));
+
+	// SSE2 has no ceil or floor, truncate and step by one where truncation went the wrong way
+	__m128i first = _mm_cvttps_epi32(firstX);
+	first = _mm_sub_epi32(first, _mm_castps_si128(_mm_cmplt_ps(_mm_cvtepi32_ps(first), firstX)));
+	__m128i last = _mm_cvttps_epi32(lastX);
+	last = _mm_add_epi32(last, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(last), lastX)));
+
+	alignas(16) int spanFirst[OCCLUSION_TILE_HEIGHT];
+	alignas(16) int spanLast[OCCLUSION_TILE_HEIGHT];
+	_mm_store_si128(reinterpret_cast<__m128i*>(spanFirst), first);
+	_mm_store_si128(reinterpret_cast<__m128i*>(spanLast), last);
+	for (uint32_t row = 0; row < OCCLUSION_TILE_HEIGHT; ++row)
+	{
+		const int y = rowY + static_cast<int>(row);
+		if (y < triangle.minY || y > triangle.maxY)
+		{
+			spanLast[row] = spanFirst[row] - 1;
+		}
+	}
+
+	const float tileMinY = static_cast<float>(std::max(rowY, triangle.minY));
+	const float tileMaxY = static_cast<float>(std::min(rowY + static_cast<int>(OCCLUSION_TILE_HEIGHT), triangle.maxY + 1));
+	const uint32_t firstTile = static_cast<uint32_t>(triangle.minX) / OCCLUSION_TILE_WIDTH;
+	const uint32_t lastTile = static_cast<uint32_t>(triangle.maxX) / OCCLUSION_TILE_WIDTH;
+	for (uint32_t tileX = firstTile; tileX <= lastTile; ++tileX)
+	{
+		const int pixelX = static_cast<int>(tileX * OCCLUSION_TILE_WIDTH);
+
+		uint32_t rowMasks[OCCLUSION_TILE_HEIGHT];
+		uint32_t anyCoverage = 0U;
+		for (uint32_t row = 0; row < OCCLUSION_TILE_HEIGHT; ++row)
+		{
+			const int start = std::max(spanFirst[row] - pixelX, 0);
+			const int end = std::min(spanLast[row] - pixelX, static_cast<int>(OCCLUSION_TILE_WIDTH) - 1);
+			rowMasks[row] = start <= end ? (~0U >> (31 - end)) & (~0U << start) : 0U;
+			anyCoverage |= rowMasks[row];
+		}
+		if (anyCoverage == 0U)
+		{
+			continue;
+		}
+
+		// farthest point of the plane over the part of the tile the triangle's bounds overlap
+		const float tileMinX = static_cast<float>(std::max(pixelX, triangle.minX));
+		const float tileMaxX = static_cast<float>(std::min(pixelX + static_cast<int>(OCCLUSION_TILE_WIDTH), triangle.maxX + 1));
+		const float planeDepth = triangle.depth
+			+ triangle.depthDx * (triangle.depthDx > 0.0f ? tileMaxX : tileMinX)
+			+ triangle.depthDy * (triangle.depthDy > 0.0f ? tileMaxY : tileMinY);
+
+		updateTile(tileRow * tilesX + tileX, rowMasks, std::min(planeDepth, triangle.maxDepth));
+	}
+}
+
+void OcclusionBuffer::updateTile(uint32_t tileIndex, const uint32_t rowMasks[OCCLUSION_TILE_HEIGHT], float triangleDepth)
+{
+	float& farthest = farthestDepth[tileIndex];
+	// behind everything that already covers the tile
+	if (triangleDepth >= farthest)
+	{
+		return;
+	}
+
+	float& working = workingDepth[tileIndex];
+	__m128i* workingMask = reinterpret_cast<__m128i*>(&workingMasks[tileIndex * OCCLUSION_TILE_HEIGHT]);
+	const __m128i triangleMask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rowMasks));
+	const __m128i fullMask = _mm_set1_epi32(-1);
+
+	// a triangle much closer than the working layer starts a new one instead of being merged with it
+	const bool triangleCovers = _mm_movemask_epi8(_mm_cmpeq_epi32(triangleMask, fullMask)) == 0xFFFF;
+	if (triangleCovers || working - triangleDepth > farthest - working)
+	{
+		working = triangleDepth;
+		_mm_storeu_si128(workingMask, triangleMask);
+	}
+	else
+	{
+		working = std::max(working, triangleDepth);
+		_mm_storeu_si128(workingMask, _mm_or_si128(_mm_loadu_si128(workingMask), triangleMask));
+	}
+
+	// once the working layer covers the tile its farthest depth bounds the whole tile
+	if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128(workingMask), fullMask)) == 0xFFFF)
+	{
+		farthest = working;
+		working = 0.0f;
+		_mm_storeu_si128(workingMask, _mm_setzero_si128());
+	}
+}
+
+bool OcclusionBuffer::isOccluded(const glm::vec4& boundingSphere) const
+{
+	// same test as occlusion.comp, the box around the sphere against the farthest depths under it
+	glm::vec2 pixelMin{ std::numeric_limits<float>::max() };
+	glm::vec2 pixelMax{ std::numeric_limits<float>::lowest() };
+	float nearestDepth = std::numeric_limits<float>::max();
+	const glm::vec2 size{ static_cast<float>(width), static_cast<float>(height) };
+	for (int i = 0; i < 8; ++i)
+	{
+		const glm::vec3 corner = glm::vec3(boundingSphere) + boundingSphere.w * glm::vec3(
+			(i & 1) != 0 ? 1.0f : -1.0f, (i & 2) != 0 ? 1.0f : -1.0f, (i & 4) != 0 ? 1.0f : -1.0f);
+		const glm::vec4 clip = viewProj * glm::vec4(corner, 1.0f);
+		// behind the camera the projection flips, treat the object as visible
+		if (clip.w <= MIN_CLIP_W)
+		{
+			return false;
+		}
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		const glm::vec2 pixel = (glm::vec2(ndc) * 0.5f + 0.5f) * size;
+		pixelMin = glm::min(pixelMin, pixel);
+		pixelMax = glm::max(pixelMax, pixel);
+		nearestDepth = std::min(nearestDepth, ndc.z);
+	}
+
+	// crossing the near plane or off screen, frustum culling decides
+	if (nearestDepth < 0.0f || pixelMax.x < 0.0f || pixelMax.y < 0.0f || pixelMin.x >= size.x || pixelMin.y >= size.y)
+	{
+		return false;
+	}
+
+	const uint32_t firstTileX = static_cast<uint32_t>(std::max(pixelMin.x, 0.0f)) / OCCLUSION_TILE_WIDTH;
+	const uint32_t lastTileX = static_cast<uint32_t>(std::min(pixelMax.x, size.x - 1.0f)) / OCCLUSION_TILE_WIDTH;
+	const uint32_t firstTileY = static_cast<uint32_t>(std::max(pixelMin.y, 0.0f)) / OCCLUSION_TILE_HEIGHT;
+	const uint32_t lastTileY = static_cast<uint32_t>(std::min(pixelMax.y, size.y - 1.0f)) / OCCLUSION_TILE_HEIGHT;
+
+	const __m128 nearest = _mm_set1_ps(nearestDepth);
+	for (uint32_t tileY = firstTileY; tileY <= lastTileY; ++tileY)
+	{
+		for (uint32_t tileX = firstTileX; tileX <= lastTileX; tileX += 4)
+		{
+			// lanes past the last tile read the next row or the padding and are ignored
+			const __m128 farthest = _mm_loadu_ps(&farthestDepth[tileY * tilesX + tileX]);
+			const int occluded = _mm_movemask_ps(_mm_cmpgt_ps(nearest, farthest));
+			const int lanes = (1 << std::min(4U, lastTileX - tileX + 1)) - 1;
+			if ((occluded & lanes) != lanes)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
@@ -59,12 +59,14 @@ VkPipeline PipelineBuild::BuildPipeline(VkDevice device, const BuildInfo& buildI
 		.pDynamicStates = dynamicStateEnables.data(),
 	};
 
+	const std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(buildInfo.colorAttachmentFormats.size(), buildInfo.colorBlendAttachment);
+
 	const VkPipelineColorBlendStateCreateInfo colorBlending = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
 		.logicOpEnable = VK_FALSE,
 		.logicOp = VK_LOGIC_OP_COPY,
-		.attachmentCount = 1,
-		.pAttachments = &buildInfo.colorBlendAttachment,
+		.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size()),
+		.pAttachments = colorBlendAttachments.data(),
 	};
 
 	const VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {
@@ -92,12 +94,11 @@ VkPipeline PipelineBuild::BuildPipeline(VkDevice device, const BuildInfo& buildI
 	// ----- NOT USED -----
 
 	VkPipelineRenderingCreateInfo dynamicRenderingInfo = { VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO };
-	VkFormat colorAttachmentFormats[] = { VK_FORMAT_R8G8B8A8_SRGB };
 
 	dynamicRenderingInfo.pNext = nullptr;
-	dynamicRenderingInfo.colorAttachmentCount = std::size(colorAttachmentFormats);
-	dynamicRenderingInfo.pColorAttachmentFormats = colorAttachmentFormats;
-	dynamicRenderingInfo.depthAttachmentFormat = VK_FORMAT_D32_SFLOAT;
+	dynamicRenderingInfo.colorAttachmentCount = static_cast<uint32_t>(buildInfo.colorAttachmentFormats.size());
+	dynamicRenderingInfo.pColorAttachmentFormats = buildInfo.colorAttachmentFormats.data();
+	dynamicRenderingInfo.depthAttachmentFormat = buildInfo.depthAttachmentFormat;
 	dynamicRenderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
 
 	const VkGraphicsPipelineCreateInfo pipelineInfo = {
@@ -128,3 +129,30 @@ VkPipeline PipelineBuild::BuildPipeline(VkDevice device, const BuildInfo& buildI
 	}
 	return newPipeline;
 }
+
+VkPipeline PipelineBuild::BuildComputePipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkShaderModule shaderModule)
+{
+	assert(pipelineLayout != VK_NULL_HANDLE);
+	assert(shaderModule != VK_NULL_HANDLE);
+
+	const VkComputePipelineCreateInfo pipelineInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = nullptr,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = shaderModule,
+			.pName = "main",
+		},
+		.layout = pipelineLayout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+	};
+
+	VkPipeline newPipeline;
+	VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline);
+	if (result != VK_SUCCESS)
+	{
+		return VK_NULL_HANDLE; // failed to create compute pipeline
+	}
+	return newPipeline;
+}
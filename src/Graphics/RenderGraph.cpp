@@ -0,0 +1,458 @@
+#include "Graphics/RenderGraph.h"
+
+#include <public/tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+#include "Graphics/Timeline.h"
+#include "Graphics/VulkanInit.h"
+#include "Log.h"
+
+static constexpr VkAccessFlags2 WRITE_ACCESS_MASK =
+	VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+	VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+static constexpr uint32_t NO_PREDECESSOR = UINT32_MAX;
+
+static bool isSameDesc(const RenderGraph::ImageDesc& a, const RenderGraph::ImageDesc& b)
+{
+	return a.format == b.format
+		&& a.extent.width == b.extent.width
+		&& a.extent.height == b.extent.height
+		&& a.usage == b.usage
+		&& a.aspect == b.aspect;
+}
+
+static VkImageCreateInfo toImageCreateInfo(const RenderGraph::ImageDesc& desc)
+{
+	return VulkanInit::imageCreateInfo(desc.format, desc.usage, VkExtent3D{ desc.extent.width, desc.extent.height, 1 });
+}
+
+RenderGraph::AccessInfo RenderGraph::GetAccessInfo(Access access)
+{
+	switch (access)
+	{
+	case Access::COLOR_ATTACHMENT:
+		return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true };
+	case Access::DEPTH_ATTACHMENT:
+		return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true };
+	case Access::DEPTH_ATTACHMENT_READ:
+		return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false };
+	case Access::FRAGMENT_SAMPLED:
+		return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+	case Access::COMPUTE_SAMPLED:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+	case Access::COMPUTE_STORAGE_READ:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+	case Access::COMPUTE_STORAGE_WRITE:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true };
+	case Access::TRANSFER_SRC:
+		return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false };
+	case Access::TRANSFER_DST:
+		return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true };
+	case Access::PRESENT:
+	default:
+		// the present semaphore makes the image visible to the presentation engine
+		return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false };
+	}
+}
+
+void RenderGraph::init(Timeline* timeline)
+{
+	this->timeline = timeline;
+}
+
+void RenderGraph::deinit()
+{
+	releaseTransientImages();
+}
+
+void RenderGraph::reset()
+{
+	images.clear();
+	passes.clear();
+}
+
+RenderGraph::ImageId RenderGraph::importImage(std::string_view name, VkImage image, VkImageView imageView, VkImageAspectFlags aspect, const ImageState& initialState, std::optional<Access> finalAccess)
+{
+	GraphImage& graphImage = images.emplace_back();
+	graphImage.name = name;
+	graphImage.image = image;
+	graphImage.imageView = imageView;
+	graphImage.aspect = aspect;
+	graphImage.finalAccess = finalAccess;
+	graphImage.layout = initialState.layout;
+	graphImage.writeStage = initialState.stage;
+	graphImage.writeAccess = initialState.access;
+	return static_cast<ImageId>(images.size() - 1);
+}
+
+RenderGraph::ImageId RenderGraph::createImage(std::string_view name, const ImageDesc& desc)
+{
+	GraphImage& graphImage = images.emplace_back();
+	graphImage.name = name;
+	graphImage.aspect = desc.aspect == ImageCreateInfo::Usage::DEPTH ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	graphImage.transient = true;
+	graphImage.desc = desc;
+	return static_cast<ImageId>(images.size() - 1);
+}
+
+void RenderGraph::addPass(std::string_view name, std::initializer_list<ImageUse> uses, PassFunction&& function)
+{
+	passes.push_back(Pass{
+		.name = std::string(name),
+		.uses = uses,
+		.function = std::move(function),
+		});
+}
+
+void RenderGraph::compile()
+{
+	ZoneScoped;
+	cullPasses();
+	computeLifetimes();
+	placeTransientImages();
+}
+
+void RenderGraph::cullPasses()
+{
+	// walk backwards from the outputs, a pass is needed if it writes something a needed pass reads
+	std::vector<bool> needed(images.size(), false);
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		needed[i] = images[i].finalAccess.has_value();
+	}
+
+	culledPassCount = 0U;
+	for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass)
+	{
+		bool writesAnything = false;
+		bool writesNeeded = false;
+		for (const ImageUse& use : pass->uses)
+		{
+			if (GetAccessInfo(use.access).write)
+			{
+				writesAnything = true;
+				writesNeeded = writesNeeded || needed[use.image];
+			}
+		}
+
+		pass->live = !writesAnything || writesNeeded;
+		if (!pass->live)
+		{
+			++culledPassCount;
+			continue;
+		}
+
+		for (const ImageUse& use : pass->uses)
+		{
+			needed[use.image] = true;
+		}
+	}
+}
+
+void RenderGraph::computeLifetimes()
+{
+	for (uint32_t passIndex = 0; passIndex < passes.size(); ++passIndex)
+	{
+		if (!passes[passIndex].live)
+		{
+			continue;
+		}
+		for (const ImageUse& use : passes[passIndex].uses)
+		{
+			GraphImage& image = images[use.image];
+			image.firstPass = std::min(image.firstPass, passIndex);
+			image.lastPass = std::max(image.lastPass, passIndex);
+		}
+	}
+}
+
+void RenderGraph::placeTransientImages()
+{
+	std::vector<ImageId> transientIds;
+	for (ImageId id = 0; id < images.size(); ++id)
+	{
+		if (images[id].transient)
+		{
+			transientIds.push_back(id);
+		}
+	}
+
+	// the physical images are reused as long as the descs and lifetimes match the last frame
+	bool sameShape = transientIds.size() == transientImages.size();
+	for (size_t i = 0; sameShape && i < transientIds.size(); ++i)
+	{
+		const GraphImage& image = images[transientIds[i]];
+		const TransientImage& cached = transientImages[i];
+		sameShape = isSameDesc(image.desc, cached.desc) && image.firstPass == cached.firstPass && image.lastPass == cached.lastPass;
+	}
+
+	if (!sameShape)
+	{
+		ZoneScopedN("Place Transient Images");
+		releaseTransientImages();
+
+		transientImages.resize(transientIds.size());
+		std::vector<VkMemoryRequirements> requirements(transientIds.size());
+		std::vector<uint32_t> blockOfImage(transientIds.size(), UINT32_MAX);
+		VkDeviceSize unaliasedSize = 0U;
+		for (size_t i = 0; i < transientIds.size(); ++i)
+		{
+			const GraphImage& image = images[transientIds[i]];
+			transientImages[i] = TransientImage{
+				.desc = image.desc,
+				.firstPass = image.firstPass,
+				.lastPass = image.lastPass,
+				.handle = 0U,
+				.predecessor = NO_PREDECESSOR,
+			};
+			requirements[i] = ResourceManager::ptr->GetImageMemoryRequirements(toImageCreateInfo(image.desc));
+		}
+
+		// largest first, then each image goes into the first block that is free for its whole lifetime
+		std::vector<uint32_t> order(transientIds.size());
+		std::iota(order.begin(), order.end(), 0U);
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return requirements[a].size > requirements[b].size;
+			});
+
+		std::vector<std::vector<uint32_t>> blockImages;
+		for (const uint32_t i : order)
+		{
+			const TransientImage& transient = transientImages[i];
+			if (transient.firstPass > transient.lastPass)
+			{
+				// only used by culled passes
+				continue;
+			}
+			unaliasedSize += requirements[i].size;
+
+			uint32_t chosenBlock = UINT32_MAX;
+			for (uint32_t block = 0; block < blockImages.size() && chosenBlock == UINT32_MAX; ++block)
+			{
+				if ((memoryBlocks[block].requirements.memoryTypeBits & requirements[i].memoryTypeBits) == 0U)
+				{
+					continue;
+				}
+
+				const bool overlaps = std::any_of(blockImages[block].begin(), blockImages[block].end(), [&](uint32_t other) {
+					return transient.firstPass <= transientImages[other].lastPass && transientImages[other].firstPass <= transient.lastPass;
+					});
+				if (!overlaps)
+				{
+					chosenBlock = block;
+				}
+			}
+
+			if (chosenBlock == UINT32_MAX)
+			{
+				chosenBlock = static_cast<uint32_t>(memoryBlocks.size());
+				memoryBlocks.push_back(MemoryBlock{ .requirements = requirements[i] });
+				blockImages.emplace_back();
+			}
+
+			VkMemoryRequirements& blockRequirements = memoryBlocks[chosenBlock].requirements;
+			blockRequirements.size = std::max(blockRequirements.size, requirements[i].size);
+			blockRequirements.alignment = std::max(blockRequirements.alignment, requirements[i].alignment);
+			blockRequirements.memoryTypeBits &= requirements[i].memoryTypeBits;
+			blockImages[chosenBlock].push_back(i);
+			blockOfImage[i] = chosenBlock;
+		}
+
+		transientMemorySize = 0U;
+		for (uint32_t block = 0; block < memoryBlocks.size(); ++block)
+		{
+			memoryBlocks[block].allocation = ResourceManager::ptr->AllocateImageMemory(memoryBlocks[block].requirements);
+			transientMemorySize += memoryBlocks[block].requirements.size;
+
+			// images in a block never overlap, so ordering them by first use gives the aliasing chain
+			std::vector<uint32_t>& chain = blockImages[block];
+			std::sort(chain.begin(), chain.end(), [&](uint32_t a, uint32_t b) {
+				return transientImages[a].firstPass < transientImages[b].firstPass;
+				});
+			for (size_t link = 1; link < chain.size(); ++link)
+			{
+				transientImages[chain[link]].predecessor = chain[link - 1];
+			}
+		}
+
+		for (size_t i = 0; i < transientImages.size(); ++i)
+		{
+			if (blockOfImage[i] == UINT32_MAX)
+			{
+				continue;
+			}
+			transientImages[i].handle = ResourceManager::ptr->CreateImage(ImageCreateInfo{
+				.imageInfo = toImageCreateInfo(transientImages[i].desc),
+				.imageType = ImageCreateInfo::ImageType::TEXTURE_2D,
+				.usage = transientImages[i].desc.aspect,
+				.aliasAllocation = memoryBlocks[blockOfImage[i]].allocation,
+				});
+		}
+
+		LOG_CORE_INFO("Render graph: {} transient images in {} memory blocks, {} KiB ({} KiB without aliasing)",
+			transientImages.size(), memoryBlocks.size(), transientMemorySize / 1024, unaliasedSize / 1024);
+	}
+
+	for (size_t i = 0; i < transientIds.size(); ++i)
+	{
+		GraphImage& image = images[transientIds[i]];
+		const TransientImage& transient = transientImages[i];
+		if (transient.handle != 0U)
+		{
+			const Image physicalImage = ResourceManager::ptr->GetImage(transient.handle);
+			image.image = physicalImage.image;
+			image.imageView = physicalImage.imageView;
+		}
+		image.aliasPredecessor = transient.predecessor == NO_PREDECESSOR ? UINT32_MAX : transientIds[transient.predecessor];
+	}
+}
+
+void RenderGraph::releaseTransientImages()
+{
+	// frames already submitted may still use the memory
+	std::vector<ImageHandle> handles;
+	std::vector<VmaAllocation> allocations;
+	for (const TransientImage& transient : transientImages)
+	{
+		if (transient.handle != 0U)
+		{
+			handles.push_back(transient.handle);
+		}
+	}
+	for (const MemoryBlock& block : memoryBlocks)
+	{
+		allocations.push_back(block.allocation);
+	}
+
+	if (!handles.empty() || !allocations.empty())
+	{
+		timeline->deferDeletion([handles = std::move(handles), allocations = std::move(allocations)]() {
+			for (const ImageHandle handle : handles)
+			{
+				ResourceManager::ptr->DestroyImage(handle);
+			}
+			for (const VmaAllocation allocation : allocations)
+			{
+				ResourceManager::ptr->FreeMemory(allocation);
+			}
+			});
+	}
+
+	transientImages.clear();
+	memoryBlocks.clear();
+	transientMemorySize = 0U;
+}
+
+void RenderGraph::addBarrier(GraphImage& image, const AccessInfo& info, bool discardContents)
+{
+	const bool layoutChange = discardContents || image.layout != info.layout;
+	if (!info.write && !layoutChange)
+	{
+		// reads after reads need nothing, a read after a write only needs the write made visible once per stage
+		image.readStages |= info.stage;
+		if ((image.visibleStages & info.stage) == info.stage)
+		{
+			return;
+		}
+
+		pendingBarriers.push_back(VkImageMemoryBarrier2{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+			.srcStageMask = image.writeStage,
+			.srcAccessMask = image.writeAccess,
+			.dstStageMask = info.stage,
+			.dstAccessMask = info.access,
+			.oldLayout = image.layout,
+			.newLayout = image.layout,
+			.image = image.image,
+			.subresourceRange = { image.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS },
+			});
+		image.visibleStages |= info.stage;
+		return;
+	}
+
+	// writes and layout transitions wait for the last write and every read since
+	const VkPipelineStageFlags2 srcStages = image.writeStage | image.readStages;
+	if (srcStages != VK_PIPELINE_STAGE_2_NONE || layoutChange)
+	{
+		pendingBarriers.push_back(VkImageMemoryBarrier2{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+			.srcStageMask = srcStages,
+			.srcAccessMask = image.writeAccess,
+			.dstStageMask = info.stage,
+			.dstAccessMask = info.access,
+			.oldLayout = discardContents ? VK_IMAGE_LAYOUT_UNDEFINED : image.layout,
+			.newLayout = info.layout,
+			.image = image.image,
+			.subresourceRange = { image.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS },
+			});
+	}
+
+	image.layout = info.layout;
+	image.writeStage = info.stage;
+	image.writeAccess = info.write ? (info.access & WRITE_ACCESS_MASK) : VK_ACCESS_2_NONE;
+	image.readStages = info.write ? VK_PIPELINE_STAGE_2_NONE : info.stage;
+	image.visibleStages = info.stage;
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd)
+{
+	ZoneScoped;
+	barrierCount = 0U;
+
+	const auto flushBarriers = [&]() {
+		if (pendingBarriers.empty())
+		{
+			return;
+		}
+		const VkDependencyInfo dependencyInfo{
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.imageMemoryBarrierCount = static_cast<uint32_t>(pendingBarriers.size()),
+			.pImageMemoryBarriers = pendingBarriers.data(),
+		};
+		vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+		barrierCount += static_cast<uint32_t>(pendingBarriers.size());
+		pendingBarriers.clear();
+	};
+
+	for (uint32_t passIndex = 0; passIndex < passes.size(); ++passIndex)
+	{
+		Pass& pass = passes[passIndex];
+		if (!pass.live)
+		{
+			continue;
+		}
+
+		for (const ImageUse& use : pass.uses)
+		{
+			GraphImage& image = images[use.image];
+			const bool firstUse = image.transient && image.firstPass == passIndex && image.layout == VK_IMAGE_LAYOUT_UNDEFINED;
+			if (firstUse && image.aliasPredecessor != UINT32_MAX)
+			{
+				// the memory was last used by another image, wait for it before overwriting
+				const GraphImage& predecessor = images[image.aliasPredecessor];
+				image.writeStage = predecessor.writeStage | predecessor.readStages;
+				image.writeAccess = predecessor.writeAccess;
+			}
+			addBarrier(image, GetAccessInfo(use.access), firstUse);
+		}
+		flushBarriers();
+
+		ZoneScopedN("Render Graph Pass");
+		ZoneName(pass.name.c_str(), pass.name.size());
+		pass.function(cmd, *this);
+	}
+
+	for (GraphImage& image : images)
+	{
+		if (image.finalAccess.has_value())
+		{
+			addBarrier(image, GetAccessInfo(*image.finalAccess), false);
+		}
+	}
+	flushBarriers();
+}
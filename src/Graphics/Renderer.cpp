@@ -15,18 +15,26 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
 #include <gtx/transform.hpp>
-#include <gtx/quaternion.hpp>
 
 #include <backends/imgui_impl_sdl.h>
 #include <backends/imgui_impl_vulkan.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <string_view>
 
 #include "Graphics/VulkanInit.h"
+#include "Jobs/JobSystem.h"
 #include "Editor.h"
 #include "Log.h"
+#include "MappedFile.h"
 #include "RenderableTypes.h"
+#include "Structures/Hash.h"
+#include "TextureCompression.h"
 
 #define VK_CHECK(x)                                                 \
 	do                                                              \
@@ -40,10 +48,43 @@
 	} while (0)
 
 
-void Renderer::init()
+RenderTypes::LatencySettings RenderTypes::GetLatencySettings(LatencyProfile profile)
+{
+	switch (profile)
+	{
+	case LatencyProfile::LOW_LATENCY:
+		return { .framesInFlight = 1, .presentModes = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR }, .lateInputSampling = true };
+	case LatencyProfile::THROUGHPUT:
+		return { .framesInFlight = 3, .presentModes = { VK_PRESENT_MODE_FIFO_KHR }, .lateInputSampling = false };
+	case LatencyProfile::BALANCED:
+	default:
+		return { .framesInFlight = 2, .presentModes = { VK_PRESENT_MODE_FIFO_KHR }, .lateInputSampling = false };
+	}
+}
+
+const char* RenderTypes::GetLatencyProfileName(LatencyProfile profile)
+{
+	switch (profile)
+	{
+	case LatencyProfile::LOW_LATENCY: return "Low latency";
+	case LatencyProfile::THROUGHPUT: return "Throughput";
+	case LatencyProfile::BALANCED:
+	default: return "Balanced";
+	}
+}
+
+void Renderer::init(RenderTypes::LatencyProfile profile)
 {
 	ZoneScoped;
 
+	latencyProfile = profile;
+	latency = RenderTypes::GetLatencySettings(profile);
+	frame.resize(latency.framesInFlight);
+	graphics.commands.resize(latency.framesInFlight);
+	compute.commands.resize(latency.framesInFlight);
+	imguiRenderTexture.resize(latency.framesInFlight);
+	LOG_CORE_INFO("Latency profile: {}, {} frames in flight", RenderTypes::GetLatencyProfileName(profile), latency.framesInFlight);
+
 	SDL_Init(SDL_INIT_VIDEO);
 
 	const SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
@@ -63,6 +104,7 @@ void Renderer::init()
 	initGraphicsCommands();
 	initComputeCommands();
 	initSyncStructures();
+	stagingRing.init(&timeline, STAGING_RING_SIZE);
 
 	initImguiRenderpass();
 	initImgui();
@@ -70,6 +112,8 @@ void Renderer::init()
 
 
 	initShaders();
+	initHizImages();
+	initOcclusionBuffer();
 
 	initShaderData();
 
@@ -78,97 +122,672 @@ void Renderer::init()
 void Renderer::initShaderData()
 {
 	ZoneScoped;
-	camera.proj = glm::perspective(glm::radians(90.0f), 800.0f / 600.0f, 0.1f, 100.0f);
-	camera.proj[1][1] *= -1;
-	camera.pos = { 6.0f,3.0f,6.0f,0.0f };
-	Editor::lightDirection = &sunlight.direction;
-	Editor::lightColor = &sunlight.color;
-	Editor::lightAmbientColor = &sunlight.ambientColor;
+	Editor::recordTimeMs = &recordTimeMs;
+	Editor::presentLatencyMs = &presentLatencyMs;
+	Editor::asyncComputeMs = &asyncComputeMs;
+	Editor::asyncOverlapMs = &asyncOverlapMs;
+	Editor::graphicsGpuMs = &graphicsGpuMs;
+	Editor::fragmentInvocations = &fragmentInvocations;
+	Editor::softwareOcclusionMs = &softwareOcclusionMs;
+	Editor::softwareCulledObjects = &softwareCulledObjects;
+	Editor::textureResidentBytes = &textureResidentBytes;
+	Editor::textureTotalBytes = &textureTotalBytes;
+	Editor::textureStreamedBytes = &textureStreamedBytes;
+	Editor::latencyProfileName = RenderTypes::GetLatencyProfileName(latencyProfile);
 }
 
-void Renderer::drawObjects(VkCommandBuffer cmd, const std::vector<RenderableTypes::RenderObject>& renderObjects)
-{	
+void Renderer::startRenderThread()
+{
+	renderThread = std::thread([this]() {
+		tracy::SetThreadName("Render");
+		renderThreadLoop();
+		});
+}
+
+void Renderer::stopRenderThread()
+{
+	if (!renderThread.joinable())
+	{
+		return;
+	}
+	submitFrame(FramePacket{ .shutdown = true });
+	renderThread.join();
+}
+
+void Renderer::submitFrame(FramePacket&& packet)
+{
 	ZoneScoped;
-	const int COUNT = static_cast<int>(renderObjects.size());
-	const RenderableTypes::RenderObject* FIRST = renderObjects.data();
+	while (!framePackets.push(std::move(packet)))
+	{
+		framePackets.waitForSpace();
+	}
+}
+
+void Renderer::waitForFrameSlot()
+{
+	if (!latency.lateInputSampling)
+	{
+		return;
+	}
+	ZoneScoped;
+	frameSlotReady.wait(false);
+	frameSlotReady.store(false);
+}
+
+void Renderer::renderThreadLoop()
+{
+	FramePacket packet;
+	while (true)
+	{
+		// the fence is waited before taking a packet, so with late input sampling the
+		// main thread only samples once there is a free frame to record it into
+		beginFrame();
+		frameSlotReady.store(true);
+		frameSlotReady.notify_one();
+
+		while (!framePackets.pop(packet))
+		{
+			framePackets.waitForItem();
+		}
+		if (packet.shutdown)
+		{
+			break;
+		}
+		draw(packet);
+	}
+}
+
+void Renderer::applySettings(const RenderTypes::RenderSettings& settings)
+{
+	recordThreadCount = settings.recordThreadCount > 0
+		? std::min(settings.recordThreadCount, static_cast<int>(MAX_RECORD_THREADS))
+		: defaultRecordThreadCount;
+	depthPrepass = settings.depthPrepass;
+	occlusionCulling = settings.occlusionCulling && gpuOcclusionSupported;
+	softwareOcclusion = settings.softwareOcclusion;
+	textureFeedback = settings.textureFeedback && textureFeedbackSupported;
+}
+
+void Renderer::updateFrameData(const FramePacket& packet)
+{
+	ZoneScoped;
+	const RenderableTypes::RenderObjectArrays& renderObjects = packet.renderObjects;
+	const uint32_t COUNT = renderObjects.size();
+	const glm::mat4* transforms = renderObjects.transforms.data();
+	const RenderableTypes::MeshHandle* meshHandles = renderObjects.meshes.data();
+	const RenderableTypes::MaterialHandle* materialHandles = renderObjects.materials.data();
+
+	ensureObjectCapacity(getCurrentFrame(), COUNT);
+	ensureMaterialCapacity(getCurrentFrame(), static_cast<uint32_t>(materials.size()));
 
 	// fill buffers
 	// binding 0
 		//slot 0 - transform
 	GPUShaderData::DrawData* drawDataSSBO = (GPUShaderData::DrawData*)ResourceManager::ptr->GetBuffer(getCurrentFrame().drawDataBuffer).ptr;
 	GPUShaderData::Transform* objectSSBO = (GPUShaderData::Transform*)ResourceManager::ptr->GetBuffer(getCurrentFrame().transformBuffer).ptr;
-	GPUShaderData::Material* materialSSBO = (GPUShaderData::Material*)ResourceManager::ptr->GetBuffer(getCurrentFrame().materialBuffer).ptr;
+	GPUShaderData::DrawCommand* drawCommandSSBO = (GPUShaderData::DrawCommand*)ResourceManager::ptr->GetBuffer(getCurrentFrame().drawCommandBuffer).ptr;
+
+	// hidden objects start out culled, the occlusion buffer only ever clears more
+	softwareVisibility.resize(COUNT);
+	std::transform(renderObjects.flags.begin(), renderObjects.flags.end(), softwareVisibility.begin(),
+		[](uint8_t flags) { return static_cast<uint8_t>(flags & RenderableTypes::VISIBLE); });
+	uint8_t* visibility = softwareVisibility.data();
+	std::atomic<uint32_t> culledObjects{ 0U };
+
+	Jobs::JobSystem::ptr->parallelFor(COUNT, TRANSFORM_JOB_GRAIN, [=, this, &culledObjects](uint32_t begin, uint32_t end) {
+		ZoneScopedN("Update Transforms");
+		uint32_t culled = 0U;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			drawDataSSBO[i].transformIndex = static_cast<int>(i);
+			drawDataSSBO[i].materialIndex = static_cast<int>(materialHandles[i]);
+
+			const glm::mat4& modelMatrix = transforms[i];
+			objectSSBO[i] = GPUShaderData::PackTransform(modelMatrix);
+
+			// every object is drawn once unless the cull shaders reject it, visible is left for the cull shader
+			const RenderMesh& mesh = meshes.get(meshHandles[i]);
+			// the longest basis vector scales the radius enough for any rotation and shear
+			const glm::vec3 axisLengthsSquared{ glm::dot(glm::vec3(modelMatrix[0]), glm::vec3(modelMatrix[0])),
+				glm::dot(glm::vec3(modelMatrix[1]), glm::vec3(modelMatrix[1])), glm::dot(glm::vec3(modelMatrix[2]), glm::vec3(modelMatrix[2])) };
+			GPUShaderData::DrawCommand& command = drawCommandSSBO[i];
+			command.count = mesh.indexCount > 0 ? mesh.indexCount : mesh.vertexCount;
+			command.instanceCount = 1;
+			command.first = 0;
+			command.vertexOffset = 0;
+			command.firstInstance = 0;
+			command.boundingSphere = glm::vec4(glm::vec3(modelMatrix * glm::vec4(glm::vec3(mesh.boundingSphere), 1.0f)),
+				mesh.boundingSphere.w * std::sqrt(std::max({ axisLengthsSquared.x, axisLengthsSquared.y, axisLengthsSquared.z })));
+
+			if (softwareOcclusion && visibility[i] != 0U && occlusionBuffer.isOccluded(command.boundingSphere))
+			{
+				visibility[i] = 0U;
+				++culled;
+			}
+		}
+		culledObjects.fetch_add(culled, std::memory_order_relaxed);
+		});
+	softwareCulledObjects.store(culledObjects.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		//slot 2 - materials, persistent table so only edits are written
+	uploadDirtyMaterials();
+	// binding 1
+		//slot 0 - camera
+	GPUShaderData::Camera* cameraSSBO = (GPUShaderData::Camera*)ResourceManager::ptr->GetBuffer(getCurrentFrame().cameraBuffer).ptr;
+	*cameraSSBO = packet.camera;
+		//slot 1 - directionalLight
+	GPUShaderData::DirectionalLight* dirLightSSBO = (GPUShaderData::DirectionalLight*)ResourceManager::ptr->GetBuffer(getCurrentFrame().dirLightBuffer).ptr;
+	*dirLightSSBO = packet.sunlight;
+}
+
+static VkBufferMemoryBarrier2 queueTransferBarrier(VkBuffer buffer, uint32_t srcQueueFamily, uint32_t dstQueueFamily,
+	VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+	return VkBufferMemoryBarrier2{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+		.srcStageMask = srcStage,
+		.srcAccessMask = srcAccess,
+		.dstStageMask = dstStage,
+		.dstAccessMask = dstAccess,
+		.srcQueueFamilyIndex = srcQueueFamily,
+		.dstQueueFamilyIndex = dstQueueFamily,
+		.buffer = buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE,
+	};
+}
+
+static VkBufferMemoryBarrier2 bufferMemoryBarrier(VkBuffer buffer,
+	VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+	return queueTransferBarrier(buffer, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, srcStage, srcAccess, dstStage, dstAccess);
+}
+
+static void bufferBarrier(VkCommandBuffer cmd, const VkBufferMemoryBarrier2& barrier)
+{
+	const VkDependencyInfo dependencyInfo{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.bufferMemoryBarrierCount = 1,
+		.pBufferMemoryBarriers = &barrier,
+	};
+	vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+static VkImageMemoryBarrier2 imageMemoryBarrier(VkImage image, uint32_t baseMip, uint32_t mipCount,
+	VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkImageLayout oldLayout,
+	VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess, VkImageLayout newLayout)
+{
+	return VkImageMemoryBarrier2{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+		.srcStageMask = srcStage,
+		.srcAccessMask = srcAccess,
+		.dstStageMask = dstStage,
+		.dstAccessMask = dstAccess,
+		.oldLayout = oldLayout,
+		.newLayout = newLayout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = baseMip,
+			.levelCount = mipCount,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+	};
+}
+
+static void imageBarrier(VkCommandBuffer cmd, const VkImageMemoryBarrier2& barrier)
+{
+	const VkDependencyInfo dependencyInfo{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.imageMemoryBarrierCount = 1,
+		.pImageMemoryBarriers = &barrier,
+	};
+	vkCmdPipelineBarrier2(cmd, &dependencyInfo);
+}
+
+void Renderer::dispatchCulling(const FramePacket& packet)
+{
+	ZoneScoped;
+	RenderFrame& currentFrame = getCurrentFrame();
+	const VkCommandBuffer cmd = compute.commands[getCurrentFrameNumber()].buffer;
+	const VkBuffer drawCommandBuffer = ResourceManager::ptr->GetBuffer(currentFrame.drawCommandBuffer).buffer;
+
+	VK_CHECK(vkResetCommandBuffer(cmd, 0));
+	const VkCommandBufferBeginInfo cmdBeginInfo = VulkanInit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+	if (timestampPeriod > 0.0f)
+	{
+		vkCmdResetQueryPool(cmd, currentFrame.timestampPool, RenderTypes::COMPUTE_BEGIN, 2);
+		vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, currentFrame.timestampPool, RenderTypes::COMPUTE_BEGIN);
+	}
 
-	for (int i = 0; i < COUNT; ++i)
+	// beginFrame waited for the graphics submission that released the buffer, so the acquire needs no semaphore
+	if (!sharesQueueFamily() && currentFrame.drawCommandsReleased)
 	{
-		const RenderableTypes::RenderObject& object = FIRST[i];
+		bufferBarrier(cmd, queueTransferBarrier(drawCommandBuffer, graphics.queueFamily, compute.queueFamily,
+			VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT));
+	}
 
-		drawDataSSBO[i].transformIndex = i;
-		drawDataSSBO[i].materialIndex = i;
+	GPUShaderData::CullPushConstants constants{
+		.drawCount = packet.renderObjects.size(),
+		.occlusionCulling = occlusionCulling ? 1U : 0U,
+	};
+	const Frustum frustum = Frustum::FromViewProj(packet.camera.proj * packet.camera.view);
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes), std::begin(constants.frustumPlanes));
 
-		const glm::mat4 modelMatrix = glm::translate(glm::mat4{ 1.0 }, object.translation)
-			* glm::toMat4(glm::quat(object.rotation))
-			* glm::scale(glm::mat4{ 1.0 }, object.scale);
-		objectSSBO[i].modelMatrix = modelMatrix;
-		objectSSBO[i].normalMatrix = glm::mat3(glm::transpose(glm::inverse(modelMatrix)));
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &currentFrame.cullSet, 0, nullptr);
+	vkCmdPushConstants(cmd, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUShaderData::CullPushConstants), &constants);
+	vkCmdDispatch(cmd, (constants.drawCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
 
-		materialSSBO[i] = GPUShaderData::Material{
-			.specular = {0.4f,0.4,0.4f},
-			.shininess = 64.0f,
-			.textureIndices = {object.textureHandle.has_value() ? object.textureHandle.value() : -1,
-							object.normalHandle.has_value() ? object.normalHandle.value() : -1,
-							0,
-							0},
-		};
+	if (!sharesQueueFamily())
+	{
+		bufferBarrier(cmd, queueTransferBarrier(drawCommandBuffer, compute.queueFamily, graphics.queueFamily,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE));
+	}
 
+	if (timestampPeriod > 0.0f)
+	{
+		vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, currentFrame.timestampPool, RenderTypes::COMPUTE_END);
 	}
-	// binding 1
-		//slot 0 - camera
-	camera.view =
-		glm::lookAt({ camera.pos.x,camera.pos.y,camera.pos.z },
-			glm::vec3(0.0f, -0.5f, 0.0f),
-			UP_DIR);
-	//const float rotationSpeed = 0.5f;
-	//camera.view = glm::rotate(camera.view, (frameNumber / 120.0f) * rotationSpeed, UP_DIR);
-	GPUShaderData::Camera* cameraSSBO = (GPUShaderData::Camera*)ResourceManager::ptr->GetBuffer(getCurrentFrame().cameraBuffer).ptr;
-	*cameraSSBO = camera;
-		//slot 1 - directionalLight
-	GPUShaderData::DirectionalLight* dirLightSSBO = (GPUShaderData::DirectionalLight*)ResourceManager::ptr->GetBuffer(getCurrentFrame().dirLightBuffer).ptr;
-	*dirLightSSBO = sunlight;
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	currentFrame.computeValue = computeTimeline.nextValue();
+	const VkSemaphore signalSemaphore = computeTimeline.getSemaphore();
+
+	const VkTimelineSemaphoreSubmitInfo timelineSubmit = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &currentFrame.computeValue,
+	};
+
+	const VkSubmitInfo submit = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = &timelineSubmit,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &cmd,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &signalSemaphore,
+	};
+
+	VK_CHECK(vkQueueSubmit(compute.queue, 1, &submit, VK_NULL_HANDLE));
+}
+
+void Renderer::rasterizeOccluders(const FramePacket& packet)
+{
+	ZoneScoped;
+	if (!softwareOcclusion)
+	{
+		softwareOcclusionMs.store(0.0f, std::memory_order_relaxed);
+		return;
+	}
+
+	const auto rasterizeStart = std::chrono::high_resolution_clock::now();
+	frameOccluders.clear();
+	for (const RenderableTypes::OccluderObject& occluder : packet.occluders)
+	{
+		frameOccluders.push_back({ .mesh = &occluderMeshes[occluder.occluderHandle], .modelMatrix = occluder.transform });
+	}
+	occlusionBuffer.rasterize(packet.camera.proj * packet.camera.view, frameOccluders.data(), static_cast<uint32_t>(frameOccluders.size()));
+	softwareOcclusionMs.store(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - rasterizeStart).count(), std::memory_order_relaxed);
+}
+
+void Renderer::buildHiz(VkCommandBuffer cmd)
+{
+	ZoneScoped;
+	const RenderFrame& currentFrame = getCurrentFrame();
+	const uint32_t groupsX = (hizExtent.width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+	const uint32_t groupsY = (hizExtent.height + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE;
+
+	const GPUShaderData::HizPushConstants constants{
+		.mipCount = hizMipCount,
+		.workgroupCount = groupsX * groupsY,
+	};
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, hizPipelineLayout, 0, 1, &currentFrame.hizSet, 0, nullptr);
+	vkCmdPushConstants(cmd, hizPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUShaderData::HizPushConstants), &constants);
+	vkCmdDispatch(cmd, groupsX, groupsY, 1);
+}
 
+void Renderer::cullOccluded(VkCommandBuffer cmd, const FramePacket& packet)
+{
+	ZoneScoped;
+	const RenderFrame& currentFrame = getCurrentFrame();
+	const VkBuffer drawCommandBuffer = ResourceManager::ptr->GetBuffer(currentFrame.drawCommandBuffer).buffer;
+	const VkBuffer lateDrawCommandBuffer = ResourceManager::ptr->GetBuffer(currentFrame.lateDrawCommandBuffer).buffer;
+
+	// the early draws read the commands the test writes visibility into
+	bufferBarrier(cmd, bufferMemoryBarrier(drawCommandBuffer,
+		VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_NONE,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT));
+
+	const GPUShaderData::OcclusionPushConstants constants{
+		.viewProj = packet.camera.proj * packet.camera.view,
+		.depthSize = glm::vec2(static_cast<float>(window.extent.width), static_cast<float>(window.extent.height)),
+		.drawCount = packet.renderObjects.size(),
+		.hizMipCount = hizMipCount,
+	};
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, occlusionPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, occlusionPipelineLayout, 0, 1, &currentFrame.occlusionSet, 0, nullptr);
+	vkCmdPushConstants(cmd, occlusionPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUShaderData::OcclusionPushConstants), &constants);
+	vkCmdDispatch(cmd, (constants.drawCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	bufferBarrier(cmd, bufferMemoryBarrier(lateDrawCommandBuffer,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT));
+}
+
+static void atomicMin(std::atomic<float>& target, float value)
+{
+	float current = target.load(std::memory_order_relaxed);
+	while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+void Renderer::requestTextureMips(const FramePacket& packet)
+{
+	ZoneScoped;
+	const RenderableTypes::RenderObjectArrays& renderObjects = packet.renderObjects;
+	const uint32_t COUNT = renderObjects.size();
+	const glm::mat4* transforms = renderObjects.transforms.data();
+	const RenderableTypes::MeshHandle* meshHandles = renderObjects.meshes.data();
+	const RenderableTypes::MaterialHandle* materialHandles = renderObjects.materials.data();
+	const uint8_t* flags = renderObjects.flags.data();
+	const glm::vec3 cameraPos = glm::vec3(packet.camera.pos);
+	// pixels a world unit covers at distance 1
+	const float pixelsPerUnit = packet.camera.proj[1][1] * 0.5f * static_cast<float>(window.extent.height);
+
+	// finest uvLod each material is seen at this frame
+	std::vector<std::atomic<float>> materialLods(materials.size());
+	for (std::atomic<float>& lod : materialLods)
+	{
+		lod.store(std::numeric_limits<float>::max(), std::memory_order_relaxed);
+	}
+	std::atomic<float>* lods = materialLods.data();
+
+	Jobs::JobSystem::ptr->parallelFor(COUNT, TRANSFORM_JOB_GRAIN, [=, this](uint32_t begin, uint32_t end) {
+		ZoneScopedN("Estimate Texture Mips");
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			if ((flags[i] & RenderableTypes::VISIBLE) == 0)
+			{
+				continue;
+			}
+			const RenderMesh& mesh = meshes.get(meshHandles[i]);
+			const glm::mat4& modelMatrix = transforms[i];
+			const float scale = std::sqrt(std::max({ glm::dot(glm::vec3(modelMatrix[0]), glm::vec3(modelMatrix[0])),
+				glm::dot(glm::vec3(modelMatrix[1]), glm::vec3(modelMatrix[1])), glm::dot(glm::vec3(modelMatrix[2]), glm::vec3(modelMatrix[2])) }));
+			const glm::vec3 centre = glm::vec3(modelMatrix * glm::vec4(glm::vec3(mesh.boundingSphere), 1.0f));
+			// the nearest point of the bounds decides, it is where the texture is magnified the most
+			const float distance = std::max(glm::length(centre - cameraPos) - mesh.boundingSphere.w * scale, TEXTURE_STREAMING_NEAR_DISTANCE);
+			const float uvPerPixel = mesh.uvDensity * distance / (scale * pixelsPerUnit);
+			atomicMin(lods[materialHandles[i]], std::log2(uvPerPixel));
+		}
+		});
+
+	for (size_t material = 0; material < materials.size(); ++material)
+	{
+		const float uvLod = lods[material].load(std::memory_order_relaxed);
+		if (uvLod == std::numeric_limits<float>::max())
+		{
+			continue;
+		}
+		const glm::ivec4& textureIndices = materials[material].materialData.textureIndices;
+		for (int texture = 0; texture < 3; ++texture)
+		{
+			if (textureIndices[texture] > 0)
+			{
+				textureStreamer.request(static_cast<RenderableTypes::TextureHandle>(textureIndices[texture]), uvLod);
+			}
+		}
+	}
+}
+
+void Renderer::streamTextures(VkCommandBuffer cmd, const FramePacket& packet)
+{
+	ZoneScoped;
+	RenderFrame& currentFrame = getCurrentFrame();
+	// the frame has finished, so what its fragments asked for can be read without waiting
+	GPUShaderData::TextureStreamingHeader* streamingHeader = static_cast<GPUShaderData::TextureStreamingHeader*>(
+		ResourceManager::ptr->GetBuffer(currentFrame.textureStreamingBuffer).ptr);
+	GPUShaderData::TextureStreaming* streamingSlots = reinterpret_cast<GPUShaderData::TextureStreaming*>(streamingHeader + 1);
+	textureStreamer.beginRequests(static_cast<uint64_t>(frameNumber));
+	if (currentFrame.textureFeedbackWritten)
+	{
+		for (const RenderFrame::FeedbackSlot& feedback : currentFrame.feedbackSlots)
+		{
+			if (streamingSlots[feedback.slot].requestedMip != std::numeric_limits<uint32_t>::max())
+			{
+				textureStreamer.requestMip(feedback.handle, streamingSlots[feedback.slot].requestedMip);
+			}
+		}
+	}
+	requestTextureMips(packet);
+
+	// whatever the device has left above the headroom is free for streaming, up to the pool size
+	const MemoryBudget memory = ResourceManager::ptr->GetDeviceMemoryBudget();
+	const int64_t spare = static_cast<int64_t>(memory.budget) - static_cast<int64_t>(memory.usage)
+		- static_cast<int64_t>(static_cast<float>(memory.budget) * TEXTURE_STREAMING_HEADROOM);
+	const int64_t available = std::max(static_cast<int64_t>(textureStreamer.getResidentSize()) + spare, int64_t(0));
+	const size_t memoryLimit = std::min(static_cast<size_t>(available), TEXTURE_STREAMING_POOL_SIZE);
+
+	uint64_t streamedBytes = 0U;
+	std::vector<VkImageView> mipViews;
+	std::vector<bool> swapped(bindlessTextures.array.size(), false);
+	bool anySwapped = false;
+	for (const TextureStreamer::Change& change : textureStreamer.plan(TEXTURE_STREAMING_FRAME_BUDGET, memoryLimit))
+	{
+		// frames in flight still sample the old slot, so the new image needs one of its own
+		if (bindlessTable.getFreeCount() == 0)
+		{
+			break;
+		}
+		RenderableTypes::Texture levels;
+		textureStreamer.getLevels(change.handle, change.baseMip, levels);
+		BindlessTexture& texture = bindlessTextures.get(change.handle);
+		const BindlessTexture retired = texture;
+		// every level arrives from the CPU, so the compute fallback never adds views
+		texture.image = recordTextureUpload(cmd, levels, mipViews);
+		texture.slot = bindlessTable.add(ResourceManager::ptr->GetImage(texture.image).imageView);
+
+		// only work submitted before this frame sees the old slot, every frame's materials move to the new one before they are drawn
+		timeline.deferDeletion([this, retired]() {
+			ResourceManager::ptr->DestroyImage(retired.image);
+			bindlessTable.remove(retired.slot);
+			});
+		swapped[change.handle] = true;
+		anySwapped = true;
+		textureStreamer.commit(change);
+		streamedBytes += change.uploadSize;
+	}
+
+	if (anySwapped)
+	{
+		for (RenderableTypes::MaterialHandle material = 0; material < materials.size(); ++material)
+		{
+			const glm::ivec4& textureIndices = materials[material].materialData.textureIndices;
+			for (int texture = 0; texture < 3; ++texture)
+			{
+				if (textureIndices[texture] > 0 && textureIndices[texture] < static_cast<int>(swapped.size()) && swapped[textureIndices[texture]])
+				{
+					for (RenderFrame& renderFrame : frame)
+					{
+						renderFrame.dirtyMaterials.push_back(material);
+					}
+					break;
+				}
+			}
+		}
+		// this frame's materials were written before the swaps
+		uploadDirtyMaterials();
+	}
+
+	// the fragments sample relative to the resident levels, the base turns that back into a mip of the whole texture
+	streamingHeader->feedback = textureFeedback ? 1U : 0U;
+	currentFrame.feedbackSlots.clear();
+	for (RenderableTypes::TextureHandle handle = 1; handle < bindlessTextures.array.size(); ++handle)
+	{
+		const uint32_t slot = bindlessTextures.get(handle).slot;
+		if (textureStreamer.isStreamed(handle) && slot != BindlessTable::INVALID_SLOT)
+		{
+			streamingSlots[slot] = {
+				.baseMip = textureStreamer.getBaseMip(handle),
+				.requestedMip = std::numeric_limits<uint32_t>::max(),
+			};
+			currentFrame.feedbackSlots.push_back({ .slot = slot, .handle = handle });
+		}
+	}
+	currentFrame.textureFeedbackWritten = textureFeedback;
+
+	textureResidentBytes.store(textureStreamer.getResidentSize(), std::memory_order_relaxed);
+	textureTotalBytes.store(textureStreamer.getTotalSize(), std::memory_order_relaxed);
+	textureStreamedBytes.store(streamedBytes, std::memory_order_relaxed);
+}
+
+float Renderer::drawObjects(VkCommandBuffer cmd, const FramePacket& packet, RenderTypes::DrawPass pass, RenderTypes::DrawPhase phase)
+{	
+	ZoneScoped;
+	const RenderableTypes::RenderObjectArrays& renderObjects = packet.renderObjects;
+	const int COUNT = static_cast<int>(renderObjects.size());
+
+	// record draw ranges into secondary command buffers, the first range on this thread
+	const auto recordStart = std::chrono::high_resolution_clock::now();
+
+	const int jobCount = std::clamp((COUNT + static_cast<int>(MIN_DRAWS_PER_RECORD_JOB) - 1) / static_cast<int>(MIN_DRAWS_PER_RECORD_JOB), 1, recordThreadCount);
+	const int rangeSize = (COUNT + jobCount - 1) / jobCount;
+
+	VkCommandBuffer secondaryBuffers[MAX_RECORD_THREADS];
+	Jobs::Counter recordCounter;
+	for (int job = jobCount - 1; job >= 0; --job)
+	{
+		const int begin = std::min(COUNT, job * rangeSize);
+		const int end = std::min(COUNT, begin + rangeSize);
+		const RenderTypes::CommandContext& commands = pass == RenderTypes::DrawPass::DEPTH_PREPASS
+			? getCurrentFrame().prepassCommands[phase][job]
+			: getCurrentFrame().recordCommands[phase][job];
+		secondaryBuffers[job] = commands.buffer;
+
+		if (job == 0)
+		{
+			recordDrawJob(commands, pass, phase, renderObjects, begin, end);
+		}
+		else
+		{
+			Jobs::JobSystem::ptr->run([this, &commands, pass, phase, &renderObjects, begin, end]() {
+				recordDrawJob(commands, pass, phase, renderObjects, begin, end);
+				}, recordCounter);
+		}
+	}
+	Jobs::JobSystem::ptr->wait(recordCounter);
+
+	vkCmdExecuteCommands(cmd, static_cast<uint32_t>(jobCount), secondaryBuffers);
+
+	return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+}
+
+void Renderer::recordDrawJob(const RenderTypes::CommandContext& commands, RenderTypes::DrawPass pass, RenderTypes::DrawPhase phase, const RenderableTypes::RenderObjectArrays& objects, int begin, int end)
+{
+	ZoneScoped;
+	VK_CHECK(vkResetCommandPool(device, commands.pool, 0));
+
+	// the depth pre-pass renders without colour attachments
+	const VkFormat colorAttachmentFormats[] = { RENDER_IMAGE_FORMAT };
+	const VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+		.colorAttachmentCount = pass == RenderTypes::DrawPass::DEPTH_PREPASS ? 0U : static_cast<uint32_t>(std::size(colorAttachmentFormats)),
+		.pColorAttachmentFormats = colorAttachmentFormats,
+		.depthAttachmentFormat = DEPTH_IMAGE_FORMAT,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+	};
+
+	// the fragment invocation query of the primary is active around both passes
+	const VkCommandBufferInheritanceInfo inheritanceInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = &inheritanceRenderingInfo,
+		.pipelineStatistics = pipelineStatisticsSupported ? VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT : 0U,
+	};
+
+	const VkCommandBufferBeginInfo cmdBeginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = &inheritanceInfo,
+	};
+
+	VK_CHECK(vkBeginCommandBuffer(commands.buffer, &cmdBeginInfo));
+	// dynamic state is not inherited from the primary
+	setViewportAndScissor(commands.buffer);
+	recordDrawRange(commands.buffer, pass, phase, objects, begin, end);
+	VK_CHECK(vkEndCommandBuffer(commands.buffer));
+}
+
+void Renderer::recordDrawRange(VkCommandBuffer cmd, RenderTypes::DrawPass pass, RenderTypes::DrawPhase phase, const RenderableTypes::RenderObjectArrays& objects, int begin, int end)
+{
+	ZoneScoped;
+	const bool prepass = pass == RenderTypes::DrawPass::DEPTH_PREPASS;
 	const MaterialType* lastMaterialType = nullptr;
 	const RenderMesh* lastMesh = nullptr;
-	for (int i = 0; i < COUNT; ++i)
+	const BufferHandle drawCommandHandle = phase == RenderTypes::EARLY ? getCurrentFrame().drawCommandBuffer : getCurrentFrame().lateDrawCommandBuffer;
+	const VkBuffer drawCommandBuffer = ResourceManager::ptr->GetBuffer(drawCommandHandle).buffer;
+
+	// every material shares the depth only pipeline
+	if (prepass)
+	{
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassLayout, 0, 1, &getCurrentFrame().globalSet, 0, nullptr);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassLayout, 1, 1, &getCurrentFrame().sceneSet, 0, nullptr);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipeline);
+	}
+
+	for (int i = begin; i < end; ++i)
 	{
-		const RenderableTypes::RenderObject& object = FIRST[i];
+		// hidden, or hidden by the CPU occlusion buffer, not even recorded
+		if (softwareVisibility[i] == 0U)
+		{
+			continue;
+		}
 
-		// TODO : RenderObjects hold material handle for different materials
-		const MaterialType* currentMaterialType{ &materials["defaultMaterial"] };
-		if (currentMaterialType != lastMaterialType)
+		VkPipelineLayout pipelineLayout = depthPrepassLayout;
+		if (!prepass)
 		{
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, currentMaterialType->pipelineLayout, 0, 1, &getCurrentFrame().globalSet, 0, nullptr);
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, currentMaterialType->pipelineLayout, 1, 1, &getCurrentFrame().sceneSet, 0, nullptr);
+			const MaterialType* currentMaterialType{ materials[objects.materials[i]].matType };
+			if (currentMaterialType != lastMaterialType)
+			{
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, currentMaterialType->pipelineLayout, 0, 1, &getCurrentFrame().globalSet, 0, nullptr);
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, currentMaterialType->pipelineLayout, 1, 1, &getCurrentFrame().sceneSet, 0, nullptr);
+				const VkDescriptorSet bindlessSet = bindlessTable.getSet();
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, currentMaterialType->pipelineLayout, 2, 1, &bindlessSet, 0, nullptr);
 
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, currentMaterialType->pipeline);
+				// after the pre-pass only the front most fragment of each pixel is shaded
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepass ? currentMaterialType->depthEqualPipeline : currentMaterialType->pipeline);
 
-			lastMaterialType = currentMaterialType;
+				lastMaterialType = currentMaterialType;
+			}
+			pipelineLayout = currentMaterialType->pipelineLayout;
 		}
 
 		const GPUShaderData::PushConstants constants = {
 			.drawDataIndex = i,
 		};
-		vkCmdPushConstants(cmd, currentMaterialType->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUShaderData::PushConstants), &constants);
+		vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUShaderData::PushConstants), &constants);
 
 		// TODO : Find better way of handling mesh handle
 		// Currently having to recreate handle which is not good.
-		const RenderMesh* currentMesh { &meshes.get(object.meshHandle)};
-		const RenderableTypes::MeshDesc* currentMeshDesc = { &currentMesh->meshDesc };
+		const RenderMesh* currentMesh { &meshes.get(objects.meshes[i])};
 		if (currentMesh != lastMesh)
 		{
 			const VkDeviceSize offset{ 0 };
-			const VkBuffer vertexBuffer = ResourceManager::ptr->GetBuffer(currentMesh->vertexBuffer).buffer;
+			const VkBuffer vertexBuffer = ResourceManager::ptr->GetBuffer(prepass ? currentMesh->positionBuffer : currentMesh->vertexBuffer).buffer;
 			vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, &offset);
-			if (currentMeshDesc->hasIndices())
+			if (currentMesh->indexCount > 0)
 			{
 				const VkBuffer indexBuffer = ResourceManager::ptr->GetBuffer(currentMesh->indexBuffer).buffer;
 				vkCmdBindIndexBuffer(cmd, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
@@ -176,37 +795,300 @@ void Renderer::drawObjects(VkCommandBuffer cmd, const std::vector<RenderableType
 			lastMesh = currentMesh;
 		}
 
-		if (currentMeshDesc->hasIndices())
+		// the cull shaders set the instance count to zero if the object is culled or drawn by the other phase
+		const VkDeviceSize commandOffset = sizeof(GPUShaderData::DrawCommand) * static_cast<VkDeviceSize>(i);
+		if (currentMesh->indexCount > 0)
 		{
-			vkCmdDrawIndexed(cmd, static_cast<uint32_t>(currentMeshDesc->indices.size()), 1, 0, 0, 0);
+			vkCmdDrawIndexedIndirect(cmd, drawCommandBuffer, commandOffset, 1, sizeof(GPUShaderData::DrawCommand));
 		}
 		else
 		{
-			vkCmdDraw(cmd, static_cast<uint32_t>(currentMeshDesc->vertices.size()), 1, 0, 0);
+			vkCmdDrawIndirect(cmd, drawCommandBuffer, commandOffset, 1, sizeof(GPUShaderData::DrawCommand));
+		}
+	}
+}
+
+void Renderer::updatePresentLatency(std::chrono::steady_clock::time_point sampleTime)
+{
+	const float latencyMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - sampleTime).count();
+	presentLatencyMs.store(latencyMs, std::memory_order_relaxed);
+
+	accumulatedLatencyMs += latencyMs;
+	if (++latencySampleCount < LATENCY_LOG_FRAMES)
+	{
+		return;
+	}
+
+	LOG_CORE_INFO("{}: input to present {:.3f} ms", RenderTypes::GetLatencyProfileName(latencyProfile), accumulatedLatencyMs / LATENCY_LOG_FRAMES);
+	accumulatedLatencyMs = 0.0f;
+	latencySampleCount = 0U;
+}
+
+void Renderer::setViewportAndScissor(VkCommandBuffer cmd)
+{
+	const VkViewport viewport{
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = static_cast<float>(window.extent.width),
+		.height = static_cast<float>(window.extent.height),
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f,
+	};
+
+	const VkRect2D scissor{
+		.offset = {.x = 0,.y = 0},
+		.extent = window.extent
+	};
+
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+static uint32_t grownCapacity(uint32_t capacity, uint32_t required)
+{
+	uint32_t newCapacity = std::max(capacity, 1U);
+	while (newCapacity < required)
+	{
+		newCapacity *= 2;
+	}
+	return newCapacity;
+}
+
+// Starts with every object hidden, the first frame draws everything in the late phase
+static BufferHandle createDrawCommandBuffer(uint32_t capacity)
+{
+	const BufferHandle buffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::DrawCommand) * capacity, .usage = GFX::Buffer::Usage::INDIRECT });
+	std::memset(ResourceManager::ptr->GetBuffer(buffer).ptr, 0, sizeof(GPUShaderData::DrawCommand) * capacity);
+	return buffer;
+}
+
+void Renderer::ensureObjectCapacity(RenderFrame& renderFrame, uint32_t objectCount)
+{
+	if (objectCount > objectHighWaterMark)
+	{
+		objectHighWaterMark = objectCount;
+	}
+
+	if (objectCount <= renderFrame.objectCapacity)
+	{
+		return;
+	}
+
+	ZoneScoped;
+	const uint32_t newCapacity = grownCapacity(renderFrame.objectCapacity, objectCount);
+
+	// the GPU may still read the old buffers until the submissions made so far have finished
+	// graphics waits for the frame's culling, so its timeline value covers the compute queue as well
+	const BufferHandle oldDrawDataBuffer = renderFrame.drawDataBuffer;
+	const BufferHandle oldTransformBuffer = renderFrame.transformBuffer;
+	const BufferHandle oldDrawCommandBuffer = renderFrame.drawCommandBuffer;
+	const BufferHandle oldLateDrawCommandBuffer = renderFrame.lateDrawCommandBuffer;
+	timeline.deferDeletion([=]() {
+		ResourceManager::ptr->DestroyBuffer(oldDrawDataBuffer);
+		ResourceManager::ptr->DestroyBuffer(oldTransformBuffer);
+		ResourceManager::ptr->DestroyBuffer(oldDrawCommandBuffer);
+		ResourceManager::ptr->DestroyBuffer(oldLateDrawCommandBuffer);
+		});
+
+	renderFrame.drawDataBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::DrawData) * newCapacity, .usage = GFX::Buffer::Usage::STORAGE });
+	renderFrame.transformBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::Transform) * newCapacity, .usage = GFX::Buffer::Usage::STORAGE });
+	renderFrame.drawCommandBuffer = createDrawCommandBuffer(newCapacity);
+	renderFrame.lateDrawCommandBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::DrawCommand) * newCapacity, .usage = GFX::Buffer::Usage::INDIRECT });
+	renderFrame.drawCommandsReleased = false;
+	renderFrame.objectCapacity = newCapacity;
+
+	writeGlobalBufferDescriptors(renderFrame);
+	LOG_CORE_INFO("Object buffers grown to {} (high-water mark {})", newCapacity, objectHighWaterMark);
+}
+
+void Renderer::ensureMaterialCapacity(RenderFrame& renderFrame, uint32_t materialCount)
+{
+	if (materialCount <= renderFrame.materialCapacity)
+	{
+		return;
+	}
+
+	ZoneScoped;
+	const uint32_t newCapacity = grownCapacity(renderFrame.materialCapacity, materialCount);
+
+	const BufferHandle oldMaterialBuffer = renderFrame.materialBuffer;
+	timeline.deferDeletion([=]() {
+		ResourceManager::ptr->DestroyBuffer(oldMaterialBuffer);
+		});
+
+	renderFrame.materialBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::Material) * newCapacity, .usage = GFX::Buffer::Usage::STORAGE });
+	renderFrame.materialCapacity = newCapacity;
+
+	// the new buffer starts empty, so the whole table has to be written again
+	renderFrame.dirtyMaterials.clear();
+	for (RenderableTypes::MaterialHandle handle = 0; handle < materials.size(); ++handle)
+	{
+		renderFrame.dirtyMaterials.push_back(handle);
+	}
+
+	writeGlobalBufferDescriptors(renderFrame);
+	LOG_CORE_INFO("Material buffer grown to {}", newCapacity);
+}
+
+void Renderer::writeGlobalBufferDescriptors(const RenderFrame& renderFrame)
+{
+	const Buffer drawDataBuffer = ResourceManager::ptr->GetBuffer(renderFrame.drawDataBuffer);
+	const Buffer transformBuffer = ResourceManager::ptr->GetBuffer(renderFrame.transformBuffer);
+	const Buffer materialBuffer = ResourceManager::ptr->GetBuffer(renderFrame.materialBuffer);
+
+	VkDescriptorBufferInfo globalBuffers[] = {
+		{.buffer = drawDataBuffer.buffer, .range = drawDataBuffer.size },
+		{.buffer = transformBuffer.buffer, .range = transformBuffer.size },
+		{.buffer = materialBuffer.buffer, .range = materialBuffer.size },
+	};
+
+	const VkWriteDescriptorSet globalWrites[] = {
+		VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, renderFrame.globalSet, &globalBuffers[0], 0),
+		VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, renderFrame.globalSet, &globalBuffers[1], 1),
+		VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, renderFrame.globalSet, &globalBuffers[2], 2),
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(std::size(globalWrites)), globalWrites, 0, nullptr);
+
+	const Buffer drawCommandBuffer = ResourceManager::ptr->GetBuffer(renderFrame.drawCommandBuffer);
+	VkDescriptorBufferInfo cullBuffer = { .buffer = drawCommandBuffer.buffer, .range = drawCommandBuffer.size };
+	const VkWriteDescriptorSet cullWrite = VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, renderFrame.cullSet, &cullBuffer, 0);
+	vkUpdateDescriptorSets(device, 1, &cullWrite, 0, nullptr);
+
+	const Buffer lateDrawCommandBuffer = ResourceManager::ptr->GetBuffer(renderFrame.lateDrawCommandBuffer);
+	VkDescriptorBufferInfo occlusionBuffers[] = {
+		{.buffer = drawCommandBuffer.buffer, .range = drawCommandBuffer.size },
+		{.buffer = lateDrawCommandBuffer.buffer, .range = lateDrawCommandBuffer.size },
+	};
+	const VkWriteDescriptorSet occlusionWrites[] = {
+		VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, renderFrame.occlusionSet, &occlusionBuffers[0], 0),
+		VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, renderFrame.occlusionSet, &occlusionBuffers[1], 1),
+	};
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(std::size(occlusionWrites)), occlusionWrites, 0, nullptr);
+}
+
+void Renderer::uploadDirtyMaterials()
+{
+	ZoneScoped;
+	RenderFrame& currentFrame = getCurrentFrame();
+	GPUShaderData::Material* materialSSBO = (GPUShaderData::Material*)ResourceManager::ptr->GetBuffer(currentFrame.materialBuffer).ptr;
+
+	for (const RenderableTypes::MaterialHandle handle : currentFrame.dirtyMaterials)
+	{
+		GPUShaderData::Material material = materials[handle].materialData;
+		for (int texture = 0; texture < 3; ++texture)
+		{
+			material.textureIndices[texture] = getTextureSlot(material.textureIndices[texture]);
 		}
+		materialSSBO[handle] = material;
 	}
+	currentFrame.dirtyMaterials.clear();
 }
 
-void Renderer::draw(const std::vector<RenderableTypes::RenderObject>& renderObjects)
+int Renderer::getTextureSlot(int textureHandle)
+{
+	if (textureHandle <= 0 || textureHandle >= static_cast<int>(bindlessTextures.array.size()))
+	{
+		return -1;
+	}
+	const uint32_t slot = bindlessTextures.get(static_cast<RenderableTypes::TextureHandle>(textureHandle)).slot;
+	return slot == BindlessTable::INVALID_SLOT ? -1 : static_cast<int>(slot);
+}
+
+void Renderer::beginFrame()
 {
 	ZoneScoped;
+	timeline.wait(getCurrentFrame().submitValue);
+	timeline.collect();
+	resolveFrameQueries();
+}
+
+static uint64_t intervalOverlap(uint64_t aBegin, uint64_t aEnd, uint64_t bBegin, uint64_t bEnd)
+{
+	const uint64_t begin = std::max(aBegin, bBegin);
+	const uint64_t end = std::min(aEnd, bEnd);
+	return end > begin ? end - begin : 0U;
+}
+
+void Renderer::resolveFrameQueries()
+{
+	RenderFrame& currentFrame = getCurrentFrame();
+	if (!currentFrame.queriesWritten)
+	{
+		return;
+	}
+	currentFrame.queriesWritten = false;
+
+	// the frame's submissions have finished, so the results are available without waiting
+	uint64_t fragmentShaderInvocations = 0U;
+	if (pipelineStatisticsSupported
+		&& vkGetQueryPoolResults(device, currentFrame.statisticsPool, 0, 1, sizeof(fragmentShaderInvocations), &fragmentShaderInvocations, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+	{
+		fragmentInvocations.store(fragmentShaderInvocations, std::memory_order_relaxed);
+	}
+
+	if (timestampPeriod <= 0.0f)
+	{
+		return;
+	}
 
-	ImGui_ImplVulkan_NewFrame();
-	ImGui_ImplSDL2_NewFrame(window.window);
-	ImGui::NewFrame();
+	uint64_t timestamps[RenderTypes::TIMESTAMP_COUNT];
+	if (vkGetQueryPoolResults(device, currentFrame.timestampPool, 0, RenderTypes::TIMESTAMP_COUNT, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+	{
+		return;
+	}
+
+	const uint64_t computeBegin = timestamps[RenderTypes::COMPUTE_BEGIN];
+	const uint64_t computeEnd = timestamps[RenderTypes::COMPUTE_END];
+	const uint64_t graphicsBegin = timestamps[RenderTypes::GRAPHICS_BEGIN];
+	const uint64_t graphicsEnd = timestamps[RenderTypes::GRAPHICS_END];
+
+	// culling overlaps the previous frame's graphics work, its own frame only starts drawing once it is done.
+	// Both intervals are counted but not the part where they overlap each other.
+	AsyncComputeStats& stats = asyncComputeStats;
+	const uint64_t overlapTicks = intervalOverlap(computeBegin, computeEnd, stats.lastGraphicsBegin, stats.lastGraphicsEnd)
+		+ intervalOverlap(computeBegin, computeEnd, graphicsBegin, graphicsEnd)
+		- intervalOverlap(std::max(computeBegin, stats.lastGraphicsBegin), std::min(computeEnd, stats.lastGraphicsEnd), graphicsBegin, graphicsEnd);
+	stats.lastGraphicsBegin = graphicsBegin;
+	stats.lastGraphicsEnd = graphicsEnd;
+
+	const float ticksToMs = timestampPeriod / 1000000.0f;
+	const float computeMs = static_cast<float>(computeEnd - computeBegin) * ticksToMs;
+	const float overlapMs = static_cast<float>(overlapTicks) * ticksToMs;
+	asyncComputeMs.store(computeMs, std::memory_order_relaxed);
+	asyncOverlapMs.store(overlapMs, std::memory_order_relaxed);
+	graphicsGpuMs.store(static_cast<float>(graphicsEnd - graphicsBegin) * ticksToMs, std::memory_order_relaxed);
+
+	stats.accumulatedComputeMs += computeMs;
+	stats.accumulatedOverlapMs += overlapMs;
+	if (++stats.sampleCount < ASYNC_COMPUTE_LOG_FRAMES)
+	{
+		return;
+	}
+
+	LOG_CORE_INFO("Async compute {:.3f} ms, {:.3f} ms overlapped with graphics ({} queue family)",
+		stats.accumulatedComputeMs / ASYNC_COMPUTE_LOG_FRAMES, stats.accumulatedOverlapMs / ASYNC_COMPUTE_LOG_FRAMES,
+		sharesQueueFamily() ? "shared" : "dedicated");
+	stats.accumulatedComputeMs = 0.0f;
+	stats.accumulatedOverlapMs = 0.0f;
+	stats.sampleCount = 0U;
+}
 
-	Editor::ViewportTexture = imguiRenderTexture[getCurrentFrameNumber()];
-	Editor::DrawEditor();
+void Renderer::draw(FramePacket& packet)
+{
+	ZoneScoped;
 
-	ImGui::Render();
+	applySettings(packet.settings);
 
-	VK_CHECK(vkWaitForFences(device, 1, &getCurrentFrame().renderFen, true, 1000000000));
+	if (window.resized.exchange(false))
+	{
+		recreateSwapchain();
+		return;
+	}
 
 	uint32_t swapchainImageIndex;
 	VkResult result = vkAcquireNextImageKHR(device, swapchain.swapchain, 1000000000, getCurrentFrame().presentSem, nullptr, &swapchainImageIndex);
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.resized == true)
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
 	{
-		window.resized = false;
 		recreateSwapchain();
 		return;
 	}
@@ -215,7 +1097,11 @@ void Renderer::draw(const std::vector<RenderableTypes::RenderObject>& renderObje
 		throw std::runtime_error("failed to acquire swap chain image!");
 	}
 
-	VK_CHECK(vkResetFences(device, 1, &getCurrentFrame().renderFen));
+	// culling runs on the compute queue while graphics is still busy with the previous frame
+	rasterizeOccluders(packet);
+	updateFrameData(packet);
+	dispatchCulling(packet);
+
 	VK_CHECK(vkResetCommandBuffer(graphics.commands[getCurrentFrameNumber()].buffer, 0));
 
 	const VkCommandBuffer cmd = graphics.commands[getCurrentFrameNumber()].buffer;
@@ -229,218 +1115,316 @@ void Renderer::draw(const std::vector<RenderableTypes::RenderObject>& renderObje
 
 	vkBeginCommandBuffer(cmd, &cmdBeginInfo);
 
-	const VkViewport viewport{
-		.x = 0.0f,
-		.y = 0.0f,
-		.width = static_cast<float>(window.extent.width),
-		.height = static_cast<float>(window.extent.height),
-		.minDepth = 0.0f,
-		.maxDepth = 1.0f,
-	};
+	if (timestampPeriod > 0.0f)
+	{
+		vkCmdResetQueryPool(cmd, getCurrentFrame().timestampPool, RenderTypes::GRAPHICS_BEGIN, 2);
+		vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, getCurrentFrame().timestampPool, RenderTypes::GRAPHICS_BEGIN);
+	}
+	if (pipelineStatisticsSupported)
+	{
+		vkCmdResetQueryPool(cmd, getCurrentFrame().statisticsPool, 0, 1);
+	}
 
-	const VkRect2D scissor{
-		.offset = {.x = 0,.y = 0},
-		.extent = window.extent
-	};
+	const VkBuffer drawCommandBuffer = ResourceManager::ptr->GetBuffer(getCurrentFrame().drawCommandBuffer).buffer;
+	if (!sharesQueueFamily())
+	{
+		// source stage matches the compute timeline wait, so the acquire happens after the release
+		bufferBarrier(cmd, queueTransferBarrier(drawCommandBuffer, compute.queueFamily, graphics.queueFamily,
+			VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_NONE,
+			VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT));
+	}
 
-	vkCmdSetViewport(cmd, 0, 1, &viewport);
-	vkCmdSetScissor(cmd, 0, 1, &scissor);
+	streamTextures(cmd, packet);
 
-	const VkImageMemoryBarrier presentImgMemBarrier{
-		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-		.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-		.image = swapchain.images[swapchainImageIndex],
-		.subresourceRange = {
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.baseMipLevel = 0,
-			.levelCount = 1,
-			.baseArrayLayer = 0,
-			.layerCount = 1,
-		}
-	};
+	setViewportAndScissor(cmd);
 
-	VkImageMemoryBarrier renderImgMemBarrier = presentImgMemBarrier;
-	renderImgMemBarrier.image = ResourceManager::ptr->GetImage(getCurrentFrame().renderImage).image;
+	RenderGraph& graph = getCurrentFrame().graph;
+	graph.reset();
 
-	VkImageMemoryBarrier initialBarriers[] = { presentImgMemBarrier,renderImgMemBarrier };
+	// the acquire semaphore is waited at colour output, so the swapchain image is only ready from there
+	const RenderGraph::ImageId swapchainTarget = graph.importImage("Swapchain",
+		swapchain.images[swapchainImageIndex], swapchain.imageViews[swapchainImageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+		{ .stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT }, RenderGraph::Access::PRESENT);
 
-	vkCmdPipelineBarrier(
-		cmd,
-		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-		0,
-		0,
-		nullptr,
-		0,
-		nullptr,
-		static_cast<uint32_t>(std::size(initialBarriers)),
-		initialBarriers
-	);
+	const Image renderImage = ResourceManager::ptr->GetImage(getCurrentFrame().renderImage);
+	const RenderGraph::ImageId sceneColor = graph.importImage("Scene Color", renderImage.image, renderImage.imageView, VK_IMAGE_ASPECT_COLOR_BIT, {});
 
-	const VkImageMemoryBarrier depthImgMemBarrier{
-		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-		.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-		.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-		.image = ResourceManager::ptr->GetImage(depthImage).image,
-		.subresourceRange = {
-			.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
-			.baseMipLevel = 0,
-			.levelCount = 1,
-			.baseArrayLayer = 0,
+	const RenderGraph::ImageId sceneDepth = graph.createImage("Scene Depth", {
+		.format = DEPTH_IMAGE_FORMAT,
+		.extent = window.extent,
+		.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		.aspect = ImageCreateInfo::Usage::DEPTH,
+		});
+
+	// rebuilt from scratch every frame, nothing of the previous contents is kept
+	const Image hizImage = ResourceManager::ptr->GetImage(getCurrentFrame().hizImage);
+	const RenderGraph::ImageId hiz = graph.importImage("Hi-Z", hizImage.image, hizImage.imageView, VK_IMAGE_ASPECT_COLOR_BIT, {});
+
+	// one statistics query spans every geometry pass, so the editor's fragments aren't counted
+	const VkQueryPool statisticsPool = getCurrentFrame().statisticsPool;
+	float frameRecordTimeMs = 0.0f;
+
+	const auto renderGeometry = [&](VkCommandBuffer cmd, const RenderGraph& graph, RenderTypes::DrawPass pass, bool clear,
+		std::initializer_list<RenderTypes::DrawPhase> phases) {
+		const bool shading = pass == RenderTypes::DrawPass::SHADING;
+		// after the pre-pass depth is complete and only tested
+		const bool depthReadOnly = shading && depthPrepass;
+
+		const VkRenderingAttachmentInfo colorAttachInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+			.imageView = graph.getImageView(sceneColor),
+			.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.clearValue = {
+				.color = {0.0f, 0.0f, 0.0f, 1.0f}
+			}
+		};
+
+		const VkRenderingAttachmentInfo depthAttachInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+			.imageView = graph.getImageView(sceneDepth),
+			.imageLayout = depthReadOnly ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.loadOp = clear && !depthReadOnly ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.clearValue = {
+				.depthStencil = {1.0f},
+			}
+		};
+
+		// the depth pre-pass renders without colour attachments
+		const VkRenderingInfo renderInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+			.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
+			.renderArea = {.offset = {.x = 0,.y = 0}, .extent = window.extent},
 			.layerCount = 1,
+			.colorAttachmentCount = shading ? 1U : 0U,
+			.pColorAttachments = &colorAttachInfo,
+			.pDepthAttachment = &depthAttachInfo,
+		};
+		vkCmdBeginRendering(cmd, &renderInfo);
+		for (const RenderTypes::DrawPhase phase : phases)
+		{
+			frameRecordTimeMs += drawObjects(cmd, packet, pass, phase);
 		}
+		vkCmdEndRendering(cmd);
 	};
 
-	vkCmdPipelineBarrier(
-		cmd,
-		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-		0,
-		0,
-		nullptr,
-		0,
-		nullptr,
-		1,
-		&depthImgMemBarrier
-	);
-
-	const VkRenderingAttachmentInfo colorAttachInfo{
-		.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-		.imageView = ResourceManager::ptr->GetImage(getCurrentFrame().renderImage).imageView,
-		.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-		.clearValue = { 
-			.color = {0.0f, 0.0f, 0.0f, 1.0f}
+	const auto beginStatistics = [&](VkCommandBuffer cmd) {
+		if (pipelineStatisticsSupported)
+		{
+			vkCmdBeginQuery(cmd, statisticsPool, 0, 0);
 		}
 	};
-
-	const VkRenderingAttachmentInfo depthAttachInfo{
-		.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-		.imageView = ResourceManager::ptr->GetImage(depthImage).imageView,
-		.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-		.clearValue = {
-			.depthStencil = {1.0f},
+	const auto endStatistics = [&](VkCommandBuffer cmd) {
+		if (pipelineStatisticsSupported)
+		{
+			vkCmdEndQuery(cmd, statisticsPool, 0);
 		}
 	};
 
-	const VkRenderingInfo renderInfo{
-		.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
-		.renderArea = scissor,
-		.layerCount = 1,
-		.colorAttachmentCount = 1,
-		.pColorAttachments = &colorAttachInfo,
-		.pDepthAttachment = &depthAttachInfo,
+	// objects visible last time are drawn first, their depth builds the Hi-Z the rest are tested against
+	const auto addOcclusionPasses = [&]() {
+		graph.addPass("Hi-Z", {
+			{ sceneDepth, RenderGraph::Access::COMPUTE_SAMPLED },
+			{ hiz, RenderGraph::Access::COMPUTE_STORAGE_WRITE },
+			}, [&](VkCommandBuffer cmd, const RenderGraph& graph) {
+				buildHiz(cmd);
+			});
+
+		graph.addPass("Occlusion Cull", {
+			{ hiz, RenderGraph::Access::COMPUTE_SAMPLED },
+			}, [&](VkCommandBuffer cmd, const RenderGraph& graph) {
+				cullOccluded(cmd, packet);
+			});
 	};
-	vkCmdBeginRendering(cmd, &renderInfo);
 
-	drawObjects(cmd, renderObjects);
+	if (depthPrepass)
+	{
+		graph.addPass("Depth Prepass", {
+			{ sceneDepth, RenderGraph::Access::DEPTH_ATTACHMENT },
+			}, [&](VkCommandBuffer cmd, const RenderGraph& graph) {
+				beginStatistics(cmd);
+				renderGeometry(cmd, graph, RenderTypes::DrawPass::DEPTH_PREPASS, true, { RenderTypes::EARLY });
+			});
+
+		if (occlusionCulling)
+		{
+			addOcclusionPasses();
+			graph.addPass("Depth Prepass Late", {
+				{ sceneDepth, RenderGraph::Access::DEPTH_ATTACHMENT },
+				}, [&](VkCommandBuffer cmd, const RenderGraph& graph) {
+					renderGeometry(cmd, graph, RenderTypes::DrawPass::DEPTH_PREPASS, false, { RenderTypes::LATE });
+				});
+		}
 
-	vkCmdEndRendering(cmd);
+		// depth already holds both phases, so shading draws them in one pass
+		graph.addPass("Scene", {
+			{ sceneColor, RenderGraph::Access::COLOR_ATTACHMENT },
+			{ sceneDepth, RenderGraph::Access::DEPTH_ATTACHMENT_READ },
+			}, [&](VkCommandBuffer cmd, const RenderGraph& graph) {
+				if (occlusionCulling)
+				{
+					renderGeometry(cmd, graph, RenderTypes::DrawPass::SHADING, true, { RenderTypes::EARLY, RenderTypes::LATE });
+				}
+				else
+				{
+					renderGeometry(cmd, graph, RenderTypes::DrawPass::SHADING, true, { RenderTypes::EARLY });
+				}
+				endStatistics(cmd);
+			});
+	}
+	else
+	{
+		graph.addPass("Scene", {
+			{ sceneColor, RenderGraph::Access::COLOR_ATTACHMENT },
+			{ sceneDepth, RenderGraph::Access::DEPTH_ATTACHMENT },
+			}, [&](VkCommandBuffer cmd, const RenderGraph& graph) {
+				beginStatistics(cmd);
+				renderGeometry(cmd, graph, RenderTypes::DrawPass::SHADING, true, { RenderTypes::EARLY });
+				if (!occlusionCulling)
+				{
+					endStatistics(cmd);
+				}
+			});
 
-	const VkImageMemoryBarrier imgMemBarrier{
-		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-		.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-		.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-		.image = ResourceManager::ptr->GetImage(getCurrentFrame().renderImage).image,
-		.subresourceRange = {
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.baseMipLevel = 0,
-			.levelCount = 1,
-			.baseArrayLayer = 0,
-			.layerCount = 1,
+		if (occlusionCulling)
+		{
+			addOcclusionPasses();
+			graph.addPass("Scene Late", {
+				{ sceneColor, RenderGraph::Access::COLOR_ATTACHMENT },
+				{ sceneDepth, RenderGraph::Access::DEPTH_ATTACHMENT },
+				}, [&](VkCommandBuffer cmd, const RenderGraph& graph) {
+					renderGeometry(cmd, graph, RenderTypes::DrawPass::SHADING, false, { RenderTypes::LATE });
+					endStatistics(cmd);
+				});
 		}
-	};
-		
-	vkCmdPipelineBarrier(
-		cmd,
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-		0,
-		0,
-		nullptr,
-		0,
-		nullptr,
-		1,
-		&imgMemBarrier
-	);
+	}
 
+	graph.addPass("Editor", {
+		{ sceneColor, RenderGraph::Access::FRAGMENT_SAMPLED },
+		{ sceneDepth, RenderGraph::Access::FRAGMENT_SAMPLED },
+		{ swapchainTarget, RenderGraph::Access::COLOR_ATTACHMENT },
+		}, [&](VkCommandBuffer cmd, const RenderGraph& graph) {
+			const VkClearValue clearValue{
+				.color = { 0.1f, 0.1f, 0.1f, 1.0f }
+			};
+			VkRenderPassBeginInfo rpInfo = VulkanInit::renderpassBeginInfo(imguiPass, window.extent, swapchain.framebuffers[swapchainImageIndex]);
+			const VkClearValue clearValues[] = { clearValue };
+			rpInfo.clearValueCount = 1;
+			rpInfo.pClearValues = &clearValues[0];
+
+			vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+			ImGui_ImplVulkan_RenderDrawData(&packet.imguiFrame.drawData, cmd);
+			vkCmdEndRenderPass(cmd);
+		});
 
-	const VkImageMemoryBarrier depthShaderImgMemBarrier{
-		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-		.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-		.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-		.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-		.image = ResourceManager::ptr->GetImage(depthImage).image,
-		.subresourceRange = {
-			.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
-			.baseMipLevel = 0,
-			.levelCount = 1,
-			.baseArrayLayer = 0,
-			.layerCount = 1,
+	graph.compile();
+
+	// the depth image belongs to the graph and changes whenever its memory is placed again
+	if (getCurrentFrame().imguiDepthView != graph.getImageView(sceneDepth))
+	{
+		// the old set comes from ImGui's pool, it would run dry after enough resizes
+		if (const ImTextureID retiredTexture = getCurrentFrame().imguiDepthTexture)
+		{
+			timeline.deferDeletion([retiredTexture]() {
+				ImGui_ImplVulkan_RemoveTexture(reinterpret_cast<VkDescriptorSet>(retiredTexture));
+				});
 		}
-	};
+		getCurrentFrame().imguiDepthView = graph.getImageView(sceneDepth);
+		getCurrentFrame().imguiDepthTexture = ImGui_ImplVulkan_AddTexture(imguiSampler, getCurrentFrame().imguiDepthView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+	if (getCurrentFrame().hizDepthView != graph.getImageView(sceneDepth))
+	{
+		getCurrentFrame().hizDepthView = graph.getImageView(sceneDepth);
+		VkDescriptorImageInfo depthInfo = {
+			.sampler = hizSampler,
+			.imageView = getCurrentFrame().hizDepthView,
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		};
+		const VkWriteDescriptorSet depthWrite = VulkanInit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, getCurrentFrame().hizSet, &depthInfo, 0);
+		vkUpdateDescriptorSets(device, 1, &depthWrite, 0, nullptr);
+	}
 
-	vkCmdPipelineBarrier(
-		cmd,
-		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-		0,
-		0,
-		nullptr,
-		0,
-		nullptr,
-		1,
-		&depthShaderImgMemBarrier
-	);
-	Editor::ViewportTexture = imguiRenderTexture[getCurrentFrameNumber()];
+	// the editor only knows placeholders, the textures depend on the frame being recorded
+	packet.imguiFrame.replaceTexture(Editor::ViewportTexture, imguiRenderTexture[getCurrentFrameNumber()]);
+	packet.imguiFrame.replaceTexture(Editor::ViewportDepthTexture, getCurrentFrame().imguiDepthTexture);
 
-	const VkClearValue clearValue{
-		.color = { 0.1f, 0.1f, 0.1f, 1.0f }
-	};
-	VkRenderPassBeginInfo rpInfo = VulkanInit::renderpassBeginInfo(imguiPass, window.extent, swapchain.framebuffers[swapchainImageIndex]);
-	const VkClearValue clearValues[] = { clearValue };
-	rpInfo.clearValueCount = 1;
-	rpInfo.pClearValues = &clearValues[0];
+	graph.execute(cmd);
+
+	recordTimeMs.store(frameRecordTimeMs, std::memory_order_relaxed);
+
+	// hand the draw commands back for the next time the compute queue culls into them, with the visibility the occlusion test wrote
+	if (!sharesQueueFamily())
+	{
+		bufferBarrier(cmd, queueTransferBarrier(drawCommandBuffer, graphics.queueFamily, compute.queueFamily,
+			VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE));
+		getCurrentFrame().drawCommandsReleased = true;
+	}
+
+	if (getCurrentFrame().textureFeedbackWritten)
+	{
+		// the requests are read on the CPU once the frame comes around again
+		bufferBarrier(cmd, bufferMemoryBarrier(ResourceManager::ptr->GetBuffer(getCurrentFrame().textureStreamingBuffer).buffer,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT));
+	}
 
-	vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
-	vkCmdEndRenderPass(cmd);
+	if (timestampPeriod > 0.0f)
+	{
+		vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, getCurrentFrame().timestampPool, RenderTypes::GRAPHICS_END);
+	}
+	getCurrentFrame().queriesWritten = true;
 
 	vkEndCommandBuffer(cmd);
 
-	const VkPipelineStageFlags waitStage { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	// only the indirect draws wait for culling, everything in front of them may start early
+	const VkSemaphore waitSemaphores[] = { getCurrentFrame().presentSem, computeTimeline.getSemaphore() };
+	const VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT };
+	const uint64_t waitValues[] = { 0U, getCurrentFrame().computeValue };
+
+	getCurrentFrame().submitValue = timeline.nextValue();
+	// levels streamed in this frame are read by its submission
+	stagingRing.retire(getCurrentFrame().submitValue);
+	const VkSemaphore signalSemaphores[] = { swapchain.renderSemaphores[swapchainImageIndex], timeline.getSemaphore() };
+	// values for binary semaphores are ignored
+	const uint64_t signalValues[] = { 0U, getCurrentFrame().submitValue };
+
+	const VkTimelineSemaphoreSubmitInfo timelineSubmit = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.waitSemaphoreValueCount = static_cast<uint32_t>(std::size(waitValues)),
+		.pWaitSemaphoreValues = waitValues,
+		.signalSemaphoreValueCount = static_cast<uint32_t>(std::size(signalValues)),
+		.pSignalSemaphoreValues = signalValues,
+	};
 
 	const VkSubmitInfo submit = {
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.pNext = nullptr,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &getCurrentFrame().presentSem,
-		.pWaitDstStageMask = &waitStage,
+		.pNext = &timelineSubmit,
+		.waitSemaphoreCount = static_cast<uint32_t>(std::size(waitSemaphores)),
+		.pWaitSemaphores = waitSemaphores,
+		.pWaitDstStageMask = waitStages,
 		.commandBufferCount = 1,
 		.pCommandBuffers = &cmd,
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = &getCurrentFrame().renderSem,
+		.signalSemaphoreCount = static_cast<uint32_t>(std::size(signalSemaphores)),
+		.pSignalSemaphores = signalSemaphores,
 	};
 
-	vkQueueSubmit(graphics.queue, 1, &submit, getCurrentFrame().renderFen);
+	VK_CHECK(vkQueueSubmit(graphics.queue, 1, &submit, VK_NULL_HANDLE));
 
 	const VkPresentInfoKHR presentInfo = {
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
 		.pNext = nullptr,
 		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &getCurrentFrame().renderSem,
+		.pWaitSemaphores = &swapchain.renderSemaphores[swapchainImageIndex],
 		.swapchainCount = 1,
 		.pSwapchains = &swapchain.swapchain,
 		.pImageIndices = &swapchainImageIndex,
 	};
 	vkQueuePresentKHR(graphics.queue, &presentInfo);
+	updatePresentLatency(packet.sampleTime);
 	FrameMark;
 	frameNumber++;
 }
@@ -464,16 +1448,39 @@ void Renderer::initVulkan() {
 	SDL_Vulkan_CreateSurface(window.window, instance, &surface);
 
 	vkb::PhysicalDeviceSelector selector{ vkb_inst };
+	// dynamic rendering, synchronization2 and the device memory requirement queries are all core 1.3.
+	// texture streaming sizes itself from the memory budget, VMA only estimates it without the extension
 	const vkb::PhysicalDevice physicalDevice = selector
-		.set_minimum_version(1, 2)
+		.set_minimum_version(1, 3)
 		.set_surface(surface)
+		.add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
 		.select()
 		.value();
 
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice.physical_device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice.physical_device, nullptr, &extensionCount, extensions.data());
+	const bool memoryBudgetSupported = std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension) {
+		return std::string_view(extension.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+		});
+
 	vkb::DeviceBuilder deviceBuilder{ physicalDevice };
 
+	VkPhysicalDeviceSynchronization2Features synchronization2Feature{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES,
+		.synchronization2 = VK_TRUE,
+	};
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeature{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+		.pNext = &synchronization2Feature,
+		.timelineSemaphore = VK_TRUE,
+	};
+
 	VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeature{
 		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+		.pNext = &timelineFeature,
 		.dynamicRendering = VK_TRUE,
 	};
 
@@ -481,13 +1488,47 @@ void Renderer::initVulkan() {
 		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
 		.pNext = &dynamicRenderingFeature,
 		.shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+		.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+		.descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
 		.descriptorBindingPartiallyBound = VK_TRUE,
 		.descriptorBindingVariableDescriptorCount = VK_TRUE,
 		.runtimeDescriptorArray = VK_TRUE,
 	};
 
+	// pipeline statistics are optional, they only feed the depth pre-pass numbers. The query stays active
+	// while the draw secondaries execute, so they have to be able to inherit it.
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice.physical_device, &supportedFeatures);
+	pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE && supportedFeatures.inheritedQueries == VK_TRUE;
+	// without BC formats textures are uploaded uncompressed
+	blockCompressionSupported = supportedFeatures.textureCompressionBC == VK_TRUE;
+	// texture feedback is written with atomics from default.frag, without them the shader is built without it
+	textureFeedbackSupported = supportedFeatures.fragmentStoresAndAtomics == VK_TRUE;
+	if (!textureFeedbackSupported)
+	{
+		LOG_CORE_WARN("Fragment shader stores are not supported, texture feedback is disabled");
+	}
+	// the Hi-Z downsample loops over its mip levels, without dynamic indexing the late phase is never culled
+	gpuOcclusionSupported = supportedFeatures.shaderStorageImageArrayDynamicIndexing == VK_TRUE;
+	if (!gpuOcclusionSupported)
+	{
+		LOG_CORE_WARN("Storage image arrays can't be dynamically indexed, GPU occlusion culling is disabled");
+	}
+
+	VkPhysicalDeviceFeatures2 deviceFeatures{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		.pNext = &descIndexFeatures,
+		.features = {
+			.textureCompressionBC = supportedFeatures.textureCompressionBC,
+			.pipelineStatisticsQuery = pipelineStatisticsSupported ? VK_TRUE : VK_FALSE,
+			.fragmentStoresAndAtomics = textureFeedbackSupported ? VK_TRUE : VK_FALSE,
+			.shaderStorageImageArrayDynamicIndexing = gpuOcclusionSupported ? VK_TRUE : VK_FALSE,
+			.inheritedQueries = pipelineStatisticsSupported ? VK_TRUE : VK_FALSE,
+		},
+	};
+
 	const vkb::Device vkbDevice = deviceBuilder
-		.add_pNext(&descIndexFeatures)
+		.add_pNext(&deviceFeatures)
 		.build()
 		.value();
 
@@ -501,6 +1542,7 @@ void Renderer::initVulkan() {
 	compute.queueFamily = vkbDevice.get_queue_index(vkb::QueueType::compute).value();
 
 	const VmaAllocatorCreateInfo allocatorInfo = {
+		.flags = memoryBudgetSupported ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0U,
 		.physicalDevice = chosenGPU,
 		.device = device,
 		.instance = instance,
@@ -515,11 +1557,16 @@ void Renderer::createSwapchain()
 {
 	ZoneScoped;
 	vkb::SwapchainBuilder swapchainBuilder{ chosenGPU,device,surface };
+	swapchainBuilder
+		.use_default_format_selection()
+		.set_desired_extent(window.extent.width, window.extent.height);
+	for (const VkPresentModeKHR presentMode : latency.presentModes)
+	{
+		swapchainBuilder.add_fallback_present_mode(presentMode);
+	}
+	swapchainBuilder.add_fallback_present_mode(VK_PRESENT_MODE_FIFO_KHR);
 
 	vkb::Swapchain vkbSwapchain = swapchainBuilder
-		.use_default_format_selection()
-		.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-		.set_desired_extent(window.extent.width, window.extent.height)
 		.build()
 		.value();
 
@@ -527,9 +1574,21 @@ void Renderer::createSwapchain()
 	swapchain.images = vkbSwapchain.get_images().value();
 	swapchain.imageViews = vkbSwapchain.get_image_views().value();
 	swapchain.imageFormat = vkbSwapchain.image_format;
+	swapchain.presentMode = vkbSwapchain.present_mode;
+
+	const VkSemaphoreCreateInfo semaphoreCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0
+	};
+	swapchain.renderSemaphores.resize(swapchain.images.size());
+	for (VkSemaphore& renderSemaphore : swapchain.renderSemaphores)
+	{
+		vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &renderSemaphore);
+	}
 
 	const VkDeviceSize imageSize = { static_cast<VkDeviceSize>(window.extent.height * window.extent.width * 4) };
-	const VkFormat image_format{ VK_FORMAT_R8G8B8A8_SRGB };
+	const VkFormat image_format{ RENDER_IMAGE_FORMAT };
 
 	const VkExtent3D imageExtent{
 		.width = static_cast<uint32_t>(window.extent.width),
@@ -538,9 +1597,7 @@ void Renderer::createSwapchain()
 	};
 
 	const VkImageCreateInfo imageInfo = VulkanInit::imageCreateInfo(image_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, imageExtent);
-	const VkFormat depthFormat{ VK_FORMAT_D32_SFLOAT };
-	const VkImageCreateInfo depthImageInfo = VulkanInit::imageCreateInfo(depthFormat, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, imageExtent);
-	for (int i = 0; i < FRAME_OVERLAP; ++i)
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
 	{
 		frame[i].renderImage = ResourceManager::ptr->CreateImage(ImageCreateInfo{
 			.imageInfo = imageInfo,
@@ -550,12 +1607,7 @@ void Renderer::createSwapchain()
 
 	}
 
-	depthImage = ResourceManager::ptr->CreateImage(ImageCreateInfo{
-			.imageInfo = depthImageInfo,
-			.imageType = ImageCreateInfo::ImageType::TEXTURE_2D,
-			.usage = ImageCreateInfo::Usage::DEPTH
-		});
-	LOG_CORE_INFO("Create Swapchain");
+	LOG_CORE_INFO("Create Swapchain, {} images, present mode {}", swapchain.images.size(), static_cast<int>(swapchain.presentMode));
 }
 
 void Renderer::destroySwapchain()
@@ -567,11 +1619,16 @@ void Renderer::destroySwapchain()
 	}
 	vkDestroyRenderPass(device, imguiPass, nullptr);
 	vkDestroySwapchainKHR(device, swapchain.swapchain, nullptr);
+	for (const VkSemaphore renderSemaphore : swapchain.renderSemaphores)
+	{
+		vkDestroySemaphore(device, renderSemaphore, nullptr);
+	}
 
-	for (int i = 0; i < FRAME_OVERLAP; ++i)
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
 	{
 		ResourceManager::ptr->DestroyImage(frame[i].renderImage);
 	};
+	destroyHizImages();
 	LOG_CORE_INFO("Destroy swapchain");
 }
 
@@ -579,14 +1636,11 @@ void Renderer::recreateSwapchain()
 {
 	ZoneScoped;
 	
-	SDL_Event e;
-	int flags = SDL_GetWindowFlags(window.window);
-	bool minimized = (flags & SDL_WINDOW_MINIMIZED) ? true : false;
-	while (minimized)
+	// events belong to the main thread, so a minimized window skips frames until it is restored
+	if (SDL_GetWindowFlags(window.window) & SDL_WINDOW_MINIMIZED)
 	{
-		flags = SDL_GetWindowFlags(window.window);
-		minimized = (flags & SDL_WINDOW_MINIMIZED) ? true : false;
-		SDL_WaitEvent(&e);
+		window.resized = true;
+		return;
 	}
 	int width = 0, height = 0;
 	SDL_GetWindowSize(window.window, &width, &height);
@@ -599,6 +1653,8 @@ void Renderer::recreateSwapchain()
 	createSwapchain();
 	initImguiRenderpass();
 	initImguiRenderImages();
+	initHizImages();
+	initOcclusionBuffer();
 }
 
 
@@ -611,8 +1667,9 @@ void Renderer::initImguiRenderpass()
 		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
 		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		// the render graph transitions the image around the pass
+		.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 	};
 
 	const VkAttachmentReference color_attachment_ref = {
@@ -685,14 +1742,12 @@ void Renderer::initImguiRenderImages()
 	instanceDeletionQueue.push_function([=] {
 		vkDestroySampler(device, imageSampler, nullptr);
 	});
+	imguiSampler = imageSampler;
 
-	for (int i = 0; i < FRAME_OVERLAP; ++i)
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
 	{
 		imguiRenderTexture[i] = ImGui_ImplVulkan_AddTexture(imageSampler, ResourceManager::ptr->GetImage(frame[i].renderImage).imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	}
-	imguiDepthTexture = ImGui_ImplVulkan_AddTexture(imageSampler, ResourceManager::ptr->GetImage(depthImage).imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-	Editor::ViewportDepthTexture = imguiDepthTexture;
 }
 
 void Renderer::initImgui()
@@ -736,8 +1791,9 @@ void Renderer::initImgui()
 		.Device = device,
 		.Queue = graphics.queue,
 		.DescriptorPool = imguiPool,
-		.MinImageCount = 3,
-		.ImageCount = 3,
+		.MinImageCount = std::max(2U, static_cast<uint32_t>(swapchain.images.size())),
+		// the backend keeps a vertex buffer per image, there must be one for every frame in flight
+		.ImageCount = std::max({ 2U, static_cast<uint32_t>(swapchain.images.size()), latency.framesInFlight }),
 		.MSAASamples = VK_SAMPLE_COUNT_1_BIT,
 	};
 	
@@ -771,7 +1827,7 @@ void Renderer::initGraphicsCommands()
 		.queueFamilyIndex = graphics.queueFamily
 	};
 
-	for (int i = 0; i < 2; ++i)
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
 	{
 		VkCommandPool* commandPool = &graphics.commands[i].pool;
 
@@ -786,8 +1842,25 @@ void Renderer::initGraphicsCommands()
 		};
 
 		vkAllocateCommandBuffers(device, &bufferAllocInfo, &graphics.commands[i].buffer);
+
+		for (int job = 0; job < static_cast<int>(MAX_RECORD_THREADS); ++job)
+		{
+			for (int phase = 0; phase < static_cast<int>(RenderTypes::DRAW_PHASE_COUNT); ++phase)
+			{
+				for (RenderTypes::CommandContext* recordCommands : { &frame[i].recordCommands[phase][job], &frame[i].prepassCommands[phase][job] })
+				{
+					const VkCommandPoolCreateInfo recordPoolInfo = VulkanInit::commandPoolCreateInfo(graphics.queueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+					vkCreateCommandPool(device, &recordPoolInfo, nullptr, &recordCommands->pool);
+
+					const VkCommandBufferAllocateInfo recordAllocInfo = VulkanInit::commandBufferAllocateInfo(recordCommands->pool, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+					vkAllocateCommandBuffers(device, &recordAllocInfo, &recordCommands->buffer);
+				}
+			}
+		}
 	}
 
+	defaultRecordThreadCount = std::clamp(static_cast<int>(Jobs::JobSystem::ptr->getThreadCount()), 1, static_cast<int>(MAX_RECORD_THREADS));
+
 
 	const VkCommandPoolCreateInfo uploadCommandPoolInfo = VulkanInit::commandPoolCreateInfo(graphics.queueFamily);
 	vkCreateCommandPool(device, &uploadCommandPoolInfo, nullptr, &uploadContext.commandPool);
@@ -805,35 +1878,64 @@ void Renderer::initComputeCommands(){
 		.queueFamilyIndex = compute.queueFamily
 	};
 
-	VkCommandPool* commandPool = &compute.commands[0].pool;
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
+	{
+		VkCommandPool* commandPool = &compute.commands[i].pool;
 
-	vkCreateCommandPool(device, &computeCommandPoolCreateInfo, nullptr, commandPool);
+		vkCreateCommandPool(device, &computeCommandPoolCreateInfo, nullptr, commandPool);
 
-	const VkCommandBufferAllocateInfo bufferAllocInfo{
-		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-		.pNext = nullptr,
-		.commandPool = *commandPool,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandBufferCount = 1
-	};
+		const VkCommandBufferAllocateInfo bufferAllocInfo{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.pNext = nullptr,
+			.commandPool = *commandPool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		};
 
-	vkAllocateCommandBuffers(device, &bufferAllocInfo, &compute.commands[0].buffer);
+		vkAllocateCommandBuffers(device, &bufferAllocInfo, &compute.commands[i].buffer);
+	}
 }
 
 void Renderer::initSyncStructures()
 {
 	ZoneScoped;
 
-	for (int i = 0; i < FRAME_OVERLAP; ++i)
+	timeline.init(device);
+	computeTimeline.init(device);
+	for (RenderFrame& renderFrame : frame)
 	{
-		const VkFenceCreateInfo fenceCreateInfo = {
-			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-			.pNext = nullptr,
-			.flags = VK_FENCE_CREATE_SIGNALED_BIT
-		};
+		renderFrame.graph.init(&timeline);
+	}
+
+	// overlap is only reported when both queues can write timestamps
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(chosenGPU, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(chosenGPU, &queueFamilyCount, queueFamilies.data());
+	if (queueFamilies[graphics.queueFamily].timestampValidBits > 0 && queueFamilies[compute.queueFamily].timestampValidBits > 0)
+	{
+		timestampPeriod = gpuProperties.limits.timestampPeriod;
+	}
+	else
+	{
+		LOG_CORE_WARN("Timestamps not supported on both queues, async compute overlap is not measured");
+	}
+
+	const VkQueryPoolCreateInfo queryPoolInfo{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = RenderTypes::TIMESTAMP_COUNT,
+	};
 
-		vkCreateFence(device, &fenceCreateInfo, nullptr, &frame[i].renderFen);
+	const VkQueryPoolCreateInfo statisticsPoolInfo{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+		.queryCount = 1,
+		.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
+	};
 
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
+	{
 		const VkSemaphoreCreateInfo semaphoreCreateInfo = {
 			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
 			.pNext = nullptr,
@@ -841,14 +1943,12 @@ void Renderer::initSyncStructures()
 		};
 
 		vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame[i].presentSem);
-		vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame[i].renderSem);
+		vkCreateQueryPool(device, &queryPoolInfo, nullptr, &frame[i].timestampPool);
+		if (pipelineStatisticsSupported)
+		{
+			vkCreateQueryPool(device, &statisticsPoolInfo, nullptr, &frame[i].statisticsPool);
+		}
 	}
-
-
-	const VkFenceCreateInfo uploadFenceCreateInfo = VulkanInit::fenceCreateInfo();
-	vkCreateFence(device, &uploadFenceCreateInfo, nullptr, &uploadContext.uploadFence);
-
-
 }
 
 void Renderer::initShaders()
@@ -861,7 +1961,6 @@ void Renderer::initShaders()
 	{
 		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
 		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10 },
-		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 32 },
 		{ VK_DESCRIPTOR_TYPE_SAMPLER, 10 }
 	};
 	VkDescriptorPoolCreateInfo poolCreateInfo{
@@ -873,44 +1972,81 @@ void Renderer::initShaders()
 	vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &globalPool);
 	vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &scenePool);
 
+	const VkDescriptorPoolSize cullPoolSizes[] =
+	{
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(frame.size()) },
+	};
+	const VkDescriptorPoolCreateInfo cullPoolCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = static_cast<uint32_t>(frame.size()),
+		.poolSizeCount = static_cast<uint32_t>(std::size(cullPoolSizes)),
+		.pPoolSizes = cullPoolSizes,
+	};
+	vkCreateDescriptorPool(device, &cullPoolCreateInfo, nullptr, &cullPool);
+
+	// a Hi-Z downsample set and an occlusion test set per frame
+	const VkDescriptorPoolSize occlusionPoolSizes[] =
+	{
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * static_cast<uint32_t>(frame.size()) },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_HIZ_MIPS * static_cast<uint32_t>(frame.size()) },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * static_cast<uint32_t>(frame.size()) },
+	};
+	const VkDescriptorPoolCreateInfo occlusionPoolCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = 2 * static_cast<uint32_t>(frame.size()),
+		.poolSizeCount = static_cast<uint32_t>(std::size(occlusionPoolSizes)),
+		.pPoolSizes = occlusionPoolSizes,
+	};
+	vkCreateDescriptorPool(device, &occlusionPoolCreateInfo, nullptr, &occlusionPool);
+
+	// a set per level step of one texture
+	const VkDescriptorPoolSize mipPoolSizes[] =
+	{
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 * MAX_TEXTURE_MIPS },
+	};
+	const VkDescriptorPoolCreateInfo mipPoolCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = MAX_TEXTURE_MIPS,
+		.poolSizeCount = static_cast<uint32_t>(std::size(mipPoolSizes)),
+		.pPoolSizes = mipPoolSizes,
+	};
+	vkCreateDescriptorPool(device, &mipPoolCreateInfo, nullptr, &mipPool);
+
+	// every frame samples textures through the one set, its capacity sizes the streaming buffers
+	bindlessTable.init(device, chosenGPU, MAX_BINDLESS_TEXTURES);
+	const size_t textureStreamingSize = sizeof(GPUShaderData::TextureStreamingHeader) + sizeof(GPUShaderData::TextureStreaming) * bindlessTable.getCapacity();
+
 	// create buffers
 
-	for (int i = 0; i < FRAME_OVERLAP; ++i)
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
 	{
-		frame[i].drawDataBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::DrawData) * MAX_OBJECTS, .usage = GFX::Buffer::Usage::STORAGE });
-		frame[i].transformBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::Transform) * MAX_OBJECTS, .usage = GFX::Buffer::Usage::STORAGE });
-		frame[i].materialBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::Material) * MAX_OBJECTS, .usage = GFX::Buffer::Usage::STORAGE });
+		frame[i].drawDataBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::DrawData) * INITIAL_OBJECT_CAPACITY, .usage = GFX::Buffer::Usage::STORAGE });
+		frame[i].transformBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::Transform) * INITIAL_OBJECT_CAPACITY, .usage = GFX::Buffer::Usage::STORAGE });
+		frame[i].drawCommandBuffer = createDrawCommandBuffer(INITIAL_OBJECT_CAPACITY);
+		frame[i].lateDrawCommandBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::DrawCommand) * INITIAL_OBJECT_CAPACITY, .usage = GFX::Buffer::Usage::INDIRECT });
+		frame[i].hizCounterBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(uint32_t), .usage = GFX::Buffer::Usage::STORAGE });
+		std::memset(ResourceManager::ptr->GetBuffer(frame[i].hizCounterBuffer).ptr, 0, sizeof(uint32_t));
+		frame[i].materialBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::Material) * INITIAL_MATERIAL_CAPACITY, .usage = GFX::Buffer::Usage::STORAGE });
+		frame[i].objectCapacity = INITIAL_OBJECT_CAPACITY;
+		frame[i].materialCapacity = INITIAL_MATERIAL_CAPACITY;
 
 		frame[i].cameraBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::Camera), .usage = GFX::Buffer::Usage::UNIFORM });
 		frame[i].dirLightBuffer = ResourceManager::ptr->CreateBuffer({ .size = sizeof(GPUShaderData::DirectionalLight), .usage = GFX::Buffer::Usage::UNIFORM });
+		frame[i].textureStreamingBuffer = ResourceManager::ptr->CreateBuffer({ .size = textureStreamingSize, .usage = GFX::Buffer::Usage::STORAGE });
+		std::memset(ResourceManager::ptr->GetBuffer(frame[i].textureStreamingBuffer).ptr, 0, textureStreamingSize);
 	}
 	// create descriptor layout
 
-	VkDescriptorBindingFlags flags[] = {
-		0,
-		0,
-		0,
-		0,
-		VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
-	};
-
-	VkDescriptorSetLayoutBindingFlagsCreateInfo globalBindingFlags{
-		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
-		.bindingCount = static_cast<uint32_t>(std::size(flags)),
-		.pBindingFlags = flags,
-	};
-
 	const VkDescriptorSetLayoutBinding globalBindings[] = {
 		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0)},
 		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1)},
 		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 2)},
 		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3)},
-		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 4, 32)},
 	};
 
 	const VkDescriptorSetLayoutCreateInfo globalSetLayoutInfo = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-		.pNext = &globalBindingFlags,
+		.pNext = nullptr,
 		.flags = 0,
 		.bindingCount = static_cast<uint32_t>(std::size(globalBindings)),
 		.pBindings = globalBindings,
@@ -918,7 +2054,8 @@ void Renderer::initShaders()
 
 	const VkDescriptorSetLayoutBinding sceneBindings[] = {
 		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0)},
-		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1)}
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1)},
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2)}
 	};
 	const VkDescriptorSetLayoutCreateInfo sceneSetLayoutInfo = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
@@ -928,22 +2065,67 @@ void Renderer::initShaders()
 		.pBindings = sceneBindings,
 	};
 
-	vkCreateDescriptorSetLayout(device, &globalSetLayoutInfo, nullptr, &globalSetLayout);
-	vkCreateDescriptorSetLayout(device, &sceneSetLayoutInfo, nullptr, &sceneSetLayout);
+	const VkDescriptorSetLayoutBinding cullBindings[] = {
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0)},
+	};
+	const VkDescriptorSetLayoutCreateInfo cullSetLayoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.bindingCount = static_cast<uint32_t>(std::size(cullBindings)),
+		.pBindings = cullBindings,
+	};
 
-	// create descriptors
+	const VkDescriptorSetLayoutBinding hizBindings[] = {
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0)},
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, MAX_HIZ_MIPS)},
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2)},
+	};
+	const VkDescriptorSetLayoutCreateInfo hizSetLayoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.bindingCount = static_cast<uint32_t>(std::size(hizBindings)),
+		.pBindings = hizBindings,
+	};
 
-	uint32_t counts[] = { 32 };  // Set 0 has a variable count descriptor with a maximum of 32 elements
+	const VkDescriptorSetLayoutBinding occlusionBindings[] = {
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0)},
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1)},
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2)},
+	};
+	const VkDescriptorSetLayoutCreateInfo occlusionSetLayoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.bindingCount = static_cast<uint32_t>(std::size(occlusionBindings)),
+		.pBindings = occlusionBindings,
+	};
 
-	VkDescriptorSetVariableDescriptorCountAllocateInfo globalSetCounts = {
-		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO,
-		.descriptorSetCount = 1,
-		.pDescriptorCounts = counts
+	vkCreateDescriptorSetLayout(device, &globalSetLayoutInfo, nullptr, &globalSetLayout);
+	vkCreateDescriptorSetLayout(device, &sceneSetLayoutInfo, nullptr, &sceneSetLayout);
+	vkCreateDescriptorSetLayout(device, &cullSetLayoutInfo, nullptr, &cullSetLayout);
+	vkCreateDescriptorSetLayout(device, &hizSetLayoutInfo, nullptr, &hizSetLayout);
+	vkCreateDescriptorSetLayout(device, &occlusionSetLayoutInfo, nullptr, &occlusionSetLayout);
+
+	const VkDescriptorSetLayoutBinding mipBindings[] = {
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0)},
+		{VulkanInit::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1)},
+	};
+	const VkDescriptorSetLayoutCreateInfo mipSetLayoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.bindingCount = static_cast<uint32_t>(std::size(mipBindings)),
+		.pBindings = mipBindings,
 	};
+	vkCreateDescriptorSetLayout(device, &mipSetLayoutInfo, nullptr, &mipSetLayout);
+
+	// create descriptors
 
 	const VkDescriptorSetAllocateInfo allocInfo = {
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-		.pNext = &globalSetCounts,
+		.pNext = nullptr,
 		.descriptorPool = globalPool,
 		.descriptorSetCount = 1,
 		.pSetLayouts = &globalSetLayout,
@@ -957,40 +2139,78 @@ void Renderer::initShaders()
 		.pSetLayouts = &sceneSetLayout,
 	};
 
-	VkSamplerCreateInfo samplerInfo = VulkanInit::samplerCreateInfo(VK_FILTER_NEAREST);
+	const VkDescriptorSetAllocateInfo cullAllocInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = cullPool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &cullSetLayout,
+	};
+
+	const VkDescriptorSetAllocateInfo hizAllocInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = occlusionPool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &hizSetLayout,
+	};
+
+	const VkDescriptorSetAllocateInfo occlusionAllocInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = occlusionPool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &occlusionSetLayout,
+	};
+
+	// trilinear, every uploaded texture has a full mip chain
+	VkSamplerCreateInfo samplerInfo = VulkanInit::samplerCreateInfo(VK_FILTER_LINEAR);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 	VkSampler imageSampler;
 	vkCreateSampler(device, &samplerInfo, nullptr, &imageSampler);
 	instanceDeletionQueue.push_function([=] {
 		vkDestroySampler(device, imageSampler, nullptr);
 		});
 
+	// the Hi-Z shaders only fetch texels, the sampler is never used for filtering
+	const VkSamplerCreateInfo hizSamplerInfo = VulkanInit::samplerCreateInfo(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	vkCreateSampler(device, &hizSamplerInfo, nullptr, &hizSampler);
+	instanceDeletionQueue.push_function([=] {
+		vkDestroySampler(device, hizSampler, nullptr);
+		});
+
 	VkDescriptorImageInfo samplerDescInfo{.sampler = imageSampler };
 
-	for (int i = 0; i < FRAME_OVERLAP; ++i)
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
 	{
 		vkAllocateDescriptorSets(device, &allocInfo, &frame[i].globalSet);
 		vkAllocateDescriptorSets(device, &sceneAllocInfo, &frame[i].sceneSet);
+		vkAllocateDescriptorSets(device, &cullAllocInfo, &frame[i].cullSet);
+		vkAllocateDescriptorSets(device, &hizAllocInfo, &frame[i].hizSet);
+		vkAllocateDescriptorSets(device, &occlusionAllocInfo, &frame[i].occlusionSet);
+
+		writeGlobalBufferDescriptors(frame[i]);
+
+		VkDescriptorBufferInfo counterBuffer = {
+			.buffer = ResourceManager::ptr->GetBuffer(frame[i].hizCounterBuffer).buffer,
+			.range = ResourceManager::ptr->GetBuffer(frame[i].hizCounterBuffer).size,
+		};
+		const VkWriteDescriptorSet counterWrite = VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame[i].hizSet, &counterBuffer, 2);
+		vkUpdateDescriptorSets(device, 1, &counterWrite, 0, nullptr);
 
-		VkDescriptorBufferInfo globalBuffers[] = {
-			{.buffer = ResourceManager::ptr->GetBuffer(frame[i].drawDataBuffer).buffer, .range = ResourceManager::ptr->GetBuffer(frame[i].drawDataBuffer).size },
-			{.buffer = ResourceManager::ptr->GetBuffer(frame[i].transformBuffer).buffer, .range = ResourceManager::ptr->GetBuffer(frame[i].transformBuffer).size},
-			{.buffer = ResourceManager::ptr->GetBuffer(frame[i].materialBuffer).buffer, .range = ResourceManager::ptr->GetBuffer(frame[i].materialBuffer).size},
-		};	
 		VkDescriptorBufferInfo sceneBuffers[] = {
 			{.buffer = ResourceManager::ptr->GetBuffer(frame[i].cameraBuffer).buffer, .range = ResourceManager::ptr->GetBuffer(frame[i].cameraBuffer).size},
-			{.buffer = ResourceManager::ptr->GetBuffer(frame[i].dirLightBuffer).buffer, .range = ResourceManager::ptr->GetBuffer(frame[i].dirLightBuffer).size }
+			{.buffer = ResourceManager::ptr->GetBuffer(frame[i].dirLightBuffer).buffer, .range = ResourceManager::ptr->GetBuffer(frame[i].dirLightBuffer).size },
+			{.buffer = ResourceManager::ptr->GetBuffer(frame[i].textureStreamingBuffer).buffer, .range = ResourceManager::ptr->GetBuffer(frame[i].textureStreamingBuffer).size }
 		};
 
-		const VkWriteDescriptorSet globalWrites[] = {
-			VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame[i].globalSet, &globalBuffers[0], 0),
-			VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame[i].globalSet, &globalBuffers[1], 1),
-			VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame[i].globalSet, &globalBuffers[2], 2),
-			VulkanInit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_SAMPLER, frame[i].globalSet, &samplerDescInfo, 3)
-		};
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(std::size(globalWrites)), globalWrites, 0, nullptr);
+		const VkWriteDescriptorSet samplerWrite = VulkanInit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_SAMPLER, frame[i].globalSet, &samplerDescInfo, 3);
+		vkUpdateDescriptorSets(device, 1, &samplerWrite, 0, nullptr);
 		const VkWriteDescriptorSet sceneWrites[] = {
 			VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame[i].sceneSet, &sceneBuffers[0], 0),
-			VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame[i].sceneSet, &sceneBuffers[1], 1)
+			VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frame[i].sceneSet, &sceneBuffers[1], 1),
+			VulkanInit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame[i].sceneSet, &sceneBuffers[2], 2)
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(std::size(sceneWrites)), sceneWrites, 0, nullptr);
 	}
@@ -1003,9 +2223,9 @@ void Renderer::initShaders()
 		.size = sizeof(GPUShaderData::PushConstants),
 	};
 
-	VkDescriptorSetLayout setLayouts[] = { globalSetLayout, sceneSetLayout };
+	VkDescriptorSetLayout setLayouts[] = { globalSetLayout, sceneSetLayout, bindlessTable.getLayout() };
 	VkPipelineLayoutCreateInfo defaultPipelineLayoutInfo = VulkanInit::pipelineLayoutCreateInfo();
-	defaultPipelineLayoutInfo.setLayoutCount = 2;
+	defaultPipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(std::size(setLayouts));
 	defaultPipelineLayoutInfo.pSetLayouts = setLayouts;
 	defaultPipelineLayoutInfo.pushConstantRangeCount = 1;
 	defaultPipelineLayoutInfo.pPushConstantRanges = &defaultPushConstants;
@@ -1021,7 +2241,9 @@ void Renderer::initShaders()
 	};
 
 	VkShaderModule vertexShader = shaderLoadFunc((std::string)"../../assets/shaders/default.vert.spv");
-	VkShaderModule fragShader = shaderLoadFunc((std::string)"../../assets/shaders/default.frag.spv");
+	VkShaderModule fragShader = shaderLoadFunc(textureFeedbackSupported
+		? (std::string)"../../assets/shaders/default.frag.spv"
+		: (std::string)"../../assets/shaders/default_nofeedback.frag.spv");
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = VulkanInit::vertexInputStateCreateInfo();
 	VertexInputDescription vertexDescription = RenderMesh::getVertexDescription();
@@ -1040,243 +2262,992 @@ void Renderer::initShaders()
 		.shaderStages = {VulkanInit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, vertexShader),
 					VulkanInit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragShader)},
 		.vertexInputInfo = vertexInputInfo,
+		.colorAttachmentFormats = { RENDER_IMAGE_FORMAT },
+		.depthAttachmentFormat = DEPTH_IMAGE_FORMAT,
 	};
 
 	VkPipeline defaultPipeline = PipelineBuild::BuildPipeline(device, buildInfo);	
+
+	buildInfo.depthStencil = VulkanInit::depthStencilStateCreateInfo(true, false, VK_COMPARE_OP_EQUAL);
+	VkPipeline defaultDepthEqualPipeline = PipelineBuild::BuildPipeline(device, buildInfo);
+
 	const std::string defaultMaterialName = "defaultMaterial";
-	materials[defaultMaterialName] = { .pipeline = defaultPipeline, .pipelineLayout = defaultPipelineLayout };
+	materialTypes[defaultMaterialName] = { .pipeline = defaultPipeline, .depthEqualPipeline = defaultDepthEqualPipeline, .pipelineLayout = defaultPipelineLayout };
 	LOG_CORE_INFO("Material created: " + defaultMaterialName);
 
-	vkDestroyShaderModule(device, vertexShader, nullptr);
-	vkDestroyShaderModule(device, fragShader, nullptr);
+	const RenderableTypes::MaterialHandle defaultMaterial = createMaterial({});
+	assert(defaultMaterial == RenderableTypes::DEFAULT_MATERIAL);
+
+	vkDestroyShaderModule(device, vertexShader, nullptr);
+	vkDestroyShaderModule(device, fragShader, nullptr);
+
+	// depth pre-pass, positions only and no fragment shader
+	VkShaderModule depthVertexShader = shaderLoadFunc((std::string)"../../assets/shaders/depth.vert.spv");
+
+	VkPipelineVertexInputStateCreateInfo positionInputInfo = VulkanInit::vertexInputStateCreateInfo();
+	VertexInputDescription positionDescription = RenderMesh::getPositionVertexDescription();
+	positionInputInfo.pVertexAttributeDescriptions = positionDescription.attributes.data();
+	positionInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(positionDescription.attributes.size());
+	positionInputInfo.pVertexBindingDescriptions = positionDescription.bindings.data();
+	positionInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(positionDescription.bindings.size());
+
+	const PipelineBuild::BuildInfo depthPrepassBuildInfo{
+		.depthStencil = VulkanInit::depthStencilStateCreateInfo(true, true),
+		.pipelineLayout = defaultPipelineLayout,
+		.rasterizer = VulkanInit::rasterizationStateCreateInfo(VK_POLYGON_MODE_FILL),
+		.shaderStages = {VulkanInit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, depthVertexShader)},
+		.vertexInputInfo = positionInputInfo,
+		.colorAttachmentFormats = {},
+		.depthAttachmentFormat = DEPTH_IMAGE_FORMAT,
+	};
+	depthPrepassPipeline = PipelineBuild::BuildPipeline(device, depthPrepassBuildInfo);
+	depthPrepassLayout = defaultPipelineLayout;
+
+	vkDestroyShaderModule(device, depthVertexShader, nullptr);
+
+	// frustum culling on the compute queue
+	const VkPushConstantRange cullPushConstants{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(GPUShaderData::CullPushConstants),
+	};
+
+	VkPipelineLayoutCreateInfo cullPipelineLayoutInfo = VulkanInit::pipelineLayoutCreateInfo();
+	cullPipelineLayoutInfo.setLayoutCount = 1;
+	cullPipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+	cullPipelineLayoutInfo.pushConstantRangeCount = 1;
+	cullPipelineLayoutInfo.pPushConstantRanges = &cullPushConstants;
+	vkCreatePipelineLayout(device, &cullPipelineLayoutInfo, nullptr, &cullPipelineLayout);
+
+	VkShaderModule cullShader = shaderLoadFunc((std::string)"../../assets/shaders/cull.comp.spv");
+	cullPipeline = PipelineBuild::BuildComputePipeline(device, cullPipelineLayout, cullShader);
+	vkDestroyShaderModule(device, cullShader, nullptr);
+
+	// Hi-Z downsample and the occlusion test of the late phase, both on the graphics queue
+	const VkPushConstantRange hizPushConstants{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(GPUShaderData::HizPushConstants),
+	};
+
+	VkPipelineLayoutCreateInfo hizPipelineLayoutInfo = VulkanInit::pipelineLayoutCreateInfo();
+	hizPipelineLayoutInfo.setLayoutCount = 1;
+	hizPipelineLayoutInfo.pSetLayouts = &hizSetLayout;
+	hizPipelineLayoutInfo.pushConstantRangeCount = 1;
+	hizPipelineLayoutInfo.pPushConstantRanges = &hizPushConstants;
+	vkCreatePipelineLayout(device, &hizPipelineLayoutInfo, nullptr, &hizPipelineLayout);
+
+	// hiz.comp needs the dynamic indexing feature, without it the pipeline stays null and is never bound
+	if (gpuOcclusionSupported)
+	{
+		VkShaderModule hizShader = shaderLoadFunc((std::string)"../../assets/shaders/hiz.comp.spv");
+		hizPipeline = PipelineBuild::BuildComputePipeline(device, hizPipelineLayout, hizShader);
+		vkDestroyShaderModule(device, hizShader, nullptr);
+	}
+
+	const VkPushConstantRange occlusionPushConstants{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(GPUShaderData::OcclusionPushConstants),
+	};
+
+	VkPipelineLayoutCreateInfo occlusionPipelineLayoutInfo = VulkanInit::pipelineLayoutCreateInfo();
+	occlusionPipelineLayoutInfo.setLayoutCount = 1;
+	occlusionPipelineLayoutInfo.pSetLayouts = &occlusionSetLayout;
+	occlusionPipelineLayoutInfo.pushConstantRangeCount = 1;
+	occlusionPipelineLayoutInfo.pPushConstantRanges = &occlusionPushConstants;
+	vkCreatePipelineLayout(device, &occlusionPipelineLayoutInfo, nullptr, &occlusionPipelineLayout);
+
+	VkShaderModule occlusionShader = shaderLoadFunc((std::string)"../../assets/shaders/occlusion.comp.spv");
+	occlusionPipeline = PipelineBuild::BuildComputePipeline(device, occlusionPipelineLayout, occlusionShader);
+	vkDestroyShaderModule(device, occlusionShader, nullptr);
+
+	// mip generation for textures that can't be blitted
+	const VkPushConstantRange mipPushConstants{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(GPUShaderData::MipPushConstants),
+	};
+
+	VkPipelineLayoutCreateInfo mipPipelineLayoutInfo = VulkanInit::pipelineLayoutCreateInfo();
+	mipPipelineLayoutInfo.setLayoutCount = 1;
+	mipPipelineLayoutInfo.pSetLayouts = &mipSetLayout;
+	mipPipelineLayoutInfo.pushConstantRangeCount = 1;
+	mipPipelineLayoutInfo.pPushConstantRanges = &mipPushConstants;
+	vkCreatePipelineLayout(device, &mipPipelineLayoutInfo, nullptr, &mipPipelineLayout);
+
+	VkShaderModule mipShader = shaderLoadFunc((std::string)"../../assets/shaders/mipgen.comp.spv");
+	mipPipeline = PipelineBuild::BuildComputePipeline(device, mipPipelineLayout, mipShader);
+	vkDestroyShaderModule(device, mipShader, nullptr);
+}
+
+static uint32_t nextPowerOfTwo(uint32_t value)
+{
+	uint32_t power = 1;
+	while (power < value)
+	{
+		power *= 2;
+	}
+	return power;
+}
+
+void Renderer::initHizImages()
+{
+	ZoneScoped;
+	// the first level halves the depth image, padding to powers of two keeps every texel at exactly 2x2 of the level below
+	hizExtent = {
+		.width = nextPowerOfTwo((window.extent.width + 1) / 2),
+		.height = nextPowerOfTwo((window.extent.height + 1) / 2),
+	};
+	hizMipCount = 1;
+	while ((std::max(hizExtent.width, hizExtent.height) >> hizMipCount) > 0 && hizMipCount < MAX_HIZ_MIPS)
+	{
+		++hizMipCount;
+	}
+
+	VkImageCreateInfo imageInfo = VulkanInit::imageCreateInfo(HIZ_FORMAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+		VkExtent3D{ .width = hizExtent.width, .height = hizExtent.height, .depth = 1 });
+	imageInfo.mipLevels = hizMipCount;
+
+	for (RenderFrame& renderFrame : frame)
+	{
+		// the depth view is written again on the next frame, a recreated image may reuse the old handle
+		renderFrame.hizDepthView = VK_NULL_HANDLE;
+		renderFrame.hizImage = ResourceManager::ptr->CreateImage(ImageCreateInfo{
+			.imageInfo = imageInfo,
+			.imageType = ImageCreateInfo::ImageType::TEXTURE_2D,
+			.usage = ImageCreateInfo::Usage::COLOR
+			});
+		const Image hizImage = ResourceManager::ptr->GetImage(renderFrame.hizImage);
+
+		// levels past the top repeat it, every element of a statically used array has to be valid
+		VkDescriptorImageInfo mipInfos[MAX_HIZ_MIPS];
+		for (uint32_t mip = 0; mip < MAX_HIZ_MIPS; ++mip)
+		{
+			if (mip < hizMipCount)
+			{
+				VkImageViewCreateInfo viewInfo = VulkanInit::imageViewCreateInfo(HIZ_FORMAT, hizImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
+				viewInfo.subresourceRange.baseMipLevel = mip;
+				vkCreateImageView(device, &viewInfo, nullptr, &renderFrame.hizMipViews[mip]);
+			}
+			mipInfos[mip] = {
+				.imageView = renderFrame.hizMipViews[std::min(mip, hizMipCount - 1)],
+				.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+			};
+		}
+
+		const VkWriteDescriptorSet mipWrite = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = nullptr,
+			.dstSet = renderFrame.hizSet,
+			.dstBinding = 1,
+			.descriptorCount = MAX_HIZ_MIPS,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.pImageInfo = mipInfos,
+		};
+
+		VkDescriptorImageInfo hizInfo = {
+			.sampler = hizSampler,
+			.imageView = hizImage.imageView,
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		};
+		const VkWriteDescriptorSet hizWrites[] = {
+			mipWrite,
+			VulkanInit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, renderFrame.occlusionSet, &hizInfo, 2),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(std::size(hizWrites)), hizWrites, 0, nullptr);
+	}
+	LOG_CORE_INFO("Hi-Z {}x{}, {} levels", hizExtent.width, hizExtent.height, hizMipCount);
+}
+
+void Renderer::destroyHizImages()
+{
+	for (RenderFrame& renderFrame : frame)
+	{
+		for (uint32_t mip = 0; mip < hizMipCount; ++mip)
+		{
+			vkDestroyImageView(device, renderFrame.hizMipViews[mip], nullptr);
+			renderFrame.hizMipViews[mip] = VK_NULL_HANDLE;
+		}
+		ResourceManager::ptr->DestroyImage(renderFrame.hizImage);
+	}
+}
+
+void Renderer::initOcclusionBuffer()
+{
+	const uint32_t height = SOFTWARE_OCCLUSION_WIDTH * window.extent.height / std::max(window.extent.width, 1U);
+	occlusionBuffer.init(SOFTWARE_OCCLUSION_WIDTH, height);
+}
+
+void Renderer::deinit() 
+{
+	ZoneScoped;
+	stopRenderThread();
+
+	for (RenderFrame& renderFrame : frame)
+	{
+		renderFrame.graph.deinit();
+	}
+	timeline.flush();
+	computeTimeline.flush();
+	LOG_CORE_INFO("Object high-water mark: {} (initial capacity {})", objectHighWaterMark, INITIAL_OBJECT_CAPACITY);
+
+	instanceDeletionQueue.flush();
+
+	destroySwapchain();
+
+	stagingRing.deinit();
+	delete ResourceManager::ptr;
+
+	for (auto& materialType : materialTypes)
+	{
+		vkDestroyPipelineLayout(device, materialType.second.pipelineLayout, nullptr);
+		vkDestroyPipeline(device, materialType.second.pipeline, nullptr);
+		vkDestroyPipeline(device, materialType.second.depthEqualPipeline, nullptr);
+	}
+	// the layout is shared with the default material
+	vkDestroyPipeline(device, depthPrepassPipeline, nullptr);
+
+	vkDestroyPipeline(device, cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, cullPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+
+	vkDestroyPipeline(device, hizPipeline, nullptr);
+	vkDestroyPipelineLayout(device, hizPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, hizSetLayout, nullptr);
+	vkDestroyPipeline(device, occlusionPipeline, nullptr);
+	vkDestroyPipelineLayout(device, occlusionPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, occlusionSetLayout, nullptr);
+	vkDestroyDescriptorPool(device, occlusionPool, nullptr);
+
+	vkDestroyPipeline(device, mipPipeline, nullptr);
+	vkDestroyPipelineLayout(device, mipPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, mipSetLayout, nullptr);
+	vkDestroyDescriptorPool(device, mipPool, nullptr);
+
+	vkDestroyDescriptorPool(device, scenePool, nullptr);
+	vkDestroyDescriptorSetLayout(device, sceneSetLayout, nullptr);
+	vkDestroyDescriptorPool(device, globalPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, globalSetLayout, nullptr);
+	bindlessTable.deinit();
+
+	vkDestroyCommandPool(device, uploadContext.commandPool, nullptr);
+	timeline.deinit();
+	computeTimeline.deinit();
+
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
+	{
+		vkDestroySemaphore(device, frame[i].presentSem, nullptr);
+		vkDestroyQueryPool(device, frame[i].timestampPool, nullptr);
+		if (pipelineStatisticsSupported)
+		{
+			vkDestroyQueryPool(device, frame[i].statisticsPool, nullptr);
+		}
+	}
+
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
+	{
+		vkDestroyCommandPool(device, graphics.commands[i].pool, nullptr);
+		vkDestroyCommandPool(device, compute.commands[i].pool, nullptr);
+		for (int phase = 0; phase < static_cast<int>(RenderTypes::DRAW_PHASE_COUNT); ++phase)
+		{
+			for (int job = 0; job < static_cast<int>(MAX_RECORD_THREADS); ++job)
+			{
+				vkDestroyCommandPool(device, frame[i].recordCommands[phase][job].pool, nullptr);
+				vkDestroyCommandPool(device, frame[i].prepassCommands[phase][job].pool, nullptr);
+			}
+		}
+	}
+
+	vmaDestroyAllocator(allocator);
+	vkDestroySurfaceKHR(instance, surface, nullptr);
+	vkb::destroy_debug_utils_messenger(instance, debugMessenger);
+	vkDestroyDevice(device, nullptr);
+	vkDestroyInstance(instance, nullptr);
+
+	SDL_DestroyWindow(window.window);
+}
+
+// Where an asset's bytes came from, decoded data and the file it was read from never share a key
+enum class AssetSource : uint32_t
+{
+	MEMORY,
+	FILE,
+};
+
+// Key of a file as it is on disk, so a hit skips parsing as well. 0 if it can't be read.
+static uint64_t hashFile(const char* path, const uint32_t* settings, size_t settingCount)
+{
+	MappedFile file;
+	if (!file.open(path))
+	{
+		return 0;
+	}
+	return Hash::Hash64(file.data(), file.size(), Hash::Hash64(settings, settingCount * sizeof(uint32_t)));
+}
+
+static uint64_t hashMesh(const RenderableTypes::MeshDesc& mesh)
+{
+	const uint32_t settings[] = { static_cast<uint32_t>(AssetSource::MEMORY), static_cast<uint32_t>(mesh.vertices.size()), static_cast<uint32_t>(mesh.indices.size()) };
+	const uint64_t vertexHash = Hash::Hash64(mesh.vertices.data(), mesh.vertices.size() * sizeof(RenderableTypes::Vertex), Hash::Hash64(settings, sizeof(settings)));
+	return Hash::Hash64(mesh.indices.data(), mesh.indices.size() * sizeof(RenderableTypes::MeshDesc::Index), vertexHash);
+}
+
+static uint64_t hashTexture(const RenderableTypes::Texture& texture)
+{
+	const uint32_t settings[] = { static_cast<uint32_t>(AssetSource::MEMORY), static_cast<uint32_t>(texture.desc.format), static_cast<uint32_t>(texture.blockFormat),
+		static_cast<uint32_t>(texture.texWidth), static_cast<uint32_t>(texture.texHeight), static_cast<uint32_t>(texture.texChannels) };
+	uint64_t hash = Hash::Hash64(settings, sizeof(settings));
+	if (texture.levels.empty())
+	{
+		return Hash::Hash64(texture.ptr, static_cast<size_t>(texture.texWidth) * texture.texHeight * texture.texChannels, hash);
+	}
+	for (const std::span<const uint8_t>& level : texture.levels)
+	{
+		hash = Hash::Hash64(level.data(), level.size(), hash);
+	}
+	return hash;
+}
+
+RenderableTypes::MeshHandle Renderer::uploadMesh(const RenderableTypes::MeshDesc& mesh)
+{
+	ZoneScoped;
+	const uint64_t key = hashMesh(mesh);
+	if (const RenderableTypes::MeshHandle cached = meshCache.acquire(key))
+	{
+		return cached;
+	}
+
+	RenderMesh renderMesh{
+		.vertexCount = static_cast<uint32_t>(mesh.vertices.size()),
+		.indexCount = static_cast<uint32_t>(mesh.indices.size()),
+	};
+	RenderableTypes::MeshDesc::CalculateBounds(mesh.vertices.empty() ? nullptr : &mesh.vertices[0].position, mesh.vertices.size(),
+		sizeof(RenderableTypes::Vertex), renderMesh.bounds, renderMesh.boundingSphere);
+	renderMesh.uvDensity = RenderableTypes::MeshDesc::CalculateUvDensity(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size());
+
+	const StagingRing::Allocation vertices = stagingRing.allocate(mesh.vertices.size() * sizeof(RenderableTypes::Vertex), alignof(RenderableTypes::Vertex));
+	// a second, position only stream keeps the depth pre-pass fetch small
+	const StagingRing::Allocation positions = stagingRing.allocate(mesh.vertices.size() * sizeof(glm::vec3), alignof(glm::vec3));
+	const StagingRing::Allocation indices = stagingRing.allocate(mesh.indices.size() * sizeof(RenderableTypes::MeshDesc::Index), alignof(RenderableTypes::MeshDesc::Index));
+
+	memcpy(vertices.ptr, mesh.vertices.data(), vertices.size);
+	glm::vec3* positionStream = reinterpret_cast<glm::vec3*>(positions.ptr);
+	for (size_t i = 0; i < mesh.vertices.size(); ++i)
+	{
+		positionStream[i] = mesh.vertices[i].position;
+	}
+	memcpy(indices.ptr, mesh.indices.data(), indices.size);
+
+	const RenderableTypes::MeshHandle handle = finishMeshUpload(renderMesh, vertices, positions, indices);
+	meshCache.insert(key, handle);
+	return handle;
 }
 
-void Renderer::deinit() 
+RenderableTypes::MeshHandle Renderer::loadMesh(const char* file)
 {
 	ZoneScoped;
+	const uint32_t settings[] = { static_cast<uint32_t>(AssetSource::FILE) };
+	const uint64_t key = hashFile(file, settings, std::size(settings));
+	if (const RenderableTypes::MeshHandle cached = key != 0 ? meshCache.acquire(key) : 0)
+	{
+		return cached;
+	}
 
-	for (int i = 0; i < FRAME_OVERLAP; ++i)
+	RenderMesh renderMesh{ .indexCount = 0 };
+	StagingRing::Allocation vertices;
+	StagingRing::Allocation positions;
+	const bool loaded = RenderableTypes::MeshDesc::LoadObj(file, [this, &renderMesh, &vertices, &positions](size_t vertexCount) {
+		renderMesh.vertexCount = static_cast<uint32_t>(vertexCount);
+		vertices = stagingRing.allocate(vertexCount * sizeof(RenderableTypes::Vertex), alignof(RenderableTypes::Vertex));
+		positions = stagingRing.allocate(vertexCount * sizeof(glm::vec3), alignof(glm::vec3));
+		return RenderableTypes::MeshStreams{
+			.vertices = reinterpret_cast<RenderableTypes::Vertex*>(vertices.ptr),
+			.positions = reinterpret_cast<glm::vec3*>(positions.ptr),
+		};
+		}, renderMesh.bounds, renderMesh.boundingSphere, renderMesh.uvDensity);
+	if (!loaded)
 	{
-		vkWaitForFences(device, 1, &frame[i].renderFen, true, 1000000000);
+		LOG_CORE_WARN("Failed to load mesh file: {}", file);
+		return RenderableTypes::MeshHandle(0);
 	}
 
-	instanceDeletionQueue.flush();
+	const RenderableTypes::MeshHandle handle = finishMeshUpload(renderMesh, vertices, positions, StagingRing::Allocation{});
+	meshCache.insert(key, handle);
+	return handle;
+}
 
-	destroySwapchain();
+void Renderer::releaseMesh(RenderableTypes::MeshHandle handle)
+{
+	if (handle == 0 || !meshCache.release(handle))
+	{
+		return;
+	}
+	// the handle is only handed out again with the buffers, so draws still in flight never pick up another mesh
+	const RenderMesh mesh = meshes.get(handle);
+	timeline.deferDeletion([this, handle, mesh]() {
+		ResourceManager::ptr->DestroyBuffer(mesh.vertexBuffer);
+		ResourceManager::ptr->DestroyBuffer(mesh.positionBuffer);
+		ResourceManager::ptr->DestroyBuffer(mesh.indexBuffer);
+		meshes.remove(handle);
+		});
+}
 
-	delete ResourceManager::ptr;
+RenderableTypes::MeshHandle Renderer::finishMeshUpload(RenderMesh& renderMesh, const StagingRing::Allocation& vertices,
+	const StagingRing::Allocation& positions, const StagingRing::Allocation& indices)
+{
+	immediateSubmit([&](VkCommandBuffer cmd) {
+		renderMesh.vertexBuffer = copyToDeviceBuffer(cmd, vertices, GFX::Buffer::Usage::VERTEX);
+		renderMesh.positionBuffer = copyToDeviceBuffer(cmd, positions, GFX::Buffer::Usage::VERTEX);
+		if (renderMesh.indexCount > 0)
+		{
+			renderMesh.indexBuffer = copyToDeviceBuffer(cmd, indices, GFX::Buffer::Usage::INDEX);
+		}
+		});
+
+	LOG_CORE_INFO("Mesh Uploaded");
+	return meshes.add(renderMesh);
+}
 
-	for (auto& material : materials)
+RenderableTypes::OccluderHandle Renderer::createOccluder(const RenderableTypes::MeshDesc& mesh)
+{
+	ZoneScoped;
+	OccluderMesh occluderMesh;
+	occluderMesh.positions.reserve(mesh.vertices.size());
+	for (const RenderableTypes::Vertex& vertex : mesh.vertices)
 	{
-		vkDestroyPipelineLayout(device, material.second.pipelineLayout, nullptr);
-		vkDestroyPipeline(device, material.second.pipeline, nullptr);
+		occluderMesh.positions.push_back(vertex.position);
 	}
 
-	vkDestroyDescriptorPool(device, scenePool, nullptr);
-	vkDestroyDescriptorSetLayout(device, sceneSetLayout, nullptr);
-	vkDestroyDescriptorPool(device, globalPool, nullptr);
-	vkDestroyDescriptorSetLayout(device, globalSetLayout, nullptr);
+	if (mesh.hasIndices())
+	{
+		occluderMesh.indices = mesh.indices;
+	}
+	else
+	{
+		occluderMesh.indices.resize(mesh.vertices.size());
+		for (size_t i = 0; i < occluderMesh.indices.size(); ++i)
+		{
+			occluderMesh.indices[i] = static_cast<uint32_t>(i);
+		}
+	}
 
-	vkDestroyFence(device, uploadContext.uploadFence, nullptr);
-	vkDestroyCommandPool(device, uploadContext.commandPool, nullptr);
+	occluderMeshes.push_back(std::move(occluderMesh));
+	return static_cast<RenderableTypes::OccluderHandle>(occluderMeshes.size() - 1);
+}
 
-	for (int i = 0; i < FRAME_OVERLAP; ++i)
+BufferHandle Renderer::copyToDeviceBuffer(VkCommandBuffer cmd, const StagingRing::Allocation& staging, GFX::Buffer::Usage usage)
+{
+	const BufferHandle buffer = ResourceManager::ptr->CreateBuffer(BufferCreateInfo{
+		.size = staging.size,
+		.usage = usage,
+		.transfer = BufferCreateInfo::Transfer::DST,
+		});
+
+	const VkBufferCopy copy{
+		.srcOffset = staging.offset,
+		.dstOffset = 0,
+		.size = staging.size,
+	};
+	vkCmdCopyBuffer(cmd, staging.buffer, ResourceManager::ptr->GetBuffer(buffer).buffer, 1, &copy);
+	return buffer;
+}
+
+RenderableTypes::TextureHandle Renderer::uploadTexture(const RenderableTypes::Texture& texture)
+{
+	if (texture.ptr == nullptr && texture.levels.empty())
 	{
-		vkDestroySemaphore(device, frame[i].presentSem, nullptr);
-		vkDestroySemaphore(device, frame[i].renderSem, nullptr);
-		vkDestroyFence(device, frame[i].renderFen, nullptr);
+		return RenderableTypes::TextureHandle(0);
 	}
+	const uint64_t key = hashTexture(texture);
+	if (const RenderableTypes::TextureHandle cached = textureCache.acquire(key))
+	{
+		return cached;
+	}
+	const ImageHandle image = uploadTextureInternal(texture);
+	RenderableTypes::TextureHandle bindlessHandle = bindlessTextures.add(BindlessTexture{
+		.image = image,
+		.slot = bindlessTable.add(ResourceManager::ptr->GetImage(image).imageView),
+		});
+	textureCache.insert(key, bindlessHandle);
 
-	vkDestroyCommandPool(device, graphics.commands[0].pool, nullptr);
-	vkDestroyCommandPool(device, graphics.commands[1].pool, nullptr);
-	vkDestroyCommandPool(device, compute.commands[0].pool, nullptr);
-
-	vmaDestroyAllocator(allocator);
-	vkDestroySurfaceKHR(instance, surface, nullptr);
-	vkb::destroy_debug_utils_messenger(instance, debugMessenger);
-	vkDestroyDevice(device, nullptr);
-	vkDestroyInstance(instance, nullptr);
+	LOG_CORE_INFO("Texture Uploaded: ");
 
-	SDL_DestroyWindow(window.window);
+	return bindlessHandle;
 }
 
-RenderableTypes::MeshHandle Renderer::uploadMesh(const RenderableTypes::MeshDesc& mesh)
+std::vector<RenderableTypes::TextureHandle> Renderer::loadTextures(std::span<const RenderableTypes::TextureLoadRequest> requests)
 {
 	ZoneScoped;
-	RenderMesh renderMesh {.meshDesc = mesh};
+	const uint32_t requestCount = static_cast<uint32_t>(requests.size());
+	std::vector<uint64_t> keys(requestCount);
+	const auto hashFiles = [&requests, &keys](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			// the same file loads as a different texture with another format, or block compressed
+			const uint32_t settings[] = { static_cast<uint32_t>(AssetSource::FILE), static_cast<uint32_t>(requests[i].desc.format),
+				static_cast<uint32_t>(requests[i].desc.compress) };
+			keys[i] = hashFile(requests[i].path.c_str(), settings, std::size(settings));
+		}
+	};
+	if (Jobs::JobSystem::ptr != nullptr)
+	{
+		Jobs::JobSystem::ptr->parallelFor(requestCount, 1, hashFiles);
+	}
+	else
 	{
-		const size_t bufferSize = mesh.vertices.size() * sizeof(RenderableTypes::Vertex);
+		hashFiles(0, requestCount);
+	}
 
-		BufferHandle stagingBuffer = ResourceManager::ptr->CreateBuffer(BufferCreateInfo{
-			.size = bufferSize,
-			.usage = GFX::Buffer::Usage::NONE,
-			.transfer = BufferCreateInfo::Transfer::SRC,
-			});
+	// only the first request for content that isn't cached yet is decoded, the repeats share its handle
+	constexpr uint32_t CACHED = std::numeric_limits<uint32_t>::max();
+	std::vector<RenderableTypes::TextureHandle> handles(requestCount, RenderableTypes::TextureHandle(0));
+	std::vector<uint32_t> sources(requestCount);
+	std::unordered_map<uint64_t, uint32_t> batchSources;
+	std::vector<RenderableTypes::TextureLoadRequest> loadRequests;
+	std::vector<uint32_t> loadIndices;
+	for (uint32_t i = 0; i < requestCount; ++i)
+	{
+		if (keys[i] != 0)
+		{
+			handles[i] = textureCache.acquire(keys[i]);
+			if (handles[i] != 0)
+			{
+				sources[i] = CACHED;
+				continue;
+			}
+			const auto [source, inserted] = batchSources.try_emplace(keys[i], i);
+			if (!inserted)
+			{
+				sources[i] = source->second;
+				continue;
+			}
+		}
+		sources[i] = i;
+		handles[i] = bindlessTextures.add(BindlessTexture{});
+		loadRequests.push_back(requests[i]);
+		loadIndices.push_back(i);
+	}
 
-		memcpy(ResourceManager::ptr->GetBuffer(stagingBuffer).ptr, mesh.vertices.data(), bufferSize);
+	// uploads go one at a time on this thread in whatever order the decodes finish
+	RenderableTypes::TextureUtil::LoadTextures(loadRequests, [this, &handles, &loadIndices](uint32_t loadIndex, RenderableTypes::Texture& texture) {
+		const uint32_t index = loadIndices[loadIndex];
+		if (texture.ptr == nullptr && texture.levels.empty())
+		{
+			bindlessTextures.remove(handles[index]);
+			handles[index] = RenderableTypes::TextureHandle(0);
+			return;
+		}
+		// the whole chain stays on the CPU, only the levels up to the streaming tail go up now
+		RenderableTypes::TextureUtil::BuildMipChain(texture);
+		const uint32_t baseMip = textureStreamer.add(handles[index], std::make_unique<RenderableTypes::Texture>(std::move(texture)));
+		RenderableTypes::Texture levels;
+		textureStreamer.getLevels(handles[index], baseMip, levels);
+		BindlessTexture& bindlessTexture = bindlessTextures.get(handles[index]);
+		bindlessTexture.image = uploadTextureInternal(levels);
+		bindlessTexture.slot = bindlessTable.add(ResourceManager::ptr->GetImage(bindlessTexture.image).imageView);
+		});
 
-		renderMesh.vertexBuffer = ResourceManager::ptr->CreateBuffer(BufferCreateInfo{
-			.size = bufferSize,
-			.usage = GFX::Buffer::Usage::VERTEX,
-			.transfer = BufferCreateInfo::Transfer::DST,
-			});
+	// a repeat comes after its source, which is cached by then unless it failed
+	for (uint32_t i = 0; i < requestCount; ++i)
+	{
+		if (sources[i] == i && keys[i] != 0 && handles[i] != 0)
+		{
+			textureCache.insert(keys[i], handles[i]);
+		}
+		else if (sources[i] != i && sources[i] != CACHED)
+		{
+			handles[i] = textureCache.acquire(keys[i]);
+		}
+	}
 
-		const Buffer src = ResourceManager::ptr->GetBuffer(stagingBuffer);
-		const Buffer dst = ResourceManager::ptr->GetBuffer(renderMesh.vertexBuffer);
+	LOG_CORE_INFO("Textures Uploaded: {}, {} shared", loadRequests.size(), requestCount - loadRequests.size());
 
-		immediateSubmit([=](VkCommandBuffer cmd) {
-			VkBufferCopy copy;
-			copy.dstOffset = 0;
-			copy.srcOffset = 0;
-			copy.size = bufferSize;
-			vkCmdCopyBuffer(cmd, src.buffer, dst.buffer, 1, &copy);
-			});
+	return handles;
+}
 
-		ResourceManager::ptr->DestroyBuffer(stagingBuffer);
-	}
+static std::size_t hashMaterial(const MaterialInstance& material)
+{
+	const std::string_view bytes{ reinterpret_cast<const char*>(&material.materialData), sizeof(GPUShaderData::Material) };
+	return std::hash<std::string_view>{}(bytes) ^ std::hash<const MaterialType*>{}(material.matType);
+}
 
-	if (mesh.hasIndices())
+void Renderer::releaseTexture(RenderableTypes::TextureHandle handle)
+{
+	if (handle == 0 || !textureCache.release(handle))
+	{
+		return;
+	}
+	// materials hold the handle rather than the slot, once it is reused they would sample the next texture loaded
+	for (RenderableTypes::MaterialHandle material = 0; material < materials.size(); ++material)
 	{
-		const size_t bufferSize = mesh.indices.size() * sizeof(RenderableTypes::MeshDesc::Index);
+		MaterialInstance& instance = materials[material];
+		const glm::ivec4 textureIndices = instance.materialData.textureIndices;
+		if (textureIndices[0] != static_cast<int>(handle) && textureIndices[1] != static_cast<int>(handle) && textureIndices[2] != static_cast<int>(handle))
+		{
+			continue;
+		}
+		const auto oldEntry = materialLookup.find(hashMaterial(instance));
+		if (oldEntry != materialLookup.end() && oldEntry->second == material)
+		{
+			materialLookup.erase(oldEntry);
+		}
+		for (int texture = 0; texture < 3; ++texture)
+		{
+			if (textureIndices[texture] == static_cast<int>(handle))
+			{
+				instance.materialData.textureIndices[texture] = -1;
+			}
+		}
+		materialLookup.try_emplace(hashMaterial(instance), material);
+		for (RenderFrame& renderFrame : frame)
+		{
+			renderFrame.dirtyMaterials.push_back(material);
+		}
+	}
 
-		BufferHandle stagingBuffer = ResourceManager::ptr->CreateBuffer(BufferCreateInfo{
-			.size = bufferSize,
-			.usage = GFX::Buffer::Usage::INDEX,
-			.transfer = BufferCreateInfo::Transfer::SRC,
-			});
+	// the slot and the handle are only handed out again once nothing submitted so far can sample them
+	const BindlessTexture texture = bindlessTextures.get(handle);
+	timeline.deferDeletion([this, handle, texture]() {
+		ResourceManager::ptr->DestroyImage(texture.image);
+		bindlessTable.remove(texture.slot);
+		bindlessTextures.remove(handle);
+		});
+	textureStreamer.remove(handle);
+}
 
-		memcpy(ResourceManager::ptr->GetBuffer(stagingBuffer).ptr, mesh.indices.data(), bufferSize);
+static GPUShaderData::Material toShaderMaterial(const RenderableTypes::MaterialDesc& materialDesc)
+{
+	return GPUShaderData::Material{
+		.diffuse = materialDesc.diffuse,
+		.specular = materialDesc.specular,
+		.shininess = materialDesc.shininess,
+		.textureIndices = {
+			materialDesc.diffuseTexture.has_value() ? static_cast<int>(materialDesc.diffuseTexture.value()) : -1,
+			materialDesc.normalTexture.has_value() ? static_cast<int>(materialDesc.normalTexture.value()) : -1,
+			materialDesc.ormTexture.has_value() ? static_cast<int>(materialDesc.ormTexture.value()) : -1,
+			0},
+	};
+}
 
-		renderMesh.indexBuffer = ResourceManager::ptr->CreateBuffer(BufferCreateInfo{
-			.size = bufferSize,
-			.usage = GFX::Buffer::Usage::INDEX,
-			.transfer = BufferCreateInfo::Transfer::DST,
-			});
+static bool isSameMaterial(const MaterialInstance& a, const MaterialInstance& b)
+{
+	return a.matType == b.matType && memcmp(&a.materialData, &b.materialData, sizeof(GPUShaderData::Material)) == 0;
+}
+
+RenderableTypes::MaterialHandle Renderer::createMaterial(const RenderableTypes::MaterialDesc& materialDesc)
+{
+	ZoneScoped;
+	const MaterialInstance newMaterial{
+		.matType = &materialTypes["defaultMaterial"],
+		.materialData = toShaderMaterial(materialDesc),
+	};
 
-		const Buffer src = ResourceManager::ptr->GetBuffer(stagingBuffer);
-		const Buffer dst = ResourceManager::ptr->GetBuffer(renderMesh.indexBuffer);
+	// identical materials share one handle and one GPU table entry
+	const std::size_t materialHash = hashMaterial(newMaterial);
+	const auto existing = materialLookup.find(materialHash);
+	if (existing != materialLookup.end() && isSameMaterial(materials[existing->second], newMaterial))
+	{
+		return existing->second;
+	}
 
-		immediateSubmit([=](VkCommandBuffer cmd) {
-			VkBufferCopy copy;
-			copy.dstOffset = 0;
-			copy.srcOffset = 0;
-			copy.size = bufferSize;
-			vkCmdCopyBuffer(cmd, src.buffer, dst.buffer, 1, &copy);
-			});
+	const RenderableTypes::MaterialHandle handle = static_cast<RenderableTypes::MaterialHandle>(materials.size());
+	materials.push_back(newMaterial);
+	materialLookup.try_emplace(materialHash, handle);
 
-		ResourceManager::ptr->DestroyBuffer(stagingBuffer);
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
+	{
+		frame[i].dirtyMaterials.push_back(handle);
 	}
 
-	LOG_CORE_INFO("Mesh Uploaded");
-	return meshes.add(renderMesh);
+	LOG_CORE_INFO("Material instance created");
+	return handle;
 }
 
-RenderableTypes::TextureHandle Renderer::uploadTexture(const RenderableTypes::Texture& texture)
+void Renderer::updateMaterial(RenderableTypes::MaterialHandle handle, const RenderableTypes::MaterialDesc& materialDesc)
 {
-	if (texture.ptr == nullptr)
+	ZoneScoped;
+	assert(handle < materials.size());
+	MaterialInstance& material = materials[handle];
+
+	const auto oldEntry = materialLookup.find(hashMaterial(material));
+	if (oldEntry != materialLookup.end() && oldEntry->second == handle)
 	{
-		return RenderableTypes::TextureHandle(0);
+		materialLookup.erase(oldEntry);
 	}
-	ImageHandle newTextureHandle = uploadTextureInternal(texture);
-	RenderableTypes::TextureHandle bindlessHandle = bindlessImages.add(newTextureHandle);
 
-	VkDescriptorImageInfo bindlessImageInfo = {
-		.imageView = ResourceManager::ptr->GetImage(bindlessImages.get(bindlessHandle)).imageView,
-		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-	};
+	material.materialData = toShaderMaterial(materialDesc);
+	materialLookup.try_emplace(hashMaterial(material), handle);
 
-	for (int i = 0; i < FRAME_OVERLAP; ++i)
+	for (int i = 0; i < static_cast<int>(frame.size()); ++i)
 	{
-		VkWriteDescriptorSet write{
-			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.dstSet = frame[i].globalSet,
-			.dstBinding = 4,
-			.dstArrayElement = bindlessHandle,
-			.descriptorCount = static_cast<uint32_t>(1),
-			.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-			.pImageInfo = &bindlessImageInfo,
-		};
-
-		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+		frame[i].dirtyMaterials.push_back(handle);
 	}
+}
 
-	LOG_CORE_INFO("Texture Uploaded: ");
-
-	return bindlessHandle;
+static VkFormat getTextureVkFormat(RenderableTypes::BlockFormat format, uint32_t channels, bool srgb)
+{
+	switch (format)
+	{
+	case RenderableTypes::BlockFormat::BC1:
+		return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case RenderableTypes::BlockFormat::BC4:
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+	case RenderableTypes::BlockFormat::BC5:
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	case RenderableTypes::BlockFormat::BC7:
+		return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	default:
+		break;
+	}
+	switch (channels)
+	{
+	case 1:
+		return VK_FORMAT_R8_UNORM;
+	case 2:
+		return VK_FORMAT_R8G8_UNORM;
+	default:
+		return srgb ? DEFAULT_FORMAT : NORMAL_FORMAT;
+	}
 }
 
 ImageHandle Renderer::uploadTextureInternal(const RenderableTypes::Texture& image)
 {
-	const VkDeviceSize imageSize = { static_cast<VkDeviceSize>(image.texWidth * image.texHeight * 4) };
-	const VkFormat image_format = {image.desc.format == RenderableTypes::TextureDesc::Format::DEFAULT ? DEFAULT_FORMAT : NORMAL_FORMAT };
-
-	BufferHandle stagingBuffer = ResourceManager::ptr->CreateBuffer(BufferCreateInfo{
-			.size = imageSize,
-			.usage = GFX::Buffer::Usage::NONE,
-			.transfer = BufferCreateInfo::Transfer::SRC,
+	ZoneScoped;
+	ImageHandle newImage;
+	std::vector<VkImageView> mipViews;
+	immediateSubmit([&](VkCommandBuffer cmd) {
+		newImage = recordTextureUpload(cmd, image, mipViews);
 		});
 
-	//copy data to buffer
+	for (const VkImageView view : mipViews)
+	{
+		vkDestroyImageView(device, view, nullptr);
+	}
+	if (!mipViews.empty())
+	{
+		vkResetDescriptorPool(device, mipPool, 0);
+	}
+
+	return newImage;
+}
 
-	memcpy(ResourceManager::ptr->GetBuffer(stagingBuffer).ptr, image.ptr, static_cast<size_t>(imageSize));
+ImageHandle Renderer::recordTextureUpload(VkCommandBuffer cmd, const RenderableTypes::Texture& image, std::vector<VkImageView>& mipViews)
+{
+	ZoneScoped;
+	const uint32_t channels = static_cast<uint32_t>(image.texChannels);
+	const VkDeviceSize imageSize = { static_cast<VkDeviceSize>(image.texWidth * image.texHeight) * channels };
+	const bool normalMap = image.desc.format == RenderableTypes::TextureDesc::Format::NORMAL;
+	const bool preMipped = !image.levels.empty();
+	// only colour is sRGB, normals, single channels and packed ORM are linear data
+	const bool srgb = image.desc.format == RenderableTypes::TextureDesc::Format::DEFAULT;
+	const VkFormat image_format = getTextureVkFormat(image.blockFormat, channels, srgb);
 
 	const VkExtent3D imageExtent{
 		.width = static_cast<uint32_t>(image.texWidth),
 		.height = static_cast<uint32_t>(image.texHeight),
 		.depth = 1,
 	};
+	const uint32_t mipCount = preMipped ? static_cast<uint32_t>(image.levels.size()) : RenderableTypes::TextureUtil::GetMipCount(imageExtent.width, imageExtent.height);
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(chosenGPU, image_format, &formatProperties);
+	const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	const bool canBlit = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+
+	// normal maps are filtered on the CPU so every level is renormalised, compressed and KTX2 textures arrive
+	// with their whole chain, the rest are filtered on the GPU. The compute fallback only writes RGBA8, narrower
+	// formats that can't be blitted are filtered on the CPU too.
+	std::vector<uint8_t> cpuMipLevels;
+	if (!preMipped && normalMap)
+	{
+		RenderableTypes::TextureUtil::GenerateNormalMips(static_cast<const uint8_t*>(image.ptr), imageExtent.width, imageExtent.height, cpuMipLevels);
+	}
+	else if (!preMipped && channels < 4 && !canBlit)
+	{
+		RenderableTypes::TextureUtil::GenerateMips(static_cast<const uint8_t*>(image.ptr), imageExtent.width, imageExtent.height, channels, false, cpuMipLevels);
+	}
+	const bool cpuMips = preMipped || !cpuMipLevels.empty() || mipCount == 1;
+	const bool blitMips = !cpuMips && canBlit;
 
-	const VkImageCreateInfo dimg_info = VulkanInit::imageCreateInfo(image_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent);
-
-	ImageHandle newImage = ResourceManager::ptr->CreateImage(ImageCreateInfo{ .imageInfo = dimg_info, .imageType = ImageCreateInfo::ImageType::TEXTURE_2D });
+	VkDeviceSize stagingSize = imageSize + cpuMipLevels.size();
+	if (preMipped)
+	{
+		stagingSize = 0;
+		for (const std::span<const uint8_t>& level : image.levels)
+		{
+			stagingSize += level.size();
+		}
+	}
+	// block aligned for every format, copy offsets must be multiples of the block size
+	const StagingRing::Allocation staging = stagingRing.allocate(stagingSize, 16);
+	uint8_t* stagingData = staging.ptr;
+	if (preMipped)
+	{
+		// straight from the mapped file for KTX2, the level sizes are multiples of the block size so every level stays aligned
+		for (const std::span<const uint8_t>& level : image.levels)
+		{
+			memcpy(stagingData, level.data(), level.size());
+			stagingData += level.size();
+		}
+	}
+	else
+	{
+		memcpy(stagingData, image.ptr, static_cast<size_t>(imageSize));
+		if (!cpuMipLevels.empty())
+		{
+			memcpy(stagingData + imageSize, cpuMipLevels.data(), cpuMipLevels.size());
+		}
+	}
 
-	immediateSubmit([&](VkCommandBuffer cmd) {
-		const VkImageSubresourceRange range{
-			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-			.baseMipLevel = 0,
-			.levelCount = 1,
-			.baseArrayLayer = 0,
-			.layerCount = 1,
-		};
+	VkImageCreateInfo dimg_info = VulkanInit::imageCreateInfo(image_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent);
+	dimg_info.mipLevels = mipCount;
+	if (blitMips)
+	{
+		dimg_info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+	else if (!cpuMips)
+	{
+		// the compute fallback writes through UNORM storage views, sRGB formats can't be storage images themselves
+		dimg_info.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		dimg_info.flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+	}
 
-		const VkImageMemoryBarrier imageBarrier_toTransfer = {
-			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-			.srcAccessMask = 0,
-			.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			.image = ResourceManager::ptr->GetImage(newImage).image,
-			.subresourceRange = range,
-		};
+	// the sampled view keeps the sRGB format, so it must not inherit the storage usage
+	ImageHandle newImage = ResourceManager::ptr->CreateImage(ImageCreateInfo{
+		.imageInfo = dimg_info,
+		.imageType = ImageCreateInfo::ImageType::TEXTURE_2D,
+		.viewUsage = (dimg_info.usage & VK_IMAGE_USAGE_STORAGE_BIT) != 0 ? VkImageUsageFlags{ VK_IMAGE_USAGE_SAMPLED_BIT } : 0U,
+		});
+	const VkImage vkImage = ResourceManager::ptr->GetImage(newImage).image;
 
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toTransfer);
+	imageBarrier(cmd, imageMemoryBarrier(vkImage, 0, mipCount,
+		VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
 
-		const VkBufferImageCopy copyRegion = {
-			.bufferOffset = 0,
+	// the GPU fills in every level the CPU didn't
+	const uint32_t uploadedMips = cpuMips ? mipCount : 1;
+	std::vector<VkBufferImageCopy> copyRegions;
+	VkDeviceSize bufferOffset = staging.offset;
+	for (uint32_t mip = 0; mip < uploadedMips; ++mip)
+	{
+		const uint32_t mipWidth = std::max(imageExtent.width >> mip, 1u);
+		const uint32_t mipHeight = std::max(imageExtent.height >> mip, 1u);
+		copyRegions.push_back({
+			.bufferOffset = bufferOffset,
 			.bufferRowLength = 0,
 			.bufferImageHeight = 0,
 			.imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel = 0,
+				.mipLevel = mip,
 				.baseArrayLayer = 0,
 				.layerCount = 1},
-			.imageExtent = imageExtent,
+			.imageExtent = { mipWidth, mipHeight, 1 },
+			});
+		bufferOffset += TextureCompression::GetLevelSize(image.blockFormat, mipWidth, mipHeight, channels);
+	}
+
+	vkCmdCopyBufferToImage(cmd, staging.buffer, vkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+	if (cpuMips)
+	{
+		imageBarrier(cmd, imageMemoryBarrier(vkImage, 0, mipCount,
+			VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+	}
+	else if (blitMips)
+	{
+		generateMipsBlit(cmd, vkImage, imageExtent, mipCount);
+	}
+	else
+	{
+		generateMipsCompute(cmd, vkImage, image_format, imageExtent, mipCount, mipViews);
+	}
+
+	return newImage;
+}
+
+void Renderer::generateMipsBlit(VkCommandBuffer cmd, VkImage image, VkExtent3D extent, uint32_t mipCount)
+{
+	// every level is filtered from the one below, which is done as soon as it has been read
+	for (uint32_t mip = 1; mip < mipCount; ++mip)
+	{
+		imageBarrier(cmd, imageMemoryBarrier(image, mip - 1, 1,
+			VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL));
+
+		const int32_t sourceWidth = static_cast<int32_t>(std::max(extent.width >> (mip - 1), 1u));
+		const int32_t sourceHeight = static_cast<int32_t>(std::max(extent.height >> (mip - 1), 1u));
+		const VkImageBlit blit{
+			.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - 1, 0, 1 },
+			.srcOffsets = { { 0, 0, 0 }, { sourceWidth, sourceHeight, 1 } },
+			.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 },
+			.dstOffsets = { { 0, 0, 0 }, { std::max(sourceWidth / 2, 1), std::max(sourceHeight / 2, 1), 1 } },
 		};
+		vkCmdBlitImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
 
-		vkCmdCopyBufferToImage(cmd, ResourceManager::ptr->GetBuffer(stagingBuffer).buffer, ResourceManager::ptr->GetImage(newImage).image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		imageBarrier(cmd, imageMemoryBarrier(image, mip - 1, 1,
+			VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+	}
 
-		VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
+	imageBarrier(cmd, imageMemoryBarrier(image, mipCount - 1, 1,
+		VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+}
 
-		imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+void Renderer::generateMipsCompute(VkCommandBuffer cmd, VkImage image, VkFormat format, VkExtent3D extent, uint32_t mipCount, std::vector<VkImageView>& outViews)
+{
+	imageBarrier(cmd, imageMemoryBarrier(image, 0, mipCount,
+		VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL));
 
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
-		});
+	for (uint32_t mip = 0; mip < mipCount; ++mip)
+	{
+		VkImageViewCreateInfo viewInfo = VulkanInit::imageViewCreateInfo(VK_FORMAT_R8G8B8A8_UNORM, image, VK_IMAGE_ASPECT_COLOR_BIT);
+		viewInfo.subresourceRange.baseMipLevel = mip;
+		vkCreateImageView(device, &viewInfo, nullptr, &outViews.emplace_back());
+	}
 
-	ResourceManager::ptr->DestroyBuffer(stagingBuffer);
+	const GPUShaderData::MipPushConstants constants{
+		.srgb = format == VK_FORMAT_R8G8B8A8_SRGB ? 1u : 0u,
+	};
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mipPipeline);
+	vkCmdPushConstants(cmd, mipPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUShaderData::MipPushConstants), &constants);
 
-	return newImage;
+	const VkDescriptorSetAllocateInfo allocInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.descriptorPool = mipPool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &mipSetLayout,
+	};
+	for (uint32_t mip = 1; mip < mipCount; ++mip)
+	{
+		VkDescriptorSet mipSet;
+		vkAllocateDescriptorSets(device, &allocInfo, &mipSet);
+		VkDescriptorImageInfo sourceInfo{ .imageView = outViews[mip - 1], .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+		VkDescriptorImageInfo destinationInfo{ .imageView = outViews[mip], .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+		const VkWriteDescriptorSet mipWrites[] = {
+			VulkanInit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, mipSet, &sourceInfo, 0),
+			VulkanInit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, mipSet, &destinationInfo, 1),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(std::size(mipWrites)), mipWrites, 0, nullptr);
+
+		const uint32_t mipWidth = std::max(extent.width >> mip, 1u);
+		const uint32_t mipHeight = std::max(extent.height >> mip, 1u);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mipPipelineLayout, 0, 1, &mipSet, 0, nullptr);
+		vkCmdDispatch(cmd, (mipWidth + MIPGEN_GROUP_SIZE - 1) / MIPGEN_GROUP_SIZE, (mipHeight + MIPGEN_GROUP_SIZE - 1) / MIPGEN_GROUP_SIZE, 1);
+
+		imageBarrier(cmd, imageMemoryBarrier(image, mip, 1,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL));
+	}
+
+	imageBarrier(cmd, imageMemoryBarrier(image, 0, mipCount,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+		VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
 }
 
 void Renderer::immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function)
@@ -1291,16 +3262,46 @@ void Renderer::immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& functi
 
 	vkEndCommandBuffer(cmd);
 
-	VkSubmitInfo submit = VulkanInit::submitInfo(&cmd);
+	const uint64_t uploadValue = timeline.nextValue();
+	const VkSemaphore timelineSemaphore = timeline.getSemaphore();
+	const VkTimelineSemaphoreSubmitInfo timelineSubmit = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &uploadValue,
+	};
 
-	vkQueueSubmit(graphics.queue, 1, &submit, uploadContext.uploadFence);
+	VkSubmitInfo submit = VulkanInit::submitInfo(&cmd);
+	submit.pNext = &timelineSubmit;
+	submit.signalSemaphoreCount = 1;
+	submit.pSignalSemaphores = &timelineSemaphore;
 
-	vkWaitForFences(device, 1, &uploadContext.uploadFence, true, 9999999999);
-	vkResetFences(device, 1, &uploadContext.uploadFence);
+	VK_CHECK(vkQueueSubmit(graphics.queue, 1, &submit, VK_NULL_HANDLE));
+	stagingRing.retire(uploadValue);
+	timeline.wait(uploadValue);
 
 	vkResetCommandPool(device, uploadContext.commandPool, 0);
 }
 
+VertexInputDescription RenderMesh::getPositionVertexDescription()
+{
+	VertexInputDescription description;
+
+	description.bindings.push_back({
+		.binding = 0,
+		.stride = sizeof(glm::vec3),
+		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+		});
+
+	description.attributes.push_back({
+		.location = 0,
+		.binding = 0,
+		.format = VK_FORMAT_R32G32B32_SFLOAT,
+		.offset = 0,
+		});
+	return description;
+}
+
 VertexInputDescription RenderMesh::getVertexDescription()
 {
 	VertexInputDescription description;
@@ -1347,3 +3348,32 @@ VertexInputDescription RenderMesh::getVertexDescription()
 	description.attributes.push_back(uvAttribute);
 	return description;
 }
+
+void RenderTypes::ImGuiFrameSnapshot::capture(const ImDrawData& source)
+{
+	ZoneScoped;
+	drawLists.clear();
+	drawListPointers.clear();
+	for (int i = 0; i < source.CmdListsCount; ++i)
+	{
+		drawLists.emplace_back(source.CmdLists[i]->CloneOutput());
+		drawListPointers.push_back(drawLists.back().get());
+	}
+
+	drawData = source;
+	drawData.CmdLists = drawListPointers.data();
+}
+
+void RenderTypes::ImGuiFrameSnapshot::replaceTexture(ImTextureID placeholder, ImTextureID texture)
+{
+	for (ImDrawList* drawList : drawListPointers)
+	{
+		for (ImDrawCmd& drawCmd : drawList->CmdBuffer)
+		{
+			if (drawCmd.TextureId == placeholder)
+			{
+				drawCmd.TextureId = texture;
+			}
+		}
+	}
+}
@@ -80,8 +80,8 @@ void ResourceManager::DestroyBuffer(const BufferHandle& buffer)
 	if (deleteBuffer.buffer != VK_NULL_HANDLE)
 	{
 		vmaDestroyBuffer(allocator, deleteBuffer.buffer, deleteBuffer.allocation);
+		buffers.remove(buffer);
 	}
-	deleteBuffer.buffer = VK_NULL_HANDLE;
 }
 
 ImageHandle ResourceManager::CreateImage(const ImageCreateInfo& createInfo)
@@ -92,7 +92,15 @@ ImageHandle ResourceManager::CreateImage(const ImageCreateInfo& createInfo)
 		.usage = VMA_MEMORY_USAGE_AUTO ,
 	};
 
-	vmaCreateImage(allocator, &createInfo.imageInfo, &allocInfo, &newImage.image, &newImage.allocation, nullptr);
+	if (createInfo.aliasAllocation != VK_NULL_HANDLE)
+	{
+		// the image doesn't own its memory, so a null allocation makes destruction leave it alone
+		vmaCreateAliasingImage(allocator, createInfo.aliasAllocation, &createInfo.imageInfo, &newImage.image);
+	}
+	else
+	{
+		vmaCreateImage(allocator, &createInfo.imageInfo, &allocInfo, &newImage.image, &newImage.allocation, nullptr);
+	}
 
 	const VkImageAspectFlags imageViewType = createInfo.usage == ImageCreateInfo::Usage::COLOR ? VK_IMAGE_ASPECT_COLOR_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
 
@@ -101,6 +109,8 @@ ImageHandle ResourceManager::CreateImage(const ImageCreateInfo& createInfo)
 	{
 	case ImageCreateInfo::ImageType::TEXTURE_2D:
 		imageinfo = VulkanInit::imageViewCreateInfo(createInfo.imageInfo.format, newImage.image, imageViewType);
+		// the default view sees the whole mip chain
+		imageinfo.subresourceRange.levelCount = createInfo.imageInfo.mipLevels;
 		break;
 	default:
 		break;
@@ -117,6 +127,15 @@ ImageHandle ResourceManager::CreateImage(const ImageCreateInfo& createInfo)
 		break;
 	}
 
+	const VkImageViewUsageCreateInfo viewUsageInfo{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO,
+		.usage = createInfo.viewUsage,
+	};
+	if (createInfo.viewUsage != 0)
+	{
+		imageinfo.pNext = &viewUsageInfo;
+	}
+
 	vkCreateImageView(device, &imageinfo, nullptr, &newImage.imageView);
 
 	ImageHandle newHandle = images.add(newImage);
@@ -136,8 +155,55 @@ void ResourceManager::DestroyImage(const ImageHandle& image)
 	{
 		vmaDestroyImage(allocator, deleteImage.image, deleteImage.allocation);
 		vkDestroyImageView(device, deleteImage.imageView, nullptr);
+		images.remove(image);
 	}
-	deleteImage.image = VK_NULL_HANDLE;
 }
 
+VkMemoryRequirements ResourceManager::GetImageMemoryRequirements(const VkImageCreateInfo& imageInfo)
+{
+	const VkDeviceImageMemoryRequirements requirementsInfo = {
+		.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS,
+		.pCreateInfo = &imageInfo,
+	};
+
+	VkMemoryRequirements2 requirements = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+	};
+	vkGetDeviceImageMemoryRequirements(device, &requirementsInfo, &requirements);
+	return requirements.memoryRequirements;
+}
+
+VmaAllocation ResourceManager::AllocateImageMemory(const VkMemoryRequirements& requirements)
+{
+	const VmaAllocationCreateInfo allocInfo = {
+		.usage = VMA_MEMORY_USAGE_GPU_ONLY,
+	};
+
+	VmaAllocation allocation = VK_NULL_HANDLE;
+	vmaAllocateMemory(allocator, &requirements, &allocInfo, &allocation, nullptr);
+	return allocation;
+}
+
+void ResourceManager::FreeMemory(VmaAllocation allocation)
+{
+	vmaFreeMemory(allocator, allocation);
+}
 
+MemoryBudget ResourceManager::GetDeviceMemoryBudget()
+{
+	const VkPhysicalDeviceMemoryProperties* memoryProperties = nullptr;
+	vmaGetMemoryProperties(allocator, &memoryProperties);
+	VmaBudget heapBudgets[VK_MAX_MEMORY_HEAPS];
+	vmaGetHeapBudgets(allocator, heapBudgets);
+
+	MemoryBudget budget{};
+	for (uint32_t heap = 0; heap < memoryProperties->memoryHeapCount; ++heap)
+	{
+		if (memoryProperties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+		{
+			budget.usage += heapBudgets[heap].usage;
+			budget.budget += heapBudgets[heap].budget;
+		}
+	}
+	return budget;
+}
@@ -0,0 +1,99 @@
+#include "Graphics/StagingRing.h"
+
+#include <public/tracy/Tracy.hpp>
+
+#include "Graphics/Timeline.h"
+#include "Log.h"
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void StagingRing::init(Timeline* uploadTimeline, VkDeviceSize ringCapacity)
+{
+	ZoneScoped;
+	timeline = uploadTimeline;
+	capacity = ringCapacity;
+	buffer = ResourceManager::ptr->CreateBuffer(BufferCreateInfo{
+		.size = capacity,
+		.usage = GFX::Buffer::Usage::NONE,
+		.transfer = BufferCreateInfo::Transfer::SRC,
+		});
+	ring = ResourceManager::ptr->GetBuffer(buffer);
+}
+
+void StagingRing::deinit()
+{
+	// anything retired has been queued for deletion on the timeline already
+	for (const BufferHandle dedicatedBuffer : dedicatedBuffers)
+	{
+		ResourceManager::ptr->DestroyBuffer(dedicatedBuffer);
+	}
+	dedicatedBuffers.clear();
+	retiredRegions.clear();
+	ResourceManager::ptr->DestroyBuffer(buffer);
+	ring = Buffer{};
+}
+
+StagingRing::Allocation StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	ZoneScoped;
+	while (!retiredRegions.empty() && timeline->isComplete(retiredRegions.front().value))
+	{
+		freePosition = retiredRegions.front().end;
+		retiredRegions.pop_front();
+	}
+
+	uint64_t start = alignUp(writePosition, alignment);
+	// regions never wrap, the rest of the ring is skipped instead
+	if (start % capacity + size > capacity)
+	{
+		start = alignUp(start, capacity);
+	}
+	while (start + size > freePosition + capacity && !retiredRegions.empty())
+	{
+		timeline->wait(retiredRegions.front().value);
+		freePosition = retiredRegions.front().end;
+		retiredRegions.pop_front();
+	}
+	// an idle ring has nothing to skip over
+	if (retiredRegions.empty() && freePosition == writePosition)
+	{
+		freePosition = start;
+	}
+
+	if (size > capacity || start + size > freePosition + capacity)
+	{
+		LOG_CORE_WARN("Staging ring can't fit {} KB, using a dedicated buffer", size / 1024);
+		const BufferHandle dedicatedBuffer = ResourceManager::ptr->CreateBuffer(BufferCreateInfo{
+			.size = size,
+			.usage = GFX::Buffer::Usage::NONE,
+			.transfer = BufferCreateInfo::Transfer::SRC,
+			});
+		dedicatedBuffers.push_back(dedicatedBuffer);
+		const Buffer dedicated = ResourceManager::ptr->GetBuffer(dedicatedBuffer);
+		return Allocation{ .ptr = static_cast<uint8_t*>(dedicated.ptr), .buffer = dedicated.buffer, .offset = 0, .size = size };
+	}
+
+	writePosition = start + size;
+	const VkDeviceSize offset = start % capacity;
+	return Allocation{ .ptr = static_cast<uint8_t*>(ring.ptr) + offset, .buffer = ring.buffer, .offset = offset, .size = size };
+}
+
+void StagingRing::retire(uint64_t value)
+{
+	if (writePosition > retiredPosition)
+	{
+		retiredRegions.push_back({ .end = writePosition, .value = value });
+		retiredPosition = writePosition;
+	}
+
+	for (const BufferHandle dedicatedBuffer : dedicatedBuffers)
+	{
+		timeline->deferDeletion([dedicatedBuffer]() {
+			ResourceManager::ptr->DestroyBuffer(dedicatedBuffer);
+			});
+	}
+	dedicatedBuffers.clear();
+}
@@ -0,0 +1,206 @@
+#include "Graphics/TextureStreamer.h"
+
+#include <public/tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t TextureStreamer::add(RenderableTypes::TextureHandle handle, std::unique_ptr<RenderableTypes::Texture> source)
+{
+	if (handle >= textures.size())
+	{
+		textures.resize(handle + 1);
+	}
+	StreamedTexture& texture = textures[handle];
+	const uint32_t mipCount = static_cast<uint32_t>(source->levels.size());
+	const uint32_t width = static_cast<uint32_t>(source->texWidth);
+	const uint32_t height = static_cast<uint32_t>(source->texHeight);
+
+	texture.chainSizes.assign(mipCount + 1, 0);
+	for (uint32_t mip = mipCount; mip-- > 0;)
+	{
+		texture.chainSizes[mip] = texture.chainSizes[mip + 1] + source->levels[mip].size();
+	}
+	texture.sizeLog2 = std::log2(static_cast<float>(std::max(width, height)));
+	texture.tailMip = mipCount - 1;
+	for (uint32_t mip = 0; mip < mipCount; ++mip)
+	{
+		if (std::max(std::max(width >> mip, 1U), std::max(height >> mip, 1U)) <= STREAMING_TAIL_SIZE)
+		{
+			texture.tailMip = mip;
+			break;
+		}
+	}
+	texture.baseMip = texture.tailMip;
+	texture.requestedMip = texture.tailMip;
+	texture.lastRequestFrame = currentFrame;
+	texture.source = std::move(source);
+
+	residentSize += texture.chainSizes[texture.baseMip];
+	totalSize += texture.chainSizes[0];
+	return texture.baseMip;
+}
+
+void TextureStreamer::remove(RenderableTypes::TextureHandle handle)
+{
+	if (!isStreamed(handle))
+	{
+		return;
+	}
+	StreamedTexture& texture = textures[handle];
+	residentSize -= texture.chainSizes[texture.baseMip];
+	totalSize -= texture.chainSizes[0];
+	texture = StreamedTexture{};
+}
+
+bool TextureStreamer::isStreamed(RenderableTypes::TextureHandle handle) const
+{
+	return handle < textures.size() && textures[handle].source != nullptr;
+}
+
+void TextureStreamer::beginRequests(uint64_t frame)
+{
+	currentFrame = frame;
+	for (StreamedTexture& texture : textures)
+	{
+		texture.requestedMip = texture.tailMip;
+	}
+}
+
+void TextureStreamer::request(RenderableTypes::TextureHandle handle, float uvLod)
+{
+	if (!isStreamed(handle))
+	{
+		return;
+	}
+	// the level whose texels are about a pixel apart, finer ones would only be minified away
+	const float lod = std::floor(uvLod + textures[handle].sizeLog2);
+	requestMip(handle, lod <= 0.0f ? 0U : static_cast<uint32_t>(std::min(lod, 31.0f)));
+}
+
+void TextureStreamer::requestMip(RenderableTypes::TextureHandle handle, uint32_t mip)
+{
+	if (!isStreamed(handle))
+	{
+		return;
+	}
+	StreamedTexture& texture = textures[handle];
+	texture.requestedMip = std::min(texture.requestedMip, mip);
+	texture.lastRequestFrame = currentFrame;
+}
+
+std::vector<TextureStreamer::Change> TextureStreamer::plan(size_t uploadBudget, size_t memoryLimit) const
+{
+	ZoneScoped;
+	std::vector<Change> changes;
+	std::vector<RenderableTypes::TextureHandle> candidates;
+	std::vector<bool> changed(textures.size(), false);
+	size_t resident = residentSize;
+	size_t uploaded = 0;
+
+	if (resident > memoryLimit)
+	{
+		for (RenderableTypes::TextureHandle handle = 0; handle < textures.size(); ++handle)
+		{
+			if (isStreamed(handle) && textures[handle].baseMip < textures[handle].tailMip)
+			{
+				candidates.push_back(handle);
+			}
+		}
+		// textures nobody looked at this frame go first, then the ones holding the most levels they don't need
+		std::sort(candidates.begin(), candidates.end(), [this](RenderableTypes::TextureHandle a, RenderableTypes::TextureHandle b) {
+			const StreamedTexture& textureA = textures[a];
+			const StreamedTexture& textureB = textures[b];
+			if (textureA.lastRequestFrame != textureB.lastRequestFrame)
+			{
+				return textureA.lastRequestFrame < textureB.lastRequestFrame;
+			}
+			const int64_t unneededA = static_cast<int64_t>(textureA.requestedMip) - textureA.baseMip;
+			const int64_t unneededB = static_cast<int64_t>(textureB.requestedMip) - textureB.baseMip;
+			return unneededA > unneededB;
+			});
+
+		for (const RenderableTypes::TextureHandle handle : candidates)
+		{
+			if (resident <= memoryLimit)
+			{
+				break;
+			}
+			const StreamedTexture& texture = textures[handle];
+			// over resident textures drop to what they need, the rest lose their finest level
+			const uint32_t baseMip = std::min(std::max(texture.requestedMip, texture.baseMip + 1), texture.tailMip);
+			changes.push_back({ .handle = handle, .baseMip = baseMip, .uploadSize = texture.chainSizes[baseMip] });
+			resident -= texture.chainSizes[texture.baseMip] - texture.chainSizes[baseMip];
+			uploaded += texture.chainSizes[baseMip];
+			changed[handle] = true;
+		}
+	}
+
+	candidates.clear();
+	for (RenderableTypes::TextureHandle handle = 0; handle < textures.size(); ++handle)
+	{
+		if (isStreamed(handle) && !changed[handle] && textures[handle].requestedMip < textures[handle].baseMip)
+		{
+			candidates.push_back(handle);
+		}
+	}
+	// the furthest from what they need first, then the ones needed the sharpest
+	std::sort(candidates.begin(), candidates.end(), [this](RenderableTypes::TextureHandle a, RenderableTypes::TextureHandle b) {
+		const StreamedTexture& textureA = textures[a];
+		const StreamedTexture& textureB = textures[b];
+		const uint32_t missingA = textureA.baseMip - textureA.requestedMip;
+		const uint32_t missingB = textureB.baseMip - textureB.requestedMip;
+		if (missingA != missingB)
+		{
+			return missingA > missingB;
+		}
+		return textureA.requestedMip < textureB.requestedMip;
+		});
+
+	for (const RenderableTypes::TextureHandle handle : candidates)
+	{
+		if (uploaded >= uploadBudget)
+		{
+			break;
+		}
+		const StreamedTexture& texture = textures[handle];
+		// straight to the request if it fits, otherwise as close as the budgets allow. A single level larger
+		// than the whole budget still goes in as the first upload of a frame, or it would never load.
+		for (uint32_t baseMip = texture.requestedMip; baseMip < texture.baseMip; ++baseMip)
+		{
+			const size_t growth = texture.chainSizes[baseMip] - texture.chainSizes[texture.baseMip];
+			const bool fitsBudget = uploaded + texture.chainSizes[baseMip] <= uploadBudget || (uploaded == 0 && baseMip + 1 == texture.baseMip);
+			if (fitsBudget && resident + growth <= memoryLimit)
+			{
+				changes.push_back({ .handle = handle, .baseMip = baseMip, .uploadSize = texture.chainSizes[baseMip] });
+				resident += growth;
+				uploaded += texture.chainSizes[baseMip];
+				break;
+			}
+		}
+	}
+	return changes;
+}
+
+void TextureStreamer::commit(const Change& change)
+{
+	StreamedTexture& texture = textures[change.handle];
+	residentSize = residentSize - texture.chainSizes[texture.baseMip] + texture.chainSizes[change.baseMip];
+	texture.baseMip = change.baseMip;
+}
+
+void TextureStreamer::getLevels(RenderableTypes::TextureHandle handle, uint32_t baseMip, RenderableTypes::Texture& outLevels) const
+{
+	const RenderableTypes::Texture& source = *textures[handle].source;
+	outLevels.desc = source.desc;
+	outLevels.texWidth = std::max(source.texWidth >> baseMip, 1);
+	outLevels.texHeight = std::max(source.texHeight >> baseMip, 1);
+	outLevels.texChannels = source.texChannels;
+	outLevels.blockFormat = source.blockFormat;
+	outLevels.levels.assign(source.levels.begin() + baseMip, source.levels.end());
+}
+
+uint32_t TextureStreamer::getBaseMip(RenderableTypes::TextureHandle handle) const
+{
+	return isStreamed(handle) ? textures[handle].baseMip : 0U;
+}
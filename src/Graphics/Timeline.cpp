@@ -0,0 +1,106 @@
+#include "Graphics/Timeline.h"
+
+#include <public/tracy/Tracy.hpp>
+
+#include "Log.h"
+
+void Timeline::init(VkDevice device)
+{
+	this->device = device;
+
+	const VkSemaphoreTypeCreateInfo timelineCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.pNext = nullptr,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0U,
+	};
+
+	const VkSemaphoreCreateInfo semaphoreCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &timelineCreateInfo,
+		.flags = 0,
+	};
+
+	vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore);
+}
+
+void Timeline::deinit()
+{
+	flush();
+	vkDestroySemaphore(device, semaphore, nullptr);
+	semaphore = VK_NULL_HANDLE;
+}
+
+uint64_t Timeline::nextValue()
+{
+	return submittedValue.fetch_add(1U, std::memory_order_acq_rel) + 1U;
+}
+
+uint64_t Timeline::getCompletedValue()
+{
+	uint64_t value = 0U;
+	vkGetSemaphoreCounterValue(device, semaphore, &value);
+
+	// remember the highest value seen so repeated questions about old submissions skip the driver call
+	uint64_t cached = completedValue.load(std::memory_order_relaxed);
+	while (cached < value && !completedValue.compare_exchange_weak(cached, value, std::memory_order_relaxed))
+	{
+	}
+	return value;
+}
+
+bool Timeline::isComplete(uint64_t value)
+{
+	return value <= completedValue.load(std::memory_order_relaxed) || value <= getCompletedValue();
+}
+
+void Timeline::wait(uint64_t value)
+{
+	if (isComplete(value))
+	{
+		return;
+	}
+
+	ZoneScoped;
+	const VkSemaphoreWaitInfo waitInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.semaphoreCount = 1,
+		.pSemaphores = &semaphore,
+		.pValues = &value,
+	};
+
+	if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+	{
+		LOG_CORE_ERROR("Timeline wait for {} failed", value);
+		return;
+	}
+	getCompletedValue();
+}
+
+void Timeline::deferDeletion(std::function<void()>&& function)
+{
+	std::lock_guard<std::mutex> lock(deletionMutex);
+	pendingDeletions.push_back(PendingDeletion{ .value = getSubmittedValue(), .function = std::move(function) });
+}
+
+void Timeline::collect()
+{
+	ZoneScoped;
+	const uint64_t completed = getCompletedValue();
+
+	std::lock_guard<std::mutex> lock(deletionMutex);
+	// values are pushed in increasing order, so the front is always the oldest
+	while (!pendingDeletions.empty() && pendingDeletions.front().value <= completed)
+	{
+		pendingDeletions.front().function();
+		pendingDeletions.pop_front();
+	}
+}
+
+void Timeline::flush()
+{
+	wait(getSubmittedValue());
+	collect();
+}
@@ -0,0 +1,195 @@
+#include "Jobs/JobSystem.h"
+
+#include <public/tracy/Tracy.hpp>
+#include <public/common/TracySystem.hpp>
+
+#include <algorithm>
+#include <string>
+
+Jobs::JobSystem* Jobs::JobSystem::ptr = nullptr;
+
+static thread_local uint32_t threadIndex = 0U;
+
+Jobs::JobSystem::JobSystem(uint32_t workerCount)
+{
+	ZoneScoped;
+	// queue 0 belongs to the threads that are not workers
+	for (uint32_t i = 0; i < workerCount + 1; ++i)
+	{
+		queues.push_back(std::make_unique<WorkQueue>());
+	}
+
+	for (uint32_t i = 1; i < workerCount + 1; ++i)
+	{
+		workers.emplace_back([this, i]() {
+			workerLoop(i);
+			});
+	}
+}
+
+Jobs::JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running = false;
+	}
+	wakeCondition.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+uint32_t Jobs::JobSystem::GetThreadIndex()
+{
+	return threadIndex;
+}
+
+void Jobs::JobSystem::run(JobFunction&& job, Counter& counter)
+{
+	counter.pending.fetch_add(1U, std::memory_order_relaxed);
+
+	WorkQueue& queue = *queues[GetThreadIndex() < queues.size() ? GetThreadIndex() : 0U];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(Job{ .function = std::move(job), .counter = &counter });
+	}
+
+	queuedJobs.fetch_add(1U);
+	if (sleepingWorkers.load() > 0U)
+	{
+		// taking the lock orders this with a worker that is about to sleep
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeCondition.notify_one();
+	}
+}
+
+void Jobs::JobSystem::wait(Counter& counter)
+{
+	ZoneScoped;
+	const uint32_t index = GetThreadIndex() < queues.size() ? GetThreadIndex() : 0U;
+	while (!counter.isDone())
+	{
+		if (!tryRunJob(index))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void Jobs::JobSystem::waitUntil(const std::function<bool()>& condition)
+{
+	ZoneScoped;
+	const uint32_t index = GetThreadIndex() < queues.size() ? GetThreadIndex() : 0U;
+	while (!condition())
+	{
+		if (!tryRunJob(index))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void Jobs::JobSystem::parallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function)
+{
+	ZoneScoped;
+	if (count == 0U)
+	{
+		return;
+	}
+
+	grainSize = std::max(grainSize, 1U);
+	if (count <= grainSize)
+	{
+		function(0U, count);
+		return;
+	}
+
+	Counter counter;
+	// the calling thread takes the first range itself
+	for (uint32_t begin = grainSize; begin < count; begin += grainSize)
+	{
+		const uint32_t end = std::min(count, begin + grainSize);
+		run([&function, begin, end]() {
+			function(begin, end);
+			}, counter);
+	}
+	function(0U, grainSize);
+
+	wait(counter);
+}
+
+void Jobs::JobSystem::workerLoop(uint32_t index)
+{
+	threadIndex = index;
+	const std::string threadName = "Worker " + std::to_string(index);
+	tracy::SetThreadName(threadName.c_str());
+
+	while (running.load(std::memory_order_acquire))
+	{
+		if (tryRunJob(index))
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers.fetch_add(1U);
+		wakeCondition.wait(lock, [this]() {
+			return !running.load() || queuedJobs.load() > 0U;
+			});
+		sleepingWorkers.fetch_sub(1U);
+	}
+}
+
+bool Jobs::JobSystem::tryRunJob(uint32_t index)
+{
+	Job job;
+	if (!popJob(index, job) && !stealJob(index, job))
+	{
+		return false;
+	}
+	queuedJobs.fetch_sub(1U);
+
+	{
+		ZoneScopedN("Job");
+		job.function();
+	}
+	job.counter->pending.fetch_sub(1U, std::memory_order_release);
+	return true;
+}
+
+bool Jobs::JobSystem::popJob(uint32_t index, Job& outJob)
+{
+	WorkQueue& queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty())
+	{
+		return false;
+	}
+
+	// newest first, its data is most likely still in cache
+	outJob = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	return true;
+}
+
+bool Jobs::JobSystem::stealJob(uint32_t index, Job& outJob)
+{
+	const uint32_t queueCount = static_cast<uint32_t>(queues.size());
+	for (uint32_t offset = 1; offset < queueCount; ++offset)
+	{
+		WorkQueue& victim = *queues[(index + offset) % queueCount];
+		std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+		if (!lock.owns_lock() || victim.jobs.empty())
+		{
+			continue;
+		}
+
+		// oldest first, it is usually the biggest piece of remaining work
+		outJob = std::move(victim.jobs.front());
+		victim.jobs.pop_front();
+		return true;
+	}
+	return false;
+}
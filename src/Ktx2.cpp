@@ -0,0 +1,391 @@
+#include "Ktx2.h"
+
+#include <vulkan/vulkan.h>
+#include <public/tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
+#include "Log.h"
+#include "TextureCompression.h"
+
+constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+// Data format descriptor values, from the Khronos data format specification
+constexpr uint8_t DF_MODEL_RGBSDA = 1;
+constexpr uint8_t DF_MODEL_BC1A = 128;
+constexpr uint8_t DF_MODEL_BC4 = 131;
+constexpr uint8_t DF_MODEL_BC5 = 132;
+constexpr uint8_t DF_MODEL_BC7 = 134;
+constexpr uint8_t DF_PRIMARIES_BT709 = 1;
+constexpr uint8_t DF_TRANSFER_LINEAR = 1;
+constexpr uint8_t DF_TRANSFER_SRGB = 2;
+constexpr uint8_t DF_SAMPLE_LINEAR = 0x10;
+
+struct Ktx2Header
+{
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+struct Ktx2Level
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+struct DfdSample
+{
+	uint16_t bitOffset;
+	// bits minus one
+	uint8_t bitLength;
+	uint8_t channelType;
+	uint8_t samplePosition[4];
+	uint32_t sampleLower;
+	uint32_t sampleUpper;
+};
+
+static bool fromVkFormat(uint32_t vkFormat, RenderableTypes::BlockFormat& outFormat, uint32_t& outChannels)
+{
+	outChannels = 4;
+	switch (static_cast<VkFormat>(vkFormat))
+	{
+	case VK_FORMAT_R8_UNORM:
+		outFormat = RenderableTypes::BlockFormat::NONE;
+		outChannels = 1;
+		return true;
+	case VK_FORMAT_R8G8_UNORM:
+		outFormat = RenderableTypes::BlockFormat::NONE;
+		outChannels = 2;
+		return true;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		outFormat = RenderableTypes::BlockFormat::NONE;
+		return true;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		outFormat = RenderableTypes::BlockFormat::BC1;
+		return true;
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		outFormat = RenderableTypes::BlockFormat::BC4;
+		outChannels = 1;
+		return true;
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		outFormat = RenderableTypes::BlockFormat::BC5;
+		outChannels = 2;
+		return true;
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		outFormat = RenderableTypes::BlockFormat::BC7;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static VkFormat toVkFormat(RenderableTypes::BlockFormat format, uint32_t channels, bool srgb)
+{
+	switch (format)
+	{
+	case RenderableTypes::BlockFormat::BC1:
+		return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case RenderableTypes::BlockFormat::BC4:
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+	case RenderableTypes::BlockFormat::BC5:
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	case RenderableTypes::BlockFormat::BC7:
+		return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	default:
+		break;
+	}
+	switch (channels)
+	{
+	case 1:
+		return VK_FORMAT_R8_UNORM;
+	case 2:
+		return VK_FORMAT_R8G8_UNORM;
+	default:
+		return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+// Basic data format descriptor block of the format, with the total size in front
+static std::vector<uint8_t> buildDfd(RenderableTypes::BlockFormat format, uint32_t channels, bool srgb)
+{
+	std::vector<DfdSample> samples;
+	uint8_t colorModel = DF_MODEL_RGBSDA;
+	uint8_t blockDimension = 0;
+	uint8_t bytesPlane0 = static_cast<uint8_t>(channels);
+	switch (format)
+	{
+	case RenderableTypes::BlockFormat::BC1:
+		colorModel = DF_MODEL_BC1A;
+		// the only channel of BC1 with alpha is "alpha present"
+		samples.push_back({ .bitOffset = 0, .bitLength = 63, .channelType = 1, .sampleUpper = UINT32_MAX });
+		break;
+	case RenderableTypes::BlockFormat::BC4:
+		colorModel = DF_MODEL_BC4;
+		samples.push_back({ .bitOffset = 0, .bitLength = 63, .channelType = 0, .sampleUpper = UINT32_MAX });
+		break;
+	case RenderableTypes::BlockFormat::BC5:
+		colorModel = DF_MODEL_BC5;
+		samples.push_back({ .bitOffset = 0, .bitLength = 63, .channelType = 0, .sampleUpper = UINT32_MAX });
+		samples.push_back({ .bitOffset = 64, .bitLength = 63, .channelType = 1, .sampleUpper = UINT32_MAX });
+		break;
+	case RenderableTypes::BlockFormat::BC7:
+		colorModel = DF_MODEL_BC7;
+		samples.push_back({ .bitOffset = 0, .bitLength = 127, .channelType = 0, .sampleUpper = UINT32_MAX });
+		break;
+	default:
+		// red, green, blue and alpha in that order, alpha is never sRGB encoded
+		for (uint8_t channel = 0; channel < channels; ++channel)
+		{
+			samples.push_back({
+				.bitOffset = static_cast<uint16_t>(channel * 8),
+				.bitLength = 7,
+				.channelType = static_cast<uint8_t>(channel == 3 ? 15 | (srgb ? DF_SAMPLE_LINEAR : 0) : channel),
+				.sampleUpper = 255,
+				});
+		}
+		break;
+	}
+	if (format != RenderableTypes::BlockFormat::NONE)
+	{
+		blockDimension = 3;
+		bytesPlane0 = static_cast<uint8_t>(TextureCompression::GetBlockSize(format));
+	}
+
+	const uint32_t blockSize = 24 + static_cast<uint32_t>(samples.size() * sizeof(DfdSample));
+	const uint32_t totalSize = 4 + blockSize;
+	const uint32_t descriptorType = 0;
+	const uint32_t versionAndSize = 2 | (blockSize << 16);
+	const uint8_t modelFields[4] = { colorModel, DF_PRIMARIES_BT709, srgb ? DF_TRANSFER_SRGB : DF_TRANSFER_LINEAR, 0 };
+	const uint8_t blockDimensions[4] = { blockDimension, blockDimension, 0, 0 };
+	const uint8_t bytesPlanes[8] = { bytesPlane0 };
+
+	std::vector<uint8_t> dfd(totalSize);
+	uint8_t* out = dfd.data();
+	memcpy(out, &totalSize, 4);
+	memcpy(out + 4, &descriptorType, 4);
+	memcpy(out + 8, &versionAndSize, 4);
+	memcpy(out + 12, modelFields, 4);
+	memcpy(out + 16, blockDimensions, 4);
+	memcpy(out + 20, bytesPlanes, 8);
+	memcpy(out + 28, samples.data(), samples.size() * sizeof(DfdSample));
+	return dfd;
+}
+
+// The header and level index, checked against the file size
+static bool parseHeader(const MappedFile& file, Ktx2Header& outHeader, std::vector<Ktx2Level>& outLevels)
+{
+	if (file.size() < sizeof(Ktx2Header))
+	{
+		return false;
+	}
+	memcpy(&outHeader, file.data(), sizeof(Ktx2Header));
+	if (memcmp(outHeader.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+	{
+		return false;
+	}
+
+	// a level count of zero asks the loader to generate the chain, the stored level is the only one
+	const uint32_t levelCount = std::max(outHeader.levelCount, 1U);
+	const size_t levelIndexEnd = sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level);
+	if (file.size() < levelIndexEnd)
+	{
+		return false;
+	}
+	outLevels.resize(levelCount);
+	memcpy(outLevels.data(), file.data() + sizeof(Ktx2Header), levelCount * sizeof(Ktx2Level));
+	for (const Ktx2Level& level : outLevels)
+	{
+		if (level.byteOffset > file.size() || level.byteLength > file.size() - level.byteOffset)
+		{
+			return false;
+		}
+	}
+	return static_cast<uint64_t>(outHeader.kvdByteOffset) + outHeader.kvdByteLength <= file.size();
+}
+
+bool Ktx2::Load(const char* path, const RenderableTypes::TextureDesc& textureDesc, RenderableTypes::Texture& outImage)
+{
+	ZoneScoped;
+	MappedFile file;
+	if (!file.open(path))
+	{
+		return false;
+	}
+
+	Ktx2Header header;
+	std::vector<Ktx2Level> levels;
+	if (!parseHeader(file, header, levels))
+	{
+		LOG_CORE_WARN("Invalid KTX2 file: {}", path);
+		return false;
+	}
+
+	RenderableTypes::BlockFormat format;
+	uint32_t channels;
+	if (!fromVkFormat(header.vkFormat, format, channels) || header.supercompressionScheme != 0
+		|| header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+	{
+		LOG_CORE_WARN("Unsupported KTX2 file: {}, format {} supercompression {}", path, header.vkFormat, header.supercompressionScheme);
+		return false;
+	}
+	// checked before any level size is computed, the extents are shifted by the level
+	if (header.pixelWidth == 0 || header.pixelHeight == 0
+		|| levels.size() > RenderableTypes::TextureUtil::GetMipCount(header.pixelWidth, header.pixelHeight))
+	{
+		LOG_CORE_WARN("Unsupported KTX2 file: {}, {}x{} with {} levels", path, header.pixelWidth, header.pixelHeight, header.levelCount);
+		return false;
+	}
+
+	// every level has to be as large as its extent needs, the upload trusts the sizes
+	for (uint32_t mip = 0; mip < levels.size(); ++mip)
+	{
+		const size_t expectedSize = TextureCompression::GetLevelSize(format, std::max(header.pixelWidth >> mip, 1U), std::max(header.pixelHeight >> mip, 1U), channels);
+		if (levels[mip].byteLength < expectedSize)
+		{
+			LOG_CORE_WARN("KTX2 file {} level {} is truncated", path, mip);
+			return false;
+		}
+	}
+
+	outImage.desc = textureDesc;
+	outImage.texWidth = static_cast<int>(header.pixelWidth);
+	outImage.texHeight = static_cast<int>(header.pixelHeight);
+	outImage.texChannels = static_cast<int>(channels);
+	outImage.blockFormat = format;
+	outImage.levels.clear();
+	for (uint32_t mip = 0; mip < levels.size(); ++mip)
+	{
+		const size_t levelSize = TextureCompression::GetLevelSize(format, std::max(header.pixelWidth >> mip, 1U), std::max(header.pixelHeight >> mip, 1U), channels);
+		outImage.levels.emplace_back(file.data() + levels[mip].byteOffset, levelSize);
+	}
+	// the levels stay valid, moving the mapping doesn't move its pages
+	outImage.file = std::move(file);
+	return true;
+}
+
+std::span<const uint8_t> Ktx2::FindValue(const MappedFile& file, std::string_view key)
+{
+	Ktx2Header header;
+	std::vector<Ktx2Level> levels;
+	if (!parseHeader(file, header, levels))
+	{
+		return {};
+	}
+
+	// every entry is its length, the key with its terminator, the value and padding to 4 bytes
+	const uint8_t* entry = file.data() + header.kvdByteOffset;
+	const uint8_t* end = entry + header.kvdByteLength;
+	while (end - entry >= 4)
+	{
+		uint32_t length;
+		memcpy(&length, entry, 4);
+		const uint8_t* keyStart = entry + 4;
+		if (length > static_cast<size_t>(end - keyStart))
+		{
+			break;
+		}
+		const uint8_t* terminator = std::find(keyStart, keyStart + length, 0);
+		if (terminator != keyStart + length
+			&& std::string_view(reinterpret_cast<const char*>(keyStart), terminator - keyStart) == key)
+		{
+			return { terminator + 1, keyStart + length };
+		}
+		entry = keyStart + ((length + 3) & ~3U);
+	}
+	return {};
+}
+
+bool Ktx2::Write(const char* path, RenderableTypes::BlockFormat format, uint32_t channels, bool srgb, uint32_t width, uint32_t height,
+	const std::vector<std::span<const uint8_t>>& levels, const std::vector<KeyValue>& keyValues)
+{
+	ZoneScoped;
+	const std::vector<uint8_t> dfd = buildDfd(format, channels, srgb);
+	std::vector<uint8_t> kvd;
+	for (const KeyValue& keyValue : keyValues)
+	{
+		const uint32_t length = static_cast<uint32_t>(keyValue.key.size() + 1 + keyValue.value.size());
+		const size_t start = kvd.size();
+		kvd.resize(start + 4 + ((length + 3) & ~3U), 0);
+		memcpy(kvd.data() + start, &length, 4);
+		memcpy(kvd.data() + start + 4, keyValue.key.data(), keyValue.key.size());
+		std::copy(keyValue.value.begin(), keyValue.value.end(), kvd.begin() + start + 4 + keyValue.key.size() + 1);
+	}
+
+	// levels go smallest first, each aligned to its block size. Uncompressed levels also keep the 4 byte
+	// alignment the format requires, so a three channel level is aligned to 12.
+	const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+	const size_t alignment = format == RenderableTypes::BlockFormat::NONE ? std::lcm<size_t>(channels, 4) : TextureCompression::GetBlockSize(format);
+	const auto align = [](size_t offset, size_t alignment) { return (offset + alignment - 1) / alignment * alignment; };
+	const size_t dfdOffset = sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level);
+	const size_t kvdOffset = dfdOffset + dfd.size();
+	std::vector<Ktx2Level> levelIndex(levelCount);
+	size_t offset = kvdOffset + kvd.size();
+	for (uint32_t mip = levelCount; mip-- > 0;)
+	{
+		offset = align(offset, alignment);
+		levelIndex[mip] = { .byteOffset = offset, .byteLength = levels[mip].size(), .uncompressedByteLength = levels[mip].size() };
+		offset += levels[mip].size();
+	}
+
+	Ktx2Header header{
+		.vkFormat = static_cast<uint32_t>(toVkFormat(format, channels, srgb)),
+		.typeSize = 1,
+		.pixelWidth = width,
+		.pixelHeight = height,
+		.pixelDepth = 0,
+		.layerCount = 0,
+		.faceCount = 1,
+		.levelCount = levelCount,
+		.supercompressionScheme = 0,
+		.dfdByteOffset = static_cast<uint32_t>(dfdOffset),
+		.dfdByteLength = static_cast<uint32_t>(dfd.size()),
+		.kvdByteOffset = kvd.empty() ? 0 : static_cast<uint32_t>(kvdOffset),
+		.kvdByteLength = static_cast<uint32_t>(kvd.size()),
+		.sgdByteOffset = 0,
+		.sgdByteLength = 0,
+	};
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(Ktx2Level));
+	out.write(reinterpret_cast<const char*>(dfd.data()), dfd.size());
+	out.write(reinterpret_cast<const char*>(kvd.data()), kvd.size());
+	size_t written = kvdOffset + kvd.size();
+	const char padding[16] = {};
+	for (uint32_t mip = levelCount; mip-- > 0;)
+	{
+		out.write(padding, levelIndex[mip].byteOffset - written);
+		out.write(reinterpret_cast<const char*>(levels[mip].data()), levels[mip].size());
+		written = levelIndex[mip].byteOffset + levels[mip].size();
+	}
+	if (!out)
+	{
+		LOG_CORE_WARN("Failed to write KTX2 file: {}", path);
+		return false;
+	}
+	return true;
+}
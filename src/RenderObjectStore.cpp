@@ -0,0 +1,101 @@
+#include "RenderObjectStore.h"
+
+#include <public/tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
+constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+RenderEntity RenderObjectStore::create(const RenderableTypes::RenderObject& object)
+{
+	RenderEntity entity;
+	if (!freeEntities.empty())
+	{
+		entity = freeEntities.back();
+		freeEntities.pop_back();
+	}
+	else
+	{
+		entity = static_cast<RenderEntity>(entityToIndex.size());
+		entityToIndex.push_back(INVALID_INDEX);
+	}
+
+	entityToIndex[entity] = size();
+	indexToEntity.push_back(entity);
+	objects.transforms.push_back(object.transform);
+	objects.meshes.push_back(object.meshHandle);
+	objects.materials.push_back(object.materialHandle);
+	objects.flags.push_back(object.flags);
+	bounds.emplace_back();
+	return entity;
+}
+
+void RenderObjectStore::destroy(RenderEntity entity)
+{
+	// the last object fills the hole
+	const uint32_t index = entityToIndex[entity];
+	const uint32_t last = size() - 1;
+	if (index != last)
+	{
+		objects.transforms[index] = objects.transforms[last];
+		objects.meshes[index] = objects.meshes[last];
+		objects.materials[index] = objects.materials[last];
+		objects.flags[index] = objects.flags[last];
+		bounds[index] = bounds[last];
+		indexToEntity[index] = indexToEntity[last];
+		entityToIndex[indexToEntity[index]] = index;
+	}
+
+	objects.transforms.pop_back();
+	objects.meshes.pop_back();
+	objects.materials.pop_back();
+	objects.flags.pop_back();
+	bounds.pop_back();
+	indexToEntity.pop_back();
+	entityToIndex[entity] = INVALID_INDEX;
+	freeEntities.push_back(entity);
+}
+
+void RenderObjectStore::clear()
+{
+	objects = {};
+	bounds.clear();
+	indexToEntity.clear();
+	entityToIndex.clear();
+	freeEntities.clear();
+}
+
+void RenderObjectStore::sortForDrawing()
+{
+	ZoneScoped;
+	// the keys come from the two handle arrays alone, the rest is only touched by the permutation
+	std::vector<uint64_t> keys(size());
+	for (uint32_t i = 0; i < size(); ++i)
+	{
+		keys[i] = (static_cast<uint64_t>(objects.materials[i]) << 32) | objects.meshes[i];
+	}
+	std::vector<uint32_t> order(size());
+	std::iota(order.begin(), order.end(), 0U);
+	std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+	const auto reorder = [&order](auto& values) {
+		std::remove_reference_t<decltype(values)> sorted(values.size());
+		for (uint32_t i = 0; i < order.size(); ++i)
+		{
+			sorted[i] = values[order[i]];
+		}
+		values = std::move(sorted);
+	};
+	reorder(objects.transforms);
+	reorder(objects.meshes);
+	reorder(objects.materials);
+	reorder(objects.flags);
+	reorder(bounds);
+	reorder(indexToEntity);
+	for (uint32_t i = 0; i < size(); ++i)
+	{
+		entityToIndex[indexToEntity[i]] = i;
+	}
+}
@@ -1,7 +1,22 @@
 #include "RenderableTypes.h"
 
 #include <public/tracy/Tracy.hpp>
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "Jobs/JobSystem.h"
+#include "Ktx2.h"
 #include "Log.h"
+#include "TextureCompression.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -11,20 +26,400 @@ RenderableTypes::Texture::~Texture()
 	stbi_image_free(this->ptr);
 }
 
+RenderableTypes::Texture::Texture(Texture&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+RenderableTypes::Texture& RenderableTypes::Texture::operator=(Texture&& other) noexcept
+{
+	if (this != &other)
+	{
+		stbi_image_free(ptr);
+		desc = other.desc;
+		ptr = std::exchange(other.ptr, nullptr);
+		texWidth = other.texWidth;
+		texHeight = other.texHeight;
+		texChannels = other.texChannels;
+		blockFormat = other.blockFormat;
+		levels = std::move(other.levels);
+		blocks = std::move(other.blocks);
+		file = std::move(other.file);
+	}
+	return *this;
+}
+
 void RenderableTypes::TextureUtil::LoadTextureFromFile(const char* file, RenderableTypes::TextureDesc textureDesc, RenderableTypes::Texture& outImage)
 {
 	ZoneScoped;
 
-	stbi_uc* pixels = stbi_load(file, &outImage.texWidth, &outImage.texHeight, &outImage.texChannels, STBI_rgb_alpha);
+	if (std::string_view(file).ends_with(".ktx2"))
+	{
+		if (!Ktx2::Load(file, textureDesc, outImage))
+		{
+			LOG_CORE_WARN("Failed to load texture file: {}", file);
+		}
+		return;
+	}
+
+	if (textureDesc.compress && TextureCompression::LoadCached(file, textureDesc, outImage))
+	{
+		return;
+	}
+
+	// stb reads the compressed file straight from the mapping instead of through stdio buffers
+	MappedFile source;
+	stbi_uc* pixels = nullptr;
+	const uint32_t channels = TextureUtil::GetChannelCount(textureDesc.format);
+	if (source.open(file))
+	{
+		int sourceChannels = 0;
+		pixels = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &outImage.texWidth, &outImage.texHeight, &sourceChannels, static_cast<int>(channels));
+	}
 
 	if (!pixels)
 	{
-		LOG_CORE_WARN("Failed to load texture file: " + *file);
+		LOG_CORE_WARN("Failed to load texture file: {}", file);
 		return;
 	}
 
 	outImage.desc = textureDesc;
 	outImage.ptr = pixels;
+	outImage.texChannels = static_cast<int>(channels);
+
+	if (textureDesc.compress)
+	{
+		TextureCompression::CompressTexture(outImage);
+		TextureCompression::StoreCached(file, outImage);
+	}
+}
+
+void RenderableTypes::TextureUtil::LoadTextures(std::span<const TextureLoadRequest> requests, const std::function<void(uint32_t index, Texture& texture)>& onLoaded)
+{
+	ZoneScoped;
+	const uint32_t requestCount = static_cast<uint32_t>(requests.size());
+	if (Jobs::JobSystem::ptr == nullptr)
+	{
+		for (uint32_t i = 0; i < requestCount; ++i)
+		{
+			Texture texture;
+			LoadTextureFromFile(requests[i].path.c_str(), requests[i].desc, texture);
+			onLoaded(i, texture);
+		}
+		return;
+	}
+
+	// every decode owns its texture, finished ones are queued by index for the calling thread to hand out
+	std::vector<std::unique_ptr<Texture>> textures(requestCount);
+	std::vector<uint32_t> finished;
+	finished.reserve(requestCount);
+	std::mutex finishedMutex;
+
+	Jobs::Counter counter;
+	for (uint32_t i = 0; i < requestCount; ++i)
+	{
+		textures[i] = std::make_unique<Texture>();
+		Jobs::JobSystem::ptr->run([&requests, &textures, &finished, &finishedMutex, i]() {
+			LoadTextureFromFile(requests[i].path.c_str(), requests[i].desc, *textures[i]);
+			std::lock_guard<std::mutex> lock(finishedMutex);
+			finished.push_back(i);
+			}, counter);
+	}
+
+	// the calling thread decodes too while nothing is ready for it
+	std::vector<uint32_t> ready;
+	uint32_t handedOut = 0;
+	while (handedOut < requestCount)
+	{
+		Jobs::JobSystem::ptr->waitUntil([&finished, &finishedMutex]() {
+			std::lock_guard<std::mutex> lock(finishedMutex);
+			return !finished.empty();
+			});
+		{
+			std::lock_guard<std::mutex> lock(finishedMutex);
+			ready.swap(finished);
+		}
+		for (const uint32_t index : ready)
+		{
+			onLoaded(index, *textures[index]);
+			textures[index].reset();
+		}
+		handedOut += static_cast<uint32_t>(ready.size());
+		ready.clear();
+	}
+	Jobs::JobSystem::ptr->wait(counter);
+}
+
+RenderableTypes::TextureDesc::Format RenderableTypes::TextureUtil::GetFormatFromName(const char* file)
+{
+	const std::string name = std::filesystem::path(file).stem().string();
+	if (name.find("_normal") != std::string::npos)
+	{
+		return TextureDesc::Format::NORMAL;
+	}
+	if (name.find("_orm") != std::string::npos)
+	{
+		return TextureDesc::Format::ORM;
+	}
+	if (name.find("_depth") != std::string::npos)
+	{
+		return TextureDesc::Format::R8;
+	}
+	return TextureDesc::Format::DEFAULT;
+}
+
+uint32_t RenderableTypes::TextureUtil::GetChannelCount(TextureDesc::Format format)
+{
+	switch (format)
+	{
+	case TextureDesc::Format::R8:
+		return 1;
+	case TextureDesc::Format::NORMAL:
+	case TextureDesc::Format::RG8:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+uint32_t RenderableTypes::TextureUtil::GetMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t mipCount = 1;
+	while ((std::max(width, height) >> mipCount) > 0)
+	{
+		++mipCount;
+	}
+	return mipCount;
+}
+
+// Unpacks one RGBA8 texel into four floats
+static __m128 loadTexel(const uint8_t* texel)
+{
+	uint32_t packed;
+	memcpy(&packed, texel, sizeof(packed));
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(packed)), zero);
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+}
+
+// Hands every 2x2 block to encode, which packs the filtered texel into the low channels of its result. Odd
+// edges repeat their last texel.
+template<typename EncodeFunc>
+static void downsampleRows(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint32_t channels,
+	uint8_t* destination, uint32_t width, uint32_t beginRow, uint32_t endRow, const EncodeFunc& encode)
+{
+	for (uint32_t y = beginRow; y < endRow; ++y)
+	{
+		const uint8_t* row0 = source + static_cast<size_t>(std::min(2 * y, sourceHeight - 1)) * sourceWidth * channels;
+		const uint8_t* row1 = source + static_cast<size_t>(std::min(2 * y + 1, sourceHeight - 1)) * sourceWidth * channels;
+		uint8_t* outRow = destination + static_cast<size_t>(y) * width * channels;
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			const uint32_t x0 = std::min(2 * x, sourceWidth - 1) * channels;
+			const uint32_t x1 = std::min(2 * x + 1, sourceWidth - 1) * channels;
+			const uint8_t* texels[4] = { row0 + x0, row0 + x1, row1 + x0, row1 + x1 };
+			const uint32_t packed = encode(texels);
+			memcpy(outRow + static_cast<size_t>(x) * channels, &packed, channels);
+		}
+	}
+}
+
+static uint32_t packTexel(__m128 texel)
+{
+	const __m128i encoded = _mm_cvttps_epi32(texel);
+	const __m128i words = _mm_packs_epi32(encoded, encoded);
+	return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+}
+
+// Unpacks one RG8 normal into xyz, z is the positive root that makes it unit length
+static __m128 loadNormal(const uint8_t* texel)
+{
+	const float x = texel[0] * (2.0f / 255.0f) - 1.0f;
+	const float y = texel[1] * (2.0f / 255.0f) - 1.0f;
+	return _mm_setr_ps(x, y, std::sqrt(std::max(1.0f - x * x - y * y, 0.0f)), 0.0f);
+}
+
+static uint32_t encodeNormal(const uint8_t* const texels[4])
+{
+	const __m128 encodeScale = _mm_setr_ps(127.5f, 127.5f, 127.5f, 0.0f);
+	const __m128 encodeBias = _mm_setr_ps(127.5f + 0.5f, 127.5f + 0.5f, 127.5f + 0.5f, 0.0f);
+
+	// renormalise the sum, a flat average of unit vectors comes out shorter the more they disagree
+	const __m128 xyz = _mm_add_ps(_mm_add_ps(loadNormal(texels[0]), loadNormal(texels[1])), _mm_add_ps(loadNormal(texels[2]), loadNormal(texels[3])));
+	__m128 lengthSquared = _mm_mul_ps(xyz, xyz);
+	lengthSquared = _mm_add_ps(lengthSquared, _mm_shuffle_ps(lengthSquared, lengthSquared, _MM_SHUFFLE(2, 3, 0, 1)));
+	lengthSquared = _mm_add_ps(lengthSquared, _mm_shuffle_ps(lengthSquared, lengthSquared, _MM_SHUFFLE(1, 0, 3, 2)));
+	const __m128 length = _mm_sqrt_ps(_mm_max_ps(lengthSquared, _mm_set1_ps(1e-12f)));
+	const __m128 normal = _mm_div_ps(xyz, length);
+	// opposing normals cancel out, point those straight up
+	const __m128 degenerate = _mm_cmplt_ps(lengthSquared, _mm_set1_ps(1e-8f));
+	const __m128 up = _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f);
+	const __m128 texel = _mm_or_ps(_mm_and_ps(degenerate, up), _mm_andnot_ps(degenerate, normal));
+
+	// only x and y are kept
+	return packTexel(_mm_add_ps(_mm_mul_ps(texel, encodeScale), encodeBias));
+}
+
+static uint32_t encodeLinear(const uint8_t* const texels[4])
+{
+	const __m128 sum = _mm_add_ps(_mm_add_ps(loadTexel(texels[0]), loadTexel(texels[1])), _mm_add_ps(loadTexel(texels[2]), loadTexel(texels[3])));
+	return packTexel(_mm_add_ps(_mm_mul_ps(sum, _mm_set1_ps(0.25f)), _mm_set1_ps(0.5f)));
+}
+
+// One and two channel texels are too narrow for a four byte load, they are averaged one channel at a time
+template<uint32_t CHANNELS>
+static uint32_t encodeLinearNarrow(const uint8_t* const texels[4])
+{
+	uint32_t packed = 0;
+	for (uint32_t channel = 0; channel < CHANNELS; ++channel)
+	{
+		const uint32_t sum = texels[0][channel] + texels[1][channel] + texels[2][channel] + texels[3][channel];
+		packed |= ((sum + 2) / 4) << (channel * 8);
+	}
+	return packed;
+}
+
+// sRGB to linear for every 8 bit value, linear back to sRGB at 12 bits of linear precision
+struct SrgbTables
+{
+	float toLinear[256];
+	uint8_t toSrgb[4096];
+
+	SrgbTables()
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			const float value = i / 255.0f;
+			toLinear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+		for (uint32_t i = 0; i < 4096; ++i)
+		{
+			const float value = i / 4095.0f;
+			const float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+			toSrgb[i] = static_cast<uint8_t>(srgb * 255.0f + 0.5f);
+		}
+	}
+};
+
+static uint32_t encodeSrgb(const uint8_t* const texels[4])
+{
+	static const SrgbTables tables;
+	// rgb averages in linear space, alpha is already linear
+	__m128 sum = _mm_setzero_ps();
+	for (int i = 0; i < 4; ++i)
+	{
+		sum = _mm_add_ps(sum, _mm_setr_ps(tables.toLinear[texels[i][0]], tables.toLinear[texels[i][1]], tables.toLinear[texels[i][2]], texels[i][3]));
+	}
+	alignas(16) int32_t linear[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(linear), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(sum, _mm_setr_ps(4095.0f / 4.0f, 4095.0f / 4.0f, 4095.0f / 4.0f, 0.25f)), _mm_set1_ps(0.5f))));
+	return tables.toSrgb[linear[0]] | (tables.toSrgb[linear[1]] << 8) | (tables.toSrgb[linear[2]] << 16) | (static_cast<uint32_t>(linear[3]) << 24);
+}
+
+// Appends levels 1 and up, each filtered from the one above by encode
+template<typename EncodeFunc>
+static void generateMipChain(const uint8_t* level0, uint32_t width, uint32_t height, uint32_t channels, std::vector<uint8_t>& outMips, const EncodeFunc& encode)
+{
+	const uint32_t mipCount = RenderableTypes::TextureUtil::GetMipCount(width, height);
+	size_t totalSize = 0;
+	for (uint32_t mip = 1; mip < mipCount; ++mip)
+	{
+		totalSize += static_cast<size_t>(std::max(width >> mip, 1U)) * std::max(height >> mip, 1U) * channels;
+	}
+	const size_t firstOffset = outMips.size();
+	outMips.resize(firstOffset + totalSize);
+
+	const uint8_t* source = level0;
+	uint32_t sourceWidth = width;
+	uint32_t sourceHeight = height;
+	size_t offset = firstOffset;
+	for (uint32_t mip = 1; mip < mipCount; ++mip)
+	{
+		const uint32_t mipWidth = std::max(width >> mip, 1U);
+		const uint32_t mipHeight = std::max(height >> mip, 1U);
+		uint8_t* destination = outMips.data() + offset;
+		const auto downsample = [=, &encode](uint32_t begin, uint32_t end) {
+			downsampleRows(source, sourceWidth, sourceHeight, channels, destination, mipWidth, begin, end, encode);
+		};
+		// the big levels are split across the job threads
+		constexpr uint32_t ROWS_PER_JOB = 32;
+		if (Jobs::JobSystem::ptr != nullptr)
+		{
+			Jobs::JobSystem::ptr->parallelFor(mipHeight, ROWS_PER_JOB, downsample);
+		}
+		else
+		{
+			downsample(0, mipHeight);
+		}
+
+		source = destination;
+		sourceWidth = mipWidth;
+		sourceHeight = mipHeight;
+		offset += static_cast<size_t>(mipWidth) * mipHeight * channels;
+	}
+}
+
+void RenderableTypes::TextureUtil::GenerateNormalMips(const uint8_t* level0, uint32_t width, uint32_t height, std::vector<uint8_t>& outMips)
+{
+	ZoneScoped;
+	generateMipChain(level0, width, height, 2, outMips, encodeNormal);
+}
+
+void RenderableTypes::TextureUtil::GenerateMips(const uint8_t* level0, uint32_t width, uint32_t height, uint32_t channels, bool srgb, std::vector<uint8_t>& outMips)
+{
+	ZoneScoped;
+	switch (channels)
+	{
+	case 1:
+		generateMipChain(level0, width, height, channels, outMips, encodeLinearNarrow<1>);
+		break;
+	case 2:
+		generateMipChain(level0, width, height, channels, outMips, encodeLinearNarrow<2>);
+		break;
+	default:
+		if (srgb)
+		{
+			generateMipChain(level0, width, height, channels, outMips, encodeSrgb);
+		}
+		else
+		{
+			generateMipChain(level0, width, height, channels, outMips, encodeLinear);
+		}
+		break;
+	}
+}
+
+void RenderableTypes::TextureUtil::BuildMipChain(Texture& texture)
+{
+	ZoneScoped;
+	if (texture.ptr == nullptr || !texture.levels.empty())
+	{
+		return;
+	}
+
+	const uint32_t width = static_cast<uint32_t>(texture.texWidth);
+	const uint32_t height = static_cast<uint32_t>(texture.texHeight);
+	const uint32_t channels = static_cast<uint32_t>(texture.texChannels);
+	const uint8_t* level0 = static_cast<const uint8_t*>(texture.ptr);
+	texture.blocks.assign(level0, level0 + static_cast<size_t>(width) * height * channels);
+	if (texture.desc.format == TextureDesc::Format::NORMAL)
+	{
+		GenerateNormalMips(level0, width, height, texture.blocks);
+	}
+	else
+	{
+		GenerateMips(level0, width, height, channels, texture.desc.format == TextureDesc::Format::DEFAULT, texture.blocks);
+	}
+
+	// the levels only point into blocks once it has stopped growing
+	const uint32_t mipCount = GetMipCount(width, height);
+	size_t offset = 0;
+	for (uint32_t mip = 0; mip < mipCount; ++mip)
+	{
+		const size_t levelSize = static_cast<size_t>(std::max(width >> mip, 1U)) * std::max(height >> mip, 1U) * channels;
+		texture.levels.emplace_back(texture.blocks.data() + offset, levelSize);
+		offset += levelSize;
+	}
 
-	return;
+	stbi_image_free(texture.ptr);
+	texture.ptr = nullptr;
 }
@@ -0,0 +1,299 @@
+#include "SceneGraph.h"
+
+#include <public/tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <type_traits>
+
+#include "Jobs/JobSystem.h"
+
+constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+constexpr uint32_t SCENE_GRAPH_JOB_GRAIN = 512;
+
+SceneNodeHandle SceneGraph::createNode(SceneNodeHandle parent, std::string name)
+{
+	SceneNodeHandle handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else
+	{
+		handle = static_cast<SceneNodeHandle>(handleToIndex.size());
+		handleToIndex.push_back(INVALID_INDEX);
+	}
+
+	// appended out of order, the next update sorts it in below its parent
+	handleToIndex[handle] = static_cast<uint32_t>(handles.size());
+	handles.push_back(handle);
+	parents.push_back(parent == INVALID_SCENE_NODE ? INVALID_INDEX : handleToIndex[parent]);
+	firstChildren.push_back(0);
+	childCounts.push_back(0);
+	localTranslations.emplace_back(0.0f);
+	localRotations.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+	localScales.emplace_back(1.0f);
+	worldMatrices.emplace_back(1.0f);
+	dirty.push_back(0);
+	destroyed.push_back(0);
+	names.push_back(std::move(name));
+	layoutDirty = true;
+	return handle;
+}
+
+void SceneGraph::destroyNode(SceneNodeHandle handle)
+{
+	// the layout rebuild drops everything it can't reach from a root
+	destroyed[handleToIndex[handle]] = 1;
+	layoutDirty = true;
+}
+
+void SceneGraph::setLocalTransform(SceneNodeHandle handle, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+	const uint32_t index = handleToIndex[handle];
+	localTranslations[index] = translation;
+	localRotations[index] = rotation;
+	localScales[index] = scale;
+	markDirty(index);
+}
+
+void SceneGraph::setLocalTranslation(SceneNodeHandle handle, const glm::vec3& translation)
+{
+	const uint32_t index = handleToIndex[handle];
+	localTranslations[index] = translation;
+	markDirty(index);
+}
+
+void SceneGraph::markDirty(uint32_t index)
+{
+	if (dirty[index] == 0)
+	{
+		dirty[index] = 1;
+		dirtyNodes.push_back(index);
+	}
+}
+
+void SceneGraph::update()
+{
+	ZoneScoped;
+	std::vector<uint32_t> subtreeRoots;
+	if (layoutDirty)
+	{
+		// the rebuild moves the nodes and clears every dirty flag, the old indices can be past the new end
+		dirtyNodes.clear();
+		rebuildLayout();
+		// every level is one contiguous range from the roots down
+		for (uint32_t i = 0; i < roots.size(); ++i)
+		{
+			subtreeRoots.push_back(i);
+		}
+	}
+	else
+	{
+		// a dirty node below another dirty node is recomputed with it
+		for (const uint32_t index : dirtyNodes)
+		{
+			uint32_t ancestor = parents[index];
+			while (ancestor != INVALID_INDEX && dirty[ancestor] == 0)
+			{
+				ancestor = parents[ancestor];
+			}
+			if (ancestor == INVALID_INDEX)
+			{
+				subtreeRoots.push_back(index);
+			}
+		}
+		std::sort(subtreeRoots.begin(), subtreeRoots.end());
+
+		for (const uint32_t index : dirtyNodes)
+		{
+			dirty[index] = 0;
+		}
+		dirtyNodes.clear();
+	}
+
+	updatedNodeCount = 0;
+	updateSubtrees(subtreeRoots);
+}
+
+uint32_t SceneGraph::getLevel(uint32_t index) const
+{
+	return static_cast<uint32_t>(std::upper_bound(levelStarts.begin(), levelStarts.end(), index) - levelStarts.begin()) - 1;
+}
+
+void SceneGraph::updateSubtrees(const std::vector<uint32_t>& subtreeRoots)
+{
+	ZoneScoped;
+	// the part of every subtree on the current level, subtrees are joined by the roots on their level as the walk reaches it
+	std::vector<std::pair<uint32_t, uint32_t>> ranges;
+	std::vector<std::pair<uint32_t, uint32_t>> nextRanges;
+	std::vector<uint32_t> rangeOffsets;
+	size_t nextRoot = 0;
+	uint32_t level = 0;
+	while (!ranges.empty() || nextRoot < subtreeRoots.size())
+	{
+		if (ranges.empty())
+		{
+			level = getLevel(subtreeRoots[nextRoot]);
+		}
+		while (nextRoot < subtreeRoots.size() && getLevel(subtreeRoots[nextRoot]) == level)
+		{
+			ranges.emplace_back(subtreeRoots[nextRoot], subtreeRoots[nextRoot] + 1);
+			++nextRoot;
+		}
+
+		// the ranges are flattened into one index space so a level full of small subtrees still splits evenly
+		rangeOffsets.clear();
+		uint32_t levelCount = 0;
+		for (const auto& [begin, end] : ranges)
+		{
+			rangeOffsets.push_back(levelCount);
+			levelCount += end - begin;
+		}
+
+		// parents are on the level above, which is already done
+		Jobs::JobSystem::ptr->parallelFor(levelCount, SCENE_GRAPH_JOB_GRAIN, [this, &ranges, &rangeOffsets](uint32_t begin, uint32_t end) {
+			size_t range = std::upper_bound(rangeOffsets.begin(), rangeOffsets.end(), begin) - rangeOffsets.begin() - 1;
+			for (uint32_t flatIndex = begin; flatIndex < end; ++flatIndex)
+			{
+				while (range + 1 < rangeOffsets.size() && flatIndex >= rangeOffsets[range + 1])
+				{
+					++range;
+				}
+				const uint32_t index = ranges[range].first + (flatIndex - rangeOffsets[range]);
+
+				glm::mat4 local = glm::mat4_cast(localRotations[index]);
+				local[0] *= localScales[index].x;
+				local[1] *= localScales[index].y;
+				local[2] *= localScales[index].z;
+				local[3] = glm::vec4(localTranslations[index], 1.0f);
+				worldMatrices[index] = parents[index] == INVALID_INDEX ? local : worldMatrices[parents[index]] * local;
+			}
+			});
+		updatedNodeCount += levelCount;
+
+		// the children of a range of nodes on one level are a range on the next
+		nextRanges.clear();
+		for (const auto& [begin, end] : ranges)
+		{
+			const uint32_t childBegin = firstChildren[begin];
+			const uint32_t childEnd = firstChildren[end - 1] + childCounts[end - 1];
+			if (childBegin < childEnd)
+			{
+				nextRanges.emplace_back(childBegin, childEnd);
+			}
+		}
+		std::swap(ranges, nextRanges);
+		++level;
+	}
+}
+
+void SceneGraph::rebuildLayout()
+{
+	ZoneScoped;
+	const uint32_t nodeCount = static_cast<uint32_t>(handles.size());
+
+	// live children of every node in the old order, grouped by parent with a counting sort
+	std::vector<uint32_t> childStarts(nodeCount + 1, 0);
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		if (destroyed[i] == 0 && parents[i] != INVALID_INDEX)
+		{
+			++childStarts[parents[i] + 1];
+		}
+	}
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		childStarts[i + 1] += childStarts[i];
+	}
+	std::vector<uint32_t> children(childStarts[nodeCount]);
+	std::vector<uint32_t> childCursor(childStarts.begin(), childStarts.end() - 1);
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		if (destroyed[i] == 0 && parents[i] != INVALID_INDEX)
+		{
+			children[childCursor[parents[i]]++] = i;
+		}
+	}
+
+	// breadth first from the roots, anything below a destroyed node is never reached
+	std::vector<uint32_t> order;
+	order.reserve(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		if (destroyed[i] == 0 && parents[i] == INVALID_INDEX)
+		{
+			order.push_back(i);
+		}
+	}
+	const uint32_t rootCount = static_cast<uint32_t>(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const uint32_t node = order[i];
+		order.insert(order.end(), children.begin() + childStarts[node], children.begin() + childStarts[node + 1]);
+	}
+
+	std::vector<uint32_t> newIndices(nodeCount, INVALID_INDEX);
+	for (uint32_t i = 0; i < order.size(); ++i)
+	{
+		newIndices[order[i]] = i;
+	}
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		if (newIndices[i] == INVALID_INDEX)
+		{
+			handleToIndex[handles[i]] = INVALID_INDEX;
+			freeHandles.push_back(handles[i]);
+		}
+	}
+
+	const auto reorder = [&order](auto& values) {
+		std::remove_reference_t<decltype(values)> sorted;
+		sorted.reserve(order.size());
+		for (const uint32_t oldIndex : order)
+		{
+			sorted.push_back(std::move(values[oldIndex]));
+		}
+		values = std::move(sorted);
+	};
+	reorder(handles);
+	reorder(parents);
+	reorder(localTranslations);
+	reorder(localRotations);
+	reorder(localScales);
+	reorder(worldMatrices);
+	reorder(names);
+
+	const uint32_t newCount = static_cast<uint32_t>(order.size());
+	firstChildren.resize(newCount);
+	childCounts.resize(newCount);
+	dirty.assign(newCount, 0);
+	destroyed.assign(newCount, 0);
+	roots.assign(handles.begin(), handles.begin() + rootCount);
+	levelStarts.clear();
+
+	// children were queued in the order of their parents, so they start where the previous node's children end
+	uint32_t nextChild = rootCount;
+	uint32_t level = 0;
+	std::vector<uint32_t> levels(newCount, 0);
+	for (uint32_t i = 0; i < newCount; ++i)
+	{
+		const uint32_t oldIndex = order[i];
+		handleToIndex[handles[i]] = i;
+		if (parents[i] != INVALID_INDEX)
+		{
+			parents[i] = newIndices[parents[i]];
+			levels[i] = levels[parents[i]] + 1;
+		}
+		if (i == 0 || levels[i] != level)
+		{
+			level = levels[i];
+			levelStarts.push_back(i);
+		}
+
+		firstChildren[i] = nextChild;
+		childCounts[i] = childStarts[oldIndex + 1] - childStarts[oldIndex];
+		nextChild += childCounts[i];
+	}
+	layoutDirty = false;
+}
@@ -0,0 +1,568 @@
+#include "Structures/BVH.h"
+
+#include <public/tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <queue>
+
+#include "Jobs/JobSystem.h"
+
+constexpr uint32_t SAH_BINS = 16;
+constexpr uint32_t MAX_LEAF_OBJECTS = 4;
+// Cost of visiting a node relative to testing one object box
+constexpr float TRAVERSAL_COST = 1.0f;
+// Past this depth splits halve the object count, which keeps the traversal stacks from overflowing
+constexpr uint32_t MAX_SAH_DEPTH = 192;
+constexpr uint32_t TRAVERSAL_STACK_SIZE = 256;
+// Subtrees at least this large build their two halves as separate jobs
+constexpr uint32_t PARALLEL_BUILD_OBJECTS = 8192;
+// Refit splits into jobs down to this depth on trees of at least PARALLEL_BUILD_OBJECTS objects
+constexpr uint32_t PARALLEL_REFIT_DEPTH = 5;
+// A subtree whose surface area grew by this factor since it was built is a candidate for a rebuild
+constexpr float REBUILD_AREA_GROWTH = 1.5f;
+
+static AABB nodeBounds(const BVH::Node& node)
+{
+	return AABB{ .min = node.boundsMin, .max = node.boundsMax };
+}
+
+// Entry distance of the ray into the box, clamped to the ray start, or false if it misses before maxDistance
+static bool intersectRay(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& origin, const glm::vec3& inverseDirection,
+	float maxDistance, float& outDistance)
+{
+	const glm::vec3 t0 = (boxMin - origin) * inverseDirection;
+	const glm::vec3 t1 = (boxMax - origin) * inverseDirection;
+	const glm::vec3 tNear = glm::min(t0, t1);
+	const glm::vec3 tFar = glm::max(t0, t1);
+	const float entry = std::max({ tNear.x, tNear.y, tNear.z, 0.0f });
+	const float exit = std::min({ tFar.x, tFar.y, tFar.z });
+	outDistance = entry;
+	return entry <= exit && entry < maxDistance;
+}
+
+void BVH::build(const std::vector<AABB>& bounds)
+{
+	ZoneScoped;
+	const uint32_t count = static_cast<uint32_t>(bounds.size());
+	objectIndices.resize(count);
+	objectBounds.resize(count);
+	buildObjects.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		buildObjects[i] = { .bounds = bounds[i], .centre = bounds[i].centre(), .object = i };
+	}
+
+	const size_t nodeCount = count == 0 ? 0 : 2 * static_cast<size_t>(count) - 1;
+	nodes.assign(nodeCount, Node{});
+	builtArea.assign(nodeCount, 0.0f);
+	if (count > 0)
+	{
+		buildNode(0, 1, 0, count, 0);
+	}
+}
+
+void BVH::buildNode(uint32_t nodeIndex, uint32_t childBase, uint32_t first, uint32_t count, uint32_t depth)
+{
+	AABB bounds;
+	AABB centreBounds;
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		bounds.grow(buildObjects[i].bounds);
+		centreBounds.grow(buildObjects[i].centre);
+	}
+
+	Node& node = nodes[nodeIndex];
+	node.boundsMin = bounds.min;
+	node.boundsMax = bounds.max;
+	builtArea[nodeIndex] = bounds.surfaceArea();
+
+	if (count == 1)
+	{
+		makeLeaf(node, first, count);
+		return;
+	}
+
+	// binned surface area heuristic, the cost of a split is each side's area times its object count
+	int bestAxis = -1;
+	uint32_t bestSplit = 0;
+	float bestCost = std::numeric_limits<float>::max();
+	if (depth < MAX_SAH_DEPTH)
+	{
+		struct Bin
+		{
+			AABB bounds;
+			uint32_t count = 0;
+		};
+		// small nodes don't need the full resolution, one pass bins all three axes
+		const uint32_t binCount = std::min(SAH_BINS, count);
+		Bin bins[3][SAH_BINS];
+		const glm::vec3 extent = centreBounds.max - centreBounds.min;
+		const glm::vec3 scale = glm::vec3(static_cast<float>(binCount)) / glm::max(extent, glm::vec3{ std::numeric_limits<float>::min() });
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			const glm::vec3 binPosition = (buildObjects[i].centre - centreBounds.min) * scale;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				Bin& bin = bins[axis][std::min(binCount - 1, static_cast<uint32_t>(binPosition[axis]))];
+				bin.bounds.grow(buildObjects[i].bounds);
+				++bin.count;
+			}
+		}
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (extent[axis] <= 0.0f)
+			{
+				continue;
+			}
+
+			float rightArea[SAH_BINS];
+			uint32_t rightCount[SAH_BINS];
+			AABB right;
+			uint32_t rightObjects = 0;
+			for (uint32_t bin = binCount - 1; bin > 0; --bin)
+			{
+				right.grow(bins[axis][bin].bounds);
+				rightObjects += bins[axis][bin].count;
+				rightArea[bin] = right.surfaceArea();
+				rightCount[bin] = rightObjects;
+			}
+
+			AABB left;
+			uint32_t leftObjects = 0;
+			for (uint32_t bin = 0; bin < binCount - 1; ++bin)
+			{
+				left.grow(bins[axis][bin].bounds);
+				leftObjects += bins[axis][bin].count;
+				if (leftObjects == 0 || rightCount[bin + 1] == 0)
+				{
+					continue;
+				}
+				const float cost = left.surfaceArea() * leftObjects + rightArea[bin + 1] * rightCount[bin + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = bin + 1;
+				}
+			}
+		}
+	}
+
+	const float leafCost = builtArea[nodeIndex] * count;
+	const float splitCost = builtArea[nodeIndex] * TRAVERSAL_COST + bestCost;
+	if (count <= MAX_LEAF_OBJECTS && (bestAxis < 0 || leafCost <= splitCost))
+	{
+		makeLeaf(node, first, count);
+		return;
+	}
+
+	uint32_t leftCount = count / 2;
+	if (bestAxis >= 0)
+	{
+		// the same arithmetic as the binning, so every object lands on the side it was counted on
+		const uint32_t binCount = std::min(SAH_BINS, count);
+		const float axisMin = centreBounds.min[bestAxis];
+		const float scale = static_cast<float>(binCount) / std::max(centreBounds.max[bestAxis] - axisMin, std::numeric_limits<float>::min());
+		const auto middle = std::partition(buildObjects.begin() + first, buildObjects.begin() + first + count, [&](const BuildObject& object) {
+			return std::min(binCount - 1, static_cast<uint32_t>((object.centre[bestAxis] - axisMin) * scale)) < bestSplit;
+			});
+		leftCount = static_cast<uint32_t>(middle - (buildObjects.begin() + first));
+	}
+	else
+	{
+		// the centres coincide or the tree is too deep, any halving is as good as another
+		const int axis = depth < MAX_SAH_DEPTH ? 0 : static_cast<int>(depth % 3);
+		std::nth_element(buildObjects.begin() + first, buildObjects.begin() + first + leftCount, buildObjects.begin() + first + count,
+			[axis](const BuildObject& a, const BuildObject& b) { return a.centre[axis] < b.centre[axis]; });
+	}
+
+	// the left subtree owns 2 * leftCount - 2 nodes below its root, the right subtree's block follows it
+	node.first = childBase;
+	node.objectCount = 0;
+	const uint32_t leftChildBase = childBase + 2;
+	const uint32_t rightChildBase = childBase + 2 * leftCount;
+	const uint32_t rightFirst = first + leftCount;
+	const uint32_t rightCount = count - leftCount;
+
+	if (count >= PARALLEL_BUILD_OBJECTS && Jobs::JobSystem::ptr != nullptr)
+	{
+		Jobs::Counter counter;
+		Jobs::JobSystem::ptr->run([=, this]() {
+			buildNode(childBase, leftChildBase, first, leftCount, depth + 1);
+			}, counter);
+		buildNode(childBase + 1, rightChildBase, rightFirst, rightCount, depth + 1);
+		Jobs::JobSystem::ptr->wait(counter);
+	}
+	else
+	{
+		buildNode(childBase, leftChildBase, first, leftCount, depth + 1);
+		buildNode(childBase + 1, rightChildBase, rightFirst, rightCount, depth + 1);
+	}
+}
+
+void BVH::makeLeaf(Node& node, uint32_t first, uint32_t count)
+{
+	node.first = first;
+	node.objectCount = count;
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		objectIndices[i] = buildObjects[i].object;
+		objectBounds[i] = buildObjects[i].bounds;
+	}
+}
+
+void BVH::refit(const std::vector<AABB>& bounds)
+{
+	ZoneScoped;
+	if (!nodes.empty())
+	{
+		refitNode(0, 0, bounds);
+	}
+}
+
+void BVH::refitNode(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& objects)
+{
+	Node& node = nodes[nodeIndex];
+	AABB bounds;
+	if (node.objectCount > 0)
+	{
+		for (uint32_t i = node.first; i < node.first + node.objectCount; ++i)
+		{
+			objectBounds[i] = objects[objectIndices[i]];
+			bounds.grow(objectBounds[i]);
+		}
+	}
+	else
+	{
+		if (depth < PARALLEL_REFIT_DEPTH && objectIndices.size() >= PARALLEL_BUILD_OBJECTS && Jobs::JobSystem::ptr != nullptr)
+		{
+			Jobs::Counter counter;
+			Jobs::JobSystem::ptr->run([this, &node, depth, &objects]() { refitNode(node.first, depth + 1, objects); }, counter);
+			refitNode(node.first + 1, depth + 1, objects);
+			Jobs::JobSystem::ptr->wait(counter);
+		}
+		else
+		{
+			refitNode(node.first, depth + 1, objects);
+			refitNode(node.first + 1, depth + 1, objects);
+		}
+		bounds.grow(nodeBounds(nodes[node.first]));
+		bounds.grow(nodeBounds(nodes[node.first + 1]));
+	}
+	node.boundsMin = bounds.min;
+	node.boundsMax = bounds.max;
+}
+
+uint32_t BVH::update(const std::vector<AABB>& bounds, uint32_t maxRebuildObjects)
+{
+	ZoneScoped;
+	refit(bounds);
+	if (nodes.empty())
+	{
+		return 0;
+	}
+
+	// subtrees that grew too much, the ones that added the most surface area first. A subtree larger than the
+	// remaining budget gives way to the subtrees below it, so some of the damage is repaired every update.
+	struct Candidate
+	{
+		float addedArea;
+		uint32_t node;
+		uint32_t depth;
+
+		bool operator<(const Candidate& other) const { return addedArea < other.addedArea; }
+	};
+	std::priority_queue<Candidate> candidates;
+	std::vector<std::pair<uint32_t, uint32_t>> stack;
+	// the topmost subtrees below a node that grew past the threshold, children can grow while their parent didn't
+	const auto collectCandidates = [&](uint32_t rootIndex, uint32_t rootDepth) {
+		stack.assign(1, { rootIndex, rootDepth });
+		while (!stack.empty())
+		{
+			const auto [nodeIndex, depth] = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[nodeIndex];
+			if (node.objectCount > 0)
+			{
+				continue;
+			}
+
+			const float area = nodeBounds(node).surfaceArea();
+			if (area > builtArea[nodeIndex] * REBUILD_AREA_GROWTH || (builtArea[nodeIndex] == 0.0f && area > 0.0f))
+			{
+				candidates.push({ .addedArea = area - builtArea[nodeIndex], .node = nodeIndex, .depth = depth });
+				continue;
+			}
+			stack.emplace_back(node.first, depth + 1);
+			stack.emplace_back(node.first + 1, depth + 1);
+		}
+	};
+	collectCandidates(0, 0);
+
+	uint32_t rebuiltObjects = 0;
+	while (!candidates.empty() && rebuiltObjects < maxRebuildObjects)
+	{
+		const Candidate candidate = candidates.top();
+		candidates.pop();
+		const uint32_t nodeIndex = candidate.node;
+		const auto [first, end] = getObjectRange(nodeIndex);
+		const uint32_t count = end - first;
+		if (rebuiltObjects + count > maxRebuildObjects)
+		{
+			collectCandidates(nodes[nodeIndex].first, candidate.depth + 1);
+			collectCandidates(nodes[nodeIndex].first + 1, candidate.depth + 1);
+			continue;
+		}
+
+		for (uint32_t i = first; i < end; ++i)
+		{
+			buildObjects[i] = { .bounds = objectBounds[i], .centre = objectBounds[i].centre(), .object = objectIndices[i] };
+		}
+		buildNode(nodeIndex, nodes[nodeIndex].first, first, count, candidate.depth);
+		rebuiltObjects += count;
+	}
+	return rebuiltObjects;
+}
+
+std::pair<uint32_t, uint32_t> BVH::getObjectRange(uint32_t nodeIndex) const
+{
+	uint32_t leftmost = nodeIndex;
+	while (nodes[leftmost].objectCount == 0)
+	{
+		leftmost = nodes[leftmost].first;
+	}
+	uint32_t rightmost = nodeIndex;
+	while (nodes[rightmost].objectCount == 0)
+	{
+		rightmost = nodes[rightmost].first + 1;
+	}
+	return { nodes[leftmost].first, nodes[rightmost].first + nodes[rightmost].objectCount };
+}
+
+void BVH::appendObjects(uint32_t nodeIndex, std::vector<uint32_t>& outObjects) const
+{
+	const auto [first, end] = getObjectRange(nodeIndex);
+	outObjects.insert(outObjects.end(), objectIndices.begin() + first, objectIndices.begin() + end);
+}
+
+void BVH::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& outObjects) const
+{
+	ZoneScoped;
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	// the corner furthest along a plane's normal decides if the box is outside, the nearest if it is inside
+	const auto classify = [&frustum](const glm::vec3& boxMin, const glm::vec3& boxMax, bool& outInside) {
+		outInside = true;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			const glm::vec3 normal{ plane };
+			const glm::vec3 furthest = glm::mix(boxMin, boxMax, glm::greaterThanEqual(normal, glm::vec3{ 0.0f }));
+			if (glm::dot(normal, furthest) + plane.w < 0.0f)
+			{
+				return false;
+			}
+			const glm::vec3 nearest = glm::mix(boxMax, boxMin, glm::greaterThanEqual(normal, glm::vec3{ 0.0f }));
+			outInside = outInside && glm::dot(normal, nearest) + plane.w >= 0.0f;
+		}
+		return true;
+	};
+
+	uint32_t stack[TRAVERSAL_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		bool inside;
+		if (!classify(node.boundsMin, node.boundsMax, inside))
+		{
+			continue;
+		}
+		// nothing below a box inside every plane needs testing
+		if (inside)
+		{
+			appendObjects(static_cast<uint32_t>(&node - nodes.data()), outObjects);
+			continue;
+		}
+
+		if (node.objectCount > 0)
+		{
+			for (uint32_t i = node.first; i < node.first + node.objectCount; ++i)
+			{
+				const AABB& box = objectBounds[i];
+				if (classify(box.min, box.max, inside))
+				{
+					outObjects.push_back(objectIndices[i]);
+				}
+			}
+			continue;
+		}
+		stack[stackSize++] = node.first;
+		stack[stackSize++] = node.first + 1;
+	}
+}
+
+void BVH::querySphere(const glm::vec3& centre, float radius, std::vector<uint32_t>& outObjects) const
+{
+	ZoneScoped;
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	uint32_t stack[TRAVERSAL_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		if (!nodeBounds(node).overlapsSphere(centre, radius))
+		{
+			continue;
+		}
+
+		if (node.objectCount > 0)
+		{
+			for (uint32_t i = node.first; i < node.first + node.objectCount; ++i)
+			{
+				if (objectBounds[i].overlapsSphere(centre, radius))
+				{
+					outObjects.push_back(objectIndices[i]);
+				}
+			}
+			continue;
+		}
+		stack[stackSize++] = node.first;
+		stack[stackSize++] = node.first + 1;
+	}
+}
+
+void BVH::queryAABB(const AABB& box, std::vector<uint32_t>& outObjects) const
+{
+	ZoneScoped;
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	uint32_t stack[TRAVERSAL_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		if (!nodeBounds(node).overlaps(box))
+		{
+			continue;
+		}
+
+		if (node.objectCount > 0)
+		{
+			for (uint32_t i = node.first; i < node.first + node.objectCount; ++i)
+			{
+				if (objectBounds[i].overlaps(box))
+				{
+					outObjects.push_back(objectIndices[i]);
+				}
+			}
+			continue;
+		}
+		stack[stackSize++] = node.first;
+		stack[stackSize++] = node.first + 1;
+	}
+}
+
+std::optional<BVH::RayHit> BVH::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+	ZoneScoped;
+	std::optional<RayHit> hit;
+	if (nodes.empty())
+	{
+		return hit;
+	}
+
+	const glm::vec3 inverseDirection = 1.0f / direction;
+	float closest = maxDistance;
+	float distance;
+
+	uint32_t stack[TRAVERSAL_STACK_SIZE];
+	uint32_t stackSize = 0;
+	if (intersectRay(nodes[0].boundsMin, nodes[0].boundsMax, origin, inverseDirection, closest, distance))
+	{
+		stack[stackSize++] = 0;
+	}
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		// a closer hit may have been found since the node was pushed
+		if (!intersectRay(node.boundsMin, node.boundsMax, origin, inverseDirection, closest, distance))
+		{
+			continue;
+		}
+
+		if (node.objectCount > 0)
+		{
+			for (uint32_t i = node.first; i < node.first + node.objectCount; ++i)
+			{
+				const AABB& box = objectBounds[i];
+				if (intersectRay(box.min, box.max, origin, inverseDirection, closest, distance))
+				{
+					closest = distance;
+					hit = RayHit{ .object = objectIndices[i], .distance = distance };
+				}
+			}
+			continue;
+		}
+
+		// the nearer child is popped first
+		float leftDistance;
+		float rightDistance;
+		const Node& left = nodes[node.first];
+		const Node& right = nodes[node.first + 1];
+		const bool hitLeft = intersectRay(left.boundsMin, left.boundsMax, origin, inverseDirection, closest, leftDistance);
+		const bool hitRight = intersectRay(right.boundsMin, right.boundsMax, origin, inverseDirection, closest, rightDistance);
+		if (hitLeft && hitRight)
+		{
+			const bool leftFirst = leftDistance <= rightDistance;
+			stack[stackSize++] = leftFirst ? node.first + 1 : node.first;
+			stack[stackSize++] = leftFirst ? node.first : node.first + 1;
+		}
+		else if (hitLeft || hitRight)
+		{
+			stack[stackSize++] = hitLeft ? node.first : node.first + 1;
+		}
+	}
+	return hit;
+}
+
+float BVH::getCost() const
+{
+	if (nodes.empty())
+	{
+		return 0.0f;
+	}
+
+	float cost = 0.0f;
+	uint32_t stack[TRAVERSAL_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		const float area = nodeBounds(node).surfaceArea();
+		if (node.objectCount > 0)
+		{
+			cost += area * node.objectCount;
+			continue;
+		}
+		cost += area * TRAVERSAL_COST;
+		stack[stackSize++] = node.first;
+		stack[stackSize++] = node.first + 1;
+	}
+	const float rootArea = nodeBounds(nodes[0]).surfaceArea();
+	return rootArea > 0.0f ? cost / rootArea : 0.0f;
+}
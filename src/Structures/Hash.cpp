@@ -0,0 +1,95 @@
+#include "Structures/Hash.h"
+
+#include <cstring>
+
+constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+static uint64_t rotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// unaligned little endian reads, memcpy compiles to a single load
+static uint64_t read64(const uint8_t* bytes)
+{
+	uint64_t value;
+	std::memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+static uint32_t read32(const uint8_t* bytes)
+{
+	uint32_t value;
+	std::memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+static uint64_t accumulate(uint64_t accumulator, uint64_t input)
+{
+	accumulator += input * PRIME_2;
+	return rotateLeft(accumulator, 31) * PRIME_1;
+}
+
+static uint64_t mergeRound(uint64_t hash, uint64_t lane)
+{
+	hash ^= accumulate(0, lane);
+	return hash * PRIME_1 + PRIME_4;
+}
+
+uint64_t Hash::Hash64(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	const uint8_t* const end = bytes + size;
+	uint64_t hash;
+
+	if (size >= 32)
+	{
+		uint64_t lanes[4] = { seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1 };
+		for (const uint8_t* const limit = end - 32; bytes <= limit; bytes += 32)
+		{
+			lanes[0] = accumulate(lanes[0], read64(bytes));
+			lanes[1] = accumulate(lanes[1], read64(bytes + 8));
+			lanes[2] = accumulate(lanes[2], read64(bytes + 16));
+			lanes[3] = accumulate(lanes[3], read64(bytes + 24));
+		}
+		hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+		for (const uint64_t lane : lanes)
+		{
+			hash = mergeRound(hash, lane);
+		}
+	}
+	else
+	{
+		hash = seed + PRIME_5;
+	}
+	hash += static_cast<uint64_t>(size);
+
+	// the tail in 8, 4 and 1 byte steps
+	for (; bytes + 8 <= end; bytes += 8)
+	{
+		hash ^= accumulate(0, read64(bytes));
+		hash = rotateLeft(hash, 27) * PRIME_1 + PRIME_4;
+	}
+	if (bytes + 4 <= end)
+	{
+		hash ^= static_cast<uint64_t>(read32(bytes)) * PRIME_1;
+		hash = rotateLeft(hash, 23) * PRIME_2 + PRIME_3;
+		bytes += 4;
+	}
+	for (; bytes < end; ++bytes)
+	{
+		hash ^= static_cast<uint64_t>(*bytes) * PRIME_5;
+		hash = rotateLeft(hash, 11) * PRIME_1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME_2;
+	hash ^= hash >> 29;
+	hash *= PRIME_3;
+	hash ^= hash >> 32;
+	return hash;
+}
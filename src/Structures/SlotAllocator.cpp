@@ -0,0 +1,31 @@
+#include "Structures/SlotAllocator.h"
+
+void SlotAllocator::init(uint32_t slotCapacity)
+{
+	capacity = slotCapacity;
+	nextSlot = 0;
+	freeSlots.clear();
+}
+
+uint32_t SlotAllocator::allocate()
+{
+	if (!freeSlots.empty())
+	{
+		const uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+	if (nextSlot < capacity)
+	{
+		return nextSlot++;
+	}
+	return INVALID_SLOT;
+}
+
+void SlotAllocator::free(uint32_t slot)
+{
+	if (slot != INVALID_SLOT)
+	{
+		freeSlots.push_back(slot);
+	}
+}
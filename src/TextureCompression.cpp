@@ -0,0 +1,778 @@
+#include "TextureCompression.h"
+
+#include <public/tracy/Tracy.hpp>
+#include <emmintrin.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "Jobs/JobSystem.h"
+#include "Ktx2.h"
+#include "Log.h"
+
+// Bumped whenever the encoders change what they write
+constexpr uint32_t CACHE_VERSION = 3;
+constexpr const char* TEXTURE_CACHE_DIRECTORY = "../../assets/cache/";
+// Key/value entry of the cached KTX2 files, a CacheStamp
+constexpr const char* CACHE_STAMP_KEY = "VulkanRendererSource";
+constexpr uint32_t BLOCK_ROWS_PER_JOB = 4;
+// Interpolation weights of the BC7 4 bit indices, out of 64
+constexpr int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// 16 texels split per channel so four of them go through SSE at once
+struct BlockChannels
+{
+	alignas(16) float values[4][16];
+};
+
+static void splitChannels(const uint8_t* texels, BlockChannels& outBlock)
+{
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			outBlock.values[c][i] = texels[i * 4 + c];
+		}
+	}
+}
+
+static float horizontalSum(__m128 value)
+{
+	value = _mm_add_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+	value = _mm_add_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_cvtss_f32(value);
+}
+
+// Mean and principal axis of the first channelCount channels, the axis is left zero for a flat block
+static void fitAxis(const BlockChannels& block, int channelCount, float mean[4], float axis[4])
+{
+	__m128 centred[4][4];
+	for (int c = 0; c < 4; ++c)
+	{
+		mean[c] = 0.0f;
+		axis[c] = 0.0f;
+		if (c < channelCount)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int group = 0; group < 4; ++group)
+			{
+				sum = _mm_add_ps(sum, _mm_load_ps(block.values[c] + group * 4));
+			}
+			mean[c] = horizontalSum(sum) / 16.0f;
+		}
+		for (int group = 0; group < 4; ++group)
+		{
+			centred[c][group] = c < channelCount ? _mm_sub_ps(_mm_load_ps(block.values[c] + group * 4), _mm_set1_ps(mean[c])) : _mm_setzero_ps();
+		}
+	}
+
+	float covariance[4][4] = {};
+	int widest = 0;
+	for (int c = 0; c < channelCount; ++c)
+	{
+		for (int d = c; d < channelCount; ++d)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (int group = 0; group < 4; ++group)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(centred[c][group], centred[d][group]));
+			}
+			covariance[c][d] = covariance[d][c] = horizontalSum(sum);
+		}
+		if (covariance[c][c] > covariance[widest][widest])
+		{
+			widest = c;
+		}
+	}
+	if (covariance[widest][widest] < 1e-3f)
+	{
+		return;
+	}
+
+	// power iteration from the column of the channel that varies most
+	float direction[4] = { covariance[0][widest], covariance[1][widest], covariance[2][widest], covariance[3][widest] };
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = {};
+		float lengthSquared = 0.0f;
+		for (int c = 0; c < channelCount; ++c)
+		{
+			for (int d = 0; d < channelCount; ++d)
+			{
+				next[c] += covariance[c][d] * direction[d];
+			}
+			lengthSquared += next[c] * next[c];
+		}
+		if (lengthSquared < 1e-12f)
+		{
+			break;
+		}
+		const float inverseLength = 1.0f / std::sqrt(lengthSquared);
+		for (int c = 0; c < 4; ++c)
+		{
+			direction[c] = next[c] * inverseLength;
+		}
+	}
+	std::copy(direction, direction + 4, axis);
+}
+
+// Distance of every texel along direction from origin, in units of the direction's length
+static void project(const BlockChannels& block, int channelCount, const float origin[4], const float direction[4], float outDistances[16])
+{
+	for (int group = 0; group < 4; ++group)
+	{
+		__m128 distance = _mm_setzero_ps();
+		for (int c = 0; c < channelCount; ++c)
+		{
+			const __m128 offset = _mm_sub_ps(_mm_load_ps(block.values[c] + group * 4), _mm_set1_ps(origin[c]));
+			distance = _mm_add_ps(distance, _mm_mul_ps(offset, _mm_set1_ps(direction[c])));
+		}
+		_mm_storeu_ps(outDistances + group * 4, distance);
+	}
+}
+
+// Ends of the texels' spread along the principal axis
+static void fitEndpoints(const BlockChannels& block, int channelCount, float outEndpoints[2][4])
+{
+	float mean[4];
+	float axis[4];
+	fitAxis(block, channelCount, mean, axis);
+
+	float distances[16];
+	project(block, channelCount, mean, axis, distances);
+	const auto [lowest, highest] = std::minmax_element(distances, distances + 16);
+	for (int c = 0; c < 4; ++c)
+	{
+		outEndpoints[0][c] = std::clamp(mean[c] + axis[c] * *lowest, 0.0f, 255.0f);
+		outEndpoints[1][c] = std::clamp(mean[c] + axis[c] * *highest, 0.0f, 255.0f);
+	}
+}
+
+// Least squares endpoints for fixed interpolation weights, false if the weights can't separate them
+static bool solveEndpoints(const BlockChannels& block, int channelCount, const float weights[16], float outEndpoints[2][4])
+{
+	float a = 0.0f;
+	float b = 0.0f;
+	float c = 0.0f;
+	for (int i = 0; i < 16; ++i)
+	{
+		a += (1.0f - weights[i]) * (1.0f - weights[i]);
+		b += (1.0f - weights[i]) * weights[i];
+		c += weights[i] * weights[i];
+	}
+	const float determinant = a * c - b * b;
+	if (std::abs(determinant) < 1e-6f)
+	{
+		return false;
+	}
+
+	for (int channel = 0; channel < channelCount; ++channel)
+	{
+		float first = 0.0f;
+		float second = 0.0f;
+		for (int i = 0; i < 16; ++i)
+		{
+			first += (1.0f - weights[i]) * block.values[channel][i];
+			second += weights[i] * block.values[channel][i];
+		}
+		outEndpoints[0][channel] = std::clamp((c * first - b * second) / determinant, 0.0f, 255.0f);
+		outEndpoints[1][channel] = std::clamp((a * second - b * first) / determinant, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+// Nearest of paletteSize evenly spread colours along the quantised endpoints for every texel, returns the squared error.
+// The projection picks a candidate and its neighbours are checked against the real palette, which isn't quite even.
+static float selectIndices(const BlockChannels& block, int channelCount, const float palette[][4], int paletteSize, int outPositions[16])
+{
+	float direction[4] = {};
+	float lengthSquared = 0.0f;
+	for (int c = 0; c < channelCount; ++c)
+	{
+		direction[c] = palette[paletteSize - 1][c] - palette[0][c];
+		lengthSquared += direction[c] * direction[c];
+	}
+
+	float distances[16] = {};
+	if (lengthSquared > 0.0f)
+	{
+		for (int c = 0; c < channelCount; ++c)
+		{
+			direction[c] *= (paletteSize - 1) / lengthSquared;
+		}
+		project(block, channelCount, palette[0], direction, distances);
+	}
+
+	float error = 0.0f;
+	for (int i = 0; i < 16; ++i)
+	{
+		const int guess = std::clamp(static_cast<int>(distances[i] + 0.5f), 0, paletteSize - 1);
+		float bestError = std::numeric_limits<float>::max();
+		for (int position = std::max(guess - 1, 0); position <= std::min(guess + 1, paletteSize - 1); ++position)
+		{
+			float texelError = 0.0f;
+			for (int c = 0; c < channelCount; ++c)
+			{
+				const float difference = block.values[c][i] - palette[position][c];
+				texelError += difference * difference;
+			}
+			if (texelError < bestError)
+			{
+				bestError = texelError;
+				outPositions[i] = position;
+			}
+		}
+		error += bestError;
+	}
+	return error;
+}
+
+// Packs fields into a block from the lowest bit up
+struct BlockWriter
+{
+	uint64_t words[2] = {};
+	uint32_t position = 0;
+
+	void write(uint64_t value, uint32_t count)
+	{
+		const uint32_t word = position / 64;
+		const uint32_t offset = position % 64;
+		words[word] |= value << offset;
+		if (offset + count > 64)
+		{
+			words[word + 1] |= value >> (64 - offset);
+		}
+		position += count;
+	}
+};
+
+static uint16_t quantise565(const float colour[4])
+{
+	const uint32_t r = static_cast<uint32_t>(colour[0] * (31.0f / 255.0f) + 0.5f);
+	const uint32_t g = static_cast<uint32_t>(colour[1] * (63.0f / 255.0f) + 0.5f);
+	const uint32_t b = static_cast<uint32_t>(colour[2] * (31.0f / 255.0f) + 0.5f);
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void expand565(uint16_t packed, float outColour[4])
+{
+	const uint32_t r = (packed >> 11) & 31;
+	const uint32_t g = (packed >> 5) & 63;
+	const uint32_t b = packed & 31;
+	outColour[0] = static_cast<float>((r << 3) | (r >> 2));
+	outColour[1] = static_cast<float>((g << 2) | (g >> 4));
+	outColour[2] = static_cast<float>((b << 3) | (b >> 2));
+	outColour[3] = 255.0f;
+}
+
+// Positions along the four colour palette from the first endpoint to the second, the error is returned
+static float fitBC1(const BlockChannels& block, const float endpoints[2][4], uint16_t outColours[2], int outPositions[16])
+{
+	outColours[0] = quantise565(endpoints[0]);
+	outColours[1] = quantise565(endpoints[1]);
+	float palette[4][4];
+	expand565(outColours[0], palette[0]);
+	expand565(outColours[1], palette[3]);
+	for (int c = 0; c < 4; ++c)
+	{
+		palette[1][c] = (2.0f * palette[0][c] + palette[3][c]) / 3.0f;
+		palette[2][c] = (palette[0][c] + 2.0f * palette[3][c]) / 3.0f;
+	}
+	return selectIndices(block, 3, palette, 4, outPositions);
+}
+
+void TextureCompression::CompressBlockBC1(const uint8_t* texels, uint8_t* outBlock)
+{
+	BlockChannels block;
+	splitChannels(texels, block);
+
+	float endpoints[2][4];
+	fitEndpoints(block, 3, endpoints);
+	uint16_t colours[2];
+	int positions[16];
+	float error = fitBC1(block, endpoints, colours, positions);
+
+	// one least squares pass over the chosen positions
+	float weights[16];
+	for (int i = 0; i < 16; ++i)
+	{
+		weights[i] = positions[i] / 3.0f;
+	}
+	if (solveEndpoints(block, 3, weights, endpoints))
+	{
+		uint16_t refinedColours[2];
+		int refinedPositions[16];
+		const float refinedError = fitBC1(block, endpoints, refinedColours, refinedPositions);
+		if (refinedError < error)
+		{
+			error = refinedError;
+			std::copy(refinedColours, refinedColours + 2, colours);
+			std::copy(refinedPositions, refinedPositions + 16, positions);
+		}
+	}
+
+	// the first colour must be the larger for the four colour mode, equal colours only ever use it
+	if (colours[0] < colours[1])
+	{
+		std::swap(colours[0], colours[1]);
+		for (int& position : positions)
+		{
+			position = 3 - position;
+		}
+	}
+	else if (colours[0] == colours[1])
+	{
+		std::fill(positions, positions + 16, 0);
+	}
+
+	// palette order is first, second, then the two between them
+	constexpr uint32_t POSITION_TO_INDEX[4] = { 0, 2, 3, 1 };
+	uint32_t indices = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		indices |= POSITION_TO_INDEX[positions[i]] << (2 * i);
+	}
+	memcpy(outBlock, &colours[0], 2);
+	memcpy(outBlock + 2, &colours[1], 2);
+	memcpy(outBlock + 4, &indices, 4);
+}
+
+void TextureCompression::CompressBlockBC4(const uint8_t* texels, uint32_t channel, uint8_t* outBlock)
+{
+	uint8_t lowest = 255;
+	uint8_t highest = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		lowest = std::min(lowest, texels[i * 4 + channel]);
+		highest = std::max(highest, texels[i * 4 + channel]);
+	}
+
+	// the larger value first selects the eight value mode, a flat block only ever uses the first value
+	BlockWriter writer;
+	writer.write(highest, 8);
+	writer.write(lowest, 8);
+	if (highest != lowest)
+	{
+		const float scale = 7.0f / (highest - lowest);
+		for (int i = 0; i < 16; ++i)
+		{
+			const uint32_t position = static_cast<uint32_t>((highest - texels[i * 4 + channel]) * scale + 0.5f);
+			// palette order is highest, lowest, then the six between them
+			const uint32_t index = position == 0 ? 0 : position == 7 ? 1 : position + 1;
+			writer.write(index, 3);
+		}
+	}
+	memcpy(outBlock, writer.words, 8);
+}
+
+void TextureCompression::CompressBlockBC5(const uint8_t* texels, uint8_t* outBlock)
+{
+	CompressBlockBC4(texels, 0, outBlock);
+	CompressBlockBC4(texels, 1, outBlock + 8);
+}
+
+struct Bc7Endpoints
+{
+	// 7 bits per channel, the p-bit is the shared lowest bit of the 8 bit value
+	int colours[2][4];
+	int pBits[2];
+};
+
+// The p-bit is chosen for the whole endpoint, whichever brings all four channels closer
+static void quantiseBc7(const float endpoint[4], int outColour[4], int& outPBit)
+{
+	float bestError = std::numeric_limits<float>::max();
+	for (int pBit = 0; pBit < 2; ++pBit)
+	{
+		int colour[4];
+		float error = 0.0f;
+		for (int c = 0; c < 4; ++c)
+		{
+			colour[c] = std::clamp(static_cast<int>((endpoint[c] - pBit) * 0.5f + 0.5f), 0, 127);
+			const float difference = static_cast<float>(colour[c] * 2 + pBit) - endpoint[c];
+			error += difference * difference;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			outPBit = pBit;
+			std::copy(colour, colour + 4, outColour);
+		}
+	}
+}
+
+static float fitBC7(const BlockChannels& block, const float endpoints[2][4], Bc7Endpoints& outEndpoints, int outPositions[16])
+{
+	int expanded[2][4];
+	for (int e = 0; e < 2; ++e)
+	{
+		quantiseBc7(endpoints[e], outEndpoints.colours[e], outEndpoints.pBits[e]);
+		for (int c = 0; c < 4; ++c)
+		{
+			expanded[e][c] = outEndpoints.colours[e][c] * 2 + outEndpoints.pBits[e];
+		}
+	}
+
+	float palette[16][4];
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			palette[i][c] = static_cast<float>(((64 - BC7_WEIGHTS[i]) * expanded[0][c] + BC7_WEIGHTS[i] * expanded[1][c] + 32) >> 6);
+		}
+	}
+	return selectIndices(block, 4, palette, 16, outPositions);
+}
+
+void TextureCompression::CompressBlockBC7(const uint8_t* texels, uint8_t* outBlock)
+{
+	BlockChannels block;
+	splitChannels(texels, block);
+
+	float endpoints[2][4];
+	fitEndpoints(block, 4, endpoints);
+	Bc7Endpoints quantised;
+	int positions[16];
+	const float error = fitBC7(block, endpoints, quantised, positions);
+
+	float weights[16];
+	for (int i = 0; i < 16; ++i)
+	{
+		weights[i] = BC7_WEIGHTS[positions[i]] / 64.0f;
+	}
+	if (solveEndpoints(block, 4, weights, endpoints))
+	{
+		Bc7Endpoints refined;
+		int refinedPositions[16];
+		if (fitBC7(block, endpoints, refined, refinedPositions) < error)
+		{
+			quantised = refined;
+			std::copy(refinedPositions, refinedPositions + 16, positions);
+		}
+	}
+
+	// the first index drops its top bit, so it has to be in the lower half of the palette
+	if (positions[0] >= 8)
+	{
+		std::swap(quantised.colours[0], quantised.colours[1]);
+		std::swap(quantised.pBits[0], quantised.pBits[1]);
+		for (int& position : positions)
+		{
+			position = 15 - position;
+		}
+	}
+
+	BlockWriter writer;
+	writer.write(1 << 6, 7);
+	for (int c = 0; c < 4; ++c)
+	{
+		writer.write(quantised.colours[0][c], 7);
+		writer.write(quantised.colours[1][c], 7);
+	}
+	writer.write(quantised.pBits[0], 1);
+	writer.write(quantised.pBits[1], 1);
+	writer.write(positions[0], 3);
+	for (int i = 1; i < 16; ++i)
+	{
+		writer.write(positions[i], 4);
+	}
+	memcpy(outBlock, writer.words, 16);
+}
+
+RenderableTypes::BlockFormat TextureCompression::GetBlockFormat(RenderableTypes::TextureDesc::Format format)
+{
+	switch (format)
+	{
+	case RenderableTypes::TextureDesc::Format::NORMAL:
+		// z is rebuilt in the shader from x and y
+	case RenderableTypes::TextureDesc::Format::RG8:
+		return RenderableTypes::BlockFormat::BC5;
+	case RenderableTypes::TextureDesc::Format::R8:
+		return RenderableTypes::BlockFormat::BC4;
+	default:
+		return RenderableTypes::BlockFormat::BC7;
+	}
+}
+
+uint32_t TextureCompression::GetBlockSize(RenderableTypes::BlockFormat format)
+{
+	switch (format)
+	{
+	case RenderableTypes::BlockFormat::BC1:
+	case RenderableTypes::BlockFormat::BC4:
+		return 8;
+	case RenderableTypes::BlockFormat::BC5:
+	case RenderableTypes::BlockFormat::BC7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+size_t TextureCompression::GetLevelSize(RenderableTypes::BlockFormat format, uint32_t width, uint32_t height, uint32_t channels)
+{
+	if (format == RenderableTypes::BlockFormat::NONE)
+	{
+		return static_cast<size_t>(width) * height * channels;
+	}
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+}
+
+void TextureCompression::CompressLevel(RenderableTypes::BlockFormat format, const uint8_t* texels, uint32_t width, uint32_t height, uint32_t channels, uint8_t* outBlocks)
+{
+	ZoneScoped;
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+	const uint32_t blockSize = GetBlockSize(format);
+
+	const auto compressRows = [=](uint32_t begin, uint32_t end) {
+		// narrower texels are widened to RGBA8, missing colour channels read as 0 and alpha as 255
+		uint8_t block[64];
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			memcpy(block + i * 4, "\0\0\0\xff", 4);
+		}
+		for (uint32_t blockY = begin; blockY < end; ++blockY)
+		{
+			for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+			{
+				// blocks past the edge repeat the last row and column
+				for (uint32_t y = 0; y < 4; ++y)
+				{
+					const uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+					for (uint32_t x = 0; x < 4; ++x)
+					{
+						const uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+						memcpy(block + (y * 4 + x) * 4, texels + (static_cast<size_t>(sourceY) * width + sourceX) * channels, channels);
+					}
+				}
+
+				uint8_t* outBlock = outBlocks + (static_cast<size_t>(blockY) * blocksX + blockX) * blockSize;
+				switch (format)
+				{
+				case RenderableTypes::BlockFormat::BC1:
+					CompressBlockBC1(block, outBlock);
+					break;
+				case RenderableTypes::BlockFormat::BC4:
+					CompressBlockBC4(block, 0, outBlock);
+					break;
+				case RenderableTypes::BlockFormat::BC5:
+					CompressBlockBC5(block, outBlock);
+					break;
+				case RenderableTypes::BlockFormat::BC7:
+					CompressBlockBC7(block, outBlock);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+	};
+
+	if (Jobs::JobSystem::ptr != nullptr)
+	{
+		Jobs::JobSystem::ptr->parallelFor(blocksY, BLOCK_ROWS_PER_JOB, compressRows);
+	}
+	else
+	{
+		compressRows(0, blocksY);
+	}
+}
+
+void TextureCompression::CompressTexture(RenderableTypes::Texture& texture)
+{
+	ZoneScoped;
+	const uint32_t width = static_cast<uint32_t>(texture.texWidth);
+	const uint32_t height = static_cast<uint32_t>(texture.texHeight);
+	const uint32_t channels = static_cast<uint32_t>(texture.texChannels);
+	const uint8_t* level0 = static_cast<const uint8_t*>(texture.ptr);
+	const RenderableTypes::BlockFormat format = GetBlockFormat(texture.desc.format);
+
+	// the GPU can't filter into compressed levels, so the whole chain is built here
+	std::vector<uint8_t> mips;
+	if (texture.desc.format == RenderableTypes::TextureDesc::Format::NORMAL)
+	{
+		RenderableTypes::TextureUtil::GenerateNormalMips(level0, width, height, mips);
+	}
+	else
+	{
+		const bool srgb = texture.desc.format == RenderableTypes::TextureDesc::Format::DEFAULT;
+		RenderableTypes::TextureUtil::GenerateMips(level0, width, height, channels, srgb, mips);
+	}
+
+	const uint32_t mipCount = RenderableTypes::TextureUtil::GetMipCount(width, height);
+	size_t totalSize = 0;
+	for (uint32_t mip = 0; mip < mipCount; ++mip)
+	{
+		totalSize += GetLevelSize(format, std::max(width >> mip, 1U), std::max(height >> mip, 1U), channels);
+	}
+	texture.blocks.resize(totalSize);
+	texture.levels.clear();
+
+	const uint8_t* source = level0;
+	size_t blockOffset = 0;
+	for (uint32_t mip = 0; mip < mipCount; ++mip)
+	{
+		const uint32_t mipWidth = std::max(width >> mip, 1U);
+		const uint32_t mipHeight = std::max(height >> mip, 1U);
+		const size_t levelSize = GetLevelSize(format, mipWidth, mipHeight, channels);
+		CompressLevel(format, source, mipWidth, mipHeight, channels, texture.blocks.data() + blockOffset);
+		texture.levels.emplace_back(texture.blocks.data() + blockOffset, levelSize);
+		blockOffset += levelSize;
+		source = mip == 0 ? mips.data() : source + static_cast<size_t>(mipWidth) * mipHeight * channels;
+	}
+
+	stbi_image_free(texture.ptr);
+	texture.ptr = nullptr;
+	texture.blockFormat = format;
+}
+
+// The cached file is stale once the source's size or write time differ
+struct CacheStamp
+{
+	uint32_t version;
+	uint32_t padding;
+	uint64_t sourceSize;
+	int64_t sourceWriteTime;
+};
+
+// The key only has to be stable on one machine, the cache is never shared
+static std::filesystem::path getCachePath(const char* file, RenderableTypes::TextureDesc::Format format)
+{
+	std::error_code error;
+	const std::filesystem::path source = std::filesystem::absolute(file, error).lexically_normal();
+	const size_t key = std::hash<std::string>{}(source.string() + '#' + std::to_string(static_cast<int>(format)));
+	char keyText[17];
+	std::snprintf(keyText, sizeof(keyText), "%016llx", static_cast<unsigned long long>(key));
+	return std::filesystem::path(TEXTURE_CACHE_DIRECTORY) / (source.stem().string() + "_" + keyText + ".ktx2");
+}
+
+static bool getSourceStamp(const char* file, CacheStamp& outStamp)
+{
+	std::error_code error;
+	outStamp = { .version = CACHE_VERSION, .padding = 0 };
+	outStamp.sourceSize = std::filesystem::file_size(file, error);
+	if (error)
+	{
+		return false;
+	}
+	outStamp.sourceWriteTime = std::filesystem::last_write_time(file, error).time_since_epoch().count();
+	return !error;
+}
+
+bool TextureCompression::LoadCached(const char* file, const RenderableTypes::TextureDesc& textureDesc, RenderableTypes::Texture& outImage)
+{
+	ZoneScoped;
+	CacheStamp sourceStamp;
+	if (!getSourceStamp(file, sourceStamp))
+	{
+		return false;
+	}
+
+	const std::filesystem::path cachePath = getCachePath(file, textureDesc.format);
+	std::error_code error;
+	if (!std::filesystem::exists(cachePath, error))
+	{
+		return false;
+	}
+
+	RenderableTypes::Texture cached;
+	if (!Ktx2::Load(cachePath.string().c_str(), textureDesc, cached))
+	{
+		return false;
+	}
+	const std::span<const uint8_t> cachedStamp = Ktx2::FindValue(cached.file, CACHE_STAMP_KEY);
+	if (cached.blockFormat != GetBlockFormat(textureDesc.format) || cachedStamp.size() != sizeof(CacheStamp)
+		|| memcmp(cachedStamp.data(), &sourceStamp, sizeof(CacheStamp)) != 0)
+	{
+		return false;
+	}
+
+	outImage.desc = cached.desc;
+	outImage.texWidth = cached.texWidth;
+	outImage.texHeight = cached.texHeight;
+	outImage.texChannels = cached.texChannels;
+	outImage.blockFormat = cached.blockFormat;
+	outImage.levels = std::move(cached.levels);
+	outImage.file = std::move(cached.file);
+	return true;
+}
+
+void TextureCompression::StoreCached(const char* file, const RenderableTypes::Texture& texture)
+{
+	ZoneScoped;
+	CacheStamp sourceStamp;
+	if (!getSourceStamp(file, sourceStamp))
+	{
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(TEXTURE_CACHE_DIRECTORY, error);
+	const uint8_t* stampBytes = reinterpret_cast<const uint8_t*>(&sourceStamp);
+	const std::vector<Ktx2::KeyValue> keyValues = {
+		{ .key = "KTXwriter", .value = { 'V', 'u', 'l', 'k', 'a', 'n', 'R', 'e', 'n', 'd', 'e', 'r', 'e', 'r', '\0' } },
+		{ .key = CACHE_STAMP_KEY, .value = std::vector<uint8_t>(stampBytes, stampBytes + sizeof(CacheStamp)) },
+	};
+	const bool srgb = texture.desc.format == RenderableTypes::TextureDesc::Format::DEFAULT;
+	Ktx2::Write(getCachePath(file, texture.desc.format).string().c_str(), texture.blockFormat, static_cast<uint32_t>(texture.texChannels), srgb,
+		static_cast<uint32_t>(texture.texWidth), static_cast<uint32_t>(texture.texHeight), texture.levels, keyValues);
+}
+
+uint32_t TextureCompression::CompressDirectory(const char* directory)
+{
+	ZoneScoped;
+	const auto start = std::chrono::high_resolution_clock::now();
+	uint32_t textureCount = 0;
+	size_t uncompressedSize = 0;
+	size_t compressedSize = 0;
+
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(directory, error))
+	{
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		if (!entry.is_regular_file() || (extension != ".png" && extension != ".jpg" && extension != ".jpeg"))
+		{
+			continue;
+		}
+
+		const std::string path = entry.path().string();
+		const RenderableTypes::TextureDesc textureDesc{
+			.format = RenderableTypes::TextureUtil::GetFormatFromName(path.c_str()),
+			.compress = true,
+		};
+		RenderableTypes::Texture texture;
+		RenderableTypes::TextureUtil::LoadTextureFromFile(path.c_str(), textureDesc, texture);
+		if (texture.levels.empty())
+		{
+			continue;
+		}
+
+		size_t textureSize = 0;
+		for (const std::span<const uint8_t>& level : texture.levels)
+		{
+			textureSize += level.size();
+		}
+		// a full chain is a third larger than its first level
+		uncompressedSize += static_cast<size_t>(texture.texWidth) * texture.texHeight * texture.texChannels * 4 / 3;
+		compressedSize += textureSize;
+		++textureCount;
+		LOG_CORE_INFO("{}: {}x{} {} levels, {} KB", path, texture.texWidth, texture.texHeight, texture.levels.size(), textureSize / 1024);
+	}
+
+	const double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	LOG_CORE_INFO("Compressed {} textures in {:.0f} ms, {} KB to {} KB", textureCount, elapsedMs, uncompressedSize / 1024, compressedSize / 1024);
+	return textureCount;
+}
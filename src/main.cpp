@@ -1,7 +1,15 @@
 #include <public/tracy/Tracy.hpp>
 #include <public/common/TracySystem.hpp>
 
+#include <algorithm>
+#include <string_view>
+#include <thread>
+
+#include "Benchmark.h"
 #include "Engine.h"
+#include "Jobs/JobSystem.h"
+#include "Log.h"
+#include "TextureCompression.h"
 
 
 int main(int argc, char* argv[])
@@ -9,8 +17,38 @@ int main(int argc, char* argv[])
 	ZoneScoped;
 	tracy::SetThreadName("MainThread");
 
+	if (argc > 2 && std::string_view(argv[1]) == "--benchmark")
+	{
+		Log::Init();
+		return Benchmark::Run(argv[2]) ? 0 : 1;
+	}
+
+	if (argc > 2 && std::string_view(argv[1]) == "--compress-textures")
+	{
+		Log::Init();
+		Jobs::JobSystem::ptr = new Jobs::JobSystem(std::max(1U, std::thread::hardware_concurrency()) - 1U);
+		const uint32_t textureCount = TextureCompression::CompressDirectory(argv[2]);
+		delete Jobs::JobSystem::ptr;
+		Jobs::JobSystem::ptr = nullptr;
+		return textureCount > 0 ? 0 : 1;
+	}
+
+	RenderTypes::LatencyProfile latencyProfile = RenderTypes::LatencyProfile::BALANCED;
+	if (argc > 2 && std::string_view(argv[1]) == "--latency")
+	{
+		const std::string_view profileName = argv[2];
+		if (profileName == "low")
+		{
+			latencyProfile = RenderTypes::LatencyProfile::LOW_LATENCY;
+		}
+		else if (profileName == "throughput")
+		{
+			latencyProfile = RenderTypes::LatencyProfile::THROUGHPUT;
+		}
+	}
+
 	Engine game;
-	game.init();
+	game.init(latencyProfile);
 	game.run();
 	game.deinit();
 
@@ -0,0 +1,65 @@
+#include "Graphics/AssetCache.h"
+
+#include "Test.h"
+
+static void missesReturnZero()
+{
+	AssetCache cache;
+	CHECK(cache.acquire(42) == 0);
+	CHECK(cache.getHitCount() == 0);
+	CHECK(cache.getReferenceCount(7) == 0);
+}
+
+static void hitsShareTheHandle()
+{
+	AssetCache cache;
+	cache.insert(42, 7);
+	CHECK(cache.getReferenceCount(7) == 1);
+
+	CHECK(cache.acquire(42) == 7);
+	CHECK(cache.acquire(42) == 7);
+	CHECK(cache.getReferenceCount(7) == 3);
+	CHECK(cache.getHitCount() == 2);
+
+	// other content stays apart
+	cache.insert(43, 8);
+	CHECK(cache.acquire(43) == 8);
+	CHECK(cache.getReferenceCount(7) == 3 && cache.getReferenceCount(8) == 2);
+	CHECK(cache.getHitCount() == 3);
+}
+
+static void lastReleaseFreesTheHandle()
+{
+	AssetCache cache;
+	cache.insert(42, 7);
+	CHECK(cache.acquire(42) == 7);
+
+	CHECK(!cache.release(7));
+	CHECK(cache.getReferenceCount(7) == 1);
+	CHECK(cache.release(7));
+	CHECK(cache.getReferenceCount(7) == 0);
+
+	// the key is gone with the handle, the next load of the content inserts it again
+	CHECK(cache.acquire(42) == 0);
+	cache.insert(42, 9);
+	CHECK(cache.acquire(42) == 9);
+	CHECK(cache.getHitCount() == 2);
+}
+
+static void uncachedHandlesHaveOneReference()
+{
+	AssetCache cache;
+	cache.insert(42, 7);
+	CHECK(cache.release(12));
+	CHECK(cache.getReferenceCount(7) == 1);
+}
+
+int main()
+{
+	return Test::Run({
+		{ "misses return zero", &missesReturnZero },
+		{ "hits share the handle", &hitsShareTheHandle },
+		{ "last release frees the handle", &lastReleaseFreesTheHandle },
+		{ "uncached handles have one reference", &uncachedHandlesHaveOneReference },
+		});
+}
@@ -0,0 +1,280 @@
+#include "Structures/BVH.h"
+
+#include <gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <random>
+
+#include "Jobs/JobSystem.h"
+#include "Test.h"
+
+// past the size where the halves of the tree are built as jobs
+constexpr uint32_t PARALLEL_OBJECT_COUNT = 20000;
+
+static std::vector<AABB> makeBoxes(uint32_t count, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 4.0f);
+	std::vector<AABB> boxes(count);
+	for (AABB& box : boxes)
+	{
+		box.min = { position(random), position(random), position(random) };
+		box.max = box.min + glm::vec3{ size(random), size(random), size(random) };
+	}
+	return boxes;
+}
+
+static bool contains(const BVH::Node& node, const AABB& box)
+{
+	return glm::all(glm::lessThanEqual(node.boundsMin, box.min)) && glm::all(glm::greaterThanEqual(node.boundsMax, box.max));
+}
+
+// every object is in exactly one leaf, and every node contains what is below it
+static void checkTree(const BVH& bvh, const std::vector<AABB>& bounds)
+{
+	const std::vector<BVH::Node>& nodes = bvh.getNodes();
+	CHECK(bvh.getObjectCount() == bounds.size());
+	CHECK(nodes.size() == (bounds.empty() ? 0 : 2 * bounds.size() - 1));
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	std::vector<uint32_t> objects;
+	bool nested = true;
+	std::vector<uint32_t> stack{ 0 };
+	while (!stack.empty())
+	{
+		const BVH::Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (node.objectCount > 0)
+		{
+			continue;
+		}
+		for (const uint32_t child : { node.first, node.first + 1 })
+		{
+			const AABB childBounds{ .min = nodes[child].boundsMin, .max = nodes[child].boundsMax };
+			nested = nested && contains(node, childBounds);
+			stack.push_back(child);
+		}
+	}
+	CHECK(nested);
+
+	// a box around everything finds every object once, and the root contains them all
+	AABB everything;
+	for (const AABB& box : bounds)
+	{
+		everything.grow(box);
+	}
+	bvh.queryAABB(everything, objects);
+	std::sort(objects.begin(), objects.end());
+	CHECK(objects.size() == bounds.size());
+	CHECK(std::adjacent_find(objects.begin(), objects.end()) == objects.end());
+	CHECK(contains(nodes[0], everything));
+}
+
+static std::vector<uint32_t> sorted(std::vector<uint32_t> objects)
+{
+	std::sort(objects.begin(), objects.end());
+	return objects;
+}
+
+// the queries against a linear scan over the same boxes
+static void checkQueries(const BVH& bvh, const std::vector<AABB>& bounds, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-110.0f, 110.0f);
+	std::uniform_real_distribution<float> extent(1.0f, 40.0f);
+	std::vector<uint32_t> found;
+	std::vector<uint32_t> expected;
+	for (int query = 0; query < 32; ++query)
+	{
+		const glm::vec3 centre{ position(random), position(random), position(random) };
+		const float radius = extent(random);
+
+		const AABB box{ .min = centre - radius, .max = centre + radius };
+		found.clear();
+		expected.clear();
+		bvh.queryAABB(box, found);
+		for (uint32_t i = 0; i < bounds.size(); ++i)
+		{
+			if (bounds[i].overlaps(box))
+			{
+				expected.push_back(i);
+			}
+		}
+		CHECK(sorted(found) == expected);
+
+		found.clear();
+		expected.clear();
+		bvh.querySphere(centre, radius, found);
+		for (uint32_t i = 0; i < bounds.size(); ++i)
+		{
+			if (bounds[i].overlapsSphere(centre, radius))
+			{
+				expected.push_back(i);
+			}
+		}
+		CHECK(sorted(found) == expected);
+
+		const glm::mat4 viewProj = glm::perspectiveRH_ZO(glm::radians(60.0f), 1.5f, 0.1f, radius * 4.0f)
+			* glm::lookAt(centre, glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+		const Frustum frustum = Frustum::FromViewProj(viewProj);
+		found.clear();
+		expected.clear();
+		bvh.queryFrustum(frustum, found);
+		for (uint32_t i = 0; i < bounds.size(); ++i)
+		{
+			bool outside = false;
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				const glm::vec3 normal{ plane };
+				const glm::vec3 furthest = glm::mix(bounds[i].min, bounds[i].max, glm::greaterThanEqual(normal, glm::vec3{ 0.0f }));
+				outside = outside || glm::dot(normal, furthest) + plane.w < 0.0f;
+			}
+			if (!outside)
+			{
+				expected.push_back(i);
+			}
+		}
+		CHECK(sorted(found) == expected);
+
+		const glm::vec3 direction = glm::normalize(-centre);
+		const glm::vec3 inverseDirection = 1.0f / direction;
+		const std::optional<BVH::RayHit> hit = bvh.raycast(centre, direction);
+		std::optional<float> closest;
+		for (const AABB& target : bounds)
+		{
+			const glm::vec3 t0 = (target.min - centre) * inverseDirection;
+			const glm::vec3 t1 = (target.max - centre) * inverseDirection;
+			const float entry = std::max({ glm::min(t0, t1).x, glm::min(t0, t1).y, glm::min(t0, t1).z, 0.0f });
+			const float exit = std::min({ glm::max(t0, t1).x, glm::max(t0, t1).y, glm::max(t0, t1).z });
+			if (entry <= exit && (!closest || entry < *closest))
+			{
+				closest = entry;
+			}
+		}
+		CHECK(hit.has_value() == closest.has_value());
+		if (hit && closest)
+		{
+			CHECK(hit->distance == *closest);
+			CHECK(bounds[hit->object].overlapsSphere(centre + direction * hit->distance, 1e-3f * (1.0f + hit->distance)));
+		}
+	}
+}
+
+static void emptyTreeFindsNothing()
+{
+	BVH bvh;
+	bvh.build({});
+	std::vector<uint32_t> found;
+	bvh.queryAABB(AABB{ .min = glm::vec3{ -1.0f }, .max = glm::vec3{ 1.0f } }, found);
+	bvh.querySphere(glm::vec3{ 0.0f }, 10.0f, found);
+	CHECK(found.empty());
+	CHECK(!bvh.raycast(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }).has_value());
+	CHECK(bvh.update({}, 16) == 0);
+}
+
+static void queriesMatchLinearScan()
+{
+	const std::vector<AABB> bounds = makeBoxes(1000, 1);
+	BVH bvh;
+	bvh.build(bounds);
+	checkTree(bvh, bounds);
+	checkQueries(bvh, bounds, 2);
+}
+
+static void rayStartingInsideABoxHitsItAtZero()
+{
+	const std::vector<AABB> bounds = {
+		{ .min = glm::vec3{ -1.0f }, .max = glm::vec3{ 1.0f } },
+		{ .min = { -1.0f, -1.0f, -6.0f }, .max = { 1.0f, 1.0f, -4.0f } },
+	};
+	BVH bvh;
+	bvh.build(bounds);
+
+	const std::optional<BVH::RayHit> inside = bvh.raycast(glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f });
+	CHECK(inside.has_value() && inside->object == 0 && inside->distance == 0.0f);
+
+	const std::optional<BVH::RayHit> ahead = bvh.raycast(glm::vec3{ 0.0f, 0.0f, -2.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f });
+	CHECK(ahead.has_value() && ahead->object == 1 && ahead->distance == 2.0f);
+	CHECK(!bvh.raycast(glm::vec3{ 0.0f, 0.0f, -2.0f }, glm::vec3{ 0.0f, 0.0f, -1.0f }, 1.5f).has_value());
+}
+
+static void parallelBuildMatchesLinearScan()
+{
+	const std::vector<AABB> bounds = makeBoxes(PARALLEL_OBJECT_COUNT, 3);
+	Jobs::JobSystem jobSystem(3);
+	Jobs::JobSystem::ptr = &jobSystem;
+
+	BVH bvh;
+	bvh.build(bounds);
+	checkTree(bvh, bounds);
+	checkQueries(bvh, bounds, 4);
+
+	// the parallel refit as well
+	std::vector<AABB> moved = bounds;
+	for (AABB& box : moved)
+	{
+		box.min.y += 5.0f;
+		box.max.y += 5.0f;
+	}
+	bvh.refit(moved);
+	checkTree(bvh, moved);
+	checkQueries(bvh, moved, 5);
+
+	Jobs::JobSystem::ptr = nullptr;
+}
+
+static void updateRepairsMovedObjects()
+{
+	std::vector<AABB> bounds = makeBoxes(2000, 6);
+	BVH bvh;
+	bvh.build(bounds);
+	const float builtCost = bvh.getCost();
+
+	// a quarter of the objects jump across the scene, refitting alone leaves huge overlapping nodes
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> offset(-150.0f, 150.0f);
+	for (uint32_t i = 0; i < bounds.size(); i += 4)
+	{
+		const glm::vec3 move{ offset(random), offset(random), offset(random) };
+		bounds[i].min += move;
+		bounds[i].max += move;
+	}
+	BVH refitted = bvh;
+	refitted.refit(bounds);
+	checkTree(refitted, bounds);
+	checkQueries(refitted, bounds, 8);
+	const float refitCost = refitted.getCost();
+	CHECK(refitCost > builtCost);
+
+	// a budget smaller than the tree still rebuilds something, and never more than the budget
+	const uint32_t budget = 256;
+	const uint32_t rebuilt = bvh.update(bounds, budget);
+	CHECK(rebuilt > 0 && rebuilt <= budget);
+	checkTree(bvh, bounds);
+	checkQueries(bvh, bounds, 9);
+	CHECK(bvh.getCost() < refitCost);
+
+	// with enough budget the repaired tree costs about as much as a fresh build
+	for (int pass = 0; pass < 8 && bvh.update(bounds, static_cast<uint32_t>(bounds.size())) > 0; ++pass)
+	{
+	}
+	BVH rebuiltTree;
+	rebuiltTree.build(bounds);
+	CHECK(bvh.getCost() < rebuiltTree.getCost() * 1.5f);
+	checkQueries(bvh, bounds, 10);
+}
+
+int main()
+{
+	return Test::Run({
+		{ "empty tree finds nothing", &emptyTreeFindsNothing },
+		{ "queries match a linear scan", &queriesMatchLinearScan },
+		{ "ray starting inside a box hits it at zero", &rayStartingInsideABoxHitsItAtZero },
+		{ "parallel build matches a linear scan", &parallelBuildMatchesLinearScan },
+		{ "update repairs moved objects", &updateRepairsMovedObjects },
+		});
+}
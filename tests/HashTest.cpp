@@ -0,0 +1,84 @@
+#include "Structures/Hash.h"
+
+#include <cstring>
+#include <set>
+#include <string_view>
+#include <vector>
+
+#include "Test.h"
+
+static uint64_t hashString(std::string_view text, uint64_t seed = 0)
+{
+	return Hash::Hash64(text.data(), text.size(), seed);
+}
+
+// Filled like the xxHash sanity buffer, every byte differs from its neighbours
+static std::vector<uint8_t> makeBytes(size_t size)
+{
+	std::vector<uint8_t> bytes(size);
+	uint64_t generator = 2654435761U;
+	for (uint8_t& byte : bytes)
+	{
+		byte = static_cast<uint8_t>(generator >> 56);
+		generator *= 11400714785074694797ULL;
+	}
+	return bytes;
+}
+
+static void matchesPublishedVectors()
+{
+	CHECK(hashString("") == 0xEF46DB3751D8E999ULL);
+	CHECK(hashString("a") == 0xD24EC4F1A98C6E5BULL);
+	CHECK(hashString("abc") == 0x44BC2CF5AD770999ULL);
+	CHECK(hashString("xxhash") == 0x32DD38952C4BC720ULL);
+	// longer than one 32 byte step, so the four lanes are merged
+	CHECK(hashString("Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1ULL);
+	CHECK(hashString("", 2654435761U) == 0xAC75FDA2929B17EFULL);
+}
+
+static void seedsChainRanges()
+{
+	const uint64_t first = hashString("first range");
+	CHECK(hashString("second range", first) != hashString("second range"));
+	CHECK(hashString("second range", first) == hashString("second range", hashString("first range")));
+	// a different first range changes the chained result
+	CHECK(hashString("second range", hashString("first rangf")) != hashString("second range", first));
+}
+
+static void everyTailLengthIsHashed()
+{
+	const std::vector<uint8_t> bytes = makeBytes(256);
+	std::vector<uint8_t> shifted(bytes.size() + 8);
+	std::set<uint64_t> hashes;
+	for (size_t size = 0; size <= 100; ++size)
+	{
+		const uint64_t hash = Hash::Hash64(bytes.data(), size);
+		hashes.insert(hash);
+
+		// the same bytes at every misalignment hash the same
+		for (size_t offset = 1; offset < 8; ++offset)
+		{
+			memcpy(shifted.data() + offset, bytes.data(), size);
+			CHECK(Hash::Hash64(shifted.data() + offset, size) == hash);
+		}
+
+		// flipping the last byte of the range changes the hash, whichever of the 8, 4 or 1 byte tails it is in
+		if (size > 0)
+		{
+			std::vector<uint8_t> changed(bytes.begin(), bytes.begin() + size);
+			changed.back() ^= 1;
+			CHECK(Hash::Hash64(changed.data(), size) != hash);
+		}
+	}
+	// each prefix hashes differently
+	CHECK(hashes.size() == 101);
+}
+
+int main()
+{
+	return Test::Run({
+		{ "matches the published XXH64 vectors", &matchesPublishedVectors },
+		{ "seeds chain ranges", &seedsChainRanges },
+		{ "every tail length is hashed", &everyTailLengthIsHashed },
+		});
+}
@@ -0,0 +1,178 @@
+#include "Ktx2.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Log.h"
+#include "TextureCompression.h"
+#include "Test.h"
+
+// Byte offsets into the file, from the KTX2 specification
+constexpr size_t PIXEL_WIDTH_OFFSET = 20;
+constexpr size_t PIXEL_HEIGHT_OFFSET = 24;
+constexpr size_t LEVEL_INDEX_OFFSET = 80;
+constexpr size_t LEVEL_INDEX_ENTRY_SIZE = 24;
+
+static std::string getTestPath(const char* name)
+{
+	return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// A full chain of the format with random contents, the levels span the returned storage
+struct Chain
+{
+	std::vector<std::vector<uint8_t>> storage;
+	std::vector<std::span<const uint8_t>> levels;
+};
+
+static Chain makeChain(RenderableTypes::BlockFormat format, uint32_t width, uint32_t height, uint32_t channels, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	Chain chain;
+	for (uint32_t mip = 0; mip < RenderableTypes::TextureUtil::GetMipCount(width, height); ++mip)
+	{
+		const size_t size = TextureCompression::GetLevelSize(format, std::max(width >> mip, 1U), std::max(height >> mip, 1U), channels);
+		std::vector<uint8_t>& level = chain.storage.emplace_back(size);
+		for (uint8_t& value : level)
+		{
+			value = static_cast<uint8_t>(random());
+		}
+	}
+	for (const std::vector<uint8_t>& level : chain.storage)
+	{
+		chain.levels.emplace_back(level);
+	}
+	return chain;
+}
+
+static void patchFile(const std::string& path, size_t offset, uint32_t value)
+{
+	std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+	file.seekp(static_cast<std::streamoff>(offset));
+	file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static bool load(const std::string& path, RenderableTypes::Texture& outImage)
+{
+	return Ktx2::Load(path.c_str(), RenderableTypes::TextureDesc{ .format = RenderableTypes::TextureDesc::Format::DEFAULT }, outImage);
+}
+
+static void compressedChainsRoundTrip()
+{
+	const std::string path = getTestPath("Ktx2Test_bc7.ktx2");
+	const Chain chain = makeChain(RenderableTypes::BlockFormat::BC7, 13, 7, 4, 1);
+	const std::vector<Ktx2::KeyValue> keyValues = { { .key = "Stamp", .value = { 1, 2, 3 } } };
+	CHECK(Ktx2::Write(path.c_str(), RenderableTypes::BlockFormat::BC7, 4, true, 13, 7, chain.levels, keyValues));
+
+	RenderableTypes::Texture texture;
+	CHECK(load(path, texture));
+	CHECK(texture.texWidth == 13 && texture.texHeight == 7 && texture.texChannels == 4);
+	CHECK(texture.blockFormat == RenderableTypes::BlockFormat::BC7);
+	CHECK(texture.levels.size() == 4);
+	bool levelsMatch = texture.levels.size() == chain.levels.size();
+	bool aligned = true;
+	for (size_t mip = 0; levelsMatch && mip < texture.levels.size(); ++mip)
+	{
+		levelsMatch = std::equal(texture.levels[mip].begin(), texture.levels[mip].end(), chain.levels[mip].begin(), chain.levels[mip].end());
+		aligned = aligned && (texture.levels[mip].data() - texture.file.data()) % 16 == 0;
+	}
+	CHECK(levelsMatch);
+	// every level starts on a whole block
+	CHECK(aligned);
+
+	const std::span<const uint8_t> stamp = Ktx2::FindValue(texture.file, "Stamp");
+	CHECK(stamp.size() == 3 && stamp[0] == 1 && stamp[2] == 3);
+	CHECK(Ktx2::FindValue(texture.file, "Missing").empty());
+
+	texture = RenderableTypes::Texture{};
+	std::filesystem::remove(path);
+}
+
+static void uncompressedLevelsStayAligned()
+{
+	const std::string path = getTestPath("Ktx2Test_uncompressed.ktx2");
+	for (const uint32_t channels : { 1U, 2U, 4U })
+	{
+		// odd sizes leave every level a length that isn't a multiple of 4
+		const Chain chain = makeChain(RenderableTypes::BlockFormat::NONE, 7, 5, channels, channels);
+		CHECK(Ktx2::Write(path.c_str(), RenderableTypes::BlockFormat::NONE, channels, false, 7, 5, chain.levels, {}));
+
+		RenderableTypes::Texture texture;
+		CHECK(load(path, texture));
+		CHECK(texture.blockFormat == RenderableTypes::BlockFormat::NONE);
+		CHECK(texture.texWidth == 7 && texture.texHeight == 5 && texture.texChannels == static_cast<int>(channels));
+		CHECK(texture.levels.size() == 3);
+		bool levelsMatch = texture.levels.size() == chain.levels.size();
+		bool aligned = true;
+		for (size_t mip = 0; levelsMatch && mip < texture.levels.size(); ++mip)
+		{
+			const size_t expectedSize = static_cast<size_t>(std::max(7U >> mip, 1U)) * std::max(5U >> mip, 1U) * channels;
+			levelsMatch = texture.levels[mip].size() == expectedSize
+				&& std::equal(texture.levels[mip].begin(), texture.levels[mip].end(), chain.levels[mip].begin(), chain.levels[mip].end());
+			// every level offset is a multiple of 4 and of the texel size
+			const size_t offset = static_cast<size_t>(texture.levels[mip].data() - texture.file.data());
+			aligned = aligned && offset % 4 == 0 && offset % channels == 0;
+		}
+		CHECK(levelsMatch);
+		CHECK(aligned);
+	}
+	std::filesystem::remove(path);
+}
+
+static void malformedFilesAreRejected()
+{
+	const std::string path = getTestPath("Ktx2Test_malformed.ktx2");
+	const Chain chain = makeChain(RenderableTypes::BlockFormat::BC7, 32, 32, 4, 2);
+	const auto writeValid = [&]() {
+		Ktx2::Write(path.c_str(), RenderableTypes::BlockFormat::BC7, 4, false, 32, 32, chain.levels, {});
+	};
+	RenderableTypes::Texture texture;
+
+	// the level sizes come from the extents shifted by the level, an empty extent never reaches them
+	writeValid();
+	patchFile(path, PIXEL_WIDTH_OFFSET, 0);
+	CHECK(!load(path, texture));
+	writeValid();
+	patchFile(path, PIXEL_HEIGHT_OFFSET, 0);
+	CHECK(!load(path, texture));
+
+	// six levels can't belong to a 4x4 texture, which has three
+	writeValid();
+	patchFile(path, PIXEL_WIDTH_OFFSET, 4);
+	patchFile(path, PIXEL_HEIGHT_OFFSET, 4);
+	CHECK(!load(path, texture));
+
+	// the level index ends past the end of the file
+	writeValid();
+	std::filesystem::resize_file(path, LEVEL_INDEX_OFFSET + LEVEL_INDEX_ENTRY_SIZE + 8);
+	CHECK(!load(path, texture));
+
+	// a level shorter than its extent needs
+	writeValid();
+	patchFile(path, LEVEL_INDEX_OFFSET + 8, 15);
+	CHECK(!load(path, texture));
+
+	// and the untouched file still loads
+	writeValid();
+	CHECK(load(path, texture));
+	CHECK(texture.levels.size() == 6);
+
+	texture = RenderableTypes::Texture{};
+	std::filesystem::remove(path);
+}
+
+int main()
+{
+	Log::Init();
+
+	return Test::Run({
+		{ "compressed chains round trip", &compressedChainsRoundTrip },
+		{ "uncompressed levels stay aligned", &uncompressedLevelsStayAligned },
+		{ "malformed files are rejected", &malformedFilesAreRejected },
+		});
+}
@@ -0,0 +1,116 @@
+#include "Graphics/OcclusionBuffer.h"
+
+#include <gtc/matrix_transform.hpp>
+
+#include "Jobs/JobSystem.h"
+#include "Test.h"
+
+// eight tiles across, so an occludee can span more than the four tiles tested at once
+constexpr uint32_t BUFFER_WIDTH = 8 * OCCLUSION_TILE_WIDTH;
+constexpr uint32_t BUFFER_HEIGHT = 16 * OCCLUSION_TILE_HEIGHT;
+constexpr float WALL_Z = -10.0f;
+
+// Camera aligned quad from minX to maxX and minY to maxY
+static OccluderMesh makeWall(float minX, float maxX, float minY, float maxY)
+{
+	return OccluderMesh{
+		.positions = { { minX, minY, WALL_Z }, { maxX, minY, WALL_Z }, { maxX, maxY, WALL_Z }, { minX, maxY, WALL_Z } },
+		.indices = { 0, 1, 2, 0, 2, 3 },
+	};
+}
+
+// world x and y are pixels, depth grows from 0 at the camera to 1 a thousand units away
+static glm::mat4 pixelProjection()
+{
+	return glm::orthoRH_ZO(0.0f, static_cast<float>(BUFFER_WIDTH), 0.0f, static_cast<float>(BUFFER_HEIGHT), 0.0f, 1000.0f);
+}
+
+static void rasterizeWall(OcclusionBuffer& occlusionBuffer, const glm::mat4& viewProj, const OccluderMesh& wall)
+{
+	const OcclusionBuffer::Occluder occluder{ .mesh = &wall, .modelMatrix = glm::mat4{ 1.0f } };
+	occlusionBuffer.init(BUFFER_WIDTH, BUFFER_HEIGHT);
+	occlusionBuffer.rasterize(viewProj, &occluder, 1);
+}
+
+static void fullyCoveredOccludeeIsCulled()
+{
+	const OccluderMesh wall = makeWall(-16.0f, BUFFER_WIDTH + 16.0f, -16.0f, BUFFER_HEIGHT + 16.0f);
+	OcclusionBuffer occlusionBuffer;
+	rasterizeWall(occlusionBuffer, pixelProjection(), wall);
+
+	CHECK(occlusionBuffer.getTriangleCount() == 2);
+	CHECK(occlusionBuffer.isOccluded({ 128.0f, 32.0f, -50.0f, 8.0f }));
+	CHECK(occlusionBuffer.isOccluded({ 4.0f, 4.0f, -50.0f, 2.0f }));
+}
+
+static void occludeeInFrontIsKept()
+{
+	const OccluderMesh wall = makeWall(-16.0f, BUFFER_WIDTH + 16.0f, -16.0f, BUFFER_HEIGHT + 16.0f);
+	OcclusionBuffer occlusionBuffer;
+	rasterizeWall(occlusionBuffer, pixelProjection(), wall);
+
+	CHECK(!occlusionBuffer.isOccluded({ 128.0f, 32.0f, -5.0f, 2.0f }));
+	// reaching through the wall is not behind it
+	CHECK(!occlusionBuffer.isOccluded({ 128.0f, 32.0f, WALL_Z - 1.0f, 2.0f }));
+}
+
+static void partiallyVisibleOccludeeIsKept()
+{
+	// the wall covers the left half, tiles 0 to 3
+	const OccluderMesh wall = makeWall(-16.0f, BUFFER_WIDTH / 2.0f, -16.0f, BUFFER_HEIGHT + 16.0f);
+	OcclusionBuffer occlusionBuffer;
+	rasterizeWall(occlusionBuffer, pixelProjection(), wall);
+
+	CHECK(occlusionBuffer.isOccluded({ 64.0f, 32.0f, -50.0f, 8.0f }));
+	CHECK(!occlusionBuffer.isOccluded({ BUFFER_WIDTH / 2.0f, 32.0f, -50.0f, 8.0f }));
+	CHECK(!occlusionBuffer.isOccluded({ 192.0f, 32.0f, -50.0f, 8.0f }));
+}
+
+static void occludeeAcrossManyTilesIsTestedInEveryTile()
+{
+	// tiles 1 to 7, seven tiles take two passes of four
+	const glm::vec4 occludee{ 144.0f, 32.0f, -200.0f, 80.0f };
+
+	const OccluderMesh fullWall = makeWall(-16.0f, BUFFER_WIDTH + 16.0f, -16.0f, BUFFER_HEIGHT + 16.0f);
+	OcclusionBuffer occlusionBuffer;
+	rasterizeWall(occlusionBuffer, pixelProjection(), fullWall);
+	CHECK(occlusionBuffer.isOccluded(occludee));
+
+	// only the last tile, in the second pass, is left uncovered
+	const OccluderMesh openWall = makeWall(-16.0f, 7.0f * OCCLUSION_TILE_WIDTH, -16.0f, BUFFER_HEIGHT + 16.0f);
+	rasterizeWall(occlusionBuffer, pixelProjection(), openWall);
+	CHECK(!occlusionBuffer.isOccluded(occludee));
+}
+
+static void occludeeAcrossTileAndNearPlaneIsKept()
+{
+	const glm::mat4 viewProj = glm::perspectiveRH_ZO(glm::radians(90.0f), static_cast<float>(BUFFER_WIDTH) / BUFFER_HEIGHT, 0.1f, 100.0f);
+	const OccluderMesh wall = makeWall(-100.0f, 100.0f, -100.0f, 100.0f);
+	OcclusionBuffer occlusionBuffer;
+	rasterizeWall(occlusionBuffer, viewProj, wall);
+
+	// the wall does cover the screen
+	CHECK(occlusionBuffer.isOccluded({ 0.0f, 0.0f, -50.0f, 1.0f }));
+	// the centre projects onto a tile edge, the near corners are between the camera and the near plane
+	CHECK(!occlusionBuffer.isOccluded({ 0.0f, 0.0f, -0.3f, 0.25f }));
+	// and here some corners are behind the camera
+	CHECK(!occlusionBuffer.isOccluded({ 0.0f, 0.0f, -0.3f, 0.5f }));
+}
+
+int main()
+{
+	// the occluders are set up and rasterised on the global job system
+	Jobs::JobSystem jobSystem(2);
+	Jobs::JobSystem::ptr = &jobSystem;
+
+	const int result = Test::Run({
+		{ "fully covered occludee is culled", &fullyCoveredOccludeeIsCulled },
+		{ "occludee in front is kept", &occludeeInFrontIsKept },
+		{ "partially visible occludee is kept", &partiallyVisibleOccludeeIsKept },
+		{ "occludee across many tiles is tested in every tile", &occludeeAcrossManyTilesIsTestedInEveryTile },
+		{ "occludee across a tile and the near plane is kept", &occludeeAcrossTileAndNearPlaneIsKept },
+		});
+
+	Jobs::JobSystem::ptr = nullptr;
+	return result;
+}
@@ -0,0 +1,146 @@
+#include "RenderObjectStore.h"
+
+#include <gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "Test.h"
+
+// Components each live entity was given, looked up again through its current index
+struct Expected
+{
+	RenderableTypes::MeshHandle mesh;
+	RenderableTypes::MaterialHandle material;
+	float x;
+	uint8_t flags;
+};
+
+static RenderEntity createObject(RenderObjectStore& store, std::map<RenderEntity, Expected>& expected, uint32_t seed)
+{
+	const Expected components{
+		.mesh = seed % 3,
+		.material = (seed * 7) % 4,
+		.x = static_cast<float>(seed),
+		.flags = static_cast<uint8_t>(seed % 2 == 0 ? RenderableTypes::VISIBLE : 0),
+	};
+	const RenderEntity entity = store.create({
+		.meshHandle = components.mesh,
+		.materialHandle = components.material,
+		.transform = glm::translate(glm::mat4{ 1.0f }, glm::vec3{ components.x, 0.0f, 0.0f }),
+		.flags = components.flags,
+		});
+	store.getBounds()[store.getIndex(entity)] = AABB{ .min = glm::vec3{ components.x }, .max = glm::vec3{ components.x + 1.0f } };
+	expected[entity] = components;
+	return entity;
+}
+
+// Entities and indices map onto each other, and every entity still has its own components
+static void checkStore(const RenderObjectStore& store, const std::map<RenderEntity, Expected>& expected)
+{
+	const RenderableTypes::RenderObjectArrays& arrays = store.getArrays();
+	CHECK(store.size() == expected.size());
+	CHECK(arrays.size() == store.size() && arrays.transforms.size() == store.size() && arrays.materials.size() == store.size());
+	CHECK(arrays.flags.size() == store.size() && store.getBounds().size() == store.size());
+
+	bool mapped = true;
+	bool intact = true;
+	for (uint32_t i = 0; i < store.size(); ++i)
+	{
+		mapped = mapped && store.getIndex(store.getEntity(i)) == i;
+	}
+	for (const auto& [entity, components] : expected)
+	{
+		const uint32_t index = store.getIndex(entity);
+		intact = intact && index < store.size() && store.getEntity(index) == entity;
+		intact = intact && arrays.meshes[index] == components.mesh && arrays.materials[index] == components.material;
+		intact = intact && arrays.transforms[index][3].x == components.x && arrays.flags[index] == components.flags;
+		intact = intact && store.getBounds()[index].min.x == components.x;
+	}
+	CHECK(mapped);
+	CHECK(intact);
+}
+
+static void destroyKeepsTheArraysDense()
+{
+	RenderObjectStore store;
+	std::map<RenderEntity, Expected> expected;
+	std::vector<RenderEntity> entities;
+	for (uint32_t i = 0; i < 20; ++i)
+	{
+		entities.push_back(createObject(store, expected, i));
+	}
+	checkStore(store, expected);
+
+	// from the middle, the last object moves into the hole
+	for (const uint32_t i : { 5U, 10U, 0U })
+	{
+		store.destroy(entities[i]);
+		expected.erase(entities[i]);
+		checkStore(store, expected);
+	}
+	// the last object itself, nothing moves
+	const RenderEntity last = store.getEntity(store.size() - 1);
+	store.destroy(last);
+	expected.erase(last);
+	checkStore(store, expected);
+
+	// freed entities are handed out again
+	const RenderEntity reused = createObject(store, expected, 40);
+	CHECK(reused == last);
+	checkStore(store, expected);
+}
+
+static void sortGroupsByMaterialThenMesh()
+{
+	RenderObjectStore store;
+	std::map<RenderEntity, Expected> expected;
+	std::vector<RenderEntity> entities;
+	for (uint32_t i = 0; i < 50; ++i)
+	{
+		entities.push_back(createObject(store, expected, i));
+	}
+	for (const uint32_t i : { 3U, 17U, 49U, 24U })
+	{
+		store.destroy(entities[i]);
+		expected.erase(entities[i]);
+	}
+
+	std::vector<RenderEntity> before;
+	for (uint32_t i = 0; i < store.size(); ++i)
+	{
+		before.push_back(store.getEntity(i));
+	}
+	store.sortForDrawing();
+	checkStore(store, expected);
+
+	// ordered by key, objects with the same key in the order they had before
+	const RenderableTypes::RenderObjectArrays& arrays = store.getArrays();
+	bool ordered = true;
+	for (uint32_t i = 1; i < store.size(); ++i)
+	{
+		const uint64_t previousKey = (static_cast<uint64_t>(arrays.materials[i - 1]) << 32) | arrays.meshes[i - 1];
+		const uint64_t key = (static_cast<uint64_t>(arrays.materials[i]) << 32) | arrays.meshes[i];
+		const auto previousPosition = std::find(before.begin(), before.end(), store.getEntity(i - 1));
+		const auto position = std::find(before.begin(), before.end(), store.getEntity(i));
+		ordered = ordered && (previousKey < key || (previousKey == key && previousPosition < position));
+	}
+	CHECK(ordered);
+
+	// the mapping keeps working for destroys after the sort
+	store.destroy(entities[30]);
+	expected.erase(entities[30]);
+	const RenderEntity first = store.getEntity(0);
+	store.destroy(first);
+	expected.erase(first);
+	checkStore(store, expected);
+}
+
+int main()
+{
+	return Test::Run({
+		{ "destroy keeps the arrays dense", &destroyKeepsTheArraysDense },
+		{ "sort groups by material then mesh", &sortGroupsByMaterialThenMesh },
+		});
+}
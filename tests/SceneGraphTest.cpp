@@ -0,0 +1,127 @@
+#include "SceneGraph.h"
+
+#include <gtc/matrix_transform.hpp>
+
+#include "Jobs/JobSystem.h"
+#include "Test.h"
+
+static bool translationIs(const glm::mat4& matrix, const glm::vec3& translation)
+{
+	return glm::all(glm::lessThan(glm::abs(glm::vec3(matrix[3]) - translation), glm::vec3{ 1e-5f }));
+}
+
+static void worldMatricesFollowTheParents()
+{
+	SceneGraph sceneGraph;
+	const SceneNodeHandle root = sceneGraph.createNode(INVALID_SCENE_NODE, "Root");
+	const SceneNodeHandle child = sceneGraph.createNode(root, "Child");
+	const SceneNodeHandle grandchild = sceneGraph.createNode(child, "Grandchild");
+	sceneGraph.setLocalTranslation(root, { 1.0f, 0.0f, 0.0f });
+	sceneGraph.setLocalTransform(child, { 0.0f, 2.0f, 0.0f }, glm::angleAxis(glm::radians(90.0f), glm::vec3{ 0.0f, 0.0f, 1.0f }), glm::vec3{ 2.0f });
+	sceneGraph.setLocalTranslation(grandchild, { 1.0f, 0.0f, 0.0f });
+	sceneGraph.update();
+
+	CHECK(sceneGraph.getNodeCount() == 3);
+	CHECK(sceneGraph.getRoots().size() == 1 && sceneGraph.getRoots()[0] == root);
+	CHECK(sceneGraph.getChildCount(root) == 1 && sceneGraph.getChild(root, 0) == child);
+	CHECK(sceneGraph.getName(grandchild) == "Grandchild");
+	CHECK(translationIs(sceneGraph.getWorldMatrix(child), { 1.0f, 2.0f, 0.0f }));
+	// rotated a quarter turn and doubled, one along x becomes two along y
+	CHECK(translationIs(sceneGraph.getWorldMatrix(grandchild), { 1.0f, 4.0f, 0.0f }));
+}
+
+static void onlyMovedSubtreesAreRecomputed()
+{
+	SceneGraph sceneGraph;
+	std::vector<SceneNodeHandle> parents;
+	std::vector<SceneNodeHandle> children;
+	for (int i = 0; i < 4; ++i)
+	{
+		parents.push_back(sceneGraph.createNode(INVALID_SCENE_NODE));
+		for (int j = 0; j < 10; ++j)
+		{
+			children.push_back(sceneGraph.createNode(parents.back()));
+			sceneGraph.setLocalTranslation(children.back(), { 0.0f, 1.0f * j, 0.0f });
+		}
+	}
+	sceneGraph.update();
+	CHECK(sceneGraph.getUpdatedNodeCount() == 44);
+
+	sceneGraph.update();
+	CHECK(sceneGraph.getUpdatedNodeCount() == 0);
+
+	// a dirty child below a dirty parent is recomputed once, with its parent
+	sceneGraph.setLocalTranslation(parents[2], { 5.0f, 0.0f, 0.0f });
+	sceneGraph.setLocalTranslation(children[25], { 0.0f, 0.0f, 3.0f });
+	sceneGraph.setLocalTranslation(children[3], { 0.0f, 0.0f, 1.0f });
+	sceneGraph.update();
+	CHECK(sceneGraph.getUpdatedNodeCount() == 12);
+	CHECK(translationIs(sceneGraph.getWorldMatrix(children[25]), { 5.0f, 0.0f, 3.0f }));
+	CHECK(translationIs(sceneGraph.getWorldMatrix(children[21]), { 5.0f, 1.0f, 0.0f }));
+	CHECK(translationIs(sceneGraph.getWorldMatrix(children[3]), { 0.0f, 0.0f, 1.0f }));
+	CHECK(translationIs(sceneGraph.getWorldMatrix(children[35]), { 0.0f, 5.0f, 0.0f }));
+}
+
+static void destroyedSubtreeLeavesSurvivorsIntact()
+{
+	SceneGraph sceneGraph;
+	std::vector<SceneNodeHandle> walls;
+	std::vector<std::vector<SceneNodeHandle>> cubes;
+	for (int wall = 0; wall < 4; ++wall)
+	{
+		walls.push_back(sceneGraph.createNode(INVALID_SCENE_NODE));
+		cubes.emplace_back();
+		for (int cube = 0; cube < 64; ++cube)
+		{
+			cubes.back().push_back(sceneGraph.createNode(walls.back()));
+		}
+	}
+	sceneGraph.update();
+
+	// survivors marked dirty at their indices from before the destroy, past the end of the shrunk layout
+	sceneGraph.destroyNode(walls[0]);
+	sceneGraph.destroyNode(walls[1]);
+	sceneGraph.setLocalTranslation(walls[3], { 0.0f, 0.0f, -6.0f });
+	for (int cube = 0; cube < 64; ++cube)
+	{
+		sceneGraph.setLocalTranslation(cubes[3][cube], { 1.0f * cube, 0.0f, 0.0f });
+	}
+	sceneGraph.update();
+
+	CHECK(sceneGraph.getNodeCount() == 130);
+	CHECK(sceneGraph.getRoots().size() == 2);
+	CHECK(translationIs(sceneGraph.getWorldMatrix(cubes[3][63]), { 63.0f, 0.0f, -6.0f }));
+	CHECK(translationIs(sceneGraph.getWorldMatrix(cubes[2][10]), { 0.0f, 0.0f, 0.0f }));
+
+	// nothing stale is left to recompute, and moves after the rebuild use the new indices
+	sceneGraph.update();
+	CHECK(sceneGraph.getUpdatedNodeCount() == 0);
+	sceneGraph.setLocalTranslation(cubes[3][5], { 0.0f, 7.0f, 0.0f });
+	sceneGraph.update();
+	CHECK(sceneGraph.getUpdatedNodeCount() == 1);
+	CHECK(translationIs(sceneGraph.getWorldMatrix(cubes[3][5]), { 0.0f, 7.0f, -6.0f }));
+
+	// freed handles are handed out again
+	const SceneNodeHandle reused = sceneGraph.createNode(walls[2]);
+	CHECK(reused < 4 * 65);
+	sceneGraph.setLocalTranslation(reused, { 0.0f, 0.0f, 1.0f });
+	sceneGraph.update();
+	CHECK(sceneGraph.getChildCount(walls[2]) == 65);
+	CHECK(translationIs(sceneGraph.getWorldMatrix(reused), { 0.0f, 0.0f, 1.0f }));
+}
+
+int main()
+{
+	// every level is split across the global job system
+	Jobs::JobSystem jobSystem(2);
+	Jobs::JobSystem::ptr = &jobSystem;
+
+	const int result = Test::Run({
+		{ "world matrices follow the parents", &worldMatricesFollowTheParents },
+		{ "only moved subtrees are recomputed", &onlyMovedSubtreesAreRecomputed },
+		{ "destroyed subtree leaves survivors intact", &destroyedSubtreeLeavesSurvivorsIntact },
+		});
+
+	Jobs::JobSystem::ptr = nullptr;
+	return result;
+}
@@ -0,0 +1,83 @@
+#include "Structures/SlotAllocator.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "Test.h"
+
+static void slotsFillFromTheFront()
+{
+	SlotAllocator slots;
+	slots.init(4);
+	CHECK(slots.getCapacity() == 4 && slots.getFreeCount() == 4);
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		CHECK(slots.allocate() == i);
+	}
+	CHECK(slots.getFreeCount() == 0);
+}
+
+static void freedSlotsAreReusedFirst()
+{
+	SlotAllocator slots;
+	slots.init(8);
+	for (int i = 0; i < 4; ++i)
+	{
+		(void)slots.allocate();
+	}
+	slots.free(1);
+	slots.free(3);
+	CHECK(slots.getFreeCount() == 6);
+
+	// the freed ones come back before any slot that was never used
+	std::vector<uint32_t> reused = { slots.allocate(), slots.allocate() };
+	std::sort(reused.begin(), reused.end());
+	CHECK(reused[0] == 1 && reused[1] == 3);
+	CHECK(slots.allocate() == 4);
+	CHECK(slots.getFreeCount() == 3);
+}
+
+static void fullTableReturnsInvalidSlot()
+{
+	SlotAllocator slots;
+	slots.init(2);
+	const uint32_t first = slots.allocate();
+	(void)slots.allocate();
+	CHECK(slots.allocate() == SlotAllocator::INVALID_SLOT);
+	CHECK(slots.getFreeCount() == 0);
+
+	// freeing the failed allocation doesn't make room
+	slots.free(SlotAllocator::INVALID_SLOT);
+	CHECK(slots.getFreeCount() == 0);
+	CHECK(slots.allocate() == SlotAllocator::INVALID_SLOT);
+
+	slots.free(first);
+	CHECK(slots.allocate() == first);
+	CHECK(slots.allocate() == SlotAllocator::INVALID_SLOT);
+}
+
+static void initStartsOver()
+{
+	SlotAllocator slots;
+	slots.init(3);
+	(void)slots.allocate();
+	slots.free(slots.allocate());
+	slots.init(3);
+	CHECK(slots.getFreeCount() == 3);
+	CHECK(slots.allocate() == 0);
+
+	// an empty table never hands out a slot
+	slots.init(0);
+	CHECK(slots.getFreeCount() == 0);
+	CHECK(slots.allocate() == SlotAllocator::INVALID_SLOT);
+}
+
+int main()
+{
+	return Test::Run({
+		{ "slots fill from the front", &slotsFillFromTheFront },
+		{ "freed slots are reused first", &freedSlotsAreReusedFirst },
+		{ "full table returns invalid slot", &fullTableReturnsInvalidSlot },
+		{ "init starts over", &initStartsOver },
+		});
+}
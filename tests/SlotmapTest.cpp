@@ -0,0 +1,96 @@
+#include "Structures/Slotmap.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Graphics/AssetCache.h"
+#include "Test.h"
+
+struct Asset
+{
+	std::string name;
+};
+
+static void handlesStartAfterNull()
+{
+	Slotmap<Asset> assets;
+	const uint32_t first = assets.add({ .name = "first" });
+	const uint32_t second = assets.add({ .name = "second" });
+	CHECK(first == 1 && second == 2);
+	CHECK(assets.get(first).name == "first" && assets.get(second).name == "second");
+}
+
+static void removedHandlesAreReused()
+{
+	Slotmap<Asset> assets;
+	const uint32_t first = assets.add({ .name = "first" });
+	const uint32_t second = assets.add({ .name = "second" });
+	assets.remove(first);
+	CHECK(assets.get(first).name.empty());
+
+	const uint32_t third = assets.add({ .name = "third" });
+	CHECK(third == first);
+	CHECK(assets.get(third).name == "third" && assets.get(second).name == "second");
+	CHECK(assets.array.size() == 3);
+}
+
+// The renderer's release: the cache lets go of the key straight away, the slotmap only once the frames are done
+static void releaseThenReload()
+{
+	Slotmap<Asset> assets;
+	AssetCache cache;
+	std::vector<std::function<void()>> deferred;
+	const auto load = [&](uint64_t key, const char* name) {
+		if (const uint32_t cached = cache.acquire(key))
+		{
+			return cached;
+		}
+		const uint32_t handle = assets.add({ .name = name });
+		cache.insert(key, handle);
+		return handle;
+	};
+	const auto release = [&](uint32_t handle) {
+		if (cache.release(handle))
+		{
+			deferred.push_back([&assets, handle]() { assets.remove(handle); });
+		}
+	};
+
+	const uint32_t stale = load(1, "bricks");
+	CHECK(load(1, "bricks") == stale);
+	release(stale);
+	CHECK(deferred.empty());
+	release(stale);
+	CHECK(deferred.size() == 1);
+
+	// other content loaded while the release is pending can't take the handle that is still being sampled
+	const uint32_t other = load(2, "grass");
+	CHECK(other != stale);
+	CHECK(assets.get(stale).name == "bricks");
+
+	// reloading the released content is a miss, it comes back as a new asset
+	const uint32_t reloaded = load(1, "bricks");
+	CHECK(reloaded != stale && reloaded != other);
+	CHECK(cache.getReferenceCount(reloaded) == 1 && cache.getReferenceCount(stale) == 0);
+
+	for (const std::function<void()>& function : deferred)
+	{
+		function();
+	}
+	deferred.clear();
+	// only then is the handle handed out again
+	const uint32_t reused = load(3, "sand");
+	CHECK(reused == stale);
+	CHECK(assets.get(reused).name == "sand" && assets.get(reloaded).name == "bricks");
+	CHECK(load(1, "bricks") == reloaded);
+}
+
+int main()
+{
+	return Test::Run({
+		{ "handles start after null", &handlesStartAfterNull },
+		{ "removed handles are reused", &removedHandlesAreReused },
+		{ "release then reload", &releaseThenReload },
+		});
+}
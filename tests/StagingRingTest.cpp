@@ -0,0 +1,325 @@
+#include "Graphics/StagingRing.h"
+
+#define VMA_IMPLEMENTATION
+#include <vk_mem_alloc.h>
+#include <VkBootstrap.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "Graphics/Timeline.h"
+#include "Log.h"
+#include "Test.h"
+
+// CTest reports the test as skipped on machines without a Vulkan device
+constexpr int SKIP_RETURN_CODE = 77;
+
+constexpr VkDeviceSize SMALL_RING_CAPACITY = 1024;
+constexpr VkDeviceSize LARGE_RING_CAPACITY = 4096;
+
+static VkDevice device = VK_NULL_HANDLE;
+
+// What the submission that was given the value would do once it finished
+static void signalFromHost(Timeline& timeline, uint64_t value)
+{
+	const VkSemaphoreSignalInfo signalInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+		.semaphore = timeline.getSemaphore(),
+		.value = value,
+	};
+	vkSignalSemaphore(device, &signalInfo);
+}
+
+// Stands in for the GPU, signals the retired values in order once they are handed over
+class HostSignaller
+{
+public:
+	explicit HostSignaller(Timeline& timeline) : timeline(timeline), thread([this]() { run(); }) {}
+
+	~HostSignaller()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		condition.notify_one();
+		thread.join();
+	}
+
+	void submit(uint64_t value)
+	{
+		{
+			std::lock_guard lock(mutex);
+			values.push_back(value);
+		}
+		condition.notify_one();
+	}
+
+private:
+	void run()
+	{
+		std::mt19937 random(11);
+		std::uniform_int_distribution<int> delay(0, 200);
+		std::unique_lock lock(mutex);
+		while (true)
+		{
+			condition.wait(lock, [this]() { return stopping || !values.empty(); });
+			if (values.empty())
+			{
+				return;
+			}
+			const uint64_t value = values.front();
+			values.pop_front();
+			lock.unlock();
+
+			// slower than the loop that allocates, so the ring fills up and has to wait
+			std::this_thread::sleep_for(std::chrono::microseconds(delay(random)));
+			signalFromHost(timeline, value);
+			lock.lock();
+		}
+	}
+
+	Timeline& timeline;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<uint64_t> values;
+	bool stopping = false;
+	std::thread thread;
+};
+
+static bool overlaps(VkDeviceSize offsetA, VkDeviceSize sizeA, VkDeviceSize offsetB, VkDeviceSize sizeB)
+{
+	return offsetA < offsetB + sizeB && offsetB < offsetA + sizeA;
+}
+
+static void allocationsAreAlignedAndInOrder()
+{
+	Timeline timeline;
+	timeline.init(device);
+	StagingRing ring;
+	ring.init(&timeline, SMALL_RING_CAPACITY);
+
+	const StagingRing::Allocation first = ring.allocate(100, 16);
+	const StagingRing::Allocation second = ring.allocate(50, 64);
+	const StagingRing::Allocation third = ring.allocate(1, 1);
+	CHECK(first.offset == 0 && first.size == 100);
+	CHECK(second.offset == 128 && second.size == 50);
+	CHECK(third.offset == 178);
+	CHECK(first.buffer == second.buffer && second.buffer == third.buffer);
+	CHECK(second.ptr == first.ptr + 128 && third.ptr == first.ptr + 178);
+
+	// the mapping is writable end to end
+	memset(first.ptr, 0xAB, first.size);
+	memset(second.ptr, 0xCD, second.size);
+	CHECK(first.ptr[99] == 0xAB && second.ptr[0] == 0xCD);
+
+	const uint64_t value = timeline.nextValue();
+	ring.retire(value);
+	signalFromHost(timeline, value);
+	ring.deinit();
+	timeline.deinit();
+}
+
+static void regionsWrapWithoutSplitting()
+{
+	Timeline timeline;
+	timeline.init(device);
+	StagingRing ring;
+	ring.init(&timeline, SMALL_RING_CAPACITY);
+
+	const StagingRing::Allocation first = ring.allocate(900, 16);
+	const uint64_t firstValue = timeline.nextValue();
+	ring.retire(firstValue);
+	signalFromHost(timeline, firstValue);
+
+	// past the end of the ring, so it starts over at the front once the first region is free
+	const StagingRing::Allocation wrapped = ring.allocate(200, 16);
+	CHECK(wrapped.buffer == first.buffer);
+	CHECK(wrapped.offset == 0);
+	const StagingRing::Allocation next = ring.allocate(200, 16);
+	CHECK(next.buffer == first.buffer && next.offset == 208);
+
+	const uint64_t value = timeline.nextValue();
+	ring.retire(value);
+	signalFromHost(timeline, value);
+	ring.deinit();
+	timeline.deinit();
+}
+
+static void requestsThatDontFitGetDedicatedBuffers()
+{
+	Timeline timeline;
+	timeline.init(device);
+	StagingRing ring;
+	ring.init(&timeline, SMALL_RING_CAPACITY);
+
+	const StagingRing::Allocation inRing = ring.allocate(600, 16);
+	// larger than the ring
+	const StagingRing::Allocation oversized = ring.allocate(4 * SMALL_RING_CAPACITY, 16);
+	// fits the ring, but not beside the unsubmitted allocation
+	const StagingRing::Allocation crowded = ring.allocate(600, 16);
+	CHECK(oversized.buffer != inRing.buffer && oversized.offset == 0 && oversized.size == 4 * SMALL_RING_CAPACITY);
+	CHECK(crowded.buffer != inRing.buffer && crowded.buffer != oversized.buffer && crowded.offset == 0);
+	CHECK(oversized.ptr != nullptr && crowded.ptr != nullptr);
+	memset(oversized.ptr, 0, oversized.size);
+
+	// the dedicated buffers are freed through the timeline like the ring space
+	const uint64_t value = timeline.nextValue();
+	ring.retire(value);
+	signalFromHost(timeline, value);
+	timeline.collect();
+
+	const StagingRing::Allocation afterwards = ring.allocate(600, 16);
+	CHECK(afterwards.buffer == inRing.buffer);
+
+	const uint64_t lastValue = timeline.nextValue();
+	ring.retire(lastValue);
+	signalFromHost(timeline, lastValue);
+	ring.deinit();
+	timeline.deinit();
+}
+
+static void pendingRegionsAreNeverHandedOut()
+{
+	struct LiveRegion
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		// zero until the region is retired
+		uint64_t value;
+	};
+
+	Timeline timeline;
+	timeline.init(device);
+	StagingRing ring;
+	ring.init(&timeline, LARGE_RING_CAPACITY);
+
+	std::mt19937 random(12);
+	std::uniform_int_distribution<VkDeviceSize> size(1, 400);
+	std::uniform_int_distribution<int> alignmentShift(0, 6);
+	std::uniform_int_distribution<int> batchSize(1, 3);
+
+	std::vector<LiveRegion> liveRegions;
+	VkBuffer ringBuffer = VK_NULL_HANDLE;
+	uint8_t* ringBase = nullptr;
+	uint32_t overlapping = 0;
+	uint32_t dedicated = 0;
+	{
+		HostSignaller signaller(timeline);
+		int batch = batchSize(random);
+		for (int i = 0; i < 2000; ++i)
+		{
+			const VkDeviceSize alignment = VkDeviceSize{ 1 } << alignmentShift(random);
+			const StagingRing::Allocation allocation = ring.allocate(size(random), alignment);
+			if (ringBuffer == VK_NULL_HANDLE)
+			{
+				ringBuffer = allocation.buffer;
+				ringBase = allocation.ptr - allocation.offset;
+			}
+			if (allocation.buffer != ringBuffer)
+			{
+				++dedicated;
+				continue;
+			}
+			CHECK(allocation.offset % alignment == 0);
+			CHECK(allocation.offset + allocation.size <= LARGE_RING_CAPACITY);
+			CHECK(allocation.ptr == ringBase + allocation.offset);
+
+			// the signaller only moves forward, whatever is still pending now was pending inside allocate
+			const uint64_t completed = timeline.getCompletedValue();
+			std::erase_if(liveRegions, [completed](const LiveRegion& region) { return region.value != 0 && region.value <= completed; });
+			for (const LiveRegion& region : liveRegions)
+			{
+				overlapping += overlaps(region.offset, region.size, allocation.offset, allocation.size) ? 1U : 0U;
+			}
+			memset(allocation.ptr, i & 0xFF, allocation.size);
+			liveRegions.push_back({ .offset = allocation.offset, .size = allocation.size, .value = 0 });
+
+			if (--batch == 0)
+			{
+				const uint64_t value = timeline.nextValue();
+				ring.retire(value);
+				for (LiveRegion& region : liveRegions)
+				{
+					region.value = region.value == 0 ? value : region.value;
+				}
+				signaller.submit(value);
+				batch = batchSize(random);
+			}
+		}
+		const uint64_t value = timeline.nextValue();
+		ring.retire(value);
+		signaller.submit(value);
+	}
+	CHECK(overlapping == 0);
+	// every batch fits the ring, the allocator always waits instead
+	CHECK(dedicated == 0);
+
+	ring.deinit();
+	timeline.deinit();
+}
+
+int main()
+{
+	Log::Init();
+
+	vkb::InstanceBuilder builder;
+	const auto instanceResult = builder.set_app_name("Staging Ring Test")
+		.require_api_version(1, 3, 0)
+		.set_headless()
+		.build();
+	if (!instanceResult)
+	{
+		std::printf("No Vulkan instance, skipping: %s\n", instanceResult.error().message().c_str());
+		return SKIP_RETURN_CODE;
+	}
+	const vkb::Instance instance = instanceResult.value();
+
+	// the ring waits on the timeline, nothing else is needed
+	const VkPhysicalDeviceVulkan12Features features12{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.timelineSemaphore = VK_TRUE,
+	};
+	vkb::PhysicalDeviceSelector selector{ instance };
+	const auto physicalDeviceResult = selector
+		.set_minimum_version(1, 2)
+		.set_required_features_12(features12)
+		.select();
+	if (!physicalDeviceResult)
+	{
+		std::printf("No Vulkan device, skipping: %s\n", physicalDeviceResult.error().message().c_str());
+		vkb::destroy_instance(instance);
+		return SKIP_RETURN_CODE;
+	}
+
+	const vkb::Device vkbDevice = vkb::DeviceBuilder{ physicalDeviceResult.value() }.build().value();
+	device = vkbDevice.device;
+
+	const VmaAllocatorCreateInfo allocatorInfo = {
+		.physicalDevice = vkbDevice.physical_device.physical_device,
+		.device = device,
+		.instance = instance.instance,
+	};
+	VmaAllocator allocator;
+	vmaCreateAllocator(&allocatorInfo, &allocator);
+	ResourceManager::ptr = new ResourceManager(device, allocator);
+
+	const int result = Test::Run({
+		{ "allocations are aligned and in order", &allocationsAreAlignedAndInOrder },
+		{ "regions wrap without splitting", &regionsWrapWithoutSplitting },
+		{ "requests that don't fit get dedicated buffers", &requestsThatDontFitGetDedicatedBuffers },
+		{ "pending regions are never handed out", &pendingRegionsAreNeverHandedOut },
+		});
+
+	delete ResourceManager::ptr;
+	ResourceManager::ptr = nullptr;
+	vmaDestroyAllocator(allocator);
+	vkb::destroy_device(vkbDevice);
+	vkb::destroy_instance(instance);
+	return result;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdio>
+#include <initializer_list>
+#include <utility>
+
+/*
+*
+* Test: Just enough of a harness for the unit tests. A failed CHECK prints where it failed and the case keeps
+*			running, every test executable returns non zero once any check has failed so CTest reports it.
+*
+*/
+namespace Test
+{
+	typedef std::pair<const char*, void(*)()> Case;
+
+	inline int failedChecks = 0;
+
+	inline void Check(bool condition, const char* expression, const char* file, int line)
+	{
+		if (!condition)
+		{
+			std::printf("%s(%d): CHECK(%s) failed\n", file, line, expression);
+			++failedChecks;
+		}
+	}
+
+	inline int Run(std::initializer_list<Case> cases)
+	{
+		for (const Case& testCase : cases)
+		{
+			const int failedBefore = failedChecks;
+			testCase.second();
+			std::printf("[%s] %s\n", failedChecks == failedBefore ? "  OK  " : "FAILED", testCase.first);
+		}
+		return failedChecks == 0 ? 0 : 1;
+	}
+}
+
+#define CHECK(condition) ::Test::Check((condition), #condition, __FILE__, __LINE__)
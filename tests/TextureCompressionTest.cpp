@@ -0,0 +1,277 @@
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#include "Test.h"
+
+// Sixteen RGBA8 texels in row order, what every block encoder takes
+typedef std::array<uint8_t, 64> Block;
+
+// Reads a block's fields the way the format specifications lay them out, least significant bit first
+struct BitReader
+{
+	const uint8_t* data;
+	uint32_t position = 0;
+
+	uint32_t read(uint32_t count)
+	{
+		uint32_t value = 0;
+		for (uint32_t bit = 0; bit < count; ++bit, ++position)
+		{
+			value |= ((data[position / 8] >> (position % 8)) & 1U) << bit;
+		}
+		return value;
+	}
+};
+
+// Reference decoders, written from the specifications rather than the encoders
+static void decodeBC1(const uint8_t* block, Block& outTexels)
+{
+	uint16_t colours[2];
+	memcpy(colours, block, sizeof(colours));
+	int palette[4][3];
+	for (int e = 0; e < 2; ++e)
+	{
+		const int r = (colours[e] >> 11) & 31;
+		const int g = (colours[e] >> 5) & 63;
+		const int b = colours[e] & 31;
+		palette[e][0] = (r << 3) | (r >> 2);
+		palette[e][1] = (g << 2) | (g >> 4);
+		palette[e][2] = (b << 3) | (b >> 2);
+	}
+	for (int c = 0; c < 3; ++c)
+	{
+		if (colours[0] > colours[1])
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	BitReader reader{ block + 4 };
+	for (int i = 0; i < 16; ++i)
+	{
+		const uint32_t index = reader.read(2);
+		for (int c = 0; c < 3; ++c)
+		{
+			outTexels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+		}
+		outTexels[i * 4 + 3] = colours[0] <= colours[1] && index == 3 ? 0 : 255;
+	}
+}
+
+static void decodeBC4(const uint8_t* block, uint32_t channel, Block& outTexels)
+{
+	const int first = block[0];
+	const int second = block[1];
+	int palette[8] = { first, second };
+	if (first > second)
+	{
+		for (int i = 1; i < 7; ++i)
+		{
+			palette[i + 1] = ((7 - i) * first + i * second) / 7;
+		}
+	}
+	else
+	{
+		for (int i = 1; i < 5; ++i)
+		{
+			palette[i + 1] = ((5 - i) * first + i * second) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	BitReader reader{ block + 2 };
+	for (int i = 0; i < 16; ++i)
+	{
+		outTexels[i * 4 + channel] = static_cast<uint8_t>(palette[reader.read(3)]);
+	}
+}
+
+// Mode 6 is the only one the encoder writes
+static bool decodeBC7(const uint8_t* block, Block& outTexels)
+{
+	constexpr int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	BitReader reader{ block };
+	if (reader.read(7) != 1U << 6)
+	{
+		return false;
+	}
+	int endpoints[2][4];
+	for (int c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = static_cast<int>(reader.read(7)) << 1;
+		endpoints[1][c] = static_cast<int>(reader.read(7)) << 1;
+	}
+	for (int e = 0; e < 2; ++e)
+	{
+		const int pBit = static_cast<int>(reader.read(1));
+		for (int c = 0; c < 4; ++c)
+		{
+			endpoints[e][c] |= pBit;
+		}
+	}
+	for (int i = 0; i < 16; ++i)
+	{
+		const int weight = WEIGHTS[reader.read(i == 0 ? 3 : 4)];
+		for (int c = 0; c < 4; ++c)
+		{
+			outTexels[i * 4 + c] = static_cast<uint8_t>(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+		}
+	}
+	return true;
+}
+
+// Over the channels from first up to, but not including, last
+static double psnr(const Block& original, const Block& decoded, uint32_t first, uint32_t last)
+{
+	double squaredError = 0.0;
+	for (int i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = first; c < last; ++c)
+		{
+			const double difference = static_cast<double>(original[i * 4 + c]) - decoded[i * 4 + c];
+			squaredError += difference * difference;
+		}
+	}
+	const double meanSquaredError = squaredError / (16.0 * (last - first));
+	return meanSquaredError == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+static Block makeBlock(const std::function<std::array<uint8_t, 4>(int x, int y)>& texel)
+{
+	Block block;
+	for (int y = 0; y < 4; ++y)
+	{
+		for (int x = 0; x < 4; ++x)
+		{
+			const std::array<uint8_t, 4> value = texel(x, y);
+			std::copy(value.begin(), value.end(), block.begin() + (y * 4 + x) * 4);
+		}
+	}
+	return block;
+}
+
+static Block flatBlock()
+{
+	return makeBlock([](int, int) { return std::array<uint8_t, 4>{ 90, 140, 200, 255 }; });
+}
+
+// A ramp between two colours across the block, what one line through colour space fits
+static Block gradientBlock()
+{
+	return makeBlock([](int x, int) {
+		return std::array<uint8_t, 4>{ static_cast<uint8_t>(20 + 60 * x), static_cast<uint8_t>(60 + 40 * x),
+			static_cast<uint8_t>(200 - 50 * x), static_cast<uint8_t>(255 - 20 * x) };
+		});
+}
+
+static Block twoColourBlock()
+{
+	return makeBlock([](int x, int y) {
+		return (x + y) % 2 == 0 ? std::array<uint8_t, 4>{ 230, 40, 30, 255 } : std::array<uint8_t, 4>{ 20, 60, 220, 255 };
+		});
+}
+
+// xy of a bump's normals, encoded the way normal maps store them
+static Block normalBlock()
+{
+	return makeBlock([](int x, int y) {
+		const float nx = 0.5f * std::sin(0.9f * x + 0.3f);
+		const float ny = 0.4f * std::cos(0.7f * y + 0.2f);
+		return std::array<uint8_t, 4>{ static_cast<uint8_t>(nx * 127.5f + 128.0f), static_cast<uint8_t>(ny * 127.5f + 128.0f), 0, 255 };
+		});
+}
+
+// The floors sit a few dB under what the encoders reach, a regression in endpoint fitting drops well below them
+static void bc1KeepsColourBlocksClose()
+{
+	uint8_t encoded[8];
+	Block decoded;
+	const auto roundTrip = [&](const Block& block) {
+		TextureCompression::CompressBlockBC1(block.data(), encoded);
+		decodeBC1(encoded, decoded);
+		return psnr(block, decoded, 0, 3);
+	};
+	CHECK(roundTrip(flatBlock()) >= 40.0);
+	CHECK(roundTrip(gradientBlock()) >= 38.0);
+	// two colours are the endpoints themselves, only 565 rounding is lost
+	CHECK(roundTrip(twoColourBlock()) >= 38.0);
+	// opaque blocks stay in the four colour mode
+	const Block gradient = gradientBlock();
+	TextureCompression::CompressBlockBC1(gradient.data(), encoded);
+	decodeBC1(encoded, decoded);
+	bool opaque = true;
+	for (int i = 0; i < 16; ++i)
+	{
+		opaque = opaque && decoded[i * 4 + 3] == 255;
+	}
+	CHECK(opaque);
+}
+
+static void bc4AndBc5KeepChannelsClose()
+{
+	uint8_t encoded[16];
+	Block decoded{};
+	const Block gradient = gradientBlock();
+	TextureCompression::CompressBlockBC4(gradient.data(), 1, encoded);
+	decodeBC4(encoded, 1, decoded);
+	CHECK(psnr(gradient, decoded, 1, 2) >= 34.0);
+
+	// a flat channel is exact
+	const Block flat = flatBlock();
+	TextureCompression::CompressBlockBC4(flat.data(), 2, encoded);
+	decodeBC4(encoded, 2, decoded);
+	CHECK(psnr(flat, decoded, 2, 3) == 99.0);
+
+	const Block normals = normalBlock();
+	TextureCompression::CompressBlockBC5(normals.data(), encoded);
+	decodeBC4(encoded, 0, decoded);
+	decodeBC4(encoded + 8, 1, decoded);
+	CHECK(psnr(normals, decoded, 0, 2) >= 36.0);
+}
+
+static void bc7KeepsColourBlocksClose()
+{
+	uint8_t encoded[16];
+	Block decoded;
+	const auto roundTrip = [&](const Block& block) {
+		TextureCompression::CompressBlockBC7(block.data(), encoded);
+		return decodeBC7(encoded, decoded) ? psnr(block, decoded, 0, 4) : 0.0;
+	};
+	CHECK(roundTrip(flatBlock()) >= 50.0);
+	CHECK(roundTrip(gradientBlock()) >= 48.0);
+	CHECK(roundTrip(twoColourBlock()) >= 50.0);
+}
+
+static void levelSizesRoundUpToWholeBlocks()
+{
+	using RenderableTypes::BlockFormat;
+	CHECK(TextureCompression::GetLevelSize(BlockFormat::BC7, 4, 4, 4) == 16);
+	CHECK(TextureCompression::GetLevelSize(BlockFormat::BC7, 5, 3, 4) == 32);
+	CHECK(TextureCompression::GetLevelSize(BlockFormat::BC1, 1, 1, 4) == 8);
+	CHECK(TextureCompression::GetLevelSize(BlockFormat::BC4, 9, 2, 1) == 24);
+	CHECK(TextureCompression::GetLevelSize(BlockFormat::BC5, 6, 9, 2) == 96);
+	CHECK(TextureCompression::GetLevelSize(BlockFormat::BC5, 1, 7, 2) == 32);
+	// uncompressed levels are tightly packed texels
+	CHECK(TextureCompression::GetLevelSize(BlockFormat::NONE, 5, 3, 1) == 15);
+	CHECK(TextureCompression::GetLevelSize(BlockFormat::NONE, 5, 3, 2) == 30);
+}
+
+int main()
+{
+	return Test::Run({
+		{ "BC1 keeps colour blocks close", &bc1KeepsColourBlocksClose },
+		{ "BC4 and BC5 keep channels close", &bc4AndBc5KeepChannelsClose },
+		{ "BC7 keeps colour blocks close", &bc7KeepsColourBlocksClose },
+		{ "level sizes round up to whole blocks", &levelSizesRoundUpToWholeBlocks },
+		});
+}
@@ -0,0 +1,181 @@
+#include "Graphics/TextureStreamer.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "Test.h"
+
+// 256x256 RGBA8, nine levels with 64x64 as the finest always resident one
+constexpr uint32_t TAIL_MIP = 2;
+constexpr size_t FULL_CHAIN = 349524;
+constexpr size_t CHAIN_FROM_MIP1 = 87380;
+constexpr size_t TAIL_CHAIN = 21844;
+constexpr size_t UNLIMITED = ~size_t{ 0 };
+
+// The whole chain in blocks, the way a compressed or KTX2 texture arrives
+static std::unique_ptr<RenderableTypes::Texture> makeTexture(int width, int height)
+{
+	auto texture = std::make_unique<RenderableTypes::Texture>();
+	texture->texWidth = width;
+	texture->texHeight = height;
+	texture->texChannels = 4;
+	const uint32_t mipCount = RenderableTypes::TextureUtil::GetMipCount(width, height);
+	std::vector<size_t> offsets;
+	for (uint32_t mip = 0; mip < mipCount; ++mip)
+	{
+		offsets.push_back(texture->blocks.size());
+		texture->blocks.resize(texture->blocks.size() + std::max(width >> mip, 1) * std::max(height >> mip, 1) * 4);
+	}
+	offsets.push_back(texture->blocks.size());
+	for (uint32_t mip = 0; mip < mipCount; ++mip)
+	{
+		texture->levels.emplace_back(texture->blocks.data() + offsets[mip], offsets[mip + 1] - offsets[mip]);
+	}
+	return texture;
+}
+
+static void commitAll(TextureStreamer& streamer, const std::vector<TextureStreamer::Change>& changes)
+{
+	for (const TextureStreamer::Change& change : changes)
+	{
+		streamer.commit(change);
+	}
+}
+
+static void texturesStartAtTheTail()
+{
+	// the full chains and tails of the 512x64 and 32x16 textures
+	constexpr size_t WIDE_CHAIN = 174780;
+	constexpr size_t WIDE_TAIL_CHAIN = 2748;
+	constexpr size_t SMALL_CHAIN = 2732;
+
+	TextureStreamer streamer;
+	CHECK(streamer.add(0, makeTexture(256, 256)) == TAIL_MIP);
+	// the larger side decides, 64x8 is the first level that fits
+	CHECK(streamer.add(1, makeTexture(512, 64)) == 3);
+	// already small enough to be resident whole
+	CHECK(streamer.add(3, makeTexture(32, 16)) == 0);
+
+	CHECK(streamer.isStreamed(0) && streamer.isStreamed(1) && !streamer.isStreamed(2) && streamer.isStreamed(3));
+	CHECK(streamer.getBaseMip(0) == TAIL_MIP);
+	CHECK(streamer.getTotalSize() == FULL_CHAIN + WIDE_CHAIN + SMALL_CHAIN);
+	CHECK(streamer.getResidentSize() == TAIL_CHAIN + WIDE_TAIL_CHAIN + SMALL_CHAIN);
+
+	// nothing was requested past the tail, so nothing changes
+	streamer.beginRequests(1);
+	CHECK(streamer.plan(UNLIMITED, UNLIMITED).empty());
+
+	streamer.remove(1);
+	CHECK(!streamer.isStreamed(1) && streamer.getBaseMip(1) == 0);
+	CHECK(streamer.getTotalSize() == FULL_CHAIN + SMALL_CHAIN);
+	CHECK(streamer.getResidentSize() == TAIL_CHAIN + SMALL_CHAIN);
+}
+
+static void requestsLoadWhenTheBudgetsAllow()
+{
+	TextureStreamer streamer;
+	streamer.add(0, makeTexture(256, 256));
+	streamer.add(1, makeTexture(256, 256));
+	streamer.beginRequests(1);
+	streamer.requestMip(0, 0);
+	streamer.requestMip(1, 1);
+	// requests in a frame only ever lower the level
+	streamer.requestMip(1, 4);
+
+	const std::vector<TextureStreamer::Change> changes = streamer.plan(UNLIMITED, UNLIMITED);
+	CHECK(changes.size() == 2);
+	CHECK(changes.size() == 2 && changes[0].handle == 0 && changes[0].baseMip == 0 && changes[0].uploadSize == FULL_CHAIN);
+	CHECK(changes.size() == 2 && changes[1].handle == 1 && changes[1].baseMip == 1 && changes[1].uploadSize == CHAIN_FROM_MIP1);
+
+	commitAll(streamer, changes);
+	CHECK(streamer.getBaseMip(0) == 0 && streamer.getBaseMip(1) == 1);
+	CHECK(streamer.getResidentSize() == FULL_CHAIN + CHAIN_FROM_MIP1);
+	CHECK(streamer.plan(UNLIMITED, UNLIMITED).empty());
+
+	RenderableTypes::Texture levels;
+	streamer.getLevels(1, 1, levels);
+	CHECK(levels.texWidth == 128 && levels.texHeight == 128 && levels.levels.size() == 8);
+}
+
+static void uploadBudgetLimitsEachFrame()
+{
+	TextureStreamer streamer;
+	streamer.add(0, makeTexture(256, 256));
+	streamer.add(1, makeTexture(256, 256));
+	streamer.beginRequests(1);
+	streamer.requestMip(0, 0);
+	streamer.requestMip(1, 1);
+
+	// the largest shortfall goes first and takes the coarser level that fits, the other one waits
+	const std::vector<TextureStreamer::Change> partial = streamer.plan(100000, UNLIMITED);
+	CHECK(partial.size() == 1);
+	CHECK(partial.size() == 1 && partial[0].handle == 0 && partial[0].baseMip == 1 && partial[0].uploadSize == CHAIN_FROM_MIP1);
+
+	// a level larger than the whole budget still goes in as the first upload, one level at a time
+	const std::vector<TextureStreamer::Change> oversized = streamer.plan(1000, UNLIMITED);
+	CHECK(oversized.size() == 1);
+	CHECK(oversized.size() == 1 && oversized[0].handle == 0 && oversized[0].baseMip == 1);
+	commitAll(streamer, oversized);
+
+	const std::vector<TextureStreamer::Change> next = streamer.plan(1000, UNLIMITED);
+	CHECK(next.size() == 1 && next[0].handle == 0 && next[0].baseMip == 0 && next[0].uploadSize == FULL_CHAIN);
+	commitAll(streamer, next);
+	CHECK(streamer.getResidentSize() == FULL_CHAIN + TAIL_CHAIN);
+}
+
+static void memoryLimitCapsLoads()
+{
+	TextureStreamer streamer;
+	streamer.add(0, makeTexture(256, 256));
+	streamer.add(1, makeTexture(256, 256));
+	streamer.beginRequests(1);
+	streamer.requestMip(0, 0);
+	streamer.requestMip(1, 1);
+
+	// room for one more level on one texture
+	const size_t limit = CHAIN_FROM_MIP1 + TAIL_CHAIN;
+	const std::vector<TextureStreamer::Change> changes = streamer.plan(UNLIMITED, limit);
+	CHECK(changes.size() == 1);
+	CHECK(changes.size() == 1 && changes[0].handle == 0 && changes[0].baseMip == 1);
+	commitAll(streamer, changes);
+	CHECK(streamer.getResidentSize() <= limit);
+}
+
+static void evictionDropsUnusedTexturesFirst()
+{
+	TextureStreamer streamer;
+	streamer.add(0, makeTexture(256, 256));
+	streamer.add(1, makeTexture(256, 256));
+	streamer.beginRequests(1);
+	streamer.requestMip(0, 0);
+	streamer.requestMip(1, 0);
+	commitAll(streamer, streamer.plan(UNLIMITED, UNLIMITED));
+	CHECK(streamer.getResidentSize() == 2 * FULL_CHAIN);
+
+	// only the second texture is still seen, the first drops straight to the tail
+	streamer.beginRequests(2);
+	streamer.requestMip(1, 0);
+	const std::vector<TextureStreamer::Change> evicted = streamer.plan(UNLIMITED, FULL_CHAIN + CHAIN_FROM_MIP1);
+	CHECK(evicted.size() == 1);
+	CHECK(evicted.size() == 1 && evicted[0].handle == 0 && evicted[0].baseMip == TAIL_MIP && evicted[0].uploadSize == TAIL_CHAIN);
+	commitAll(streamer, evicted);
+	CHECK(streamer.getResidentSize() == FULL_CHAIN + TAIL_CHAIN);
+
+	// a texture that still needs its levels loses only the finest one
+	const std::vector<TextureStreamer::Change> squeezed = streamer.plan(UNLIMITED, CHAIN_FROM_MIP1 + TAIL_CHAIN);
+	CHECK(squeezed.size() == 1 && squeezed[0].handle == 1 && squeezed[0].baseMip == 1);
+	commitAll(streamer, squeezed);
+	CHECK(streamer.getResidentSize() == CHAIN_FROM_MIP1 + TAIL_CHAIN);
+}
+
+int main()
+{
+	return Test::Run({
+		{ "textures start at the tail", &texturesStartAtTheTail },
+		{ "requests load when the budgets allow", &requestsLoadWhenTheBudgetsAllow },
+		{ "upload budget limits each frame", &uploadBudgetLimitsEachFrame },
+		{ "memory limit caps loads", &memoryLimitCapsLoads },
+		{ "eviction drops unused textures first", &evictionDropsUnusedTexturesFirst },
+		});
+}
@@ -0,0 +1,274 @@
+#include "RenderableTypes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Jobs/JobSystem.h"
+#include "Log.h"
+#include "Test.h"
+
+static size_t getLevelSize(uint32_t width, uint32_t height, uint32_t channels, uint32_t mip)
+{
+	return static_cast<size_t>(std::max(width >> mip, 1U)) * std::max(height >> mip, 1U) * channels;
+}
+
+// Offsets of levels 1 and up in what the generators append, after whatever outMips held before
+static std::vector<size_t> getLevelOffsets(uint32_t width, uint32_t height, uint32_t channels, size_t firstOffset)
+{
+	std::vector<size_t> offsets{ 0, firstOffset };
+	for (uint32_t mip = 1; mip < RenderableTypes::TextureUtil::GetMipCount(width, height); ++mip)
+	{
+		offsets.push_back(offsets.back() + getLevelSize(width, height, channels, mip));
+	}
+	return offsets;
+}
+
+static void chainsReachOneByOne()
+{
+	CHECK(RenderableTypes::TextureUtil::GetMipCount(1, 1) == 1);
+	CHECK(RenderableTypes::TextureUtil::GetMipCount(256, 256) == 9);
+	CHECK(RenderableTypes::TextureUtil::GetMipCount(300, 17) == 9);
+	CHECK(RenderableTypes::TextureUtil::GetMipCount(1, 37) == 6);
+
+	struct Case
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t channels;
+	};
+	for (const Case& size : { Case{ 300, 17, 4 }, Case{ 1, 37, 1 }, Case{ 37, 1, 2 }, Case{ 5, 3, 4 }, Case{ 1, 1, 4 } })
+	{
+		const std::vector<uint8_t> level0(getLevelSize(size.width, size.height, size.channels, 0), 77);
+		// the levels are appended, what was there before stays
+		std::vector<uint8_t> mips{ 1, 2, 3 };
+		RenderableTypes::TextureUtil::GenerateMips(level0.data(), size.width, size.height, size.channels, false, mips);
+		const std::vector<size_t> offsets = getLevelOffsets(size.width, size.height, size.channels, 3);
+		CHECK(mips.size() == offsets.back());
+		CHECK(mips[0] == 1 && mips[1] == 2 && mips[2] == 3);
+		// a flat image stays flat down to 1x1, the repeated odd edges included
+		CHECK(std::all_of(mips.begin() + 3, mips.end(), [](uint8_t value) { return value == 77; }));
+	}
+
+	std::vector<uint8_t> normalMips;
+	const std::vector<uint8_t> flatNormals(getLevelSize(7, 12, 2, 0), 128);
+	RenderableTypes::TextureUtil::GenerateNormalMips(flatNormals.data(), 7, 12, normalMips);
+	CHECK(normalMips.size() == getLevelOffsets(7, 12, 2, 0).back());
+}
+
+static void linearChannelsAreBoxFiltered()
+{
+	// a single row, the filter reads it twice
+	const uint8_t row[] = { 0, 100, 200, 255 };
+	std::vector<uint8_t> mips;
+	RenderableTypes::TextureUtil::GenerateMips(row, 4, 1, 1, false, mips);
+	CHECK(mips.size() == 3 && mips[0] == 50 && mips[1] == 228 && mips[2] == 139);
+
+	const uint8_t texels[] = {
+		0, 10, 20, 30,   4, 14, 24, 34,
+		8, 18, 28, 38,   12, 22, 32, 255,
+	};
+	mips.clear();
+	RenderableTypes::TextureUtil::GenerateMips(texels, 2, 2, 4, false, mips);
+	CHECK(mips.size() == 4 && mips[0] == 6 && mips[1] == 16 && mips[2] == 26 && mips[3] == 89);
+}
+
+static void srgbIsAveragedInLinearSpace()
+{
+	// half black and half white is half the light, which sRGB stores well above 128
+	const uint8_t texels[] = {
+		0, 0, 0, 0,   255, 255, 255, 255,
+		255, 255, 255, 255,   0, 0, 0, 0,
+	};
+	std::vector<uint8_t> mips;
+	RenderableTypes::TextureUtil::GenerateMips(texels, 2, 2, 4, true, mips);
+	CHECK(mips.size() == 4);
+	CHECK(mips.size() == 4 && mips[0] >= 187 && mips[0] <= 189 && mips[0] == mips[1] && mips[1] == mips[2]);
+	// alpha is linear
+	CHECK(mips.size() == 4 && mips[3] == 128);
+
+	// flat colours survive the round trip through linear space
+	bool stable = true;
+	for (uint32_t value = 0; value < 256; ++value)
+	{
+		const std::vector<uint8_t> flat(2 * 2 * 4, static_cast<uint8_t>(value));
+		mips.clear();
+		RenderableTypes::TextureUtil::GenerateMips(flat.data(), 2, 2, 4, true, mips);
+		stable = stable && std::abs(mips[0] - static_cast<int>(value)) <= 1 && mips[3] == value;
+	}
+	CHECK(stable);
+}
+
+static glm::vec3 decodeNormal(const uint8_t* texel)
+{
+	const float x = texel[0] * (2.0f / 255.0f) - 1.0f;
+	const float y = texel[1] * (2.0f / 255.0f) - 1.0f;
+	return { x, y, std::sqrt(std::max(1.0f - x * x - y * y, 0.0f)) };
+}
+
+static void normalLevelsStayUnitLength()
+{
+	constexpr uint32_t WIDTH = 37;
+	constexpr uint32_t HEIGHT = 23;
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> tilt(0.0f, 1.2f);
+	std::vector<uint8_t> level0(getLevelSize(WIDTH, HEIGHT, 2, 0));
+	for (size_t i = 0; i < level0.size(); i += 2)
+	{
+		const float around = angle(random);
+		const float away = tilt(random);
+		level0[i] = static_cast<uint8_t>(std::sin(away) * std::cos(around) * 127.5f + 128.0f);
+		level0[i + 1] = static_cast<uint8_t>(std::sin(away) * std::sin(around) * 127.5f + 128.0f);
+	}
+	std::vector<uint8_t> mips;
+	RenderableTypes::TextureUtil::GenerateNormalMips(level0.data(), WIDTH, HEIGHT, mips);
+	const std::vector<size_t> offsets = getLevelOffsets(WIDTH, HEIGHT, 2, 0);
+	CHECK(mips.size() == offsets.back());
+
+	// every texel is the renormalised sum of the four above it, not their shorter average, so z rebuilt from
+	// xy points the same way
+	float largestLength = 0.0f;
+	float largestError = 0.0f;
+	for (uint32_t mip = 1; mip + 1 < offsets.size(); ++mip)
+	{
+		const uint8_t* source = mip == 1 ? level0.data() : mips.data() + offsets[mip - 1];
+		const uint8_t* level = mips.data() + offsets[mip];
+		const uint32_t sourceWidth = std::max(WIDTH >> (mip - 1), 1U);
+		const uint32_t sourceHeight = std::max(HEIGHT >> (mip - 1), 1U);
+		const uint32_t width = std::max(WIDTH >> mip, 1U);
+		const uint32_t height = std::max(HEIGHT >> mip, 1U);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				glm::vec3 sum{ 0.0f };
+				for (const uint32_t dy : { 0U, 1U })
+				{
+					for (const uint32_t dx : { 0U, 1U })
+					{
+						const uint32_t sourceX = std::min(2 * x + dx, sourceWidth - 1);
+						const uint32_t sourceY = std::min(2 * y + dy, sourceHeight - 1);
+						sum += decodeNormal(source + (static_cast<size_t>(sourceY) * sourceWidth + sourceX) * 2);
+					}
+				}
+				const uint8_t* texel = level + (static_cast<size_t>(y) * width + x) * 2;
+				const float x2 = texel[0] * (2.0f / 255.0f) - 1.0f;
+				const float y2 = texel[1] * (2.0f / 255.0f) - 1.0f;
+				largestLength = std::max(largestLength, std::sqrt(x2 * x2 + y2 * y2));
+				largestError = std::max(largestError, glm::length(decodeNormal(texel) - glm::normalize(sum)));
+			}
+		}
+	}
+	// within the 8 bit quantisation of the texels
+	CHECK(largestLength <= 1.0f + 2.0f / 255.0f);
+	CHECK(largestError < 0.02f);
+}
+
+static void jobsProduceTheSameLevels()
+{
+	constexpr uint32_t WIDTH = 300;
+	constexpr uint32_t HEIGHT = 260;
+	std::mt19937 random(6);
+	std::vector<uint8_t> level0(getLevelSize(WIDTH, HEIGHT, 4, 0));
+	for (uint8_t& value : level0)
+	{
+		value = static_cast<uint8_t>(random());
+	}
+	std::vector<uint8_t> serial;
+	RenderableTypes::TextureUtil::GenerateMips(level0.data(), WIDTH, HEIGHT, 4, true, serial);
+	std::vector<uint8_t> serialNormals;
+	RenderableTypes::TextureUtil::GenerateNormalMips(level0.data(), WIDTH, HEIGHT, serialNormals);
+
+	// the big levels are split into row ranges across the workers
+	Jobs::JobSystem jobSystem(3);
+	Jobs::JobSystem::ptr = &jobSystem;
+	std::vector<uint8_t> parallel;
+	RenderableTypes::TextureUtil::GenerateMips(level0.data(), WIDTH, HEIGHT, 4, true, parallel);
+	std::vector<uint8_t> parallelNormals;
+	RenderableTypes::TextureUtil::GenerateNormalMips(level0.data(), WIDTH, HEIGHT, parallelNormals);
+	Jobs::JobSystem::ptr = nullptr;
+
+	CHECK(parallel == serial);
+	CHECK(parallelNormals == serialNormals);
+}
+
+// What each request should decode to, a missing file hands out an empty texture
+struct ExpectedTexture
+{
+	int size;
+	int channels;
+};
+
+static void checkLoadOrder()
+{
+	using Format = RenderableTypes::TextureDesc::Format;
+	const std::string textures = std::string(TEST_ASSET_DIRECTORY) + "textures/";
+	const std::vector<RenderableTypes::TextureLoadRequest> requests = {
+		{ .path = textures + "default.png", .desc = { .format = Format::DEFAULT } },
+		{ .path = textures + "texture.jpg", .desc = { .format = Format::R8 } },
+		{ .path = textures + "missing.png", .desc = { .format = Format::DEFAULT } },
+		// much larger than the rest, it finishes after requests behind it
+		{ .path = textures + "beehive/beehive_orm.png", .desc = { .format = Format::ORM } },
+		{ .path = textures + "default.png", .desc = { .format = Format::RG8 } },
+		{ .path = textures + "texture.jpg", .desc = { .format = Format::DEFAULT } },
+		{ .path = textures + "default.png", .desc = { .format = Format::R8 } },
+		{ .path = textures + "texture.jpg", .desc = { .format = Format::RG8 } },
+	};
+	const ExpectedTexture expected[] = { { 400, 4 }, { 512, 1 }, { 0, 0 }, { 2048, 4 }, { 400, 2 }, { 512, 4 }, { 400, 1 }, { 512, 2 } };
+
+	// handles are handed out in request order up front, the callback only fills in what each one holds
+	std::vector<RenderableTypes::TextureHandle> handles(requests.size());
+	for (uint32_t i = 0; i < requests.size(); ++i)
+	{
+		handles[i] = i + 1;
+	}
+	std::vector<uint32_t> calls(requests.size(), 0);
+	std::vector<ExpectedTexture> loaded(requests.size() + 1, ExpectedTexture{ -1, -1 });
+	bool onCallingThread = true;
+	const std::thread::id callingThread = std::this_thread::get_id();
+	RenderableTypes::TextureUtil::LoadTextures(requests, [&](uint32_t index, RenderableTypes::Texture& texture) {
+		onCallingThread = onCallingThread && std::this_thread::get_id() == callingThread;
+		if (index < requests.size())
+		{
+			++calls[index];
+			loaded[handles[index]] = { texture.ptr != nullptr ? texture.texWidth : 0, texture.ptr != nullptr ? texture.texChannels : 0 };
+		}
+		});
+
+	CHECK(onCallingThread);
+	CHECK(std::all_of(calls.begin(), calls.end(), [](uint32_t count) { return count == 1; }));
+	bool matched = true;
+	for (uint32_t i = 0; i < requests.size(); ++i)
+	{
+		matched = matched && loaded[handles[i]].size == expected[i].size && loaded[handles[i]].channels == expected[i].channels;
+	}
+	CHECK(matched);
+}
+
+static void texturesArriveOncePerRequest()
+{
+	Log::Init();
+	checkLoadOrder();
+
+	// and decoded on the workers, finishing in any order
+	Jobs::JobSystem jobSystem(3);
+	Jobs::JobSystem::ptr = &jobSystem;
+	checkLoadOrder();
+	Jobs::JobSystem::ptr = nullptr;
+}
+
+int main()
+{
+	return Test::Run({
+		{ "chains reach 1x1", &chainsReachOneByOne },
+		{ "linear channels are box filtered", &linearChannelsAreBoxFiltered },
+		{ "sRGB is averaged in linear space", &srgbIsAveragedInLinearSpace },
+		{ "normal levels stay unit length", &normalLevelsStayUnitLength },
+		{ "jobs produce the same levels", &jobsProduceTheSameLevels },
+		{ "textures arrive once per request", &texturesArriveOncePerRequest },
+		});
+}